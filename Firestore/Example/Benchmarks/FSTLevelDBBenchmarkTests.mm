@@ -17,27 +17,39 @@
 #import <Foundation/Foundation.h>
 #import <XCTest/XCTest.h>
 #include <cstdint>
+#include <string>
+#include <vector>
 
 #include "benchmark/benchmark.h"
 
+#import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
 #import "Firestore/Source/Local/FSTLocalSerializer.h"
 #import "Firestore/Source/Remote/FSTSerializerBeta.h"
 
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
+#include "Firestore/core/src/firebase/firestore/util/path.h"
+#include "Firestore/core/src/firebase/firestore/util/status.h"
 #include "Firestore/core/src/firebase/firestore/util/string_format.h"
+#include "absl/strings/str_cat.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
 using firebase::firestore::local::LevelDbRemoteDocumentKey;
-using firebase::firestore::local::LevelDbTargetDocumentKey;
+using firebase::firestore::local::LevelDbTargetDocuments;
 using firebase::firestore::local::LevelDbTransaction;
+using firebase::firestore::local::LruParams;
 using firebase::firestore::model::DatabaseId;
 using firebase::firestore::model::DocumentKey;
+using firebase::firestore::model::DocumentKeySet;
 using firebase::firestore::model::TargetId;
+using firebase::firestore::util::Path;
+using firebase::firestore::util::Status;
 using firebase::firestore::util::StringFormat;
 
 namespace {
@@ -77,12 +89,14 @@ FSTLevelDB *LevelDBPersistence() {
   FSTSerializerBeta *remoteSerializer = [[FSTSerializerBeta alloc] initWithDatabaseID:&database_id];
   FSTLocalSerializer *serializer =
       [[FSTLocalSerializer alloc] initWithRemoteSerializer:remoteSerializer];
-  FSTLevelDB *db = [[FSTLevelDB alloc] initWithDirectory:dir serializer:serializer];
-  NSError *error;
-  BOOL success = [db start:&error];
-  if (!success) {
+  FSTLevelDB *db;
+  Status status = [FSTLevelDB dbWithDirectory:Path::FromNSString(dir)
+                                   serializer:serializer
+                                    lruParams:LruParams::Disabled()
+                                          ptr:&db];
+  if (!status.ok()) {
     [NSException raise:NSInternalInconsistencyException
-                format:@"Failed to create leveldb path %@: %@", dir, error];
+                format:@"Failed to create leveldb path %@: %s", dir, status.ToString().c_str()];
   }
 
   return db;
@@ -119,7 +133,7 @@ class LevelDBFixture : public benchmark::Fixture {
     // Arbitrary target ID
     TargetId targetID = 1;
     txn.Put(LevelDbDocumentTargetKey::Key(docKey, targetID), emptyBuffer_);
-    txn.Put(LevelDbTargetDocumentKey::Key(targetID, docKey), emptyBuffer_);
+    LevelDbTargetDocuments::AddKeys(&txn, targetID, DocumentKeySet{docKey});
   }
 
   FSTLevelDB *db_;
@@ -168,6 +182,80 @@ BENCHMARK_REGISTER_F(LevelDBFixture, RemoteEvent)
     ->Unit(benchmark::kMicrosecond)
     ->Repetitions(5);
 
+/**
+ * Fills the remote document table with `state.range(0)` documents. Each lookup benchmark then
+ * fetches every `state.range(1)`th document in key order, the access pattern of
+ * RemoteDocumentCache::GetAll.
+ */
+class LevelDBLookupFixture : public benchmark::Fixture {
+  void SetUp(benchmark::State &state) override {
+    db_ = LevelDBPersistence();
+    int64_t numDocuments = state.range(0);
+    int64_t stride = state.range(1);
+
+    LevelDbTransaction txn(db_.ptr, "benchmark");
+    for (int64_t i = 0; i < numDocuments; i++) {
+      auto docKey =
+          DocumentKey::FromPathString(absl::StrCat("docs/doc_", absl::Dec(i, absl::kZeroPad8)));
+      std::string docKeyString = LevelDbRemoteDocumentKey::Key(docKey);
+      txn.Put(docKeyString, DocumentData());
+      if (i % stride == 0) {
+        keys_.push_back(docKeyString);
+      }
+    }
+    txn.Commit();
+    db_.ptr->CompactRange(NULL, NULL);
+  }
+
+  void TearDown(benchmark::State &state) override {
+    keys_.clear();
+    db_ = nil;
+  }
+
+ protected:
+  FSTLevelDB *db_;
+  std::vector<std::string> keys_;
+};
+
+BENCHMARK_DEFINE_F(LevelDBLookupFixture, SeekEachKey)(benchmark::State &state) {
+  for (const auto &_ : state) {
+    LevelDbTransaction txn(db_.ptr, "benchmark");
+    auto it = txn.NewIterator();
+    for (const std::string &key : keys_) {
+      it->Seek(key);
+      benchmark::DoNotOptimize(it->value());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys_.size());
+}
+
+BENCHMARK_DEFINE_F(LevelDBLookupFixture, SeekForward)(benchmark::State &state) {
+  for (const auto &_ : state) {
+    LevelDbTransaction txn(db_.ptr, "benchmark");
+    auto it = txn.NewIterator();
+    for (const std::string &key : keys_) {
+      it->SeekForward(key);
+      benchmark::DoNotOptimize(it->value());
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * keys_.size());
+}
+
+/** Looks up 10k documents, either all adjacent or spread out over the table. */
+static void LookupCases(benchmark::internal::Benchmark *b) {
+  for (int stride = 1; stride <= 64; stride *= 4) {
+    b->Args({10000 * stride, stride});
+  }
+}
+
+BENCHMARK_REGISTER_F(LevelDBLookupFixture, SeekEachKey)
+    ->Apply(LookupCases)
+    ->Unit(benchmark::kMillisecond);
+
+BENCHMARK_REGISTER_F(LevelDBLookupFixture, SeekForward)
+    ->Apply(LookupCases)
+    ->Unit(benchmark::kMillisecond);
+
 @interface FSTLevelDBBenchmarkTests : XCTestCase
 @end
 
@@ -571,6 +571,24 @@ NS_ASSUME_NONNULL_BEGIN
   XCTAssertNotEqual(q51.hash, q61.hash);
 }
 
+- (void)testCanonicalHashCoversLongCanonicalIDs {
+  // -[NSString hash] only looks at the ends and middle of long strings, so these would collide.
+  NSString *padding = [@"" stringByPaddingToLength:100 withString:@"x" startingAtIndex:0];
+  FSTQuery *q1 = [FSTTestQuery("foo")
+      queryByAddingFilter:FSTTestFilter("a", @"==", [padding stringByAppendingString:@"1"])];
+  q1 = [q1 queryByAddingFilter:FSTTestFilter("b", @"==", padding)];
+  FSTQuery *q2 = [FSTTestQuery("foo")
+      queryByAddingFilter:FSTTestFilter("a", @"==", [padding stringByAppendingString:@"2"])];
+  q2 = [q2 queryByAddingFilter:FSTTestFilter("b", @"==", padding)];
+  FSTQuery *q1Copy = [FSTTestQuery("foo")
+      queryByAddingFilter:FSTTestFilter("a", @"==", [padding stringByAppendingString:@"1"])];
+  q1Copy = [q1Copy queryByAddingFilter:FSTTestFilter("b", @"==", padding)];
+
+  XCTAssertEqual(q1.canonicalHash, q1Copy.canonicalHash);
+  XCTAssertNotEqual(q1.canonicalHash, q2.canonicalHash);
+  XCTAssertNotEqual(q1.hash, q2.hash);
+}
+
 - (void)testImplicitOrderBy {
   FSTQuery *baseQuery = FSTTestQuery("foo");
   // Default is ascending
@@ -764,6 +764,44 @@ NS_ASSUME_NONNULL_BEGIN
   [_persistence shutdown];
 }
 
+- (void)testGCRanInSlices {
+  if ([self isTestBaseClass]) return;
+
+  LruParams params = LruParams::Default();
+  // Set a low threshold so we will definitely run
+  params.minBytesThreshold = 100;
+  [self newTestResourcesWithLruParams:params];
+
+  // Add 100 targets and 10 documents to each
+  for (int i = 0; i < 100; i++) {
+    _persistence.run("Add a target and some documents", [&]() {
+      FSTQueryData *queryData = [self addNextQueryInTransaction];
+      for (int j = 0; j < 10; j++) {
+        FSTDocument *doc = [self cacheADocumentInTransaction];
+        [self addDocument:doc.key toTarget:queryData.targetID];
+      }
+    });
+  }
+
+  // Run slices until the collection finishes, each in its own transaction.
+  int slices = 0;
+  BOOL finished = NO;
+  while (!finished) {
+    finished = _persistence.run("GC slice", [&]() -> BOOL {
+      return [_gc collectSliceWithLiveTargets:@{} rowBudget:50];
+    });
+    slices++;
+    XCTAssertLessThan(slices, 1000);
+  }
+
+  // The same 10 targets are collected as when collecting in a single pass.
+  size_t targetCount = _persistence.run("Count targets", [&]() -> size_t {
+    return _queryCache->size();
+  });
+  XCTAssertEqual(90, targetCount);
+  [_persistence shutdown];
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -0,0 +1,175 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#include <memory>
+#include <sstream>
+#include <string>
+
+#import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Local/FSTLevelDB.h"
+#import "Firestore/Source/Local/FSTQueryData.h"
+#import "Firestore/Source/Model/FSTDocument.h"
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_cache_snapshot.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
+#include "Firestore/core/src/firebase/firestore/model/resource_path.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "leveldb/db.h"
+
+#import "Firestore/Example/Tests/Local/FSTPersistenceTestHelpers.h"
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace testutil = firebase::firestore::testutil;
+using firebase::firestore::FirestoreErrorCode;
+using firebase::firestore::local::LevelDbCacheSnapshot;
+using firebase::firestore::local::LevelDbCacheSnapshotStats;
+using firebase::firestore::local::LevelDbRemoteDocumentChangeKey;
+using firebase::firestore::model::DocumentKeySet;
+using firebase::firestore::model::ResourcePath;
+using firebase::firestore::model::TargetId;
+using firebase::firestore::util::Path;
+using firebase::firestore::util::StatusOr;
+using leveldb::DB;
+using leveldb::Options;
+using leveldb::ReadOptions;
+using leveldb::Status;
+
+static const TargetId kTargetId = 3;
+
+@interface FSTLevelDBCacheSnapshotTests : XCTestCase
+@end
+
+@implementation FSTLevelDBCacheSnapshotTests
+
+- (FSTQuery *)query {
+  return [FSTQuery queryWithPath:ResourcePath{"coll"}];
+}
+
+/** Exports a cache holding two documents and a target that matches one of them. */
+- (std::string)exportCache {
+  FSTLevelDB *db = [FSTPersistenceTestHelpers levelDBPersistence];
+  db.run("populate cache", [&]() {
+    db.remoteDocumentCache->Add(FSTTestDoc("coll/a", 1, @{@"n" : @1}, FSTDocumentStateSynced));
+    db.remoteDocumentCache->Add(FSTTestDoc("coll/b", 2, @{@"n" : @2}, FSTDocumentStateSynced));
+
+    FSTQueryData *queryData = [[FSTQueryData alloc] initWithQuery:[self query]
+                                                         targetID:kTargetId
+                                             listenSequenceNumber:10
+                                                          purpose:FSTQueryPurposeListen];
+    db.queryCache->AddTarget(queryData);
+    db.queryCache->AddMatchingKeys(DocumentKeySet{testutil::Key("coll/a")}, kTargetId);
+  });
+
+  std::ostringstream out;
+  StatusOr<LevelDbCacheSnapshotStats> stats = LevelDbCacheSnapshot::Export(db.ptr, &out);
+  XCTAssertTrue(stats.ok());
+  XCTAssertEqual(2, stats.ValueOrDie().documents);
+  XCTAssertEqual(1, stats.ValueOrDie().targets);
+
+  [db shutdown];
+  return out.str();
+}
+
+/** Opens a new, empty leveldb in the given directory. */
+- (std::unique_ptr<DB>)openEmptyDB:(const Path &)dir {
+  Options options;
+  options.error_if_exists = true;
+  options.create_if_missing = true;
+
+  DB *db;
+  Status status = DB::Open(options, dir.ToUtf8String(), &db);
+  XCTAssert(status.ok(), @"Failed to create db: %s", status.ToString().c_str());
+  return std::unique_ptr<DB>(db);
+}
+
+- (void)testImportsExportedCache {
+  std::string snapshot = [self exportCache];
+
+  Path dir = [FSTPersistenceTestHelpers levelDBDir];
+  std::unique_ptr<DB> db = [self openEmptyDB:dir];
+  std::istringstream in(snapshot);
+  StatusOr<LevelDbCacheSnapshotStats> stats =
+      LevelDbCacheSnapshot::Import(db.get(), &in, /* max_batch_rows= */ 2);
+  XCTAssertTrue(stats.ok());
+  XCTAssertEqual(2, stats.ValueOrDie().documents);
+
+  // The change log comes along, so cursors into it remain valid.
+  std::string changePrefix = LevelDbRemoteDocumentChangeKey::KeyPrefix();
+  std::unique_ptr<leveldb::Iterator> it(db->NewIterator(ReadOptions()));
+  int changes = 0;
+  for (it->Seek(changePrefix); it->Valid() && it->key().starts_with(changePrefix); it->Next()) {
+    changes++;
+  }
+  XCTAssertEqual(2, changes);
+  it.reset();
+  db.reset();
+
+  FSTLevelDB *persistence = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  persistence.run("verify import", [&]() {
+    XCTAssertEqualObjects(persistence.remoteDocumentCache->Get(testutil::Key("coll/a")),
+                          FSTTestDoc("coll/a", 1, @{@"n" : @1}, FSTDocumentStateSynced));
+    XCTAssertNotNil(persistence.remoteDocumentCache->Get(testutil::Key("coll/b")));
+
+    FSTQueryData *queryData = persistence.queryCache->GetTarget([self query]);
+    XCTAssertEqual(kTargetId, queryData.targetID);
+    XCTAssertTrue(persistence.queryCache->GetMatchingKeys(kTargetId) ==
+                  DocumentKeySet{testutil::Key("coll/a")});
+    XCTAssertEqual(kTargetId, persistence.queryCache->highest_target_id());
+  });
+  [persistence shutdown];
+}
+
+- (void)testRejectsNonEmptyCache {
+  std::string snapshot = [self exportCache];
+
+  std::unique_ptr<DB> db = [self openEmptyDB:[FSTPersistenceTestHelpers levelDBDir]];
+  std::istringstream first(snapshot);
+  XCTAssertTrue(LevelDbCacheSnapshot::Import(db.get(), &first).ok());
+
+  std::istringstream second(snapshot);
+  StatusOr<LevelDbCacheSnapshotStats> stats = LevelDbCacheSnapshot::Import(db.get(), &second);
+  XCTAssertEqual(FirestoreErrorCode::FailedPrecondition, stats.status().code());
+}
+
+- (void)testRollsBackTruncatedSnapshot {
+  std::string snapshot = [self exportCache];
+
+  std::unique_ptr<DB> db = [self openEmptyDB:[FSTPersistenceTestHelpers levelDBDir]];
+  std::istringstream truncated(snapshot.substr(0, snapshot.size() - 1));
+  StatusOr<LevelDbCacheSnapshotStats> stats =
+      LevelDbCacheSnapshot::Import(db.get(), &truncated, /* max_batch_rows= */ 1);
+  XCTAssertEqual(FirestoreErrorCode::DataLoss, stats.status().code());
+
+  // Nothing of the partial import remains, so the full snapshot still applies.
+  std::istringstream in(snapshot);
+  XCTAssertTrue(LevelDbCacheSnapshot::Import(db.get(), &in).ok());
+}
+
+- (void)testRejectsOtherFiles {
+  std::unique_ptr<DB> db = [self openEmptyDB:[FSTPersistenceTestHelpers levelDBDir]];
+  std::istringstream in("not a snapshot");
+  StatusOr<LevelDbCacheSnapshotStats> stats = LevelDbCacheSnapshot::Import(db.get(), &in);
+  XCTAssertEqual(FirestoreErrorCode::DataLoss, stats.status().code());
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
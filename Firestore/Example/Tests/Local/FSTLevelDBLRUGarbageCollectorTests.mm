@@ -15,17 +15,27 @@
  */
 
 #include <string>
+#include <vector>
 
 #import "Firestore/Example/Tests/Local/FSTLRUGarbageCollectorTests.h"
 
 #import "Firestore/Example/Tests/Local/FSTPersistenceTestHelpers.h"
 #import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
+#import "Firestore/Source/Model/FSTDocument.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "absl/strings/match.h"
+
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
 
 using firebase::firestore::local::LevelDbDocumentTargetKey;
+using firebase::firestore::local::LevelDbSequenceNumberKey;
 using firebase::firestore::model::DocumentKey;
+using firebase::firestore::model::ListenSequenceNumber;
+using firebase::firestore::testutil::Key;
+using firebase::firestore::util::Path;
 
 using firebase::firestore::local::LruParams;
 
@@ -47,6 +57,71 @@ NS_ASSUME_NONNULL_BEGIN
   return !db.currentTransaction->Get(sentinelKey, &unusedValue).IsNotFound();
 }
 
+/** Returns the keys of the sequence number index, read in the current transaction of `db`. */
+- (std::vector<std::string>)sequenceNumberRowsIn:(FSTLevelDB *)db {
+  std::string prefix = LevelDbSequenceNumberKey::KeyPrefix();
+  auto it = db.currentTransaction->NewIterator();
+  std::vector<std::string> foundKeys;
+  for (it->Seek(prefix); it->Valid() && absl::StartsWith(it->key(), prefix); it->Next()) {
+    foundKeys.push_back(std::string{it->key()});
+  }
+  return foundKeys;
+}
+
+- (void)testIndexesDocumentsByLatestSequenceNumber {
+  FSTLevelDB *db = [FSTPersistenceTestHelpers levelDBPersistence];
+  DocumentKey key = Key("docs/a");
+  db.run("first use", [&]() { [db.referenceDelegate addReference:key]; });
+  ListenSequenceNumber lastUsed = db.run("second use", [&]() -> ListenSequenceNumber {
+    [db.referenceDelegate removeReference:key];
+    return db.currentSequenceNumber;
+  });
+
+  // Moving the sentinel removes the row for the first use without garbage collection.
+  db.run("verify", [&]() {
+    std::vector<std::string> expectedKeys = {LevelDbSequenceNumberKey::Key(lastUsed, key)};
+    XCTAssertEqual([self sequenceNumberRowsIn:db], expectedKeys);
+  });
+  [db shutdown];
+}
+
+- (void)testIndexesDocumentsByLatestSequenceNumberAfterRestart {
+  Path dir = [FSTPersistenceTestHelpers levelDBDir];
+  DocumentKey key = Key("docs/a");
+
+  FSTLevelDB *db1 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  db1.run("first use", [&]() { [db1.referenceDelegate addReference:key]; });
+  [db1 shutdown];
+  db1 = nil;
+
+  // A new instance doesn't know where the sentinel was, so it must look it up.
+  FSTLevelDB *db2 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  ListenSequenceNumber lastUsed = db2.run("second use", [&]() -> ListenSequenceNumber {
+    [db2.referenceDelegate removeReference:key];
+    return db2.currentSequenceNumber;
+  });
+  db2.run("verify", [&]() {
+    std::vector<std::string> expectedKeys = {LevelDbSequenceNumberKey::Key(lastUsed, key)};
+    XCTAssertEqual([self sequenceNumberRowsIn:db2], expectedKeys);
+  });
+  [db2 shutdown];
+}
+
+- (void)testExcludesRemoteDocumentChangeLogFromByteSize {
+  FSTLevelDB *db = [FSTPersistenceTestHelpers levelDBPersistence];
+  FSTLRUGarbageCollector *gc = ((id<FSTLRUDelegate>)db.referenceDelegate).gc;
+  size_t initialSize = [gc byteSize];
+
+  FSTDocument *doc = FSTTestDoc("docs/a", 1, @{}, FSTDocumentStateSynced);
+  db.run("add", [&]() { db.remoteDocumentCache->Add(doc); });
+  XCTAssertGreaterThan([gc byteSize], initialSize);
+
+  // Only the change log still holds rows for the document, and collection can't remove those.
+  db.run("remove", [&]() { db.remoteDocumentCache->Remove(doc.key); });
+  XCTAssertEqual([gc byteSize], initialSize);
+  [db shutdown];
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
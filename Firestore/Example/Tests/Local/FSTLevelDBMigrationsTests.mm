@@ -28,6 +28,8 @@
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_migrations.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_query_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
 #include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
 #include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
 #include "absl/strings/match.h"
@@ -40,18 +42,26 @@ NS_ASSUME_NONNULL_BEGIN
 using firebase::firestore::FirestoreErrorCode;
 using firebase::firestore::local::LevelDbDocumentMutationKey;
 using firebase::firestore::local::LevelDbDocumentTargetKey;
+using firebase::firestore::local::LevelDbMigrationProgressKey;
 using firebase::firestore::local::LevelDbMigrations;
 using firebase::firestore::local::LevelDbMutationKey;
 using firebase::firestore::local::LevelDbMutationQueueKey;
 using firebase::firestore::local::LevelDbQueryCache;
 using firebase::firestore::local::LevelDbQueryTargetKey;
 using firebase::firestore::local::LevelDbRemoteDocumentKey;
+using firebase::firestore::local::LevelDbSequenceNumberKey;
+using firebase::firestore::local::LevelDbTableSizes;
+using firebase::firestore::local::LevelDbTableSizesKey;
+using firebase::firestore::local::LevelDbTargetDocumentBlockKey;
 using firebase::firestore::local::LevelDbTargetDocumentKey;
+using firebase::firestore::local::LevelDbTargetDocuments;
 using firebase::firestore::local::LevelDbTargetGlobalKey;
 using firebase::firestore::local::LevelDbTargetKey;
+using firebase::firestore::local::LevelDbTargetResumeKey;
 using firebase::firestore::local::LevelDbTransaction;
 using firebase::firestore::model::BatchId;
 using firebase::firestore::model::DocumentKey;
+using firebase::firestore::model::DocumentKeySet;
 using firebase::firestore::model::ListenSequenceNumber;
 using firebase::firestore::model::TargetId;
 using firebase::firestore::testutil::Key;
@@ -132,6 +142,7 @@ using SchemaVersion = LevelDbMigrations::SchemaVersion;
       LevelDbTargetKey::Key(targetID),
       LevelDbTargetDocumentKey::Key(targetID, key1),
       LevelDbTargetDocumentKey::Key(targetID, key2),
+      LevelDbTargetDocumentBlockKey::Key(targetID, key1),
       LevelDbDocumentTargetKey::Key(key1, targetID),
       LevelDbDocumentTargetKey::Key(key2, targetID),
       LevelDbQueryTargetKey::Key("foo.bar.baz", targetID),
@@ -361,6 +372,249 @@ using SchemaVersion = LevelDbMigrations::SchemaVersion;
   }
 }
 
+- (void)testLeavesRemoteDocumentsUnchangedWhenAllowingCompression {
+  LevelDbMigrations::RunMigrations(_db.get(), 5);
+
+  std::string docKey = LevelDbRemoteDocumentKey::Key(Key("docs/1"));
+  std::string docValue = "\x0a\x05value";
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    transaction.Put(docKey, docValue);
+    transaction.Commit();
+  }
+
+  LevelDbMigrations::RunMigrations(_db.get(), 6);
+  XCTAssertEqual(6, LevelDbMigrations::ReadSchemaVersion(_db.get()));
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string value;
+  XCTAssertTrue(transaction.Get(docKey, &value).ok());
+  XCTAssertEqual(value, docValue);
+}
+
+- (void)testIndexesSequenceNumbers {
+  LevelDbMigrations::RunMigrations(_db.get(), 6);
+
+  DocumentKey docKey = Key("docs/1");
+  {
+    std::string emptyBuffer;
+    LevelDbTransaction transaction(_db.get(), "Setup");
+
+    FSTPBTarget *target = [FSTPBTarget message];
+    target.targetId = 2;
+    target.lastListenSequenceNumber = 20;
+    transaction.Put(LevelDbTargetKey::Key(2), target);
+
+    transaction.Put(LevelDbDocumentTargetKey::SentinelKey(docKey),
+                    LevelDbDocumentTargetKey::EncodeSentinelValue(10));
+    transaction.Put(LevelDbDocumentTargetKey::Key(docKey, 2), emptyBuffer);
+
+    // A stale entry left behind by a downgrade.
+    transaction.Put(LevelDbSequenceNumberKey::Key(5, 2), emptyBuffer);
+    transaction.Commit();
+  }
+
+  LevelDbMigrations::RunMigrations(_db.get(), 7);
+  XCTAssertEqual(7, LevelDbMigrations::ReadSchemaVersion(_db.get()));
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string prefix = LevelDbSequenceNumberKey::KeyPrefix();
+  auto it = transaction.NewIterator();
+  std::vector<std::string> foundKeys;
+  for (it->Seek(prefix); it->Valid() && absl::StartsWith(it->key(), prefix); it->Next()) {
+    foundKeys.push_back(std::string{it->key()});
+  }
+
+  std::vector<std::string> expectedKeys = {LevelDbSequenceNumberKey::Key(10, docKey),
+                                           LevelDbSequenceNumberKey::Key(20, 2)};
+  XCTAssertEqual(foundKeys, expectedKeys);
+}
+
+- (void)testComputesTableSizes {
+  LevelDbMigrations::RunMigrations(_db.get(), 7);
+
+  std::string targetKey = LevelDbTargetKey::Key(2);
+  std::string documentKey = LevelDbRemoteDocumentKey::Key(Key("docs/1"));
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    transaction.Put(targetKey, "target");
+    transaction.Put(documentKey, "document");
+    transaction.Commit();
+  }
+
+  LevelDbMigrations::RunMigrations(_db.get(), 8);
+  XCTAssertEqual(8, LevelDbMigrations::ReadSchemaVersion(_db.get()));
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string encoded;
+  XCTAssertTrue(transaction.Get(LevelDbTableSizesKey::Key(), &encoded).ok());
+  LevelDbTableSizes sizes;
+  XCTAssertTrue(sizes.Decode(encoded));
+
+  // Every row except the table sizes row itself is counted.
+  int64_t expectedTotal = 0;
+  auto it = transaction.NewIterator();
+  for (it->Seek(""); it->Valid(); it->Next()) {
+    if (it->key() != LevelDbTableSizesKey::Key()) {
+      expectedTotal += LevelDbTableSizes::RowSize(it->key(), it->value());
+    }
+  }
+  XCTAssertEqual(sizes.total(), expectedTotal);
+  XCTAssertEqual(sizes.TableSize("target"), LevelDbTableSizes::RowSize(targetKey, "target"));
+  XCTAssertEqual(sizes.TableSize("remote_document"),
+                 LevelDbTableSizes::RowSize(documentKey, "document"));
+}
+
+- (void)testPacksTargetDocumentsIntoBlocks {
+  LevelDbMigrations::RunMigrations(_db.get(), 8);
+
+  // Enough documents in one target to fill several blocks, plus a small target.
+  std::vector<DocumentKey> largeTarget;
+  for (int i = 0; i < 300; i++) {
+    largeTarget.push_back(DocumentKey::FromSegments({"docs", std::to_string(1000 + i)}));
+  }
+  std::vector<DocumentKey> smallTarget = {Key("coll/a"), Key("coll/b/sub/c")};
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    for (const DocumentKey &key : largeTarget) {
+      transaction.Put(LevelDbTargetDocumentKey::Key(1, key), "");
+    }
+    for (const DocumentKey &key : smallTarget) {
+      transaction.Put(LevelDbTargetDocumentKey::Key(2, key), "");
+    }
+    transaction.Commit();
+  }
+
+  // Use small chunks so that partly filled blocks carry over between them.
+  LevelDbMigrations::RunMigrations(_db.get(), 9, {}, 7);
+  XCTAssertEqual(9, LevelDbMigrations::ReadSchemaVersion(_db.get()));
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string targetDocumentsPrefix = LevelDbTargetDocumentKey::KeyPrefix();
+  auto it = transaction.NewIterator(targetDocumentsPrefix);
+  it->SeekToFirst();
+  XCTAssertFalse(it->Valid(), @"Target document rows should have been removed");
+
+  DocumentKeySet expectedLarge;
+  for (const DocumentKey &key : largeTarget) {
+    expectedLarge = expectedLarge.insert(key);
+  }
+  DocumentKeySet expectedSmall{smallTarget[0], smallTarget[1]};
+  XCTAssertEqual(LevelDbTargetDocuments::GetKeys(&transaction, 1), expectedLarge);
+  XCTAssertEqual(LevelDbTargetDocuments::GetKeys(&transaction, 2), expectedSmall);
+}
+
+- (void)testMovesResumeTokensOutOfTargets {
+  LevelDbMigrations::RunMigrations(_db.get(), 8);
+
+  NSData *resumeToken = [@"resume" dataUsingEncoding:NSUTF8StringEncoding];
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    FSTPBTarget *target = [FSTPBTarget message];
+    target.targetId = 2;
+    target.lastListenSequenceNumber = 20;
+    target.resumeToken = resumeToken;
+    target.snapshotVersion.seconds = 5;
+    transaction.Put(LevelDbTargetKey::Key(2), target);
+
+    // A stale entry left behind by a downgrade.
+    FSTPBTarget *stale = [FSTPBTarget message];
+    stale.targetId = 3;
+    stale.resumeToken = resumeToken;
+    transaction.Put(LevelDbTargetResumeKey::Key(3), stale);
+    transaction.Commit();
+  }
+
+  LevelDbMigrations::RunMigrations(_db.get(), 9);
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string value;
+  XCTAssertTrue(transaction.Get(LevelDbTargetKey::Key(2), &value).ok());
+  NSData *data = [NSData dataWithBytes:value.data() length:value.size()];
+  FSTPBTarget *target = [FSTPBTarget parseFromData:data error:nil];
+  XCTAssertEqual(target.targetId, 2);
+  XCTAssertEqual(target.lastListenSequenceNumber, 20);
+  XCTAssertEqual(target.resumeToken.length, 0);
+  XCTAssertFalse(target.hasSnapshotVersion && target.snapshotVersion.seconds != 0);
+
+  XCTAssertTrue(transaction.Get(LevelDbTargetResumeKey::Key(2), &value).ok());
+  data = [NSData dataWithBytes:value.data() length:value.size()];
+  FSTPBTarget *resume = [FSTPBTarget parseFromData:data error:nil];
+  XCTAssertEqual(resume.targetId, 2);
+  XCTAssertEqualObjects(resume.resumeToken, resumeToken);
+  XCTAssertEqual(resume.snapshotVersion.seconds, 5);
+
+  XCTAssertTrue(transaction.Get(LevelDbTargetResumeKey::Key(3), &value).IsNotFound());
+}
+
+- (void)testRunsMigrationsInChunks {
+  LevelDbMigrations::RunMigrations(_db.get(), 3);
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    for (int i = 0; i < 25; i++) {
+      DocumentKey key = DocumentKey::FromSegments({"docs", std::to_string(i)});
+      transaction.Put(LevelDbRemoteDocumentKey::Key(key), "");
+    }
+    transaction.Commit();
+  }
+
+  std::vector<int64_t> rowsProcessed;
+  LevelDbMigrations::RunMigrations(
+      _db.get(), 4,
+      [&](const LevelDbMigrations::Progress &progress) {
+        XCTAssertEqual(4, progress.version);
+        rowsProcessed.push_back(progress.rows_processed);
+      },
+      10);
+  XCTAssertTrue((rowsProcessed == std::vector<int64_t>{10, 20, 25}));
+  XCTAssertEqual(4, LevelDbMigrations::ReadSchemaVersion(_db.get()));
+
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string buffer;
+  XCTAssertTrue(transaction.Get(LevelDbMigrationProgressKey::Key(), &buffer).IsNotFound());
+  for (int i = 0; i < 25; i++) {
+    DocumentKey key = DocumentKey::FromSegments({"docs", std::to_string(i)});
+    XCTAssertTrue(transaction.Get(LevelDbDocumentTargetKey::SentinelKey(key), &buffer).ok());
+  }
+}
+
+- (void)testResumesInterruptedMigration {
+  LevelDbMigrations::RunMigrations(_db.get(), 3);
+  std::vector<DocumentKey> keys;
+  for (int i = 0; i < 4; i++) {
+    keys.push_back(DocumentKey::FromSegments({"docs", std::to_string(i)}));
+  }
+  {
+    LevelDbTransaction transaction(_db.get(), "Setup");
+    for (const DocumentKey &key : keys) {
+      transaction.Put(LevelDbRemoteDocumentKey::Key(key), "");
+    }
+
+    // Pretend that migration 4 was interrupted after the first two documents.
+    LevelDbMigrations::Progress progress;
+    progress.version = 4;
+    progress.cursor = LevelDbRemoteDocumentKey::Key(keys[1]);
+    progress.rows_processed = 2;
+    transaction.Put(LevelDbMigrationProgressKey::Key(), progress.Encode());
+    transaction.Commit();
+  }
+
+  std::vector<int64_t> rowsProcessed;
+  LevelDbMigrations::RunMigrations(_db.get(), 4, [&](const LevelDbMigrations::Progress &progress) {
+    rowsProcessed.push_back(progress.rows_processed);
+  });
+  XCTAssertTrue((rowsProcessed == std::vector<int64_t>{4}));
+
+  // Only the documents after the cursor were visited.
+  LevelDbTransaction transaction(_db.get(), "Verify");
+  std::string buffer;
+  for (size_t i = 0; i < keys.size(); i++) {
+    Status status = transaction.Get(LevelDbDocumentTargetKey::SentinelKey(keys[i]), &buffer);
+    XCTAssertEqual(i >= 2, status.ok());
+  }
+  XCTAssertTrue(transaction.Get(LevelDbMigrationProgressKey::Key(), &buffer).IsNotFound());
+}
+
 - (void)testCanDowngrade {
   // First, run all of the migrations
   LevelDbMigrations::RunMigrations(_db.get());
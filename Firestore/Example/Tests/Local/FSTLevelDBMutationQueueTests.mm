@@ -18,6 +18,7 @@
 
 #import <XCTest/XCTest.h>
 
+#include <set>
 #include <string>
 #include <vector>
 
@@ -28,6 +29,7 @@
 
 #include "Firestore/core/src/firebase/firestore/auth/user.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
 #include "Firestore/core/src/firebase/firestore/local/reference_set.h"
 #include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
 #include "absl/strings/string_view.h"
@@ -37,6 +39,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 using firebase::firestore::auth::User;
 using firebase::firestore::local::LevelDbMutationKey;
+using firebase::firestore::local::LevelDbStartupData;
 using firebase::firestore::local::ReferenceSet;
 using firebase::firestore::model::BatchId;
 using firebase::firestore::util::OrderedCode;
@@ -138,6 +141,18 @@ std::string MutationLikeKey(absl::string_view table, absl::string_view userID, B
   XCTAssertEqual([FSTLevelDBMutationQueue loadNextBatchIDFromDB:_db.ptr], 4);
 }
 
+- (void)testStartupDataFindsUsersAndMaxBatchID {
+  [self setDummyValueForKey:MutationLikeKey("mutationsa", "zed", 10)];
+  [self setDummyValueForKey:LevelDbMutationKey::Key("fo", 5)];
+  [self setDummyValueForKey:LevelDbMutationKey::Key("foo", 6)];
+  [self setDummyValueForKey:LevelDbMutationKey::Key("foo", 2)];
+
+  LevelDbStartupData startupData = LevelDbStartupData::Load(_db.ptr);
+  XCTAssertEqual(startupData.users(), (std::set<std::string>{"fo", "foo"}));
+  XCTAssertEqual(startupData.highest_batch_id(), 6);
+  XCTAssertTrue(startupData.has_target_global());
+}
+
 - (void)testEmptyProtoCanBeUpgraded {
   // An empty protocol buffer serializes to a zero-length byte buffer.
   GPBEmpty *empty = [GPBEmpty message];
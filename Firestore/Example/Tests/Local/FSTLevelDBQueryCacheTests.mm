@@ -14,18 +14,22 @@
  * limitations under the License.
  */
 
+#import "Firestore/Protos/objc/firestore/local/Target.pbobjc.h"
 #import "Firestore/Source/Core/FSTQuery.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
 #import "Firestore/Source/Local/FSTQueryData.h"
 
 #import "Firestore/Example/Tests/Local/FSTPersistenceTestHelpers.h"
 #import "Firestore/Example/Tests/Local/FSTQueryCacheTests.h"
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
 
 #include "Firestore/core/include/firebase/firestore/timestamp.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_query_cache.h"
 #include "Firestore/core/src/firebase/firestore/local/reference_set.h"
 #include "Firestore/core/src/firebase/firestore/model/database_id.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/model/resource_path.h"
 #include "Firestore/core/src/firebase/firestore/model/snapshot_version.h"
 #include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
@@ -33,9 +37,11 @@
 namespace testutil = firebase::firestore::testutil;
 using firebase::Timestamp;
 using firebase::firestore::local::LevelDbQueryCache;
+using firebase::firestore::local::LevelDbTargetKey;
 using firebase::firestore::local::ReferenceSet;
 using firebase::firestore::model::DatabaseId;
 using firebase::firestore::model::DocumentKey;
+using firebase::firestore::model::DocumentKeySet;
 using firebase::firestore::model::ListenSequenceNumber;
 using firebase::firestore::model::ResourcePath;
 using firebase::firestore::model::SnapshotVersion;
@@ -120,6 +126,129 @@ NS_ASSUME_NONNULL_BEGIN
   db2 = nil;
 }
 
+- (void)testResumeTokenPersistedAcrossRestarts {
+  [self.persistence shutdown];
+  self.persistence = nil;
+
+  Path dir = [FSTPersistenceTestHelpers levelDBDir];
+  FSTQuery *query = [FSTQuery queryWithPath:ResourcePath{"some", "path"}];
+  NSData *resumeToken = FSTTestResumeTokenFromSnapshotVersion(2);
+
+  FSTLevelDB *db1 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  LevelDbQueryCache *queryCache = [self getCache:db1];
+  db1.run("add query data", [&]() {
+    FSTQueryData *queryData = [[FSTQueryData alloc] initWithQuery:query
+                                                         targetID:1
+                                             listenSequenceNumber:10
+                                                          purpose:FSTQueryPurposeListen];
+    queryCache->AddTarget(queryData);
+    queryCache->UpdateResumeToken(
+        [queryData queryDataByReplacingSnapshotVersion:testutil::Version(2)
+                                           resumeToken:resumeToken
+                                        sequenceNumber:11]);
+  });
+  [db1 shutdown];
+  db1 = nil;
+
+  FSTLevelDB *db2 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  LevelDbQueryCache *queryCache2 = [self getCache:db2];
+  db2.run("verify resume token", [&]() {
+    FSTQueryData *result = queryCache2->GetTarget(query);
+    XCTAssertEqualObjects(result.resumeToken, resumeToken);
+    XCTAssertEqual(result.snapshotVersion, testutil::Version(2));
+    XCTAssertEqual(result.sequenceNumber, 10);
+  });
+  [db2 shutdown];
+  db2 = nil;
+}
+
+- (void)testTargetRowsOmitResumeTokens {
+  FSTQuery *query = [FSTQuery queryWithPath:ResourcePath{"some", "path"}];
+  NSData *resumeToken = FSTTestResumeTokenFromSnapshotVersion(2);
+  FSTQueryData *queryData = [[FSTQueryData alloc] initWithQuery:query
+                                                       targetID:1
+                                           listenSequenceNumber:10
+                                                        purpose:FSTQueryPurposeListen
+                                                snapshotVersion:testutil::Version(2)
+                                                    resumeToken:resumeToken];
+
+  self.persistence.run("testTargetRowsOmitResumeTokens", [&]() {
+    LevelDbQueryCache *cache = [self getCache:self.persistence];
+    cache->AddTarget(queryData);
+
+    // Clients that can't read target document blocks must not be able to resume the target.
+    std::string value;
+    FSTLevelDB *db = (FSTLevelDB *)self.persistence;
+    XCTAssertTrue(db.currentTransaction->Get(LevelDbTargetKey::Key(1), &value).ok());
+    NSData *data = [NSData dataWithBytes:value.data() length:value.size()];
+    FSTPBTarget *target = [FSTPBTarget parseFromData:data error:nil];
+    XCTAssertEqual(target.resumeToken.length, 0);
+
+    FSTQueryData *result = cache->GetTarget(query);
+    XCTAssertEqualObjects(result.resumeToken, resumeToken);
+    XCTAssertEqual(result.snapshotVersion, testutil::Version(2));
+  });
+}
+
+- (void)testGetTargetSeesWritesAfterRead {
+  FSTQuery *query = [FSTQuery queryWithPath:ResourcePath{"some", "path"}];
+  FSTQueryData *queryData = [[FSTQueryData alloc] initWithQuery:query
+                                                       targetID:1
+                                           listenSequenceNumber:10
+                                                        purpose:FSTQueryPurposeListen];
+
+  self.persistence.run("testGetTargetSeesWritesAfterRead", [&]() {
+    LevelDbQueryCache *cache = [self getCache:self.persistence];
+    cache->AddTarget(queryData);
+    XCTAssertEqual(cache->GetTarget(query).sequenceNumber, 10);
+
+    // Each write must replace the target that the previous read decoded.
+    NSData *resumeToken = FSTTestResumeTokenFromSnapshotVersion(2);
+    cache->UpdateResumeToken([queryData queryDataByReplacingSnapshotVersion:testutil::Version(2)
+                                                                resumeToken:resumeToken
+                                                             sequenceNumber:11]);
+    XCTAssertEqualObjects(cache->GetTarget(query).resumeToken, resumeToken);
+
+    cache->UpdateTarget([queryData queryDataByReplacingSnapshotVersion:testutil::Version(2)
+                                                           resumeToken:resumeToken
+                                                        sequenceNumber:12]);
+    XCTAssertEqual(cache->GetTarget(query).sequenceNumber, 12);
+
+    cache->RemoveTarget(cache->GetTarget(query));
+    XCTAssertNil(cache->GetTarget(query));
+  });
+}
+
+- (void)testContainsAfterRestart {
+  [self.persistence shutdown];
+  self.persistence = nil;
+
+  Path dir = [FSTPersistenceTestHelpers levelDBDir];
+  DocumentKey key1 = testutil::Key("foo/bar");
+  DocumentKey key2 = testutil::Key("foo/baz");
+
+  FSTLevelDB *db1 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  [db1.referenceDelegate addInMemoryPins:&_additionalReferences];
+  db1.run("add matching keys", [&]() {
+    [self getCache:db1]->AddMatchingKeys(DocumentKeySet{key1, key2}, 1);
+    [self getCache:db1]->RemoveMatchingKeys(DocumentKeySet{key2}, 1);
+  });
+  [db1 shutdown];
+  db1 = nil;
+
+  // The filter of targeted documents is rebuilt from the index when the database reopens.
+  FSTLevelDB *db2 = [FSTPersistenceTestHelpers levelDBPersistenceWithDir:dir];
+  [db2.referenceDelegate addInMemoryPins:&_additionalReferences];
+  db2.run("verify", [&]() {
+    LevelDbQueryCache *cache = [self getCache:db2];
+    XCTAssertTrue(cache->Contains(key1));
+    XCTAssertFalse(cache->Contains(key2));
+    XCTAssertFalse(cache->Contains(testutil::Key("foo/blah")));
+  });
+  [db2 shutdown];
+  db2 = nil;
+}
+
 - (void)testRemoveMatchingKeysForTargetID {
   self.persistence.run("testRemoveMatchingKeysForTargetID", [&]() {
     DocumentKey key1 = testutil::Key("foo/bar");
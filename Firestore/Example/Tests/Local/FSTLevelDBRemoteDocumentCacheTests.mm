@@ -19,19 +19,33 @@
 
 #import "Firestore/Example/Tests/Local/FSTPersistenceTestHelpers.h"
 #import "Firestore/Example/Tests/Local/FSTRemoteDocumentCacheTests.h"
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
+#import "Firestore/Source/Model/FSTDocument.h"
+#include "Firestore/core/src/firebase/firestore/local/decoded_document_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_remote_document_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
 #include "Firestore/core/src/firebase/firestore/local/remote_document_cache.h"
 
 #include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
 #include "absl/memory/memory.h"
 #include "leveldb/db.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+namespace testutil = firebase::firestore::testutil;
 using leveldb::WriteOptions;
+using firebase::firestore::local::DecodedDocumentCache;
 using firebase::firestore::local::LevelDbRemoteDocumentCache;
+using firebase::firestore::local::LevelDbRemoteDocumentKey;
+using firebase::firestore::local::LevelDbStartupData;
+using firebase::firestore::local::LevelDbValueCompressionOptions;
+using firebase::firestore::local::LevelDbValueCompressor;
 using firebase::firestore::local::RemoteDocumentCache;
+using firebase::firestore::model::DocumentKeySet;
 using firebase::firestore::util::OrderedCode;
 
 // A dummy document value, useful for testing code that's known to examine only document keys.
@@ -84,6 +98,162 @@ static const char *kDummy = "1";
   _db.ptr->Put(WriteOptions(), key, kDummy);
 }
 
+- (void)testCachesDecodedDocuments {
+  FSTDocument *doc = FSTTestDoc("rooms/eros", 1, @{@"a" : @1}, FSTDocumentStateSynced);
+  FSTDocument *other = FSTTestDoc("rooms/other", 1, @{@"a" : @1}, FSTDocumentStateSynced);
+
+  self.persistence.run("testCachesDecodedDocuments", [&]() {
+    _cache->Add(doc);
+    _cache->Add(other);
+    int64_t hits = _cache->decoded_documents().stats().hits;
+
+    FSTMaybeDocument *first = _cache->Get(doc.key);
+    FSTMaybeDocument *second = _cache->Get(doc.key);
+    XCTAssertEqualObjects(first, doc);
+    XCTAssertEqual(first, second);
+    XCTAssertEqual(_cache->decoded_documents().stats().hits, hits + 2);
+
+    // Documents changed behind the cache's back are decoded again.
+    FSTDocument *updated = FSTTestDoc("rooms/eros", 2, @{@"a" : @2}, FSTDocumentStateSynced);
+    LevelDbRemoteDocumentCache writer(_db, _db.serializer);
+    writer.Add(updated);
+    XCTAssertEqualObjects(_cache->Get(doc.key), updated);
+
+    _cache->Remove(other.key);
+    XCTAssertNil(_cache->Get(other.key));
+  });
+}
+
+- (void)testQueryScansBypassDecodedDocuments {
+  FSTDocument *doc = FSTTestDoc("rooms/eros", 1, @{@"a" : @1}, FSTDocumentStateSynced);
+
+  self.persistence.run("testQueryScansBypassDecodedDocuments", [&]() {
+    LevelDbRemoteDocumentCache writer(_db, _db.serializer);
+    writer.Add(doc);
+
+    XCTAssertEqual(_cache->GetMatching(FSTTestQuery("rooms")).size(), 1);
+    XCTAssertEqual(_cache->decoded_documents().byte_size(), 0);
+
+    XCTAssertEqualObjects(_cache->Get(doc.key), doc);
+    XCTAssertGreaterThan(_cache->decoded_documents().byte_size(), 0);
+  });
+}
+
+- (void)testDecodedDocumentCacheEvictsLeastRecentlyUsed {
+  DecodedDocumentCache cache(100);
+  FSTDocument *a = FSTTestDoc("rooms/a", 1, @{}, FSTDocumentStateSynced);
+  FSTDocument *b = FSTTestDoc("rooms/b", 1, @{}, FSTDocumentStateSynced);
+  FSTDocument *c = FSTTestDoc("rooms/c", 1, @{}, FSTDocumentStateSynced);
+
+  cache.Put(a.key, 1, 40, a);
+  cache.Put(b.key, 2, 40, b);
+  XCTAssertEqual(cache.Get(a.key, 1), a);
+  cache.Put(c.key, 3, 40, c);
+
+  XCTAssertEqual(cache.byte_size(), 80);
+  XCTAssertEqual(cache.Get(a.key, 1), a);
+  XCTAssertNil(cache.Get(b.key, 2));
+  XCTAssertEqual(cache.Get(c.key, 3), c);
+  // A different fingerprint means a different stored version.
+  XCTAssertNil(cache.Get(c.key, 4));
+
+  XCTAssertEqual(cache.stats().hits, 3);
+  XCTAssertEqual(cache.stats().misses, 2);
+  XCTAssertEqual(cache.stats().evictions, 1);
+}
+
+- (void)testReadsCompressedAndUncompressedDocuments {
+  NSString *text = [@"" stringByPaddingToLength:500 withString:@"repeat " startingAtIndex:0];
+  FSTDocument *plain = FSTTestDoc("rooms/plain", 1, @{@"text" : text}, FSTDocumentStateSynced);
+  FSTDocument *compressed =
+      FSTTestDoc("rooms/compressed", 1, @{@"text" : text}, FSTDocumentStateSynced);
+  FSTDocument *withDictionary =
+      FSTTestDoc("rooms/dictionary", 1, @{@"text" : text}, FSTDocumentStateSynced);
+
+  self.persistence.run("testReadsCompressedAndUncompressedDocuments", [&]() {
+    _cache->Add(plain);
+    _cache->SetCompressionOptions(LevelDbValueCompressionOptions::Default());
+    _cache->Add(compressed);
+    _cache->TrainCompressionDictionary(10);
+    _cache->Add(withDictionary);
+
+    std::string value;
+    _db.currentTransaction->Get(LevelDbRemoteDocumentKey::Key(plain.key), &value);
+    XCTAssertFalse(LevelDbValueCompressor::IsCompressed(value));
+    _db.currentTransaction->Get(LevelDbRemoteDocumentKey::Key(compressed.key), &value);
+    XCTAssertTrue(LevelDbValueCompressor::IsCompressed(value));
+
+    XCTAssertEqualObjects(_cache->Get(plain.key), plain);
+    XCTAssertEqualObjects(_cache->Get(compressed.key), compressed);
+    XCTAssertEqualObjects(_cache->Get(withDictionary.key), withDictionary);
+  });
+
+  // A new cache must load the dictionary to read the documents written with it.
+  LevelDbRemoteDocumentCache reopened(_db, _db.serializer);
+  reopened.Start(LevelDbStartupData::Load(_db.ptr));
+  self.persistence.run("testReadsCompressedAndUncompressedDocuments reopen", [&]() {
+    XCTAssertEqualObjects(reopened.Get(withDictionary.key), withDictionary);
+    XCTAssertEqualObjects(reopened.Get(testutil::Key("rooms/plain")), plain);
+  });
+}
+
+- (void)testReturnsDocumentsChangedSinceCursor {
+  FSTDocument *a = FSTTestDoc("rooms/a", 1, @{}, FSTDocumentStateSynced);
+  FSTDocument *b = FSTTestDoc("rooms/b", 1, @{}, FSTDocumentStateSynced);
+
+  self.persistence.run("testReturnsDocumentsChangedSinceCursor", [&]() {
+    auto changes = _cache->GetChangedSince(LevelDbRemoteDocumentCache::kNoChanges);
+    XCTAssertTrue(changes && changes->keys.empty());
+
+    _cache->Add(a);
+    _cache->Add(b);
+    changes = _cache->GetChangedSince(LevelDbRemoteDocumentCache::kNoChanges);
+    XCTAssertTrue(changes && changes->keys == (DocumentKeySet{a.key, b.key}));
+    int64_t cursor = changes->cursor;
+
+    _cache->Remove(a.key);
+    changes = _cache->GetChangedSince(cursor);
+    XCTAssertTrue(changes && changes->keys == DocumentKeySet{a.key});
+
+    changes = _cache->GetChangedSince(changes->cursor);
+    XCTAssertTrue(changes && changes->keys.empty());
+  });
+
+  // The log is persisted, so a new cache continues from the same cursor.
+  LevelDbRemoteDocumentCache reopened(_db, _db.serializer);
+  reopened.Start(LevelDbStartupData::Load(_db.ptr));
+  self.persistence.run("testReturnsDocumentsChangedSinceCursor reopen", [&]() {
+    int64_t cursor = reopened.GetChangedSince(LevelDbRemoteDocumentCache::kNoChanges)->cursor;
+    reopened.Add(b);
+    auto changes = reopened.GetChangedSince(cursor);
+    XCTAssertTrue(changes && changes->keys == DocumentKeySet{b.key});
+  });
+}
+
+- (void)testTruncatesChangeLog {
+  FSTDocument *a = FSTTestDoc("rooms/a", 1, @{}, FSTDocumentStateSynced);
+  FSTDocument *b = FSTTestDoc("rooms/b", 1, @{}, FSTDocumentStateSynced);
+
+  self.persistence.run("testTruncatesChangeLog", [&]() {
+    _cache->Add(a);
+    int64_t cursor = _cache->GetChangedSince(LevelDbRemoteDocumentCache::kNoChanges)->cursor;
+    _cache->Add(b);
+    _cache->Add(b);
+
+    _cache->TruncateChangeLog(1);
+    // The change to `a` is gone, so changes since the start can't be listed.
+    XCTAssertFalse(_cache->GetChangedSince(LevelDbRemoteDocumentCache::kNoChanges));
+    XCTAssertFalse(_cache->GetChangedSince(cursor));
+
+    auto changes = _cache->GetChangedSince(cursor + 1);
+    XCTAssertTrue(changes && changes->keys == DocumentKeySet{b.key});
+
+    _cache->TruncateChangeLog(0);
+    changes = _cache->GetChangedSince(changes->cursor);
+    XCTAssertTrue(changes && changes->keys.empty());
+  });
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
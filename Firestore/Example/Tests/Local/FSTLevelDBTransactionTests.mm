@@ -16,8 +16,10 @@
 
 #import <XCTest/XCTest.h>
 
+#include <chrono>  // NOLINT(build/c++11)
 #include <memory>
 #include <string>
+#include <vector>
 
 // This is out of order to satisfy the linter, which doesn't realize this is
 // the header corresponding to this test.
@@ -28,13 +30,27 @@
 #import "Firestore/Protos/objc/firestore/local/Mutation.pbobjc.h"
 #import "Firestore/Protos/objc/firestore/local/Target.pbobjc.h"
 
+#include "Firestore/core/src/firebase/firestore/local/leveldb_group_commit.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_range_delete.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
 #include "absl/strings/string_view.h"
 #include "leveldb/db.h"
 
 NS_ASSUME_NONNULL_BEGIN
 
+namespace testutil = firebase::firestore::testutil;
+using firebase::firestore::local::LevelDbDocumentMutationKey;
+using firebase::firestore::local::LevelDbGroupCommit;
+using firebase::firestore::local::LevelDbGroupCommitParams;
+using firebase::firestore::local::DeleteEverythingWithPrefix;
+using firebase::firestore::local::DeleteRange;
 using firebase::firestore::local::LevelDbMutationKey;
+using firebase::firestore::local::LevelDbRangeDeleteProgress;
+using firebase::firestore::local::LevelDbTableSizes;
+using firebase::firestore::local::LevelDbTableSizesKey;
+using firebase::firestore::local::LevelDbTargetKey;
 using firebase::firestore::local::LevelDbTransaction;
 using firebase::firestore::util::Path;
 using leveldb::DB;
@@ -78,6 +94,21 @@ using leveldb::WriteOptions;
   XCTAssertFalse(iter->Valid());
 }
 
+- (void)testPutReplacesPendingValue {
+  LevelDbTransaction transaction(_db.get(), "testPutReplacesPendingValue");
+  transaction.Put("key", "first");
+  transaction.Put("key", "second");
+
+  std::string value;
+  XCTAssertTrue(transaction.Get("key", &value).ok());
+  XCTAssertEqual(value, "second");
+
+  transaction.Commit();
+  LevelDbTransaction verify(_db.get(), "verify");
+  XCTAssertTrue(verify.Get("key", &value).ok());
+  XCTAssertEqual(value, "second");
+}
+
 - (void)testCanReadCommittedAndMutations {
   const std::string committed_key1 = "c_key1";
   const std::string committed_value1 = "c_value1";
@@ -304,6 +335,333 @@ using leveldb::WriteOptions;
                               "  - Put [mutation: user_id=user1 batch_id=42] (2 bytes)>");
 }
 
+- (void)testGroupCommitDisabledWritesEachTransaction {
+  LevelDbGroupCommit group(_db.get(), LevelDbGroupCommitParams::Disabled());
+
+  for (int i = 0; i < 3; ++i) {
+    group.Begin("testGroupCommitDisabledWritesEachTransaction")
+        ->Put("key_" + std::to_string(i), "value");
+    XCTAssertTrue(group.Commit());
+    XCTAssertFalse(group.has_pending_writes());
+  }
+
+  XCTAssertEqual(group.stats().physical_commits, 3);
+  XCTAssertEqual(group.stats().logical_commits, 3);
+  XCTAssertEqual(group.stats().max_batch_size, 1);
+}
+
+- (void)testGroupCommitMergesTransactions {
+  LevelDbGroupCommit group(_db.get(),
+                           LevelDbGroupCommitParams{3, 1000, std::chrono::hours(1)});
+  const ReadOptions &readOptions = LevelDbTransaction::DefaultReadOptions();
+  std::string value;
+
+  group.Begin("first")->Put("key_0", "value_0");
+  XCTAssertFalse(group.Commit());
+
+  // Later transactions see the deferred writes even though leveldb doesn't yet.
+  LevelDbTransaction *transaction = group.Begin("second");
+  XCTAssertTrue(transaction->Get("key_0", &value).ok());
+  XCTAssertEqual(value, "value_0");
+  XCTAssertTrue(_db->Get(readOptions, "key_0", &value).IsNotFound());
+  transaction->Delete("key_0");
+  transaction->Put("key_1", "value_1");
+  XCTAssertFalse(group.Commit());
+  XCTAssertTrue(group.has_pending_writes());
+
+  group.Begin("third")->Put("key_2", "value_2");
+  XCTAssertTrue(group.Commit());
+  XCTAssertFalse(group.has_pending_writes());
+
+  XCTAssertTrue(_db->Get(readOptions, "key_0", &value).IsNotFound());
+  XCTAssertTrue(_db->Get(readOptions, "key_1", &value).ok());
+  XCTAssertTrue(_db->Get(readOptions, "key_2", &value).ok());
+
+  XCTAssertEqual(group.stats().physical_commits, 1);
+  XCTAssertEqual(group.stats().logical_commits, 3);
+  XCTAssertEqual(group.stats().keys_written, 3);
+  XCTAssertEqual(group.stats().max_batch_size, 3);
+}
+
+- (void)testGroupCommitWritesLargeGroups {
+  LevelDbGroupCommit group(_db.get(), LevelDbGroupCommitParams{10, 4, std::chrono::hours(1)});
+
+  LevelDbTransaction *transaction = group.Begin("testGroupCommitWritesLargeGroups");
+  for (int i = 0; i < 4; ++i) {
+    transaction->Put("key_" + std::to_string(i), "value");
+  }
+  XCTAssertTrue(group.Commit());
+  XCTAssertEqual(group.stats().physical_commits, 1);
+}
+
+- (void)testGroupCommitFlushSchedulesAndWrites {
+  LevelDbGroupCommit group(_db.get(),
+                           LevelDbGroupCommitParams{10, 1000, std::chrono::hours(1)});
+  int scheduled = 0;
+  group.set_flush_scheduler([&scheduled](std::chrono::milliseconds delay) { scheduled++; });
+
+  group.Begin("first")->Put("key_0", "value_0");
+  XCTAssertFalse(group.Commit());
+  group.Begin("second")->Put("key_1", "value_1");
+  XCTAssertFalse(group.Commit());
+  // Only the transaction opening the group needs to schedule a flush.
+  XCTAssertEqual(scheduled, 1);
+
+  group.Flush();
+  XCTAssertFalse(group.has_pending_writes());
+
+  std::string value;
+  const ReadOptions &readOptions = LevelDbTransaction::DefaultReadOptions();
+  XCTAssertTrue(_db->Get(readOptions, "key_0", &value).ok());
+  XCTAssertTrue(_db->Get(readOptions, "key_1", &value).ok());
+  XCTAssertEqual(group.stats().physical_commits, 1);
+  XCTAssertEqual(group.stats().max_batch_size, 2);
+}
+
+- (void)testSeekForward {
+  const WriteOptions &writeOptions = LevelDbTransaction::DefaultWriteOptions();
+  for (int i = 0; i < 50; i++) {
+    std::string key = "key_" + std::to_string(100 + i);
+    XCTAssertTrue(_db->Put(writeOptions, key, "value").ok());
+  }
+
+  LevelDbTransaction transaction(_db.get(), "testSeekForward");
+  transaction.Delete("key_101");
+  transaction.Put("key_1015", "pending");
+
+  auto iter = transaction.NewIterator();
+  iter->SeekForward("key_100");
+  XCTAssertEqual(iter->key(), "key_100");
+
+  // Deleted keys are skipped, pending puts are visited.
+  iter->SeekForward("key_101");
+  XCTAssertEqual(iter->key(), "key_1015");
+
+  // Far enough ahead to need a real seek.
+  iter->SeekForward("key_140");
+  XCTAssertEqual(iter->key(), "key_140");
+
+  // Never moves backwards.
+  iter->SeekForward("key_120");
+  XCTAssertEqual(iter->key(), "key_140");
+
+  iter->SeekForward("key_2");
+  XCTAssertFalse(iter->Valid());
+}
+
+- (void)testPrefixIteratorStaysInRange {
+  const WriteOptions &writeOptions = LevelDbTransaction::DefaultWriteOptions();
+  XCTAssertTrue(_db->Put(writeOptions, "a", "before").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "b_1", "value").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "b_3", "value").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "c", "after").ok());
+
+  LevelDbTransaction transaction(_db.get(), "testPrefixIteratorStaysInRange");
+  transaction.Put("b_2", "pending");
+  transaction.Put("c_1", "pending");
+  transaction.Delete("b_3");
+
+  auto iter = transaction.NewIterator("b_");
+  std::vector<std::string> keys;
+  for (iter->SeekToFirst(); iter->Valid(); iter->Next()) {
+    keys.emplace_back(iter->key());
+  }
+  XCTAssertEqual(keys, (std::vector<std::string>{"b_1", "b_2"}));
+
+  // Seeking outside the range clamps to it.
+  iter->Seek("a");
+  XCTAssertEqual(iter->key(), "b_1");
+  iter->Seek("c");
+  XCTAssertFalse(iter->Valid());
+}
+
+- (void)testReverseIteration {
+  const WriteOptions &writeOptions = LevelDbTransaction::DefaultWriteOptions();
+  XCTAssertTrue(_db->Put(writeOptions, "key_1", "value").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "key_3", "value").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "key_5", "value").ok());
+  XCTAssertTrue(_db->Put(writeOptions, "other", "value").ok());
+
+  LevelDbTransaction transaction(_db.get(), "testReverseIteration");
+  transaction.Put("key_4", "pending");
+  transaction.Put("key_5", "shadowed");
+  transaction.Delete("key_3");
+
+  auto iter = transaction.NewIterator("key_");
+  std::vector<std::string> keys;
+  for (iter->SeekToLast(); iter->Valid(); iter->Prev()) {
+    keys.emplace_back(iter->key());
+  }
+  XCTAssertEqual(keys, (std::vector<std::string>{"key_5", "key_4", "key_1"}));
+
+  // Changing direction picks up where the iterator is.
+  iter->SeekToLast();
+  XCTAssertEqual(iter->value(), "shadowed");
+  iter->Prev();
+  XCTAssertEqual(iter->key(), "key_4");
+  iter->Next();
+  XCTAssertEqual(iter->key(), "key_5");
+
+  // Deleting the current entry moves Prev() to the entry before it.
+  transaction.Delete("key_5");
+  iter->Prev();
+  XCTAssertEqual(iter->key(), "key_4");
+}
+
+- (LevelDbTableSizes)readTableSizes {
+  std::string encoded;
+  Status status = _db->Get(ReadOptions(), LevelDbTableSizesKey::Key(), &encoded);
+  XCTAssertTrue(status.ok());
+  LevelDbTableSizes sizes;
+  XCTAssertTrue(sizes.Decode(encoded));
+  return sizes;
+}
+
+- (void)testUpdatesTableSizes {
+  std::string target1 = LevelDbTargetKey::Key(1);
+  std::string target2 = LevelDbTargetKey::Key(2);
+  std::string mutation = LevelDbMutationKey::Key("user", 1);
+
+  // Changes aren't counted until the table sizes row exists.
+  LevelDbTransaction untracked(_db.get(), "untracked");
+  untracked.Put(target1, "abc");
+  untracked.Commit();
+  std::string encoded;
+  XCTAssertTrue(_db->Get(ReadOptions(), LevelDbTableSizesKey::Key(), &encoded).IsNotFound());
+
+  LevelDbTableSizes initial;
+  initial.Adjust(target1, LevelDbTableSizes::RowSize(target1, "abc"));
+  LevelDbTransaction start(_db.get(), "start tracking");
+  start.Put(LevelDbTableSizesKey::Key(), initial.Encode());
+  start.Commit();
+
+  LevelDbTransaction add(_db.get(), "add");
+  add.Put(target2, "defgh");
+  add.Put(mutation, "mutation");
+  add.Commit();
+
+  LevelDbTableSizes sizes = [self readTableSizes];
+  XCTAssertEqual(sizes.TableSize("target"), LevelDbTableSizes::RowSize(target1, "abc") +
+                                                LevelDbTableSizes::RowSize(target2, "defgh"));
+  XCTAssertEqual(sizes.TableSize("mutation"), LevelDbTableSizes::RowSize(mutation, "mutation"));
+
+  // Overwriting a row that was read counts only the difference; deleting a row read as missing
+  // counts nothing.
+  LevelDbTransaction change(_db.get(), "change");
+  std::string value;
+  XCTAssertTrue(change.Get(target1, &value).ok());
+  change.Put(target1, "a");
+  auto it = change.NewIterator(LevelDbMutationKey::KeyPrefix());
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    XCTAssertEqual(it->value(), "mutation");
+  }
+  change.Delete(mutation);
+  std::string missing = LevelDbMutationKey::Key("user", 2);
+  XCTAssertTrue(change.Get(missing, &value).IsNotFound());
+  change.Delete(missing);
+  change.Commit();
+
+  sizes = [self readTableSizes];
+  XCTAssertEqual(sizes.TableSize("target"), LevelDbTableSizes::RowSize(target1, "a") +
+                                                LevelDbTableSizes::RowSize(target2, "defgh"));
+  XCTAssertEqual(sizes.TableSize("mutation"), 0);
+  XCTAssertEqual(sizes.total(), sizes.TableSize("target"));
+}
+
+- (void)testCountsRowsChangedWithoutReading {
+  std::string target = LevelDbTargetKey::Key(1);
+  std::string mutation = LevelDbMutationKey::Key("user", 1);
+  std::string index = LevelDbDocumentMutationKey::Key("user", testutil::Key("foo/bar"), 1);
+
+  LevelDbTableSizes sizes;
+  sizes.Adjust(target, LevelDbTableSizes::RowSize(target, "target"));
+  sizes.Adjust(mutation, LevelDbTableSizes::RowSize(mutation, "mutation"));
+  sizes.Adjust(index, LevelDbTableSizes::RowSize(index, ""));
+  LevelDbTransaction populate(_db.get(), "populate");
+  populate.Put(target, "target");
+  populate.Put(mutation, "mutation");
+  populate.Put(index, "");
+  populate.Put(LevelDbTableSizesKey::Key(), sizes.Encode());
+  populate.Commit();
+
+  // The sizes are kept in memory rather than read from the row. Rows the transaction neither read
+  // nor was told about are looked up as it commits.
+  LevelDbTransaction change(_db.get(), "change");
+  change.set_table_sizes(&sizes);
+  change.Put(target, "t");
+  change.Delete(mutation);
+  change.NoteCommittedSize(index, LevelDbTableSizes::RowSize(index, ""));
+  change.Delete(index);
+  change.Commit();
+
+  XCTAssertEqual(sizes.TableSize("target"), LevelDbTableSizes::RowSize(target, "t"));
+  XCTAssertEqual(sizes.TableSize("mutation"), 0);
+  XCTAssertEqual(sizes.TableSize("document_mutation"), 0);
+  XCTAssertEqual(sizes.total(), sizes.TableSize("target"));
+  LevelDbTableSizes written = [self readTableSizes];
+  XCTAssertTrue(written.tables() == sizes.tables());
+}
+
+- (void)testIgnoresCommittedSizesOfChangedRows {
+  std::string target = LevelDbTargetKey::Key(1);
+
+  LevelDbTableSizes sizes;
+  LevelDbTransaction start(_db.get(), "start tracking");
+  start.Put(LevelDbTableSizesKey::Key(), sizes.Encode());
+  start.Commit();
+
+  // Once the row has been written, only the pending value could be described, and the row was
+  // never committed.
+  LevelDbTransaction change(_db.get(), "change");
+  change.set_table_sizes(&sizes);
+  change.Put(target, "first");
+  change.NoteCommittedSize(target, LevelDbTableSizes::RowSize(target, "first"));
+  change.Put(target, "second");
+  change.Commit();
+
+  XCTAssertEqual(sizes.total(), LevelDbTableSizes::RowSize(target, "second"));
+}
+
+- (void)testDeletesRangesInBatches {
+  LevelDbTableSizes initial;
+  LevelDbTransaction populate(_db.get(), "populate");
+  for (int i = 1; i <= 25; ++i) {
+    std::string target = LevelDbTargetKey::Key(i);
+    populate.Put(target, "target");
+    initial.Adjust(target, LevelDbTableSizes::RowSize(target, "target"));
+  }
+  std::string mutation = LevelDbMutationKey::Key("user", 1);
+  populate.Put(mutation, "mutation");
+  initial.Adjust(mutation, LevelDbTableSizes::RowSize(mutation, "mutation"));
+  populate.Put(LevelDbTableSizesKey::Key(), initial.Encode());
+  populate.Commit();
+
+  // Targets 1 through 10.
+  std::vector<int64_t> rowsAfterEachBatch;
+  LevelDbRangeDeleteProgress progress = DeleteRange(
+      _db.get(), LevelDbTargetKey::Key(1), LevelDbTargetKey::Key(11),
+      [&](const LevelDbRangeDeleteProgress &batch) {
+        rowsAfterEachBatch.push_back(batch.rows_deleted);
+      },
+      4);
+  XCTAssertEqual(progress.rows_deleted, 10);
+  XCTAssertEqual(progress.batches_written, 3);
+  XCTAssertTrue((rowsAfterEachBatch == std::vector<int64_t>{4, 8, 10}));
+
+  std::string value;
+  XCTAssertTrue(_db->Get(ReadOptions(), LevelDbTargetKey::Key(10), &value).IsNotFound());
+  XCTAssertTrue(_db->Get(ReadOptions(), LevelDbTargetKey::Key(11), &value).ok());
+
+  progress = DeleteEverythingWithPrefix(_db.get(), LevelDbTargetKey::KeyPrefix());
+  XCTAssertEqual(progress.rows_deleted, 15);
+  XCTAssertEqual(progress.batches_written, 1);
+
+  LevelDbTableSizes sizes = [self readTableSizes];
+  XCTAssertEqual(sizes.TableSize("target"), 0);
+  XCTAssertEqual(sizes.total(), LevelDbTableSizes::RowSize(mutation, "mutation"));
+  XCTAssertTrue(_db->Get(ReadOptions(), mutation, &value).ok());
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -889,6 +889,40 @@ NS_ASSUME_NONNULL_BEGIN
                         ]));
 }
 
+- (void)testReexecutesCollectionQueriesAfterChanges {
+  if ([self isTestBaseClass]) return;
+
+  FSTQuery *query = [FSTTestQuery("foo") queryByAddingFilter:FSTTestFilter("a", @"==", @"b")];
+  [self allocateQuery:query];
+  FSTAssertTargetID(2);
+
+  [self applyRemoteEvent:FSTTestUpdateRemoteEvent(
+                             FSTTestDoc("foo/bar", 10, @{@"a" : @"b"}, FSTDocumentStateSynced),
+                             @[ @2 ], @[])];
+  [self writeMutation:FSTTestSetMutation(@"foo/baz", @{@"a" : @"b"})];
+  DocumentMap docs = [self.localStore executeQuery:query];
+  XCTAssertEqualObjects(docMapToArray(docs), (@[
+                          FSTTestDoc("foo/bar", 10, @{@"a" : @"b"}, FSTDocumentStateSynced),
+                          FSTTestDoc("foo/baz", 0, @{@"a" : @"b"}, FSTDocumentStateLocalMutations)
+                        ]));
+
+  // Results computed from the earlier ones must reflect remote and local changes alike.
+  [self applyRemoteEvent:FSTTestUpdateRemoteEvent(
+                             FSTTestDoc("foo/bar", 20, @{@"a" : @"c"}, FSTDocumentStateSynced),
+                             @[ @2 ], @[])];
+  [self writeMutation:FSTTestSetMutation(@"foo/bonk", @{@"a" : @"b"})];
+  docs = [self.localStore executeQuery:query];
+  XCTAssertEqualObjects(docMapToArray(docs), (@[
+                          FSTTestDoc("foo/baz", 0, @{@"a" : @"b"}, FSTDocumentStateLocalMutations),
+                          FSTTestDoc("foo/bonk", 0, @{@"a" : @"b"}, FSTDocumentStateLocalMutations)
+                        ]));
+
+  [self rejectMutation];
+  docs = [self.localStore executeQuery:query];
+  XCTAssertEqualObjects(docMapToArray(docs), (@[ FSTTestDoc("foo/bonk", 0, @{@"a" : @"b"},
+                                                            FSTDocumentStateLocalMutations) ]));
+}
+
 - (void)testPersistsResumeTokens {
   if ([self isTestBaseClass]) return;
   // This test only works in the absence of the FSTEagerGarbageCollector.
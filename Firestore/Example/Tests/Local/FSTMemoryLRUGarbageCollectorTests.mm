@@ -17,8 +17,11 @@
 #import "Firestore/Example/Tests/Local/FSTLRUGarbageCollectorTests.h"
 
 #import "Firestore/Example/Tests/Local/FSTPersistenceTestHelpers.h"
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
 #import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 #import "Firestore/Source/Local/FSTMemoryPersistence.h"
+#import "Firestore/Source/Local/FSTQueryData.h"
+#import "Firestore/Source/Model/FSTDocument.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 
 using firebase::firestore::model::DocumentKey;
@@ -42,6 +45,39 @@ NS_ASSUME_NONNULL_BEGIN
   return [delegate isPinnedAtSequenceNumber:0 document:key];
 }
 
+- (void)testTracksSizeAsCacheChanges {
+  FSTMemoryPersistence *persistence = [FSTPersistenceTestHelpers lruMemoryPersistence];
+  id<FSTLRUDelegate> delegate = (id<FSTLRUDelegate>)persistence.referenceDelegate;
+  size_t initialSize = [delegate byteSize];
+
+  FSTDocument *doc = FSTTestDoc("docs/a", 1, @{@"n" : @1}, FSTDocumentStateSynced);
+  FSTQueryData *queryData = [[FSTQueryData alloc] initWithQuery:FSTTestQuery("docs")
+                                                       targetID:1
+                                           listenSequenceNumber:1
+                                                        purpose:FSTQueryPurposeListen];
+  persistence.run("add", [&]() {
+    persistence.remoteDocumentCache->Add(doc);
+    persistence.queryCache->AddTarget(queryData);
+  });
+  size_t addedSize = [delegate byteSize];
+  XCTAssertGreaterThan(addedSize, initialSize);
+
+  // Replacing a document counts only the new version.
+  persistence.run("replace", [&]() {
+    persistence.remoteDocumentCache->Add(
+        FSTTestDoc("docs/a", 2, @{@"n" : @"a longer value"}, FSTDocumentStateSynced));
+  });
+  XCTAssertGreaterThan([delegate byteSize], addedSize);
+
+  persistence.run("remove", [&]() {
+    persistence.remoteDocumentCache->Remove(doc.key);
+    persistence.queryCache->RemoveTarget(queryData);
+  });
+  XCTAssertEqual([delegate byteSize], initialSize);
+
+  [persistence shutdown];
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
\ No newline at end of file
@@ -148,6 +148,41 @@ NS_ASSUME_NONNULL_BEGIN
   });
 }
 
+- (void)testUpdateResumeToken {
+  if ([self isTestBaseClass]) return;
+
+  self.persistence.run("testUpdateResumeToken", [&]() {
+    FSTQueryData *queryData1 = [self queryDataWithQuery:_queryRooms
+                                               targetID:1
+                                   listenSequenceNumber:10
+                                                version:1];
+    self.queryCache->AddTarget(queryData1);
+
+    FSTQueryData *queryData2 = [self queryDataWithQuery:_queryRooms
+                                               targetID:1
+                                   listenSequenceNumber:11
+                                                version:2];
+    self.queryCache->UpdateResumeToken(queryData2);
+
+    // Only the resume token and snapshot version change.
+    FSTQueryData *result = self.queryCache->GetTarget(_queryRooms);
+    XCTAssertEqualObjects(result.resumeToken, queryData2.resumeToken);
+    XCTAssertEqual(result.snapshotVersion, queryData2.snapshotVersion);
+    XCTAssertEqual(result.sequenceNumber, queryData1.sequenceNumber);
+
+    // A full update supersedes the recorded resume token.
+    FSTQueryData *queryData3 = [self queryDataWithQuery:_queryRooms
+                                               targetID:1
+                                   listenSequenceNumber:12
+                                                version:3];
+    self.queryCache->UpdateTarget(queryData3);
+    XCTAssertEqualObjects(self.queryCache->GetTarget(_queryRooms), queryData3);
+
+    self.queryCache->RemoveTarget(queryData3);
+    XCTAssertNil(self.queryCache->GetTarget(_queryRooms));
+  });
+}
+
 - (void)testRemoveQuery {
   if ([self isTestBaseClass]) return;
 
@@ -0,0 +1,135 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <XCTest/XCTest.h>
+
+#include <cstdint>
+#include <string>
+
+#import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Model/FSTDocument.h"
+
+#include "Firestore/core/src/firebase/firestore/local/query_result_cache.h"
+#include "Firestore/core/src/firebase/firestore/model/document_map.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+
+#import "Firestore/Example/Tests/Util/FSTHelpers.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace testutil = firebase::firestore::testutil;
+using firebase::firestore::local::QueryResultCache;
+using firebase::firestore::local::QueryResults;
+using firebase::firestore::model::DocumentMap;
+
+/** Creates results for `count` documents in the collection at `path`. */
+static QueryResults Results(const std::string &path, int count, int64_t position) {
+  DocumentMap documents;
+  for (int i = 0; i < count; i++) {
+    std::string doc_path = path + "/doc" + std::to_string(i);
+    FSTDocument *doc = FSTTestDoc(doc_path, 1, @{}, FSTDocumentStateSynced);
+    documents = documents.insert(testutil::Key(doc_path), doc);
+  }
+  return QueryResults{documents, position};
+}
+
+@interface FSTQueryResultCacheTests : XCTestCase
+@end
+
+@implementation FSTQueryResultCacheTests
+
+- (void)testReturnsCachedResults {
+  QueryResultCache cache(10);
+  FSTQuery *query = FSTTestQuery("coll");
+
+  XCTAssertTrue(cache.Get(query) == nullptr);
+
+  cache.Put(query, Results("coll", 2, 7));
+  const QueryResults *results = cache.Get(query);
+  XCTAssertTrue(results != nullptr);
+  XCTAssertEqual(results->documents.size(), 2);
+  XCTAssertEqual(results->change_log_position, 7);
+  XCTAssertEqual(cache.document_count(), 2);
+}
+
+- (void)testReplacesResultsOfTheSameQuery {
+  QueryResultCache cache(10);
+  FSTQuery *query = FSTTestQuery("coll");
+
+  cache.Put(query, Results("coll", 3, 1));
+  cache.Put(FSTTestQuery("coll"), Results("coll", 1, 2));
+
+  const QueryResults *results = cache.Get(query);
+  XCTAssertTrue(results != nullptr);
+  XCTAssertEqual(results->documents.size(), 1);
+  XCTAssertEqual(results->change_log_position, 2);
+  XCTAssertEqual(cache.document_count(), 1);
+}
+
+- (void)testEvictsLeastRecentlyUsedResults {
+  QueryResultCache cache(4);
+  FSTQuery *a = FSTTestQuery("a");
+  FSTQuery *b = FSTTestQuery("b");
+  FSTQuery *c = FSTTestQuery("c");
+
+  cache.Put(a, Results("a", 2, 1));
+  cache.Put(b, Results("b", 1, 1));
+  XCTAssertEqual(cache.document_count(), 3);
+
+  // Reading `a` makes `b` the least recently used entry.
+  XCTAssertTrue(cache.Get(a) != nullptr);
+
+  cache.Put(c, Results("c", 2, 1));
+  XCTAssertTrue(cache.Get(b) == nullptr);
+  XCTAssertTrue(cache.Get(c) != nullptr);
+  XCTAssertTrue(cache.Get(a) != nullptr);
+  XCTAssertEqual(cache.document_count(), 4);
+
+  // `a` was read after `c`, so `c` goes next.
+  cache.Put(b, Results("b", 1, 2));
+  XCTAssertTrue(cache.Get(c) == nullptr);
+  XCTAssertTrue(cache.Get(a) != nullptr);
+  XCTAssertTrue(cache.Get(b) != nullptr);
+  XCTAssertEqual(cache.document_count(), 3);
+}
+
+- (void)testDoesNotCacheResultsLargerThanTheCache {
+  QueryResultCache cache(2);
+  FSTQuery *small = FSTTestQuery("small");
+  FSTQuery *large = FSTTestQuery("large");
+
+  cache.Put(small, Results("small", 1, 1));
+  cache.Put(large, Results("large", 3, 1));
+
+  XCTAssertTrue(cache.Get(large) == nullptr);
+  XCTAssertTrue(cache.Get(small) != nullptr);
+  XCTAssertEqual(cache.document_count(), 1);
+}
+
+- (void)testClear {
+  QueryResultCache cache(10);
+  FSTQuery *query = FSTTestQuery("coll");
+
+  cache.Put(query, Results("coll", 2, 1));
+  cache.Clear();
+
+  XCTAssertTrue(cache.Get(query) == nullptr);
+  XCTAssertEqual(cache.document_count(), 0);
+}
+
+@end
+
+NS_ASSUME_NONNULL_END
@@ -186,6 +186,28 @@ static const int kVersion = 42;
   });
 }
 
+- (void)testDocumentsMatchingQuerySkipsSubcollectionsAndRemovedDocuments {
+  if (!self.remoteDocumentCache) return;
+
+  self.persistence.run("testDocumentsMatchingQuerySkipsSubcollectionsAndRemovedDocuments", [&]() {
+    [self setTestDocumentAtPath:"b/1"];
+    [self setTestDocumentAtPath:"b/1/c/1"];
+    [self setTestDocumentAtPath:"b/2"];
+    [self setTestDocumentAtPath:"b/3"];
+    self.remoteDocumentCache->Remove(testutil::Key("b/2"));
+
+    DocumentMap results = self.remoteDocumentCache->GetMatching(FSTTestQuery("b"));
+    [self expectMap:results.underlying_map()
+        hasDocsInArray:@[
+          FSTTestDoc("b/1", kVersion, _kDocData, FSTDocumentStateSynced),
+          FSTTestDoc("b/3", kVersion, _kDocData, FSTDocumentStateSynced)
+        ]
+               exactly:YES];
+
+    XCTAssertTrue(self.remoteDocumentCache->GetMatching(FSTTestQuery("d")).empty());
+  });
+}
+
 #pragma mark - Helpers
 - (FSTDocument *)setTestDocumentAtPath:(const absl::string_view)path {
   FSTDocument *doc = FSTTestDoc(path, kVersion, _kDocData, FSTDocumentStateSynced);
@@ -25,6 +25,7 @@ static const BOOL kDefaultSSLEnabled = YES;
 static const BOOL kDefaultPersistenceEnabled = YES;
 static const int64_t kDefaultCacheSizeBytes = 100 * 1024 * 1024;
 static const int64_t kMinimumCacheSizeBytes = 1 * 1024 * 1024;
+static const BOOL kDefaultMemoryLRUGarbageCollectionEnabled = NO;
 // TODO(b/73820332): flip the default.
 static const BOOL kDefaultTimestampsInSnapshotsEnabled = NO;
 
@@ -38,6 +39,7 @@ static const BOOL kDefaultTimestampsInSnapshotsEnabled = NO;
     _persistenceEnabled = kDefaultPersistenceEnabled;
     _timestampsInSnapshotsEnabled = kDefaultTimestampsInSnapshotsEnabled;
     _cacheSizeBytes = kDefaultCacheSizeBytes;
+    _memoryLRUGarbageCollectionEnabled = kDefaultMemoryLRUGarbageCollectionEnabled;
   }
   return self;
 }
@@ -55,7 +57,9 @@ static const BOOL kDefaultTimestampsInSnapshotsEnabled = NO;
          self.dispatchQueue == otherSettings.dispatchQueue &&
          self.isPersistenceEnabled == otherSettings.isPersistenceEnabled &&
          self.timestampsInSnapshotsEnabled == otherSettings.timestampsInSnapshotsEnabled &&
-         self.cacheSizeBytes == otherSettings.cacheSizeBytes;
+         self.cacheSizeBytes == otherSettings.cacheSizeBytes &&
+         self.isMemoryLRUGarbageCollectionEnabled ==
+             otherSettings.isMemoryLRUGarbageCollectionEnabled;
 }
 
 - (NSUInteger)hash {
@@ -65,6 +69,7 @@ static const BOOL kDefaultTimestampsInSnapshotsEnabled = NO;
   result = 31 * result + (self.isPersistenceEnabled ? 1231 : 1237);
   result = 31 * result + (self.timestampsInSnapshotsEnabled ? 1231 : 1237);
   result = 31 * result + (NSUInteger)self.cacheSizeBytes;
+  result = 31 * result + (self.isMemoryLRUGarbageCollectionEnabled ? 1231 : 1237);
   return result;
 }
 
@@ -76,6 +81,7 @@ static const BOOL kDefaultTimestampsInSnapshotsEnabled = NO;
   copy.persistenceEnabled = _persistenceEnabled;
   copy.timestampsInSnapshotsEnabled = _timestampsInSnapshotsEnabled;
   copy.cacheSizeBytes = _cacheSizeBytes;
+  copy.memoryLRUGarbageCollectionEnabled = _memoryLRUGarbageCollectionEnabled;
   return copy;
 }
 
@@ -76,6 +76,10 @@ NS_ASSUME_NONNULL_BEGIN
 static const std::chrono::milliseconds FSTLruGcInitialDelay = std::chrono::minutes(1);
 /** Minimum amount of time between GC checks, after the first one. */
 static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minutes(5);
+/** The number of rows each slice of LRU GC examines before yielding the worker queue. */
+static const int FSTLruGcSliceRowBudget = 500;
+/** How long to leave the worker queue free for other work between slices of LRU GC. */
+static const std::chrono::milliseconds FSTLruGcSliceDelay = std::chrono::milliseconds(50);
 
 @interface FSTFirestoreClient () {
   DatabaseInfo _databaseInfo;
@@ -115,6 +119,11 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
   BOOL _gcHasRun;
   _Nullable id<FSTLRUDelegate> _lruDelegate;
   DelayedOperation _lruCallback;
+  DelayedOperation _groupCommitFlush;
+
+  /** When the client was created, for measuring how long startup takes. */
+  std::chrono::steady_clock::time_point _creationTime;
+  BOOL _firstQueryListened;
 }
 
 - (Executor *)userExecutor {
@@ -150,6 +159,8 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
     _userExecutor = std::move(userExecutor);
     _workerQueue = std::move(workerQueue);
     _gcHasRun = NO;
+    _creationTime = std::chrono::steady_clock::now();
+    _firstQueryListened = NO;
     _initialGcDelay = FSTLruGcInitialDelay;
     _regularGcDelay = FSTLruGcRegularDelay;
 
@@ -191,20 +202,21 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
   // Note: The initialization work must all be synchronous (we can't dispatch more work) since
   // external write/listen operations could get queued to run before that subsequent work
   // completes.
+  FSTSerializerBeta *remoteSerializer =
+      [[FSTSerializerBeta alloc] initWithDatabaseID:&self.databaseInfo->database_id()];
+  FSTLocalSerializer *serializer =
+      [[FSTLocalSerializer alloc] initWithRemoteSerializer:remoteSerializer];
+  LruParams lruParams = LruParams::WithCacheSize(settings.cacheSizeBytes);
+
   if (settings.isPersistenceEnabled) {
     Path dir = [FSTLevelDB storageDirectoryForDatabaseInfo:*self.databaseInfo
                                         documentsDirectory:[FSTLevelDB documentsDirectory]];
 
-    FSTSerializerBeta *remoteSerializer =
-        [[FSTSerializerBeta alloc] initWithDatabaseID:&self.databaseInfo->database_id()];
-    FSTLocalSerializer *serializer =
-        [[FSTLocalSerializer alloc] initWithRemoteSerializer:remoteSerializer];
     FSTLevelDB *ldb;
-    Status levelDbStatus =
-        [FSTLevelDB dbWithDirectory:std::move(dir)
-                         serializer:serializer
-                          lruParams:LruParams::WithCacheSize(settings.cacheSizeBytes)
-                                ptr:&ldb];
+    Status levelDbStatus = [FSTLevelDB dbWithDirectory:std::move(dir)
+                                            serializer:serializer
+                                             lruParams:lruParams
+                                                   ptr:&ldb];
     if (!levelDbStatus.ok()) {
       // If leveldb fails to start then just throw up our hands: the error is unrecoverable.
       // There's nothing an end-user can do and nearly all failures indicate the developer is doing
@@ -213,9 +225,18 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
       [NSException raise:NSInternalInconsistencyException
                   format:@"Failed to open DB: %s", levelDbStatus.ToString().c_str()];
     }
+    LOG_DEBUG("Opened persistence %s ms after client creation", [self millisecondsSinceCreation]);
     _lruDelegate = ldb.referenceDelegate;
     _persistence = ldb;
     [self scheduleLruGarbageCollection];
+    [self configureGroupCommitFlushes:ldb];
+  } else if (settings.isMemoryLRUGarbageCollectionEnabled) {
+    // The cache size bounds the memory used by the cache just as it bounds the disk space.
+    FSTMemoryPersistence *memory = [FSTMemoryPersistence persistenceWithLruParams:lruParams
+                                                                       serializer:serializer];
+    _lruDelegate = (id<FSTLRUDelegate>)memory.referenceDelegate;
+    _persistence = memory;
+    [self scheduleLruGarbageCollection];
   } else {
     _persistence = [FSTMemoryPersistence persistenceWithEagerGC];
   }
@@ -253,13 +274,49 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
  */
 - (void)scheduleLruGarbageCollection {
   std::chrono::milliseconds delay = _gcHasRun ? _regularGcDelay : _initialGcDelay;
+  [self scheduleLruGarbageCollectionAfterDelay:delay];
+}
+
+/**
+ * Schedules a callback to run a slice of LRU garbage collection. A collection runs as a series of
+ * slices with short gaps between them so that it never holds up other work on the worker queue
+ * for long.
+ */
+- (void)scheduleLruGarbageCollectionAfterDelay:(std::chrono::milliseconds)delay {
   _lruCallback = _workerQueue->EnqueueAfterDelay(delay, TimerId::GarbageCollectionDelay, [self]() {
-    [self->_localStore collectGarbage:self->_lruDelegate.gc];
-    self->_gcHasRun = YES;
-    [self scheduleLruGarbageCollection];
+    BOOL finished = [self->_localStore collectGarbage:self->_lruDelegate.gc
+                                            rowBudget:FSTLruGcSliceRowBudget];
+    if (finished) {
+      self->_gcHasRun = YES;
+      [self scheduleLruGarbageCollection];
+    } else {
+      [self scheduleLruGarbageCollectionAfterDelay:FSTLruGcSliceDelay];
+    }
   });
 }
 
+/**
+ * Arranges for LevelDB writes deferred by group commit to be written out once the group commit
+ * delay elapses, even if no further transactions arrive.
+ */
+- (void)configureGroupCommitFlushes:(FSTLevelDB *)ldb {
+  __weak FSTFirestoreClient *weakSelf = self;
+  __weak FSTLevelDB *weakDb = ldb;
+  [ldb setGroupCommitFlushScheduler:[weakSelf, weakDb](std::chrono::milliseconds delay) {
+    FSTFirestoreClient *strongSelf = weakSelf;
+    // A flush that's already scheduled covers the new group too: flushing early is harmless.
+    if (!strongSelf || strongSelf->_groupCommitFlush) return;
+    strongSelf->_groupCommitFlush = strongSelf->_workerQueue->EnqueueAfterDelay(
+        delay, TimerId::GroupCommitFlush, [weakSelf, weakDb]() {
+          FSTFirestoreClient *strongSelf = weakSelf;
+          if (strongSelf) {
+            strongSelf->_groupCommitFlush = DelayedOperation{};
+          }
+          [weakDb flushPendingWrites];
+        });
+  }];
+}
+
 - (void)credentialDidChangeWithUser:(const User &)user {
   _workerQueue->VerifyIsCurrentQueue();
 
@@ -297,6 +354,10 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
     if (self->_lruCallback) {
       self->_lruCallback.Cancel();
     }
+    // Persistence writes out any deferred transactions as part of its shutdown.
+    if (self->_groupCommitFlush) {
+      self->_groupCommitFlush.Cancel();
+    }
     [self.remoteStore shutdown];
     [self.persistence shutdown];
     if (completion) {
@@ -312,11 +373,27 @@ static const std::chrono::milliseconds FSTLruGcRegularDelay = std::chrono::minut
                                                                options:options
                                                    viewSnapshotHandler:viewSnapshotHandler];
 
-  _workerQueue->Enqueue([self, listener] { [self.eventManager addListener:listener]; });
+  _workerQueue->Enqueue([self, listener] {
+    [self.eventManager addListener:listener];
+
+    // Adding a listener raises its initial snapshot from the local cache, so this measures how
+    // long a cold start keeps the app waiting for data.
+    if (!self->_firstQueryListened) {
+      self->_firstQueryListened = YES;
+      LOG_DEBUG("First query listened %s ms after client creation",
+                [self millisecondsSinceCreation]);
+    }
+  });
 
   return listener;
 }
 
+- (int64_t)millisecondsSinceCreation {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() -
+                                                               _creationTime)
+      .count();
+}
+
 - (void)removeListener:(FSTQueryListener *)listener {
   _workerQueue->Enqueue([self, listener] { [self.eventManager removeListener:listener]; });
 }
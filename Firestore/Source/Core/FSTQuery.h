@@ -278,6 +278,12 @@ typedef NS_ENUM(NSInteger, FSTRelationFilterOperator) {
  */
 @property(nonatomic, strong, readonly) NSString *canonicalID;
 
+/**
+ * A 64-bit hash of the canonicalID, computed once per query. Unlike -[NSString hash], it covers
+ * the whole canonicalID, so it can key maps of live targets.
+ */
+@property(nonatomic, assign, readonly) uint64_t canonicalHash;
+
 /** An optional bound to start the query at. */
 @property(nonatomic, nullable, strong, readonly) FSTBound *startAt;
 
@@ -423,7 +423,7 @@ NSString *FSTStringFromQueryRelationOperator(FSTRelationFilterOperator filterOpe
 }
 
 - (NSUInteger)hash {
-  return [self.canonicalID hash];
+  return (NSUInteger)self.canonicalHash;
 }
 
 - (instancetype)copyWithZone:(nullable NSZone *)zone {
@@ -531,6 +531,9 @@ NSString *FSTStringFromQueryRelationOperator(FSTRelationFilterOperator filterOpe
 @interface FSTQuery () {
   // Cached value of the canonicalID property.
   NSString *_canonicalID;
+  // Cached value of the canonicalHash property, valid once _canonicalHashed is set.
+  uint64_t _canonicalHash;
+  BOOL _canonicalHashed;
   /** The base path of the query. */
   ResourcePath _path;
 }
@@ -605,7 +608,7 @@ NSString *FSTStringFromQueryRelationOperator(FSTRelationFilterOperator filterOpe
 }
 
 - (NSUInteger)hash {
-  return [self.canonicalID hash];
+  return (NSUInteger)self.canonicalHash;
 }
 
 - (instancetype)copyWithZone:(nullable NSZone *)zone {
@@ -816,6 +819,14 @@ NSString *FSTStringFromQueryRelationOperator(FSTRelationFilterOperator filterOpe
   return canonicalID;
 }
 
+- (uint64_t)canonicalHash {
+  if (!_canonicalHashed) {
+    _canonicalHash = util::Fingerprint64(util::MakeStringView(self.canonicalID));
+    _canonicalHashed = YES;
+  }
+  return _canonicalHash;
+}
+
 #pragma mark - Private methods
 
 - (BOOL)isEqualToQuery:(FSTQuery *)other {
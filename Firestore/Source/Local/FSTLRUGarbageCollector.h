@@ -20,6 +20,7 @@
 
 #import "FIRFirestoreSettings.h"
 #import "Firestore/Source/Local/FSTQueryData.h"
+#include "Firestore/core/src/firebase/firestore/local/incremental_lru_garbage_collector.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 
@@ -72,7 +73,7 @@ struct LruResults {
  * Persistence layers intending to use LRU Garbage collection should implement this protocol. This
  * protocol defines the operations that the LRU garbage collector needs from the persistence layer.
  */
-@protocol FSTLRUDelegate
+@protocol FSTLRUDelegate <NSObject>
 
 /**
  * Enumerates all the targets that the delegate is aware of. This is typically all of the targets in
@@ -111,6 +112,23 @@ struct LruResults {
 /** Access to the underlying LRU Garbage collector instance. */
 @property(strong, nonatomic, readonly) FSTLRUGarbageCollector *gc;
 
+@optional
+
+/**
+ * Returns the nth lowest sequence number among targets and orphaned documents. Delegates that keep
+ * these ordered by sequence number can implement this to save the garbage collector enumerating
+ * all of them.
+ */
+- (firebase::firestore::model::ListenSequenceNumber)sequenceNumberForQueryCount:
+    (NSUInteger)queryCount;
+
+/**
+ * Returns the operations needed to collect garbage a slice at a time. The returned delegate must
+ * live as long as this one. Garbage collection for delegates that don't implement this runs in a
+ * single pass.
+ */
+- (firebase::firestore::local::LruGcDelegate *)incrementalGCDelegate;
+
 @end
 
 /**
@@ -158,4 +176,18 @@ struct LruResults {
 - (firebase::firestore::local::LruResults)collectWithLiveTargets:
     (NSDictionary<NSNumber *, FSTQueryData *> *)liveTargets;
 
+/**
+ * Runs part of a garbage collection, examining at most `rowBudget` rows, so that collecting a large
+ * cache can be spread over several transactions. Starts a new collection if none is in progress and
+ * the cache is over the size threshold. If the delegate can't collect incrementally, runs a whole
+ * collection instead.
+ *
+ * @return YES if no collection is in progress any more.
+ */
+- (BOOL)collectSliceWithLiveTargets:(NSDictionary<NSNumber *, FSTQueryData *> *)liveTargets
+                          rowBudget:(int)rowBudget;
+
+/** Receives timings for collections run in slices. Not owned. */
+@property(nonatomic, assign, nullable) firebase::firestore::local::LruGcMetrics *metrics;
+
 @end
@@ -17,7 +17,9 @@
 #import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 
 #include <chrono>  //NOLINT(build/c++11)
+#include <memory>
 #include <queue>
+#include <unordered_set>
 #include <utility>
 
 #import "Firestore/Source/Local/FSTMutationQueue.h"
@@ -25,13 +27,17 @@
 #include "Firestore/core/include/firebase/firestore/timestamp.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/util/log.h"
+#include "absl/memory/memory.h"
 
 using Millis = std::chrono::milliseconds;
 using firebase::Timestamp;
+using firebase::firestore::local::IncrementalLruGarbageCollector;
+using firebase::firestore::local::LruGcMetrics;
 using firebase::firestore::local::LruParams;
 using firebase::firestore::local::LruResults;
 using firebase::firestore::model::DocumentKey;
 using firebase::firestore::model::ListenSequenceNumber;
+using firebase::firestore::model::TargetId;
 
 const int64_t kFIRFirestoreCacheSizeUnlimited = LruParams::CacheSizeUnlimited;
 const ListenSequenceNumber kFSTListenSequenceNumberInvalid = -1;
@@ -82,6 +88,9 @@ class RollingSequenceNumberBuffer {
 @implementation FSTLRUGarbageCollector {
   __weak id<FSTLRUDelegate> _delegate;
   LruParams _params;
+  LruGcMetrics *_metrics;
+  // Created on first use, since it loads saved progress from the delegate.
+  std::unique_ptr<IncrementalLruGarbageCollector> _incrementalGC;
 }
 
 - (instancetype)initWithDelegate:(id<FSTLRUDelegate>)delegate params:(LruParams)params {
@@ -111,6 +120,52 @@ class RollingSequenceNumberBuffer {
   }
 }
 
+- (BOOL)collectSliceWithLiveTargets:(NSDictionary<NSNumber *, FSTQueryData *> *)liveTargets
+                          rowBudget:(int)rowBudget {
+  if (![_delegate respondsToSelector:@selector(incrementalGCDelegate)]) {
+    [self collectWithLiveTargets:liveTargets];
+    return YES;
+  }
+
+  if (!_incrementalGC) {
+    _incrementalGC = absl::make_unique<IncrementalLruGarbageCollector>(
+        [_delegate incrementalGCDelegate], _params.percentileToCollect,
+        _params.maximumSequenceNumbersToCollect, _metrics);
+  }
+
+  if (!_incrementalGC->in_progress()) {
+    if (_params.minBytesThreshold == kFIRFirestoreCacheSizeUnlimited) {
+      LOG_DEBUG("Garbage collection skipped; disabled");
+      return YES;
+    }
+
+    size_t currentSize = [self byteSize];
+    if (currentSize < _params.minBytesThreshold) {
+      LOG_DEBUG("Garbage collection skipped; Cache size %s is lower than threshold %s",
+                currentSize, _params.minBytesThreshold);
+      return YES;
+    }
+    _incrementalGC->Start();
+  }
+
+  std::unordered_set<TargetId> liveTargetIDs;
+  for (NSNumber *targetID in liveTargets) {
+    liveTargetIDs.insert([targetID intValue]);
+  }
+  return _incrementalGC->RunSlice(rowBudget, liveTargetIDs);
+}
+
+- (LruGcMetrics *)metrics {
+  return _metrics;
+}
+
+- (void)setMetrics:(LruGcMetrics *)metrics {
+  _metrics = metrics;
+  if (_incrementalGC) {
+    _incrementalGC->set_metrics(metrics);
+  }
+}
+
 - (LruResults)runGCWithLiveTargets:(NSDictionary<NSNumber *, FSTQueryData *> *)liveTargets {
   Timestamp start = Timestamp::Now();
   int sequenceNumbers = [self queryCountForPercentile:_params.percentileToCollect];
@@ -156,6 +211,9 @@ class RollingSequenceNumberBuffer {
   if (queryCount == 0) {
     return kFSTListenSequenceNumberInvalid;
   }
+  if ([_delegate respondsToSelector:@selector(sequenceNumberForQueryCount:)]) {
+    return [_delegate sequenceNumberForQueryCount:queryCount];
+  }
   RollingSequenceNumberBuffer buffer(queryCount);
   // Pointer is necessary to access stack-allocated buffer from a block.
   RollingSequenceNumberBuffer *ptr_to_buffer = &buffer;
@@ -23,7 +23,13 @@
 #import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 #import "Firestore/Source/Local/FSTPersistence.h"
 #include "Firestore/core/src/firebase/firestore/core/database_info.h"
+#include "Firestore/core/src/firebase/firestore/local/decoded_document_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_group_commit.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
+#include "Firestore/core/src/firebase/firestore/model/types.h"
 #include "Firestore/core/src/firebase/firestore/util/path.h"
 #include "Firestore/core/src/firebase/firestore/util/status.h"
 #include "Firestore/core/src/firebase/firestore/util/statusor.h"
@@ -81,6 +87,68 @@ NS_ASSUME_NONNULL_BEGIN
 
 @property(nonatomic, readonly) const std::set<std::string> &users;
 
+/**
+ * A filter over the documents with queued mutations for any user, which mutation queues update as
+ * they add and remove batches.
+ */
+@property(nonatomic, readonly) firebase::firestore::local::DocumentKeyFilter *mutatedDocuments;
+
+/**
+ * Returns one larger than the largest batch ID stored in any mutation queue. Until the first
+ * transaction commits this is answered from the rows read when the database was opened, rather
+ * than by scanning the mutation table again.
+ */
+- (firebase::firestore::model::BatchId)loadNextBatchID;
+
+/**
+ * Controls whether consecutive transactions are merged into a single LevelDB write. Defaults to
+ * LevelDbGroupCommitParams::Disabled(). Changing the parameters writes out any pending group.
+ */
+@property(nonatomic, assign) firebase::firestore::local::LevelDbGroupCommitParams groupCommitParams;
+
+/** Counters describing the LevelDB writes performed so far. */
+@property(nonatomic, readonly)
+    const firebase::firestore::local::LevelDbGroupCommitStats &groupCommitStats;
+
+/**
+ * Registers a callback that is invoked when a transaction's writes are deferred into a new group.
+ * The callback should arrange for -flushPendingWrites to be called after the given delay.
+ */
+- (void)setGroupCommitFlushScheduler:
+    (firebase::firestore::local::LevelDbGroupCommit::FlushScheduler)scheduler;
+
+/** Writes out any transactions whose writes have been deferred by group commit. */
+- (void)flushPendingWrites;
+
+/**
+ * Controls whether remote documents are compressed when written. Defaults to
+ * LevelDbValueCompressionOptions::Disabled(). Documents already stored remain readable regardless.
+ */
+@property(nonatomic, assign)
+    firebase::firestore::local::LevelDbValueCompressionOptions documentCompressionOptions;
+
+/**
+ * Trains a compression dictionary from up to `sampleCount` cached documents and uses it to compress
+ * documents written from now on, while compression is enabled.
+ */
+- (void)trainDocumentCompressionDictionaryWithSampleCount:(size_t)sampleCount;
+
+/**
+ * The approximate amount of memory, in serialized bytes, used to keep recently read documents
+ * decoded. 0 disables this cache.
+ */
+@property(nonatomic, assign) size_t decodedDocumentCacheSize;
+
+/** Counters describing how often document reads were served by the decoded document cache. */
+@property(nonatomic, readonly)
+    firebase::firestore::local::DecodedDocumentCacheStats decodedDocumentCacheStats;
+
+/**
+ * The number of bytes stored in each table, as of the last write to LevelDB. These are kept in
+ * memory and adjusted by each commit, so reading them costs nothing.
+ */
+@property(nonatomic, readonly) firebase::firestore::local::LevelDbTableSizes tableSizes;
+
 @property(nonatomic, readonly, strong) FSTLevelDBLRUDelegate *referenceDelegate;
 
 @property(nonatomic, readonly, strong) FSTLocalSerializer *serializer;
@@ -17,6 +17,8 @@
 #import "Firestore/Source/Local/FSTLevelDB.h"
 
 #include <memory>
+#include <string>
+#include <unordered_set>
 #include <utility>
 
 #import "FIRFirestoreErrors.h"
@@ -28,10 +30,12 @@
 #include "Firestore/core/include/firebase/firestore/firestore_errors.h"
 #include "Firestore/core/src/firebase/firestore/auth/user.h"
 #include "Firestore/core/src/firebase/firestore/core/database_info.h"
+#include "Firestore/core/src/firebase/firestore/local/incremental_lru_garbage_collector.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_migrations.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_query_cache.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_remote_document_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_util.h"
 #include "Firestore/core/src/firebase/firestore/local/reference_set.h"
@@ -41,6 +45,7 @@
 #include "Firestore/core/src/firebase/firestore/model/resource_path.h"
 #include "Firestore/core/src/firebase/firestore/util/filesystem.h"
 #include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/log.h"
 #include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
 #include "Firestore/core/src/firebase/firestore/util/statusor.h"
 #include "Firestore/core/src/firebase/firestore/util/string_apple.h"
@@ -57,20 +62,38 @@ using firebase::firestore::FirestoreErrorCode;
 using firebase::firestore::auth::User;
 using firebase::firestore::core::DatabaseInfo;
 using firebase::firestore::local::ConvertStatus;
+using firebase::firestore::local::DecodedDocumentCacheStats;
+using firebase::firestore::local::DocumentKeyFilter;
+using firebase::firestore::local::ExtractTableName;
 using firebase::firestore::local::LevelDbDocumentMutationKey;
-using firebase::firestore::local::LevelDbDocumentTargetKey;
+using firebase::firestore::local::LevelDbGroupCommit;
+using firebase::firestore::local::LevelDbGroupCommitParams;
+using firebase::firestore::local::LevelDbGroupCommitStats;
+using firebase::firestore::local::LevelDbLruGcProgressKey;
 using firebase::firestore::local::LevelDbMigrations;
 using firebase::firestore::local::LevelDbMutationKey;
 using firebase::firestore::local::LevelDbQueryCache;
 using firebase::firestore::local::LevelDbRemoteDocumentCache;
+using firebase::firestore::local::LevelDbRemoteDocumentChangeKey;
+using firebase::firestore::local::LevelDbSequenceNumberKey;
+using firebase::firestore::local::LevelDbStartupData;
+using firebase::firestore::local::LevelDbTableSizes;
+using firebase::firestore::local::LevelDbTableSizesKey;
 using firebase::firestore::local::LevelDbTransaction;
+using firebase::firestore::local::LevelDbValueCompressionOptions;
+using firebase::firestore::local::LruGcDelegate;
+using firebase::firestore::local::LruGcPhase;
+using firebase::firestore::local::LruGcProgress;
+using firebase::firestore::local::LruGcSlice;
 using firebase::firestore::local::LruParams;
 using firebase::firestore::local::ReferenceSet;
 using firebase::firestore::local::RemoteDocumentCache;
+using firebase::firestore::model::BatchId;
 using firebase::firestore::model::DatabaseId;
 using firebase::firestore::model::DocumentKey;
 using firebase::firestore::model::ListenSequenceNumber;
 using firebase::firestore::model::ResourcePath;
+using firebase::firestore::model::TargetId;
 using firebase::firestore::util::OrderedCode;
 using firebase::firestore::util::Path;
 using firebase::firestore::util::Status;
@@ -107,10 +130,119 @@ static const char *kReservedPathComponent = "firestore";
 
 - (void)start;
 
+- (BOOL)isPinned:(const DocumentKey &)docKey;
+
 @end
 
+namespace {
+
+/**
+ * Collects garbage a slice at a time by walking the sequence number index, and saves the progress
+ * of a collection in the database so that it survives restarts.
+ */
+class LevelDbLruGcDelegate : public LruGcDelegate {
+ public:
+  LevelDbLruGcDelegate(FSTLevelDB *db, FSTLevelDBLRUDelegate *lruDelegate)
+      : db_(db), lru_delegate_(lruDelegate) {
+  }
+
+  LruGcProgress LoadProgress() override {
+    LruGcProgress progress;
+    std::string value;
+    leveldb::Status status = db_.currentTransaction->Get(LevelDbLruGcProgressKey::Key(), &value);
+    if (status.ok()) {
+      // Progress saved in a format we don't recognize is dropped, so that a fresh collection
+      // starts instead.
+      if (!LruGcProgress::Decode(value, &progress)) {
+        LOG_DEBUG("Discarding unreadable garbage collection progress");
+      }
+    } else if (!status.IsNotFound()) {
+      HARD_FAIL("Reading garbage collection progress failed with status: %s", status.ToString());
+    }
+    return progress;
+  }
+
+  void SaveProgress(const LruGcProgress &progress) override {
+    std::string key = LevelDbLruGcProgressKey::Key();
+    if (progress.phase == LruGcPhase::Idle) {
+      db_.currentTransaction->Delete(key);
+    } else {
+      db_.currentTransaction->Put(key, progress.Encode());
+    }
+  }
+
+  LruGcSlice CountSequenceNumbers(std::string *cursor, int limit, int64_t *count) override {
+    return db_.queryCache->VisitSequenceNumbers(cursor, limit,
+                                                [count](const LevelDbSequenceNumberKey &) {
+                                                  (*count)++;
+                                                  return true;
+                                                });
+  }
+
+  LruGcSlice FindUpperBound(std::string *cursor,
+                            int limit,
+                            int64_t *remaining,
+                            ListenSequenceNumber *upper_bound) override {
+    return db_.queryCache->VisitSequenceNumbers(
+        cursor, limit, [remaining, upper_bound](const LevelDbSequenceNumberKey &row) {
+          *upper_bound = row.sequence_number();
+          return --(*remaining) > 0;
+        });
+  }
+
+  LruGcSlice RemoveTargets(ListenSequenceNumber upper_bound,
+                           const std::unordered_set<TargetId> &live_targets,
+                           std::string *cursor,
+                           int limit,
+                           int64_t *removed) override {
+    LevelDbQueryCache *queryCache = db_.queryCache;
+    return queryCache->VisitSequenceNumbers(
+        cursor, limit, [&, queryCache](const LevelDbSequenceNumberKey &row) {
+          if (row.sequence_number() > upper_bound) {
+            return false;
+          }
+          if (row.IsTarget() && live_targets.count(row.target_id()) == 0) {
+            FSTQueryData *queryData = queryCache->ReadTarget(row.target_id());
+            HARD_ASSERT(queryData, "Dangling sequence number reference found for target %s",
+                        row.target_id());
+            queryCache->RemoveTarget(queryData);
+            (*removed)++;
+          }
+          return true;
+        });
+  }
+
+  LruGcSlice RemoveOrphanedDocuments(ListenSequenceNumber upper_bound,
+                                     std::string *cursor,
+                                     int limit,
+                                     int64_t *removed) override {
+    FSTLevelDB *db = db_;
+    FSTLevelDBLRUDelegate *lruDelegate = lru_delegate_;
+    return db.queryCache->VisitSequenceNumbers(
+        cursor, limit, [&, db, lruDelegate](const LevelDbSequenceNumberKey &row) {
+          if (row.sequence_number() > upper_bound) {
+            return false;
+          }
+          if (!row.IsTarget() && ![lruDelegate isPinned:row.document_key()]) {
+            db.remoteDocumentCache->Remove(row.document_key());
+            db.queryCache->RemoveSentinel(row.document_key(), row.sequence_number());
+            (*removed)++;
+          }
+          return true;
+        });
+  }
+
+ private:
+  // Both have the same lifetime as the LRU delegate that owns this.
+  __weak FSTLevelDB *db_;
+  __weak FSTLevelDBLRUDelegate *lru_delegate_;
+};
+
+}  // namespace
+
 @implementation FSTLevelDBLRUDelegate {
   FSTLRUGarbageCollector *_gc;
+  std::unique_ptr<LevelDbLruGcDelegate> _incrementalGCDelegate;
   // This delegate should have the same lifetime as the persistence layer, but mark as
   // weak to avoid retain cycle.
   __weak FSTLevelDB *_db;
@@ -122,6 +254,7 @@ static const char *kReservedPathComponent = "firestore";
 - (instancetype)initWithPersistence:(FSTLevelDB *)persistence lruParams:(LruParams)lruParams {
   if (self = [super init]) {
     _gc = [[FSTLRUGarbageCollector alloc] initWithDelegate:self params:lruParams];
+    _incrementalGCDelegate = absl::make_unique<LevelDbLruGcDelegate>(persistence, self);
     _db = persistence;
     _currentSequenceNumber = kFSTListenSequenceNumberInvalid;
   }
@@ -172,6 +305,11 @@ static const char *kReservedPathComponent = "firestore";
 }
 
 - (BOOL)mutationQueuesContainKey:(const DocumentKey &)docKey {
+  // Most documents have no pending mutations, which the filter can tell without a lookup per user.
+  if (!_db.mutatedDocuments->MightContain(docKey)) {
+    return NO;
+  }
+
   const std::set<std::string> &users = _db.users;
   const ResourcePath &path = docKey.path();
   std::string buffer;
@@ -210,20 +348,18 @@ static const char *kReservedPathComponent = "firestore";
 - (int)removeOrphanedDocumentsThroughSequenceNumber:(ListenSequenceNumber)upperBound {
   __block int count = 0;
   _db.queryCache->EnumerateOrphanedDocuments(
-      ^(const DocumentKey &docKey, ListenSequenceNumber sequenceNumber, BOOL *stop) {
-        if (sequenceNumber <= upperBound) {
-          if (![self isPinned:docKey]) {
-            count++;
-            self->_db.remoteDocumentCache->Remove(docKey);
-            [self removeSentinel:docKey];
-          }
+      upperBound, ^(const DocumentKey &docKey, ListenSequenceNumber sequenceNumber, BOOL *stop) {
+        if (![self isPinned:docKey]) {
+          count++;
+          self->_db.remoteDocumentCache->Remove(docKey);
+          self->_db.queryCache->RemoveSentinel(docKey, sequenceNumber);
         }
       });
   return count;
 }
 
-- (void)removeSentinel:(const DocumentKey &)key {
-  _db.currentTransaction->Delete(LevelDbDocumentTargetKey::SentinelKey(key));
+- (ListenSequenceNumber)sequenceNumberForQueryCount:(NSUInteger)queryCount {
+  return _db.queryCache->NthSequenceNumber(queryCount);
 }
 
 - (int)removeTargetsThroughSequenceNumber:(ListenSequenceNumber)sequenceNumber
@@ -244,11 +380,12 @@ static const char *kReservedPathComponent = "firestore";
   return _gc;
 }
 
+- (LruGcDelegate *)incrementalGCDelegate {
+  return _incrementalGCDelegate.get();
+}
+
 - (void)writeSentinelForKey:(const DocumentKey &)key {
-  std::string sentinelKey = LevelDbDocumentTargetKey::SentinelKey(key);
-  std::string encodedSequenceNumber =
-      LevelDbDocumentTargetKey::EncodeSentinelValue([self currentSequenceNumber]);
-  _db.currentTransaction->Put(sentinelKey, encodedSequenceNumber);
+  _db.queryCache->WriteSentinel(key, [self currentSequenceNumber]);
 }
 
 - (void)removeMutationReference:(const DocumentKey &)key {
@@ -267,13 +404,24 @@ static const char *kReservedPathComponent = "firestore";
 
 @implementation FSTLevelDB {
   Path _directory;
-  std::unique_ptr<LevelDbTransaction> _transaction;
   std::unique_ptr<leveldb::DB> _ptr;
+  std::unique_ptr<LevelDbGroupCommit> _groupCommit;
   std::unique_ptr<LevelDbRemoteDocumentCache> _documentCache;
   FSTTransactionRunner _transactionRunner;
   FSTLevelDBLRUDelegate *_referenceDelegate;
   std::unique_ptr<LevelDbQueryCache> _queryCache;
   std::set<std::string> _users;
+  DocumentKeyFilter _mutatedDocuments;
+  dispatch_queue_t _readerQueue;
+  /** The contents of the table sizes row, or nullptr if the database has none. */
+  std::unique_ptr<LevelDbTableSizes> _tableSizes;
+
+  /**
+   * The highest batch ID read at startup, which stays accurate until the first transaction
+   * commits.
+   */
+  BatchId _prefetchedHighestBatchID;
+  BOOL _prefetchedHighestBatchIDValid;
 }
 
 /**
@@ -285,23 +433,6 @@ static const char *kReservedPathComponent = "firestore";
   return options;
 }
 
-+ (std::set<std::string>)collectUserSet:(LevelDbTransaction *)transaction {
-  std::set<std::string> users;
-
-  std::string tablePrefix = LevelDbMutationKey::KeyPrefix();
-  auto it = transaction->NewIterator();
-  it->Seek(tablePrefix);
-  LevelDbMutationKey rowKey;
-  while (it->Valid() && absl::StartsWith(it->key(), tablePrefix) && rowKey.Decode(it->key())) {
-    users.insert(rowKey.user_id());
-
-    auto userEnd = LevelDbMutationKey::KeyPrefix(rowKey.user_id());
-    userEnd = util::PrefixSuccessor(userEnd);
-    it->Seek(userEnd);
-  }
-  return users;
-}
-
 + (firebase::firestore::util::Status)dbWithDirectory:(firebase::firestore::util::Path)directory
                                           serializer:(FSTLocalSerializer *)serializer
                                            lruParams:
@@ -316,12 +447,14 @@ static const char *kReservedPathComponent = "firestore";
   }
 
   std::unique_ptr<DB> ldb = std::move(database.ValueOrDie());
-  LevelDbMigrations::RunMigrations(ldb.get());
-  LevelDbTransaction transaction(ldb.get(), "Start LevelDB");
-  std::set<std::string> users = [self collectUserSet:&transaction];
-  transaction.Commit();
+  LevelDbMigrations::RunMigrations(ldb.get(), [](const LevelDbMigrations::Progress &progress) {
+    LOG_DEBUG("Migrating to schema version %s: %s rows processed", progress.version,
+              progress.rows_processed);
+  });
+  LevelDbStartupData startupData = LevelDbStartupData::Load(ldb.get());
+  LOG_DEBUG("Loaded LevelDB startup data in %s us", startupData.duration().count());
   FSTLevelDB *db = [[self alloc] initWithLevelDB:std::move(ldb)
-                                           users:users
+                                     startupData:startupData
                                        directory:directory
                                       serializer:serializer
                                        lruParams:lruParams];
@@ -330,13 +463,15 @@ static const char *kReservedPathComponent = "firestore";
 }
 
 - (instancetype)initWithLevelDB:(std::unique_ptr<leveldb::DB>)db
-                          users:(std::set<std::string>)users
+                    startupData:(const LevelDbStartupData &)startupData
                       directory:(firebase::firestore::util::Path)directory
                      serializer:(FSTLocalSerializer *)serializer
                       lruParams:(firebase::firestore::local::LruParams)lruParams {
   if (self = [super init]) {
     self.started = YES;
     _ptr = std::move(db);
+    _groupCommit =
+        absl::make_unique<LevelDbGroupCommit>(_ptr.get(), LevelDbGroupCommitParams::Disabled());
     _directory = std::move(directory);
     _serializer = serializer;
     _queryCache = absl::make_unique<LevelDbQueryCache>(self, _serializer);
@@ -344,25 +479,50 @@ static const char *kReservedPathComponent = "firestore";
     _referenceDelegate = [[FSTLevelDBLRUDelegate alloc] initWithPersistence:self
                                                                   lruParams:lruParams];
     _transactionRunner.SetBackingPersistence(self);
-    _users = std::move(users);
+    [self loadTableSizes];
+    _users = startupData.users();
+    _prefetchedHighestBatchID = startupData.highest_batch_id();
+    _mutatedDocuments = startupData.mutated_documents();
+    _prefetchedHighestBatchIDValid = YES;
+    _readerQueue = dispatch_queue_create("com.google.firebase.firestore.leveldb.readers",
+                                         DISPATCH_QUEUE_CONCURRENT);
     // TODO(gsoltis): set up a leveldb transaction for these operations.
-    _queryCache->Start();
+    _queryCache->Start(startupData);
+    _documentCache->Start(startupData);
     [_referenceDelegate start];
   }
   return self;
 }
 
 - (size_t)byteSize {
-  int64_t count = 0;
-  auto iter = util::DirectoryIterator::Create(_directory);
-  for (; iter->Valid(); iter->Next()) {
-    int64_t fileSize = util::FileSize(iter->file()).ValueOrDie();
-    count += fileSize;
-  }
-  HARD_ASSERT(iter->status().ok(), "Failed to iterate leveldb directory: %s",
-              iter->status().error_message().c_str());
-  HARD_ASSERT(count <= SIZE_MAX, "Overflowed counting bytes cached");
-  return count;
+  // The remote document change log is bounded by its own truncation, and collecting documents
+  // only adds to it, so it doesn't count towards the size that drives LRU collection.
+  LevelDbTableSizes tableSizes = self.tableSizes;
+  int64_t count = tableSizes.total() -
+                  tableSizes.TableSize(ExtractTableName(LevelDbRemoteDocumentChangeKey::KeyPrefix()));
+  HARD_ASSERT(count >= 0 && count <= SIZE_MAX, "Invalid count of bytes cached: %s", count);
+  return static_cast<size_t>(count);
+}
+
+/**
+ * Reads the table sizes row once. From then on, commits adjust the copy in memory as they write it
+ * back, rather than each reading it again.
+ */
+- (void)loadTableSizes {
+  std::string encoded;
+  leveldb::Status status =
+      _ptr->Get([FSTLevelDB standardReadOptions], LevelDbTableSizesKey::Key(), &encoded);
+  if (status.IsNotFound()) return;
+  HARD_ASSERT(status.ok(), "Failed to read table sizes: %s", status.ToString());
+
+  _tableSizes = absl::make_unique<LevelDbTableSizes>();
+  HARD_ASSERT(_tableSizes->Decode(encoded), "Failed to decode table sizes");
+  _groupCommit->set_table_sizes(_tableSizes.get());
+}
+
+- (LevelDbTableSizes)tableSizes {
+  HARD_ASSERT(_tableSizes, "Table sizes are not tracked");
+  return *_tableSizes;
 }
 
 - (const std::set<std::string> &)users {
@@ -451,41 +611,120 @@ static const char *kReservedPathComponent = "firestore";
 }
 
 - (LevelDbTransaction *)currentTransaction {
-  HARD_ASSERT(_transaction != nullptr, "Attempting to access transaction before one has started");
-  return _transaction.get();
+  return _groupCommit->current();
+}
+
+#pragma mark - Group commit
+
+- (LevelDbGroupCommitParams)groupCommitParams {
+  return _groupCommit->params();
+}
+
+- (void)setGroupCommitParams:(LevelDbGroupCommitParams)groupCommitParams {
+  _groupCommit->set_params(groupCommitParams);
+}
+
+- (const LevelDbGroupCommitStats &)groupCommitStats {
+  return _groupCommit->stats();
+}
+
+- (void)setGroupCommitFlushScheduler:(LevelDbGroupCommit::FlushScheduler)scheduler {
+  _groupCommit->set_flush_scheduler(std::move(scheduler));
+}
+
+- (void)flushPendingWrites {
+  if (!self.isStarted) return;
+  _groupCommit->Flush();
+}
+
+- (LevelDbValueCompressionOptions)documentCompressionOptions {
+  return _documentCache->compression_options();
+}
+
+- (void)setDocumentCompressionOptions:(LevelDbValueCompressionOptions)documentCompressionOptions {
+  _documentCache->SetCompressionOptions(documentCompressionOptions);
+}
+
+- (void)trainDocumentCompressionDictionaryWithSampleCount:(size_t)sampleCount {
+  self.run("Train compression dictionary",
+           [&]() { _documentCache->TrainCompressionDictionary(sampleCount); });
+}
+
+- (size_t)decodedDocumentCacheSize {
+  return _documentCache->decoded_documents().max_bytes();
+}
+
+- (void)setDecodedDocumentCacheSize:(size_t)decodedDocumentCacheSize {
+  _documentCache->decoded_documents().set_max_bytes(decodedDocumentCacheSize);
+}
+
+- (DecodedDocumentCacheStats)decodedDocumentCacheStats {
+  return _documentCache->decoded_documents().stats();
 }
 
 #pragma mark - Persistence Factory methods
 
 - (id<FSTMutationQueue>)mutationQueueForUser:(const User &)user {
+  // Starting a mutation queue reads its rows directly from LevelDB, so make sure deferred writes
+  // are visible.
+  _groupCommit->Flush();
   _users.insert(user.uid());
+  [self warmMutationQueueForUserID:user.uid()];
   return [FSTLevelDBMutationQueue mutationQueueWithUser:user db:self serializer:self.serializer];
 }
 
+/**
+ * Reads the user's mutations and their document index on the reader queue, so that the first
+ * local view computed for that user finds those blocks in LevelDB's cache.
+ */
+- (void)warmMutationQueueForUserID:(const std::string &)userID {
+  DB *db = _ptr.get();
+  std::string mutationPrefix = LevelDbMutationKey::KeyPrefix(userID);
+  std::string indexPrefix = LevelDbDocumentMutationKey::KeyPrefix(userID);
+  dispatch_async(_readerQueue, ^{
+    LevelDbStartupData::WarmPrefix(db, mutationPrefix);
+    LevelDbStartupData::WarmPrefix(db, indexPrefix);
+  });
+}
+
+- (BatchId)loadNextBatchID {
+  if (_prefetchedHighestBatchIDValid) {
+    return _prefetchedHighestBatchID + 1;
+  }
+  return [FSTLevelDBMutationQueue loadNextBatchIDFromTransaction:self.currentTransaction];
+}
+
 - (LevelDbQueryCache *)queryCache {
   return _queryCache.get();
 }
 
+- (DocumentKeyFilter *)mutatedDocuments {
+  return &_mutatedDocuments;
+}
+
 - (RemoteDocumentCache *)remoteDocumentCache {
   return _documentCache.get();
 }
 
 - (void)startTransaction:(absl::string_view)label {
-  HARD_ASSERT(_transaction == nullptr, "Starting a transaction while one is already outstanding");
-  _transaction = absl::make_unique<LevelDbTransaction>(_ptr.get(), label);
+  _groupCommit->Begin(label);
   [_referenceDelegate transactionWillStart];
 }
 
 - (void)commitTransaction {
-  HARD_ASSERT(_transaction != nullptr, "Committing a transaction before one is started");
   [_referenceDelegate transactionWillCommit];
-  _transaction->Commit();
-  _transaction.reset();
+  _groupCommit->Commit();
+  _prefetchedHighestBatchIDValid = NO;
 }
 
 - (void)shutdown {
   HARD_ASSERT(self.isStarted, "FSTLevelDB shutdown without start!");
+  _groupCommit->Flush();
+  // Wait for in-flight warming reads to finish before closing the database.
+  dispatch_barrier_sync(_readerQueue, ^{
+  });
   self.started = NO;
+  _groupCommit.reset();
   _ptr.reset();
 }
 
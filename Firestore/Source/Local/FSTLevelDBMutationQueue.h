@@ -21,6 +21,7 @@
 #import "Firestore/Source/Local/FSTMutationQueue.h"
 
 #include "Firestore/core/src/firebase/firestore/auth/user.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 #include "leveldb/db.h"
 
@@ -29,7 +30,10 @@
 
 NS_ASSUME_NONNULL_BEGIN
 
-/** A mutation queue for a specific user, backed by LevelDB. */
+/**
+ * A mutation queue for a specific user, backed by LevelDB. Forwards to the C++
+ * LevelDbMutationQueue, which keeps the pending batches indexed in memory.
+ */
 @interface FSTLevelDBMutationQueue : NSObject <FSTMutationQueue>
 
 - (instancetype)init __attribute__((unavailable("Use a static constructor")));
@@ -50,6 +54,12 @@ NS_ASSUME_NONNULL_BEGIN
  */
 + (firebase::firestore::model::BatchId)loadNextBatchIDFromDB:(leveldb::DB *)db;
 
+/**
+ * Like loadNextBatchIDFromDB:, but includes the pending changes in the given transaction.
+ */
++ (firebase::firestore::model::BatchId)loadNextBatchIDFromTransaction:
+    (firebase::firestore::local::LevelDbTransaction *)transaction;
+
 @end
 
 NS_ASSUME_NONNULL_END
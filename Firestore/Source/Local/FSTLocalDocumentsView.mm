@@ -22,13 +22,19 @@
 #import "Firestore/Source/Model/FSTMutation.h"
 #import "Firestore/Source/Model/FSTMutationBatch.h"
 
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
+#include "Firestore/core/src/firebase/firestore/local/query_result_cache.h"
 #include "Firestore/core/src/firebase/firestore/local/remote_document_cache.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_map.h"
 #include "Firestore/core/src/firebase/firestore/model/resource_path.h"
 #include "Firestore/core/src/firebase/firestore/model/snapshot_version.h"
 #include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "absl/types/optional.h"
 
+using firebase::firestore::local::DocumentChangeLog;
+using firebase::firestore::local::QueryResultCache;
+using firebase::firestore::local::QueryResults;
 using firebase::firestore::local::RemoteDocumentCache;
 using firebase::firestore::model::DocumentKey;
 using firebase::firestore::model::DocumentKeySet;
@@ -49,6 +55,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 @implementation FSTLocalDocumentsView {
   RemoteDocumentCache *_remoteDocumentCache;
+
+  /**
+   * The results of recently executed collection queries, which are brought up
+   * to date with the documents changed since, rather than re-executed.
+   */
+  QueryResultCache _queryResults;
 }
 
 + (instancetype)viewWithRemoteDocumentCache:(RemoteDocumentCache *)remoteDocumentCache
@@ -156,12 +168,106 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (DocumentMap)documentsMatchingCollectionQuery:(FSTQuery *)query {
+  DocumentChangeLog &changeLog = _remoteDocumentCache->change_log();
+  int64_t position = changeLog.position();
+
+  DocumentMap results;
+  absl::optional<DocumentKeySet> changedKeys;
+  const QueryResults *cached = _queryResults.Get(query);
+  if (cached) {
+    results = cached->documents;
+    changedKeys = changeLog.ChangedSince(cached->change_log_position);
+  }
+
+  if (changedKeys) {
+    if (changedKeys->empty()) return results;
+    results = [self updateResults:results ofCollectionQuery:query changedKeys:*changedKeys];
+  } else {
+    results = [self executeCollectionQuery:query];
+  }
+
+  _queryResults.Put(query, QueryResults{results, position});
+  return results;
+}
+
+/** Runs the given collection query from scratch. */
+- (DocumentMap)executeCollectionQuery:(FSTQuery *)query {
   DocumentMap results = _remoteDocumentCache->GetMatching(query);
   // Get locally persisted mutation batches.
   NSArray<FSTMutationBatch *> *matchingBatches =
       [self.mutationQueue allMutationBatchesAffectingQuery:query];
 
-  for (FSTMutationBatch *batch in matchingBatches) {
+  results = [self applyMutationsInBatches:matchingBatches
+                                toResults:results
+                        ofCollectionQuery:query
+                                   onlyTo:nullptr];
+
+  // Finally, filter out any documents that don't actually match the query. Note that the extra
+  // reference here prevents ARC from deallocating the initial unfiltered results while we're
+  // enumerating them.
+  DocumentMap unfiltered = results;
+  for (const auto &kv : unfiltered.underlying_map()) {
+    const DocumentKey &key = kv.first;
+    FSTDocument *doc = static_cast<FSTDocument *>(kv.second);
+    if (![query matchesDocument:doc]) {
+      results = results.erase(key);
+    }
+  }
+
+  return results;
+}
+
+/**
+ * Brings earlier results of the given collection query up to date by recomputing just the
+ * documents with the given keys, the same way executeCollectionQuery: would.
+ */
+- (DocumentMap)updateResults:(DocumentMap)results
+           ofCollectionQuery:(FSTQuery *)query
+                 changedKeys:(const DocumentKeySet &)changedKeys {
+  // Only the immediate children of the collection can match the query.
+  DocumentKeySet keys;
+  for (const DocumentKey &key : changedKeys) {
+    if (query.path.IsImmediateParentOf(key.path())) {
+      keys = keys.insert(key);
+    }
+  }
+  if (keys.empty()) return results;
+
+  MaybeDocumentMap remoteDocs = _remoteDocumentCache->GetAll(keys);
+  for (const auto &kv : remoteDocs) {
+    results = results.erase(kv.first);
+    if ([kv.second isKindOfClass:[FSTDocument class]]) {
+      results = results.insert(kv.first, static_cast<FSTDocument *>(kv.second));
+    }
+  }
+
+  NSArray<FSTMutationBatch *> *batches =
+      [self.mutationQueue allMutationBatchesAffectingDocumentKeys:keys];
+  results = [self applyMutationsInBatches:batches
+                                toResults:results
+                        ofCollectionQuery:query
+                                   onlyTo:&keys];
+
+  for (const DocumentKey &key : keys) {
+    auto found = results.underlying_map().find(key);
+    if (found != results.underlying_map().end() &&
+        ![query matchesDocument:static_cast<FSTDocument *>(found->second)]) {
+      results = results.erase(key);
+    }
+  }
+
+  return results;
+}
+
+/**
+ * Applies the mutations in `batches` to the documents in `results` that belong to the given
+ * collection query, optionally only to those with the given keys.
+ */
+- (DocumentMap)applyMutationsInBatches:(NSArray<FSTMutationBatch *> *)batches
+                             toResults:(DocumentMap)results
+                     ofCollectionQuery:(FSTQuery *)query
+                                onlyTo:(const DocumentKeySet *_Nullable)onlyKeys {
+  for (FSTMutationBatch *batch in batches) {
     for (FSTMutation *mutation in batch.mutations) {
       // Only process documents belonging to the collection.
       if (!query.path.IsImmediateParentOf(mutation.key.path())) {
@@ -169,6 +275,10 @@ NS_ASSUME_NONNULL_BEGIN
       }
 
       const DocumentKey &key = mutation.key;
+      if (onlyKeys && !onlyKeys->contains(key)) {
+        continue;
+      }
+
       // baseDoc may be nil for the documents that weren't yet written to the backend.
       FSTMaybeDocument *baseDoc = nil;
       auto found = results.underlying_map().find(key);
@@ -186,19 +296,6 @@ NS_ASSUME_NONNULL_BEGIN
       }
     }
   }
-
-  // Finally, filter out any documents that don't actually match the query. Note that the extra
-  // reference here prevents ARC from deallocating the initial unfiltered results while we're
-  // enumerating them.
-  DocumentMap unfiltered = results;
-  for (const auto &kv : unfiltered.underlying_map()) {
-    const DocumentKey &key = kv.first;
-    FSTDocument *doc = static_cast<FSTDocument *>(kv.second);
-    if (![query matchesDocument:doc]) {
-      results = results.erase(key);
-    }
-  }
-
   return results;
 }
 
@@ -182,6 +182,12 @@ NS_ASSUME_NONNULL_BEGIN
 
 - (firebase::firestore::local::LruResults)collectGarbage:(FSTLRUGarbageCollector *)garbageCollector;
 
+/**
+ * Runs part of a garbage collection in its own transaction, examining at most `rowBudget` rows.
+ * Returns YES if no collection is in progress any more.
+ */
+- (BOOL)collectGarbage:(FSTLRUGarbageCollector *)garbageCollector rowBudget:(int)rowBudget;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -16,8 +16,10 @@
 
 #import "Firestore/Source/Local/FSTLocalStore.h"
 
+#include <algorithm>
 #include <set>
 #include <utility>
+#include <vector>
 
 #import "FIRTimestamp.h"
 #import "Firestore/Source/Core/FSTListenSequence.h"
@@ -166,6 +168,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
     FSTMutationBatch *batch = [self.mutationQueue addMutationBatchWithWriteTime:localWriteTime
                                                                       mutations:mutations];
     DocumentKeySet keys = [batch keys];
+    _remoteDocumentCache->change_log().Record(keys);
     MaybeDocumentMap changedDocuments = [self.localDocuments documentsForKeys:keys];
     return [FSTLocalWriteResult resultForBatchID:batch.batchID changes:std::move(changedDocuments)];
   });
@@ -193,6 +196,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
     HARD_ASSERT(batchID > lastAcked, "Acknowledged batches can't be rejected.");
 
     [self.mutationQueue removeMutationBatch:toReject];
+    _remoteDocumentCache->change_log().Record(toReject.keys);
     [self.mutationQueue performConsistencyCheck];
 
     return [self.localDocuments documentsForKeys:toReject.keys];
@@ -217,7 +221,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
     // TODO(gsoltis): move the sequence number into the reference delegate.
     ListenSequenceNumber sequenceNumber = self.persistence.currentSequenceNumber;
 
-    DocumentKeySet authoritativeUpdates;
+    std::vector<DocumentKey> authoritativeKeys;
     for (const auto &entry : remoteEvent.targetChanges) {
       TargetId targetID = entry.first;
       FSTBoxedTargetID *boxedTargetID = @(targetID);
@@ -237,12 +241,10 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
       // If the document is only updated while removing it from a target then watch isn't obligated
       // to send the absolute latest version: it can send the first version that caused the document
       // not to match.
-      for (const DocumentKey &key : change.addedDocuments) {
-        authoritativeUpdates = authoritativeUpdates.insert(key);
-      }
-      for (const DocumentKey &key : change.modifiedDocuments) {
-        authoritativeUpdates = authoritativeUpdates.insert(key);
-      }
+      authoritativeKeys.insert(authoritativeKeys.end(), change.addedDocuments.begin(),
+                               change.addedDocuments.end());
+      authoritativeKeys.insert(authoritativeKeys.end(), change.modifiedDocuments.begin(),
+                               change.modifiedDocuments.end());
 
       _queryCache->RemoveMatchingKeys(change.removedDocuments, targetID);
       _queryCache->AddMatchingKeys(change.addedDocuments, targetID);
@@ -260,27 +262,51 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
 
         if ([self shouldPersistQueryData:queryData oldQueryData:oldQueryData change:change]) {
           _queryCache->UpdateTarget(queryData);
+        } else {
+          // Still record the new resume token, which is much cheaper than rewriting the target, so
+          // that listening again after a restart resumes from here rather than re-downloading
+          // everything since the target was last written.
+          _queryCache->UpdateResumeToken(queryData);
         }
       }
     }
 
-    MaybeDocumentMap changedDocs;
-    const DocumentKeySet &limboDocuments = remoteEvent.limboDocumentChanges;
-    DocumentKeySet updatedKeys;
-    for (const auto &kv : remoteEvent.documentUpdates) {
-      updatedKeys = updatedKeys.insert(kv.first);
+    // Work through the updates in key order, so that the existing documents can be read in one
+    // forward pass and the sets and maps below built in linear time rather than a key at a time.
+    std::sort(authoritativeKeys.begin(), authoritativeKeys.end());
+    authoritativeKeys.erase(std::unique(authoritativeKeys.begin(), authoritativeKeys.end()),
+                            authoritativeKeys.end());
+    DocumentKeySet authoritativeUpdates = DocumentKeySet::FromSorted(authoritativeKeys);
+
+    std::vector<std::pair<DocumentKey, FSTMaybeDocument *>> updates(
+        remoteEvent.documentUpdates.begin(), remoteEvent.documentUpdates.end());
+    std::sort(updates.begin(), updates.end(),
+              [](const std::pair<DocumentKey, FSTMaybeDocument *> &lhs,
+                 const std::pair<DocumentKey, FSTMaybeDocument *> &rhs) {
+                return lhs.first < rhs.first;
+              });
+    std::vector<DocumentKey> updatedKeys;
+    updatedKeys.reserve(updates.size());
+    for (const auto &update : updates) {
+      updatedKeys.push_back(update.first);
     }
-    // Each loop iteration only affects its "own" doc, so it's safe to get all the remote
-    // documents in advance in a single call.
-    MaybeDocumentMap existingDocs = _remoteDocumentCache->GetAll(updatedKeys);
+    // Each update only affects its "own" doc, so it's safe to get all the remote documents in
+    // advance in a single call.
+    MaybeDocumentMap existingDocs =
+        _remoteDocumentCache->GetAll(DocumentKeySet::FromSorted(updatedKeys));
+    auto existing = existingDocs.begin();
 
-    for (const auto &kv : remoteEvent.documentUpdates) {
-      const DocumentKey &key = kv.first;
-      FSTMaybeDocument *doc = kv.second;
+    const DocumentKeySet &limboDocuments = remoteEvent.limboDocumentChanges;
+    std::vector<std::pair<DocumentKey, FSTMaybeDocument *>> changed;
+    for (const auto &update : updates) {
+      const DocumentKey &key = update.first;
+      FSTMaybeDocument *doc = update.second;
+      while (existing != existingDocs.end() && existing->first < key) {
+        ++existing;
+      }
       FSTMaybeDocument *existingDoc = nil;
-      auto foundExisting = existingDocs.find(key);
-      if (foundExisting != existingDocs.end()) {
-        existingDoc = foundExisting->second;
+      if (existing != existingDocs.end() && existing->first == key) {
+        existingDoc = existing->second;
       }
 
       // If a document update isn't authoritative, make sure we don't apply an old document version
@@ -290,7 +316,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
           (authoritativeUpdates.contains(doc.key) && !existingDoc.hasPendingWrites) ||
           doc.version >= existingDoc.version) {
         _remoteDocumentCache->Add(doc);
-        changedDocs = changedDocs.insert(key, doc);
+        changed.emplace_back(key, doc);
       } else {
         LOG_DEBUG("FSTLocalStore Ignoring outdated watch update for %s. "
                   "Current version: %s  Watch version: %s",
@@ -303,6 +329,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
         [self.persistence.referenceDelegate limboDocumentUpdated:key];
       }
     }
+    MaybeDocumentMap changedDocs = MaybeDocumentMap::FromSorted(changed);
 
     // HACK: The only reason we allow omitting snapshot version is so we can synthesize remote
     // events when we get permission denied errors while trying to resolve the state of a locally
@@ -326,9 +353,9 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
  * function.
  *
  * While the target is active, QueryData updates can be omitted when nothing about the target has
- * changed except metadata like the resume token or snapshot version. Occasionally it's worth the
- * extra write to prevent these values from getting too stale after a crash, but this doesn't have
- * to be too frequent.
+ * changed except metadata like the resume token or snapshot version. Those are journaled with
+ * QueryCache::UpdateResumeToken instead; occasionally it's still worth rewriting the whole target,
+ * but this doesn't have to be too frequent.
  */
 - (BOOL)shouldPersistQueryData:(FSTQueryData *)newQueryData
                   oldQueryData:(FSTQueryData *)oldQueryData
@@ -470,6 +497,7 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
   }
 
   [self.mutationQueue removeMutationBatch:batch];
+  _remoteDocumentCache->change_log().Record(docKeys);
 }
 
 - (LruResults)collectGarbage:(FSTLRUGarbageCollector *)garbageCollector {
@@ -478,6 +506,12 @@ static const int64_t kResumeTokenMaxAgeSeconds = 5 * 60;  // 5 minutes
   });
 }
 
+- (BOOL)collectGarbage:(FSTLRUGarbageCollector *)garbageCollector rowBudget:(int)rowBudget {
+  return self.persistence.run("Collect garbage slice", [&]() -> BOOL {
+    return [garbageCollector collectSliceWithLiveTargets:_targetIDs rowBudget:rowBudget];
+  });
+}
+
 @end
 
 NS_ASSUME_NONNULL_END
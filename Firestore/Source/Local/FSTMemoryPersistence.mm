@@ -49,6 +49,13 @@ NS_ASSUME_NONNULL_BEGIN
 
 @interface FSTMemoryPersistence ()
 
+/**
+ * Creates memory persistence whose caches keep a running total of their size, measured with the
+ * given serializer, or that don't track their size if serializer is nil.
+ */
+- (instancetype)initWithSerializer:(nullable FSTLocalSerializer *)serializer
+    NS_DESIGNATED_INITIALIZER;
+
 - (MemoryQueryCache *)queryCache;
 
 - (MemoryRemoteDocumentCache *)remoteDocumentCache;
@@ -74,7 +81,7 @@ NS_ASSUME_NONNULL_BEGIN
   std::unique_ptr<MemoryQueryCache> _queryCache;
 
   /** The RemoteDocumentCache representing the persisted cache of remote documents. */
-  MemoryRemoteDocumentCache _remoteDocumentCache;
+  std::unique_ptr<MemoryRemoteDocumentCache> _remoteDocumentCache;
 
   FSTTransactionRunner _transactionRunner;
 
@@ -90,7 +97,7 @@ NS_ASSUME_NONNULL_BEGIN
 
 + (instancetype)persistenceWithLruParams:(firebase::firestore::local::LruParams)lruParams
                               serializer:(FSTLocalSerializer *)serializer {
-  FSTMemoryPersistence *persistence = [[FSTMemoryPersistence alloc] init];
+  FSTMemoryPersistence *persistence = [[FSTMemoryPersistence alloc] initWithSerializer:serializer];
   persistence.referenceDelegate =
       [[FSTMemoryLRUReferenceDelegate alloc] initWithPersistence:persistence
                                                       serializer:serializer
@@ -99,8 +106,18 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (instancetype)init {
+  return [self initWithSerializer:nil];
+}
+
+- (instancetype)initWithSerializer:(nullable FSTLocalSerializer *)serializer {
   if (self = [super init]) {
-    _queryCache = absl::make_unique<MemoryQueryCache>(self);
+    if (serializer) {
+      _queryCache = absl::make_unique<MemoryQueryCache>(self, serializer);
+      _remoteDocumentCache = absl::make_unique<MemoryRemoteDocumentCache>(serializer);
+    } else {
+      _queryCache = absl::make_unique<MemoryQueryCache>(self);
+      _remoteDocumentCache = absl::make_unique<MemoryRemoteDocumentCache>();
+    }
     self.started = YES;
   }
   return self;
@@ -146,7 +163,7 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (MemoryRemoteDocumentCache *)remoteDocumentCache {
-  return &_remoteDocumentCache;
+  return _remoteDocumentCache.get();
 }
 
 @end
@@ -298,12 +315,11 @@ NS_ASSUME_NONNULL_BEGIN
 }
 
 - (size_t)byteSize {
-  // Note that this method is only used for testing because this delegate is only
-  // used for testing. The algorithm here (loop through everything, serialize it
-  // and count bytes) is inefficient and inexact, but won't run in production.
+  // The caches keep a running total of the encoded size of their contents, so only the mutation
+  // queues, which hold just the pending writes, are serialized here.
   size_t count = 0;
-  count += _persistence.queryCache->CalculateByteSize(_serializer);
-  count += _persistence.remoteDocumentCache->CalculateByteSize(_serializer);
+  count += _persistence.queryCache->byte_size();
+  count += _persistence.remoteDocumentCache->byte_size();
   const MutationQueues &queues = [_persistence mutationQueues];
   for (const auto &entry : queues) {
     count += [entry.second byteSizeWithSerializer:_serializer];
@@ -73,6 +73,15 @@ NS_SWIFT_NAME(FirestoreSettings)
  */
 @property(nonatomic, assign) int64_t cacheSizeBytes;
 
+/**
+ * Set to true to have the in-memory cache used when persistence is disabled keep documents that
+ * are no longer in use, collecting least-recently-used documents once the cache exceeds
+ * cacheSizeBytes. By default, the in-memory cache only keeps the documents that active queries and
+ * pending writes refer to.
+ */
+@property(nonatomic, getter=isMemoryLRUGarbageCollectionEnabled)
+    BOOL memoryLRUGarbageCollectionEnabled;
+
 @end
 
 NS_ASSUME_NONNULL_END
@@ -65,6 +65,7 @@ func initializeDb() -> Firestore {
   settings.isPersistenceEnabled = true
   settings.areTimestampsInSnapshotsEnabled = true
   settings.cacheSizeBytes = FirestoreCacheSizeUnlimited
+  settings.isMemoryLRUGarbageCollectionEnabled = false
   firestore.settings = settings
 
   return firestore
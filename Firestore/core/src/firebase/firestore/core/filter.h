@@ -59,7 +59,10 @@ class Filter {
   /** Returns true if a document matches the filter. */
   virtual bool Matches(const model::Document& doc) const = 0;
 
-  /** A unique ID identifying the filter; used when serializing queries. */
+  /**
+   * A canonical string identifying the filter. Two different instances of
+   * equivalent filters will return the same canonical ID.
+   */
   virtual std::string CanonicalId() const = 0;
 };
 
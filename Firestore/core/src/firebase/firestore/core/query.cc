@@ -22,6 +22,8 @@
 #include "Firestore/core/src/firebase/firestore/model/field_path.h"
 #include "Firestore/core/src/firebase/firestore/model/resource_path.h"
 #include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/hashing.h"
+#include "absl/strings/str_cat.h"
 
 namespace firebase {
 namespace firestore {
@@ -74,6 +76,34 @@ Query Query::Filter(std::shared_ptr<core::Filter> filter) const {
   return Query(path_, std::move(updated_filters));
 }
 
+const std::string& Query::CanonicalId() const {
+  if (!canonical_id_.empty()) {
+    return canonical_id_;
+  }
+
+  // Follows the layout of the canonical ID of FSTQuery.
+  std::string result = path_.CanonicalString();
+
+  absl::StrAppend(&result, "|f:");
+  for (const auto& filter : filters_) {
+    absl::StrAppend(&result, filter->CanonicalId());
+  }
+
+  // TODO(rsgowman): Add the explicit order by, limit and bounds once they
+  // exist. Until then, every query is ordered by key alone.
+  absl::StrAppend(&result, "|ob:",
+                  model::FieldPath::KeyFieldPath().CanonicalString(), "asc");
+
+  canonical_hash_ = util::Fingerprint64(result);
+  canonical_id_ = std::move(result);
+  return canonical_id_;
+}
+
+uint64_t Query::CanonicalHash() const {
+  CanonicalId();
+  return canonical_hash_;
+}
+
 }  // namespace core
 }  // namespace firestore
 }  // namespace firebase
@@ -17,7 +17,9 @@
 #ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_CORE_QUERY_H_
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_CORE_QUERY_H_
 
+#include <cstdint>
 #include <memory>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -79,6 +81,20 @@ class Query {
    */
   Query Filter(std::shared_ptr<core::Filter> filter) const;
 
+  /**
+   * Returns a canonical string identifying the query. Two different instances
+   * of equivalent queries will return the same canonical ID. The ID is
+   * computed on first use and then cached.
+   */
+  const std::string& CanonicalId() const;
+
+  /**
+   * Returns a 64-bit hash of the canonical ID, for use as the key of in-memory
+   * maps of queries. Equivalent queries have the same hash, but different
+   * queries may collide, so entries found by hash still need to be compared.
+   */
+  uint64_t CanonicalHash() const;
+
  private:
   bool MatchesPath(const model::Document& doc) const;
   bool MatchesFilters(const model::Document& doc) const;
@@ -92,6 +108,11 @@ class Query {
   // existing filters, plus the new one. (Both Query and Filter objects are
   // immutable.) Filters are not shared across unrelated Query instances.
   std::vector<std::shared_ptr<core::Filter>> filters_;
+
+  // The canonical ID and its hash, computed lazily. Queries are immutable, so
+  // copies can share the cached values.
+  mutable std::string canonical_id_;
+  mutable uint64_t canonical_hash_ = 0;
 };
 
 inline bool operator==(const Query& lhs, const Query& rhs) {
@@ -18,6 +18,8 @@
 
 #include <utility>
 
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "absl/strings/str_cat.h"
 #include "absl/types/optional.h"
 
 namespace firebase {
@@ -27,6 +29,26 @@ namespace core {
 using model::FieldPath;
 using model::FieldValue;
 
+namespace {
+
+const char* CanonicalName(Filter::Operator op) {
+  switch (op) {
+    case Filter::Operator::LessThan:
+      return "<";
+    case Filter::Operator::LessThanOrEqual:
+      return "<=";
+    case Filter::Operator::Equal:
+      return "==";
+    case Filter::Operator::GreaterThanOrEqual:
+      return ">=";
+    case Filter::Operator::GreaterThan:
+      return ">";
+  }
+  UNREACHABLE();
+}
+
+}  // namespace
+
 RelationFilter::RelationFilter(FieldPath field,
                                Operator op,
                                FieldValue value_rhs)
@@ -70,8 +92,9 @@ bool RelationFilter::MatchesComparison(const FieldValue& other) const {
 }
 
 std::string RelationFilter::CanonicalId() const {
-  // TODO(rsgowman): Port this
-  abort();
+  // Follows FSTRelationFilter: the field, the operator and then the value.
+  return absl::StrCat(field_.CanonicalString(), CanonicalName(op_),
+                      value_rhs_.ToString());
 }
 
 }  // namespace core
@@ -17,8 +17,10 @@
 #ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_IMMUTABLE_LLRB_NODE_H_
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_IMMUTABLE_LLRB_NODE_H_
 
+#include <cstdint>
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include "Firestore/core/src/firebase/firestore/immutable/llrb_node_iterator.h"
 #include "Firestore/core/src/firebase/firestore/immutable/sorted_map_base.h"
@@ -100,6 +102,14 @@ class LlrbNode : public SortedMapBase {
   template <typename Comparator>
   LlrbNode erase(const K& key, const Comparator& comparator) const;
 
+  /**
+   * Returns a tree holding the entries in [begin, end), which must be in
+   * ascending order of key with no duplicates. Unlike inserting the entries
+   * one at a time, this takes linear time and allocates each node once.
+   */
+  template <typename RandomIt>
+  static LlrbNode FromSorted(RandomIt begin, RandomIt end);
+
   const LlrbNode& min() const {
     const LlrbNode* node = this;
     while (!node->left().empty()) {
@@ -212,6 +222,13 @@ class LlrbNode : public SortedMapBase {
     rep_->right_ = std::move(right);
   }
 
+  /**
+   * Returns a perfectly balanced, all black tree holding the entries in
+   * [begin, end), whose size must be one less than a power of two.
+   */
+  template <typename RandomIt>
+  static LlrbNode Balanced(RandomIt begin, RandomIt end);
+
   template <typename Comparator>
   LlrbNode InnerInsert(const K& key,
                        const V& value,
@@ -282,6 +299,62 @@ LlrbNode<K, V> LlrbNode<K, V>::InnerInsert(const K& key,
   return result;
 }
 
+template <typename K, typename V>
+template <typename RandomIt>
+LlrbNode<K, V> LlrbNode<K, V>::FromSorted(RandomIt begin, RandomIt end) {
+  // The entries are split, starting from the largest, into "pennants": a node
+  // whose right child is a perfectly balanced black tree. Each pennant becomes
+  // the left child of the one before it. Reading the binary digits of
+  // size + 1 after the leading one, a 0 digit adds one black pennant and a 1
+  // digit adds a black pennant and a red one of the same size, which keeps the
+  // black height equal on every path and every red node a left child.
+  auto size = static_cast<size_type>(end - begin);
+  size_type digits = 0;
+  while ((uint64_t{2} << digits) <= uint64_t{size} + 1) {
+    digits++;
+  }
+  size_type low_bits = (size + 1) & ((size_type{1} << digits) - 1);
+
+  struct Pennant {
+    RandomIt entry;
+    Color color;
+    LlrbNode right;
+  };
+  std::vector<Pennant> pennants;
+  RandomIt high = end;
+  auto add_pennant = [&](size_type pennant_size, Color color) {
+    RandomIt low = high - pennant_size;
+    pennants.push_back(Pennant{low, color, Balanced(low + 1, high)});
+    high = low;
+  };
+
+  for (size_type i = digits; i > 0; i--) {
+    size_type pennant_size = size_type{1} << (i - 1);
+    add_pennant(pennant_size, Color::Black);
+    if (low_bits & pennant_size) {
+      add_pennant(pennant_size, Color::Red);
+    }
+  }
+
+  LlrbNode result;
+  for (auto it = pennants.rbegin(); it != pennants.rend(); ++it) {
+    result = LlrbNode{Rep{value_type{*it->entry}, it->color, std::move(result),
+                          std::move(it->right)}};
+  }
+  return result;
+}
+
+template <typename K, typename V>
+template <typename RandomIt>
+LlrbNode<K, V> LlrbNode<K, V>::Balanced(RandomIt begin, RandomIt end) {
+  if (begin == end) {
+    return LlrbNode{};
+  }
+  RandomIt middle = begin + (end - begin) / 2;
+  return LlrbNode{Rep{value_type{*middle}, Color::Black,
+                      Balanced(begin, middle), Balanced(middle + 1, end)}};
+}
+
 template <typename K, typename V>
 template <typename Comparator>
 LlrbNode<K, V> LlrbNode<K, V>::erase(const K& key,
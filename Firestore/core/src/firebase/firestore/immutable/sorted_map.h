@@ -17,6 +17,7 @@
 #ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_IMMUTABLE_SORTED_MAP_H_
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_IMMUTABLE_SORTED_MAP_H_
 
+#include <iterator>
 #include <utility>
 
 #include "Firestore/core/src/firebase/firestore/immutable/array_sorted_map.h"
@@ -70,6 +71,24 @@ class SortedMap : public impl::SortedMapBase {
     }
   }
 
+  /**
+   * Creates a SortedMap from a random access range of entries that is already
+   * in ascending order of key, with no duplicate keys. Unlike inserting the
+   * entries one at a time, this takes linear time.
+   */
+  template <typename Range>
+  static SortedMap FromSorted(const Range& entries, const C& comparator = {}) {
+    auto size = std::end(entries) - std::begin(entries);
+    if (size <= static_cast<decltype(size)>(kFixedSize)) {
+      SortedMap result{comparator};
+      for (const auto& entry : entries) {
+        result = result.insert(entry.first, entry.second);
+      }
+      return result;
+    }
+    return SortedMap{tree_type::CreateFromSorted(entries, comparator)};
+  }
+
   SortedMap(const SortedMap& other) : tag_{other.tag_} {
     switch (tag_) {
       case Tag::Array:
@@ -19,6 +19,7 @@
 
 #include <algorithm>
 #include <utility>
+#include <vector>
 
 #include "Firestore/core/src/firebase/firestore/immutable/sorted_map.h"
 #include "Firestore/core/src/firebase/firestore/immutable/sorted_map_base.h"
@@ -69,6 +70,20 @@ class SortedSet {
     }
   }
 
+  /**
+   * Creates a SortedSet from a range of keys that is already in ascending
+   * order, with no duplicates. Unlike inserting the keys one at a time, this
+   * takes linear time.
+   */
+  template <typename Range>
+  static SortedSet FromSorted(const Range& keys, const C& comparator = C()) {
+    std::vector<std::pair<K, V>> entries;
+    for (const K& key : keys) {
+      entries.emplace_back(key, V{});
+    }
+    return SortedSet{M::FromSorted(entries, comparator)};
+  }
+
   bool empty() const {
     return map_.empty();
   }
@@ -20,6 +20,7 @@
 #include <algorithm>
 #include <cassert>
 #include <functional>
+#include <iterator>
 #include <memory>
 #include <utility>
 
@@ -73,6 +74,17 @@ class TreeSortedMap : public SortedMapBase, public util::ComparatorHolder<C> {
     return TreeSortedMap{std::move(node), comparator};
   }
 
+  /**
+   * Creates a TreeSortedMap from a random access range of pairs that is
+   * already in ascending order of key, with no duplicate keys, in linear time.
+   */
+  template <typename Range>
+  static TreeSortedMap CreateFromSorted(const Range& range,
+                                        const C& comparator) {
+    node_type node = node_type::FromSorted(std::begin(range), std::end(range));
+    return TreeSortedMap{std::move(node), comparator};
+  }
+
   /** Returns true if the map contains no elements. */
   bool empty() const {
     return root_.empty();
@@ -0,0 +1,142 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DECODED_DOCUMENT_CACHE_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DECODED_DOCUMENT_CACHE_H_
+
+#if !defined(__OBJC__)
+#error "For now, this file must only be included by ObjC source files."
+#endif  // !defined(__OBJC__)
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>  // NOLINT(build/c++11)
+#include <unordered_map>
+
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "absl/strings/string_view.h"
+
+@class FSTMaybeDocument;
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** Counters describing how effective a DecodedDocumentCache has been. */
+struct DecodedDocumentCacheStats {
+  double hit_rate() const {
+    int64_t lookups = hits + misses;
+    return lookups == 0 ? 0 : static_cast<double>(hits) / lookups;
+  }
+
+  int64_t hits = 0;
+  int64_t misses = 0;
+  int64_t evictions = 0;
+};
+
+/**
+ * A bounded, least-recently-used cache of documents decoded from persistence,
+ * which saves decoding the same stored bytes over and over.
+ *
+ * Entries are keyed by document key and remember a fingerprint of the stored
+ * value they were decoded from. A lookup only hits if the stored value still
+ * has the same fingerprint, so a newer or older version of the document (for
+ * example, one read through a snapshot) is never served from the cache.
+ *
+ * The size of each entry is approximated by the size of its serialized form.
+ * All methods are thread-safe.
+ */
+class DecodedDocumentCache {
+ public:
+  static const size_t kDefaultMaxBytes = 2 * 1024 * 1024;
+
+  explicit DecodedDocumentCache(size_t max_bytes = kDefaultMaxBytes);
+
+  /** Returns a fingerprint of a stored value, for use as `fingerprint`. */
+  static uint64_t Fingerprint(absl::string_view stored);
+
+  /**
+   * Returns the document decoded from the stored value with the given
+   * fingerprint, or nil if it's not cached.
+   */
+  FSTMaybeDocument* _Nullable Get(const model::DocumentKey& key,
+                                  uint64_t fingerprint);
+
+  /**
+   * Caches `document`, which was decoded from a stored value with the given
+   * fingerprint and whose serialized form is `byte_size` bytes.
+   */
+  void Put(const model::DocumentKey& key,
+           uint64_t fingerprint,
+           size_t byte_size,
+           FSTMaybeDocument* document);
+
+  /** Drops any cached document for the given key. */
+  void Invalidate(const model::DocumentKey& key);
+
+  /** Drops all cached documents. */
+  void Clear();
+
+  size_t max_bytes() const;
+
+  /**
+   * Changes the size limit, evicting documents if needed. A limit of 0
+   * disables the cache.
+   */
+  void set_max_bytes(size_t max_bytes);
+
+  /** Returns the approximate size of the cached documents. */
+  size_t byte_size() const;
+
+  DecodedDocumentCacheStats stats() const;
+
+ private:
+  struct Entry {
+    model::DocumentKey key;
+    uint64_t fingerprint;
+    size_t byte_size;
+    FSTMaybeDocument* document;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  void EraseLocked(EntryList::iterator entry);
+  void EvictLocked();
+
+  mutable std::mutex mutex_;
+  size_t max_bytes_;
+  size_t byte_size_ = 0;
+
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<model::DocumentKey,
+                     EntryList::iterator,
+                     model::DocumentKeyHash>
+      index_;
+
+  DecodedDocumentCacheStats stats_;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DECODED_DOCUMENT_CACHE_H_
@@ -0,0 +1,126 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/decoded_document_cache.h"
+
+#include <iterator>
+
+using firebase::firestore::model::DocumentKey;
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+const size_t DecodedDocumentCache::kDefaultMaxBytes;
+
+DecodedDocumentCache::DecodedDocumentCache(size_t max_bytes)
+    : max_bytes_(max_bytes) {
+}
+
+uint64_t DecodedDocumentCache::Fingerprint(absl::string_view stored) {
+  // 64-bit FNV-1a: far cheaper than decoding, and collisions between two
+  // versions of the same document are vanishingly unlikely.
+  uint64_t hash = 14695981039346656037ULL;
+  for (char c : stored) {
+    hash ^= static_cast<uint8_t>(c);
+    hash *= 1099511628211ULL;
+  }
+  return hash ^ stored.size();
+}
+
+FSTMaybeDocument* _Nullable DecodedDocumentCache::Get(const DocumentKey& key,
+                                                      uint64_t fingerprint) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto found = index_.find(key);
+  if (found == index_.end() || found->second->fingerprint != fingerprint) {
+    stats_.misses++;
+    return nil;
+  }
+
+  stats_.hits++;
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return found->second->document;
+}
+
+void DecodedDocumentCache::Put(const DocumentKey& key,
+                               uint64_t fingerprint,
+                               size_t byte_size,
+                               FSTMaybeDocument* document) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    EraseLocked(found->second);
+  }
+  if (byte_size > max_bytes_) return;
+
+  entries_.push_front(Entry{key, fingerprint, byte_size, document});
+  index_[key] = entries_.begin();
+  byte_size_ += byte_size;
+  EvictLocked();
+}
+
+void DecodedDocumentCache::Invalidate(const DocumentKey& key) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  auto found = index_.find(key);
+  if (found != index_.end()) {
+    EraseLocked(found->second);
+  }
+}
+
+void DecodedDocumentCache::Clear() {
+  std::lock_guard<std::mutex> lock{mutex_};
+  entries_.clear();
+  index_.clear();
+  byte_size_ = 0;
+}
+
+size_t DecodedDocumentCache::max_bytes() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return max_bytes_;
+}
+
+void DecodedDocumentCache::set_max_bytes(size_t max_bytes) {
+  std::lock_guard<std::mutex> lock{mutex_};
+  max_bytes_ = max_bytes;
+  EvictLocked();
+}
+
+size_t DecodedDocumentCache::byte_size() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return byte_size_;
+}
+
+DecodedDocumentCacheStats DecodedDocumentCache::stats() const {
+  std::lock_guard<std::mutex> lock{mutex_};
+  return stats_;
+}
+
+void DecodedDocumentCache::EraseLocked(EntryList::iterator entry) {
+  byte_size_ -= entry->byte_size;
+  index_.erase(entry->key);
+  entries_.erase(entry);
+}
+
+void DecodedDocumentCache::EvictLocked() {
+  while (byte_size_ > max_bytes_ && !entries_.empty()) {
+    EraseLocked(std::prev(entries_.end()));
+    stats_.evictions++;
+  }
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,66 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
+
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKey;
+using model::DocumentKeySet;
+
+DocumentChangeLog::DocumentChangeLog(size_t capacity) : capacity_(capacity) {
+}
+
+void DocumentChangeLog::Record(const DocumentKey& key) {
+  changes_.push_back(key);
+  if (changes_.size() > capacity_) {
+    changes_.pop_front();
+  }
+  position_++;
+}
+
+void DocumentChangeLog::Record(const DocumentKeySet& keys) {
+  for (const DocumentKey& key : keys) {
+    Record(key);
+  }
+}
+
+absl::optional<DocumentKeySet> DocumentChangeLog::ChangedSince(
+    int64_t position) const {
+  HARD_ASSERT(position <= position_, "Position %s is ahead of the log (%s)",
+              position, position_);
+
+  // The retained changes are at positions (oldest, position_].
+  int64_t oldest = position_ - static_cast<int64_t>(changes_.size());
+  if (position < oldest) {
+    return absl::nullopt;
+  }
+
+  DocumentKeySet result;
+  for (auto it = changes_.begin() + (position - oldest); it != changes_.end();
+       ++it) {
+    result = result.insert(*it);
+  }
+  return result;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,81 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_CHANGE_LOG_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_CHANGE_LOG_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
+#include "absl/types/optional.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * A bounded, in-memory record of which documents changed and in what order,
+ * so that anything computed from the documents at some point can later be
+ * brought up to date by revisiting only the documents changed since.
+ *
+ * Each recorded change advances the log's position. Once the log holds
+ * `capacity` changes it discards the oldest, after which it can no longer
+ * answer for positions that old.
+ */
+class DocumentChangeLog {
+ public:
+  static const size_t kDefaultCapacity = 10000;
+
+  explicit DocumentChangeLog(size_t capacity = kDefaultCapacity);
+
+  /**
+   * Returns the current position of the log. Changes recorded from now on
+   * will be reported as changed since this position.
+   */
+  int64_t position() const {
+    return position_;
+  }
+
+  /** Records that the document with the given key has changed. */
+  void Record(const model::DocumentKey& key);
+
+  /** Records that the documents with the given keys have changed. */
+  void Record(const model::DocumentKeySet& keys);
+
+  /**
+   * Returns the keys of the documents that changed after `position`, or
+   * nullopt if the log no longer reaches back that far.
+   */
+  absl::optional<model::DocumentKeySet> ChangedSince(int64_t position) const;
+
+ private:
+  size_t capacity_;
+
+  /** The keys of the retained changes, oldest first. */
+  std::deque<model::DocumentKey> changes_;
+
+  /** The position of the most recent change. */
+  int64_t position_ = 0;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_CHANGE_LOG_H_
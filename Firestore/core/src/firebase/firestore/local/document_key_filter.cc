@@ -0,0 +1,105 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+
+#include <algorithm>
+#include <limits>
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKey;
+using model::DocumentKeyHash;
+
+namespace {
+
+/** The smallest number of keys a filter is sized for. */
+const size_t kMinCapacity = 256;
+
+/**
+ * Counters per key. With 7 hashes this gives a false positive rate of about 1%
+ * at capacity.
+ */
+const size_t kCountersPerKey = 10;
+
+const uint8_t kMaxCount = std::numeric_limits<uint8_t>::max();
+
+/** The finalizer of SplitMix64, which spreads the bits of a weak hash. */
+uint64_t Mix(uint64_t hash) {
+  hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+  return hash ^ (hash >> 31);
+}
+
+}  // namespace
+
+DocumentKeyFilter::DocumentKeyFilter(size_t expected_size)
+    : capacity_(std::max(expected_size, kMinCapacity)) {
+  size_t counter_count = 1;
+  while (counter_count < capacity_ * kCountersPerKey) {
+    counter_count <<= 1;
+  }
+  counters_.resize(counter_count);
+  mask_ = counter_count - 1;
+}
+
+uint64_t DocumentKeyFilter::KeyHash(const DocumentKey& key) {
+  return Mix(DocumentKeyHash{}(key));
+}
+
+template <typename F>
+void DocumentKeyFilter::ForEachCounter(uint64_t hash, const F& visitor) const {
+  // Derives the counters from two halves of the hash (Kirsch and
+  // Mitzenmacher). Making the step odd lets it reach every counter.
+  uint64_t position = hash & 0xffffffff;
+  uint64_t step = (hash >> 32) | 1;
+  for (int i = 0; i < kHashCount; ++i) {
+    visitor(static_cast<size_t>(position & mask_));
+    position += step;
+  }
+}
+
+void DocumentKeyFilter::AddHash(uint64_t hash) {
+  ForEachCounter(hash, [this](size_t index) {
+    uint8_t& counter = counters_[index];
+    if (counter < kMaxCount) counter++;
+  });
+  size_++;
+}
+
+void DocumentKeyFilter::RemoveHash(uint64_t hash) {
+  ForEachCounter(hash, [this](size_t index) {
+    uint8_t& counter = counters_[index];
+    // A saturated counter no longer knows how many keys it counts, so it
+    // stays put rather than risk dropping to zero while one remains.
+    if (counter > 0 && counter < kMaxCount) counter--;
+  });
+  if (size_ > 0) size_--;
+}
+
+bool DocumentKeyFilter::MightContainHash(uint64_t hash) const {
+  bool found = true;
+  ForEachCounter(hash, [this, &found](size_t index) {
+    if (counters_[index] == 0) found = false;
+  });
+  return found;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,110 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_KEY_FILTER_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_KEY_FILTER_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * An in-memory counting bloom filter over document keys, which answers "is this
+ * key definitely absent?" without reading the rows that record the keys.
+ *
+ * Each key increments a handful of small counters and removing it decrements
+ * them again, so the filter can follow a set of keys that shrinks as well as
+ * grows. MightContain() never returns false for a key that has been added more
+ * times than it has been removed, as long as keys are only removed after being
+ * added. Counters that reach their maximum stay there, which only costs false
+ * positives.
+ *
+ * The filter is sized for the number of keys it is created with. Once it holds
+ * many more than that, false positives become common and overfull() reports
+ * that the owner should rebuild it from the rows it summarizes.
+ */
+class DocumentKeyFilter {
+ public:
+  /** Creates an empty filter sized for about `expected_size` keys. */
+  explicit DocumentKeyFilter(size_t expected_size = 0);
+
+  /** Returns the hash of `key` that the filter's counters are derived from. */
+  static uint64_t KeyHash(const model::DocumentKey& key);
+
+  void Add(const model::DocumentKey& key) {
+    AddHash(KeyHash(key));
+  }
+
+  /** Removes one occurrence of a key that was previously added. */
+  void Remove(const model::DocumentKey& key) {
+    RemoveHash(KeyHash(key));
+  }
+
+  /**
+   * Returns false if `key` is definitely not in the filter, or true if it may
+   * be.
+   */
+  bool MightContain(const model::DocumentKey& key) const {
+    return MightContainHash(KeyHash(key));
+  }
+
+  /** Adds a key given its KeyHash(). */
+  void AddHash(uint64_t hash);
+
+  /** Removes a key given its KeyHash(). */
+  void RemoveHash(uint64_t hash);
+
+  bool MightContainHash(uint64_t hash) const;
+
+  /** The number of keys added and not yet removed. */
+  size_t size() const {
+    return size_;
+  }
+
+  /** The number of keys the filter was sized for. */
+  size_t capacity() const {
+    return capacity_;
+  }
+
+  /** True once the filter holds so many keys that it should be rebuilt. */
+  bool overfull() const {
+    return size_ > 2 * capacity_;
+  }
+
+ private:
+  /** The number of counters each key sets. */
+  static const int kHashCount = 7;
+
+  template <typename F>
+  void ForEachCounter(uint64_t hash, const F& visitor) const;
+
+  std::vector<uint8_t> counters_;
+  size_t mask_ = 0;
+  size_t capacity_ = 0;
+  size_t size_ = 0;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_DOCUMENT_KEY_FILTER_H_
@@ -0,0 +1,208 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/incremental_lru_garbage_collector.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::TargetId;
+using util::OrderedCode;
+
+namespace {
+
+const int64_t kProgressFormatVersion = 1;
+
+}  // namespace
+
+const model::ListenSequenceNumber LruGcProgress::kNoUpperBound;
+
+std::string LruGcProgress::Encode() const {
+  std::string result;
+  OrderedCode::WriteSignedNumIncreasing(&result, kProgressFormatVersion);
+  OrderedCode::WriteSignedNumIncreasing(&result, static_cast<int64_t>(phase));
+  OrderedCode::WriteString(&result, cursor);
+  OrderedCode::WriteSignedNumIncreasing(&result, count);
+  OrderedCode::WriteSignedNumIncreasing(&result, sequence_numbers_to_collect);
+  OrderedCode::WriteSignedNumIncreasing(&result, remaining);
+  OrderedCode::WriteSignedNumIncreasing(&result, upper_bound);
+  OrderedCode::WriteSignedNumIncreasing(&result, targets_removed);
+  OrderedCode::WriteSignedNumIncreasing(&result, documents_removed);
+  return result;
+}
+
+bool LruGcProgress::Decode(absl::string_view encoded,
+                           LruGcProgress* progress) {
+  int64_t version = 0;
+  int64_t phase = 0;
+  LruGcProgress result;
+  bool ok =
+      OrderedCode::ReadSignedNumIncreasing(&encoded, &version) &&
+      version == kProgressFormatVersion &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded, &phase) &&
+      phase >= static_cast<int64_t>(LruGcPhase::Idle) &&
+      phase <= static_cast<int64_t>(LruGcPhase::RemovingDocuments) &&
+      OrderedCode::ReadString(&encoded, &result.cursor) &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded, &result.count) &&
+      OrderedCode::ReadSignedNumIncreasing(
+          &encoded, &result.sequence_numbers_to_collect) &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded, &result.remaining) &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded, &result.upper_bound) &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded,
+                                           &result.targets_removed) &&
+      OrderedCode::ReadSignedNumIncreasing(&encoded,
+                                           &result.documents_removed) &&
+      encoded.empty();
+  if (!ok) {
+    return false;
+  }
+
+  result.phase = static_cast<LruGcPhase>(phase);
+  *progress = std::move(result);
+  return true;
+}
+
+bool LruGcProgress::operator==(const LruGcProgress& other) const {
+  return phase == other.phase && cursor == other.cursor &&
+         count == other.count &&
+         sequence_numbers_to_collect == other.sequence_numbers_to_collect &&
+         remaining == other.remaining && upper_bound == other.upper_bound &&
+         targets_removed == other.targets_removed &&
+         documents_removed == other.documents_removed;
+}
+
+IncrementalLruGarbageCollector::IncrementalLruGarbageCollector(
+    LruGcDelegate* delegate,
+    int percentile_to_collect,
+    int max_sequence_numbers_to_collect,
+    LruGcMetrics* metrics)
+    : delegate_(delegate),
+      percentile_to_collect_(percentile_to_collect),
+      max_sequence_numbers_to_collect_(max_sequence_numbers_to_collect),
+      metrics_(metrics),
+      progress_(delegate->LoadProgress()) {
+}
+
+void IncrementalLruGarbageCollector::Start() {
+  if (in_progress()) return;
+
+  progress_ = LruGcProgress{};
+  progress_.phase = LruGcPhase::Counting;
+  phase_duration_ = std::chrono::microseconds{0};
+  phase_rows_ = 0;
+}
+
+bool IncrementalLruGarbageCollector::RunSlice(
+    int row_budget, const std::unordered_set<TargetId>& live_targets) {
+  int budget = row_budget;
+  while (in_progress() && budget > 0) {
+    auto start = std::chrono::steady_clock::now();
+    LruGcSlice slice = RunPhase(budget, live_targets);
+    phase_duration_ += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - start);
+    phase_rows_ += slice.rows;
+
+    // Count moving on to the next phase as a row so that the loop always
+    // makes progress.
+    budget -= std::max(slice.rows, 1);
+    if (slice.finished) {
+      FinishPhase();
+    }
+  }
+
+  delegate_->SaveProgress(progress_);
+  return !in_progress();
+}
+
+LruGcSlice IncrementalLruGarbageCollector::RunPhase(
+    int limit, const std::unordered_set<TargetId>& live_targets) {
+  std::string* cursor = &progress_.cursor;
+  switch (progress_.phase) {
+    case LruGcPhase::Counting:
+      return delegate_->CountSequenceNumbers(cursor, limit, &progress_.count);
+
+    case LruGcPhase::FindingUpperBound:
+      return delegate_->FindUpperBound(cursor, limit, &progress_.remaining,
+                                       &progress_.upper_bound);
+
+    case LruGcPhase::RemovingTargets:
+      return delegate_->RemoveTargets(progress_.upper_bound, live_targets,
+                                      cursor, limit,
+                                      &progress_.targets_removed);
+
+    case LruGcPhase::RemovingDocuments:
+      return delegate_->RemoveOrphanedDocuments(progress_.upper_bound, cursor,
+                                                limit,
+                                                &progress_.documents_removed);
+
+    case LruGcPhase::Idle:
+      break;
+  }
+  HARD_FAIL("No garbage collection phase to run");
+}
+
+void IncrementalLruGarbageCollector::FinishPhase() {
+  LruGcPhase finished = progress_.phase;
+  if (metrics_) {
+    metrics_->PhaseCompleted(finished, phase_duration_, phase_rows_);
+  }
+  phase_duration_ = std::chrono::microseconds{0};
+  phase_rows_ = 0;
+  progress_.cursor.clear();
+
+  switch (finished) {
+    case LruGcPhase::Counting: {
+      int64_t to_collect = static_cast<int64_t>(
+          (percentile_to_collect_ / 100.0) * progress_.count);
+      to_collect = std::min<int64_t>(to_collect,
+                                     max_sequence_numbers_to_collect_);
+      progress_.sequence_numbers_to_collect = to_collect;
+      progress_.remaining = to_collect;
+      // With nothing to collect, the remaining phases would be no-ops.
+      progress_.phase = to_collect > 0 ? LruGcPhase::FindingUpperBound
+                                       : LruGcPhase::Idle;
+      break;
+    }
+
+    case LruGcPhase::FindingUpperBound:
+      progress_.phase = LruGcPhase::RemovingTargets;
+      break;
+
+    case LruGcPhase::RemovingTargets:
+      progress_.phase = LruGcPhase::RemovingDocuments;
+      break;
+
+    case LruGcPhase::RemovingDocuments:
+    case LruGcPhase::Idle:
+      progress_.phase = LruGcPhase::Idle;
+      break;
+  }
+
+  if (!in_progress() && metrics_) {
+    metrics_->CollectionCompleted(progress_);
+  }
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,253 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_INCREMENTAL_LRU_GARBAGE_COLLECTOR_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_INCREMENTAL_LRU_GARBAGE_COLLECTOR_H_
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+
+#include "Firestore/core/src/firebase/firestore/model/types.h"
+#include "absl/strings/string_view.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** The phases of a garbage collection, in the order they run. */
+enum class LruGcPhase {
+  /** No collection is in progress. */
+  Idle = 0,
+
+  /** Counting the targets and orphaned documents. */
+  Counting = 1,
+
+  /** Finding the highest sequence number that will be collected. */
+  FindingUpperBound = 2,
+
+  /** Removing targets at or below the upper bound. */
+  RemovingTargets = 3,
+
+  /** Removing orphaned documents at or below the upper bound. */
+  RemovingDocuments = 4,
+};
+
+/**
+ * The state of a garbage collection between slices. This is persisted after
+ * every slice so that a collection interrupted by a restart picks up where it
+ * left off.
+ */
+struct LruGcProgress {
+  /** The sequence number used when nothing will be collected. */
+  static const model::ListenSequenceNumber kNoUpperBound = -1;
+
+  /** Encodes this progress for storage. */
+  std::string Encode() const;
+
+  /**
+   * Decodes progress written by Encode(). Returns false, leaving `progress`
+   * unchanged, if `encoded` was not recognized.
+   */
+  static bool Decode(absl::string_view encoded, LruGcProgress* progress);
+
+  bool operator==(const LruGcProgress& other) const;
+
+  LruGcPhase phase = LruGcPhase::Idle;
+
+  /**
+   * The position within the current phase, which is opaque to the collector.
+   * Empty at the start of each phase.
+   */
+  std::string cursor;
+
+  /** The number of targets and orphaned documents counted so far. */
+  int64_t count = 0;
+
+  /** The number of sequence numbers this collection will remove. */
+  int64_t sequence_numbers_to_collect = 0;
+
+  /** The number of sequence numbers still to pass while finding the bound. */
+  int64_t remaining = 0;
+
+  model::ListenSequenceNumber upper_bound = kNoUpperBound;
+
+  int64_t targets_removed = 0;
+  int64_t documents_removed = 0;
+};
+
+/** The outcome of running one phase of a collection over a bounded range. */
+struct LruGcSlice {
+  /** The number of rows examined. */
+  int rows = 0;
+
+  /** True if the phase has no more rows to examine. */
+  bool finished = false;
+};
+
+/**
+ * Receives timings from IncrementalLruGarbageCollector, for example to log them
+ * or to report them to an analytics service.
+ */
+class LruGcMetrics {
+ public:
+  virtual ~LruGcMetrics() = default;
+
+  /**
+   * Called when a phase finishes, with the time spent in it and the number of
+   * rows it examined, summed over all of its slices since the collector was
+   * created.
+   */
+  virtual void PhaseCompleted(LruGcPhase phase,
+                              std::chrono::microseconds duration,
+                              int64_t rows) = 0;
+
+  /** Called when a collection finishes. */
+  virtual void CollectionCompleted(const LruGcProgress& progress) = 0;
+};
+
+/**
+ * The operations IncrementalLruGarbageCollector needs from persistence.
+ *
+ * Targets and orphaned documents are visited in increasing sequence number
+ * order. Each method examines at most `limit` rows, starting after the
+ * position stored in `*cursor` (or at the first row if `*cursor` is empty),
+ * and stores the position of the last row it examined back into `*cursor`.
+ */
+class LruGcDelegate {
+ public:
+  virtual ~LruGcDelegate() = default;
+
+  /** Returns the progress saved by the last call to SaveProgress(). */
+  virtual LruGcProgress LoadProgress() = 0;
+
+  virtual void SaveProgress(const LruGcProgress& progress) = 0;
+
+  /** Adds the number of targets and orphaned documents examined to `*count`. */
+  virtual LruGcSlice CountSequenceNumbers(std::string* cursor,
+                                          int limit,
+                                          int64_t* count) = 0;
+
+  /**
+   * Decrements `*remaining` for each target and orphaned document examined,
+   * setting `*upper_bound` to its sequence number, and finishes once
+   * `*remaining` reaches zero.
+   */
+  virtual LruGcSlice FindUpperBound(
+      std::string* cursor,
+      int limit,
+      int64_t* remaining,
+      model::ListenSequenceNumber* upper_bound) = 0;
+
+  /**
+   * Removes targets with a sequence number at or below `upper_bound` that
+   * aren't in `live_targets`, adding the number removed to `*removed`.
+   */
+  virtual LruGcSlice RemoveTargets(
+      model::ListenSequenceNumber upper_bound,
+      const std::unordered_set<model::TargetId>& live_targets,
+      std::string* cursor,
+      int limit,
+      int64_t* removed) = 0;
+
+  /**
+   * Removes orphaned documents with a sequence number at or below
+   * `upper_bound` that aren't otherwise pinned, adding the number removed to
+   * `*removed`.
+   */
+  virtual LruGcSlice RemoveOrphanedDocuments(
+      model::ListenSequenceNumber upper_bound,
+      std::string* cursor,
+      int limit,
+      int64_t* removed) = 0;
+};
+
+/**
+ * Runs LRU garbage collection as a series of short slices, so that collecting a
+ * large cache doesn't hold up other work for long.
+ *
+ * Each slice examines a bounded number of rows and then saves its progress
+ * through the delegate. Callers should run each slice in its own transaction
+ * and yield to other work between slices.
+ *
+ * Entries used while a collection is in progress may be counted twice or not at
+ * all, so the percentile collected is approximate. Entries used after the upper
+ * bound was found have a higher sequence number and are never removed.
+ */
+class IncrementalLruGarbageCollector {
+ public:
+  /**
+   * Creates a collector that resumes the collection saved by the delegate, if
+   * any. This must be called within a transaction.
+   *
+   * @param percentile_to_collect The percentage of sequence numbers each
+   *     collection removes.
+   * @param max_sequence_numbers_to_collect A cap on the number of sequence
+   *     numbers each collection removes.
+   * @param metrics Receives timings; may be null. Not owned.
+   */
+  IncrementalLruGarbageCollector(LruGcDelegate* delegate,
+                                 int percentile_to_collect,
+                                 int max_sequence_numbers_to_collect,
+                                 LruGcMetrics* metrics = nullptr);
+
+  const LruGcProgress& progress() const {
+    return progress_;
+  }
+
+  bool in_progress() const {
+    return progress_.phase != LruGcPhase::Idle;
+  }
+
+  void set_metrics(LruGcMetrics* metrics) {
+    metrics_ = metrics;
+  }
+
+  /** Starts a new collection unless one is already in progress. */
+  void Start();
+
+  /**
+   * Runs the collection in progress until it finishes or `row_budget` rows
+   * have been examined, then saves its progress.
+   *
+   * @return true if no collection is in progress any more.
+   */
+  bool RunSlice(int row_budget,
+                const std::unordered_set<model::TargetId>& live_targets);
+
+ private:
+  LruGcSlice RunPhase(int limit,
+                      const std::unordered_set<model::TargetId>& live_targets);
+  void FinishPhase();
+
+  LruGcDelegate* delegate_ = nullptr;
+  int percentile_to_collect_ = 0;
+  int max_sequence_numbers_to_collect_ = 0;
+  LruGcMetrics* metrics_ = nullptr;
+
+  LruGcProgress progress_;
+
+  // Totals for the current phase, reported when it finishes.
+  std::chrono::microseconds phase_duration_{0};
+  int64_t phase_rows_ = 0;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_INCREMENTAL_LRU_GARBAGE_COLLECTOR_H_
@@ -0,0 +1,464 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_cache_snapshot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Firestore/Protos/nanopb/firestore/local/maybe_document.nanopb.h"
+#include "Firestore/Protos/nanopb/firestore/local/target.nanopb.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_migrations.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_range_delete.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_util.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
+#include "Firestore/core/src/firebase/firestore/nanopb/reader.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/string_format.h"
+#include "absl/strings/match.h"
+#include "leveldb/write_batch.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using leveldb::DB;
+using leveldb::Iterator;
+using leveldb::ReadOptions;
+using nanopb::Reader;
+using util::Status;
+using util::StatusOr;
+using util::StringFormat;
+
+using Stats = LevelDbCacheSnapshotStats;
+
+const char LevelDbCacheSnapshot::kMagic[] = "FIRESTORE CACHE\n";
+
+namespace {
+
+const uint64_t kCacheSnapshotFormatVersion = 1;
+
+/**
+ * The largest key or value a snapshot may hold, which keeps a corrupt size
+ * from turning into a huge allocation. Documents are limited to 1 MiB.
+ */
+const uint64_t kMaxFieldSize = 64 * 1024 * 1024;
+
+size_t MagicSize() {
+  return sizeof(LevelDbCacheSnapshot::kMagic) - 1;
+}
+
+/**
+ * Returns the key prefixes of the tables a snapshot contains, in key order so
+ * that exporting them one after the other yields every row in key order.
+ */
+std::vector<std::string> SnapshotTablePrefixes() {
+  std::vector<std::string> prefixes = {
+      LevelDbTargetGlobalKey::Key(),
+      LevelDbTargetKey::KeyPrefix(),
+      LevelDbTargetResumeKey::KeyPrefix(),
+      LevelDbQueryTargetKey::KeyPrefix(),
+      LevelDbTargetDocumentBlockKey::KeyPrefix(),
+      LevelDbDocumentTargetKey::KeyPrefix(),
+      LevelDbRemoteDocumentKey::KeyPrefix(),
+      LevelDbRemoteDocumentChangeKey::KeyPrefix(),
+      LevelDbSequenceNumberKey::KeyPrefix(),
+  };
+  std::sort(prefixes.begin(), prefixes.end());
+  return prefixes;
+}
+
+void WriteVarint(std::ostream* out, uint64_t value) {
+  char bytes[10];
+  size_t size = 0;
+  while (value >= 0x80) {
+    bytes[size++] = static_cast<char>((value & 0x7f) | 0x80);
+    value >>= 7;
+  }
+  bytes[size++] = static_cast<char>(value);
+  out->write(bytes, size);
+}
+
+bool ReadVarint(std::istream* in, uint64_t* value) {
+  *value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    char byte;
+    if (!in->get(byte)) return false;
+
+    *value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+void WriteField(std::ostream* out, absl::string_view field) {
+  WriteVarint(out, field.size());
+  out->write(field.data(), field.size());
+}
+
+bool ReadField(std::istream* in, uint64_t size, std::string* field) {
+  if (size > kMaxFieldSize) return false;
+
+  field->resize(size);
+  if (size == 0) return true;
+  in->read(&(*field)[0], static_cast<std::streamsize>(size));
+  return in->gcount() == static_cast<std::streamsize>(size);
+}
+
+/** Returns true if `bytes` decode as the message described by `fields`. */
+template <typename T>
+bool ParsesAs(const pb_field_t fields[], absl::string_view bytes) {
+  T proto{};
+  Reader reader = Reader::Wrap(bytes);
+  reader.ReadNanopbMessage(fields, &proto);
+  reader.FreeNanopbMessage(fields, &proto);
+  return reader.status().ok();
+}
+
+/**
+ * Loads the compression dictionaries of the database, so that every remote
+ * document it stores can be decompressed.
+ */
+LevelDbValueCompressor LoadCompressor(Iterator* it) {
+  LevelDbValueCompressor compressor;
+  std::string prefix = LevelDbRemoteDocumentDictionaryKey::KeyPrefix();
+  LevelDbRemoteDocumentDictionaryKey dictionary_key;
+  for (it->Seek(prefix);
+       it->Valid() && absl::StartsWith(MakeStringView(it->key()), prefix);
+       it->Next()) {
+    HARD_ASSERT(dictionary_key.Decode(MakeStringView(it->key())),
+                "Failed to decode dictionary key");
+    compressor.AddDictionary(dictionary_key.dictionary_id(),
+                             it->value().ToString());
+  }
+  return compressor;
+}
+
+/**
+ * Reads the table sizes row into `sizes`, returning false if the row doesn't
+ * exist yet.
+ */
+bool ReadTableSizes(DB* db, LevelDbTableSizes* sizes) {
+  std::string encoded;
+  leveldb::Status status =
+      db->Get(LevelDbTransaction::DefaultReadOptions(),
+              MakeSlice(LevelDbTableSizesKey::Key()), &encoded);
+  if (status.IsNotFound()) return false;
+
+  HARD_ASSERT(status.ok(), "Failed to read table sizes: %s", status.ToString());
+  HARD_ASSERT(sizes->Decode(encoded), "Failed to decode table sizes");
+  return true;
+}
+
+Status CorruptSnapshot(const std::string& message) {
+  return Status{FirestoreErrorCode::DataLoss,
+                StringFormat("Malformed cache snapshot: %s", message)};
+}
+
+/** Streams the rows of a snapshot into a database. */
+class SnapshotImporter {
+ public:
+  SnapshotImporter(DB* db, int max_batch_rows)
+      : db_{db},
+        max_batch_rows_{max_batch_rows},
+        prefixes_{SnapshotTablePrefixes()},
+        sizes_key_{LevelDbTableSizesKey::Key()},
+        target_global_key_{LevelDbTargetGlobalKey::Key()} {
+    track_sizes_ = ReadTableSizes(db_, &sizes_);
+  }
+
+  /** Fails unless every table the snapshot fills is empty. */
+  Status CheckEmpty() const {
+    std::unique_ptr<Iterator> it(
+        db_->NewIterator(LevelDbTransaction::DefaultReadOptions()));
+    for (const std::string& prefix : prefixes_) {
+      if (prefix == target_global_key_) continue;
+
+      it->Seek(prefix);
+      if (it->Valid() &&
+          absl::StartsWith(MakeStringView(it->key()), prefix)) {
+        return Status{FirestoreErrorCode::FailedPrecondition,
+                      StringFormat("Can't import a cache snapshot into a "
+                                   "database that already has rows in %s",
+                                   DescribeKey(it->key()))};
+      }
+    }
+    return ConvertStatus(it->status());
+  }
+
+  /** Reads every row after the header and writes it to the database. */
+  Status ImportRows(std::istream* in) {
+    std::string key;
+    std::string value;
+    std::string previous_key;
+    std::string target_global;
+    bool has_target_global = false;
+
+    for (;;) {
+      uint64_t key_size = 0;
+      if (!ReadVarint(in, &key_size)) return CorruptSnapshot("truncated");
+      if (key_size == 0) break;
+
+      uint64_t value_size = 0;
+      if (!ReadField(in, key_size, &key) || !ReadVarint(in, &value_size) ||
+          !ReadField(in, value_size, &value)) {
+        return CorruptSnapshot("truncated");
+      }
+
+      // Key order lets the batches below go straight into leveldb's sorted
+      // tables, and rules out duplicate rows.
+      if (key <= previous_key) {
+        return CorruptSnapshot(
+            StringFormat("rows out of order at %s", DescribeKey(key)));
+      }
+      Status status = CheckRow(key, value);
+      if (!status.ok()) return status;
+
+      stats_.rows++;
+      stats_.bytes += LevelDbTableSizes::RowSize(key, value);
+      if (key == target_global_key_) {
+        // Written last, so that a failed import leaves the existing row.
+        target_global = value;
+        has_target_global = true;
+      } else {
+        Status put_status = Put(key, value);
+        if (!put_status.ok()) return put_status;
+      }
+      previous_key.swap(key);
+    }
+
+    uint64_t row_count = 0;
+    if (!ReadVarint(in, &row_count) ||
+        row_count != static_cast<uint64_t>(stats_.rows)) {
+      return CorruptSnapshot("wrong row count");
+    }
+    if (!has_target_global) {
+      return CorruptSnapshot("missing the target global row");
+    }
+
+    std::string existing;
+    leveldb::Status existing_status =
+        db_->Get(LevelDbTransaction::DefaultReadOptions(),
+                 MakeSlice(target_global_key_), &existing);
+    if (existing_status.ok() && track_sizes_) {
+      sizes_.Adjust(target_global_key_,
+                    -LevelDbTableSizes::RowSize(target_global_key_, existing));
+    }
+    Status status = Put(target_global_key_, target_global);
+    if (!status.ok()) return status;
+    return Flush();
+  }
+
+  /** Deletes the rows written so far, after a failed import. */
+  void RollBack() {
+    batch_.Clear();
+    batch_rows_ = 0;
+    for (const std::string& prefix : prefixes_) {
+      if (prefix == target_global_key_) continue;
+      DeleteEverythingWithPrefix(db_, prefix);
+    }
+  }
+
+  const Stats& stats() const {
+    return stats_;
+  }
+
+ private:
+  Status CheckRow(const std::string& key, const std::string& value) {
+    auto prefix =
+        std::find_if(prefixes_.begin(), prefixes_.end(),
+                     [&](const std::string& prefix) {
+                       return absl::StartsWith(key, prefix);
+                     });
+    if (prefix == prefixes_.end()) {
+      return CorruptSnapshot(
+          StringFormat("unexpected row %s", DescribeKey(key)));
+    }
+
+    bool valid = true;
+    if (*prefix == LevelDbRemoteDocumentKey::KeyPrefix()) {
+      stats_.documents++;
+      valid = !LevelDbValueCompressor::IsCompressed(value) &&
+              ParsesAs<firestore_client_MaybeDocument>(
+                  firestore_client_MaybeDocument_fields, value);
+    } else if (*prefix == LevelDbTargetKey::KeyPrefix()) {
+      stats_.targets++;
+      valid = ParsesAs<firestore_client_Target>(firestore_client_Target_fields,
+                                                value);
+    } else if (*prefix == LevelDbTargetResumeKey::KeyPrefix()) {
+      valid = ParsesAs<firestore_client_Target>(firestore_client_Target_fields,
+                                                value);
+    } else if (*prefix == target_global_key_) {
+      valid = ParsesAs<firestore_client_TargetGlobal>(
+          firestore_client_TargetGlobal_fields, value);
+    } else if (*prefix == LevelDbRemoteDocumentChangeKey::KeyPrefix()) {
+      valid = value.empty();
+    }
+    if (!valid) {
+      return CorruptSnapshot(
+          StringFormat("failed to parse %s", DescribeKey(key)));
+    }
+    return Status::OK();
+  }
+
+  Status Put(const std::string& key, const std::string& value) {
+    if (track_sizes_) {
+      sizes_.Adjust(key, LevelDbTableSizes::RowSize(key, value));
+    }
+    batch_.Put(key, value);
+    batch_rows_++;
+    if (batch_rows_ >= max_batch_rows_) return Flush();
+    return Status::OK();
+  }
+
+  /** Commits the pending rows, along with the table sizes they add up to. */
+  Status Flush() {
+    if (batch_rows_ == 0) return Status::OK();
+
+    if (track_sizes_) {
+      batch_.Put(sizes_key_, sizes_.Encode());
+    }
+    Status status = ConvertStatus(
+        db_->Write(LevelDbTransaction::DefaultWriteOptions(), &batch_));
+    batch_.Clear();
+    batch_rows_ = 0;
+    return status;
+  }
+
+  DB* db_;
+  int max_batch_rows_;
+  std::vector<std::string> prefixes_;
+  std::string sizes_key_;
+  std::string target_global_key_;
+
+  LevelDbTableSizes sizes_;
+  bool track_sizes_ = false;
+
+  leveldb::WriteBatch batch_;
+  int batch_rows_ = 0;
+  Stats stats_;
+};
+
+}  // namespace
+
+StatusOr<Stats> LevelDbCacheSnapshot::Export(DB* db, std::ostream* out) {
+  LevelDbMigrations::SchemaVersion schema_version =
+      LevelDbMigrations::ReadSchemaVersion(db);
+
+  auto release = [db](const leveldb::Snapshot* snapshot) {
+    db->ReleaseSnapshot(snapshot);
+  };
+  std::unique_ptr<const leveldb::Snapshot, decltype(release)> snapshot(
+      db->GetSnapshot(), release);
+
+  // Every row is read once, so keep the blocks out of the cache.
+  ReadOptions read_options = LevelDbTransaction::DefaultReadOptions();
+  read_options.snapshot = snapshot.get();
+  read_options.fill_cache = false;
+  std::unique_ptr<Iterator> it(db->NewIterator(read_options));
+
+  LevelDbValueCompressor compressor = LoadCompressor(it.get());
+  std::string documents_prefix = LevelDbRemoteDocumentKey::KeyPrefix();
+  std::string targets_prefix = LevelDbTargetKey::KeyPrefix();
+
+  out->write(kMagic, MagicSize());
+  WriteVarint(out, kCacheSnapshotFormatVersion);
+  WriteVarint(out, static_cast<uint64_t>(schema_version));
+
+  Stats stats;
+  std::string buffer;
+  for (const std::string& prefix : SnapshotTablePrefixes()) {
+    bool documents = prefix == documents_prefix;
+    for (it->Seek(prefix); it->Valid(); it->Next()) {
+      absl::string_view key = MakeStringView(it->key());
+      if (!absl::StartsWith(key, prefix)) break;
+
+      absl::string_view value = MakeStringView(it->value());
+      if (documents) {
+        value = compressor.Decode(value, &buffer);
+        stats.documents++;
+      } else if (prefix == targets_prefix) {
+        stats.targets++;
+      }
+
+      WriteField(out, key);
+      WriteField(out, value);
+      stats.rows++;
+      stats.bytes += LevelDbTableSizes::RowSize(key, value);
+    }
+  }
+  Status status = ConvertStatus(it->status());
+  if (!status.ok()) return status;
+
+  WriteVarint(out, 0);
+  WriteVarint(out, static_cast<uint64_t>(stats.rows));
+  if (!out->good()) {
+    return Status{FirestoreErrorCode::Internal,
+                  "Failed to write cache snapshot"};
+  }
+  return stats;
+}
+
+StatusOr<Stats> LevelDbCacheSnapshot::Import(DB* db,
+                                             std::istream* in,
+                                             int max_batch_rows) {
+  HARD_ASSERT(max_batch_rows > 0, "max_batch_rows must be positive");
+
+  LevelDbMigrations::RunMigrations(db);
+
+  std::string magic;
+  uint64_t format_version = 0;
+  uint64_t schema_version = 0;
+  if (!ReadField(in, MagicSize(), &magic) ||
+      std::memcmp(magic.data(), kMagic, MagicSize()) != 0 ||
+      !ReadVarint(in, &format_version) || !ReadVarint(in, &schema_version)) {
+    return CorruptSnapshot("not a cache snapshot");
+  }
+  if (format_version != kCacheSnapshotFormatVersion) {
+    return Status{FirestoreErrorCode::FailedPrecondition,
+                  StringFormat("Unsupported cache snapshot format version %s",
+                               format_version)};
+  }
+  LevelDbMigrations::SchemaVersion db_version =
+      LevelDbMigrations::ReadSchemaVersion(db);
+  if (schema_version != static_cast<uint64_t>(db_version)) {
+    return Status{
+        FirestoreErrorCode::FailedPrecondition,
+        StringFormat("Cache snapshot has schema version %s, expected %s",
+                     schema_version, db_version)};
+  }
+
+  SnapshotImporter importer{db, max_batch_rows};
+  Status status = importer.CheckEmpty();
+  if (!status.ok()) return status;
+
+  status = importer.ImportRows(in);
+  if (!status.ok()) {
+    importer.RollBack();
+    return status;
+  }
+  return importer.stats();
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
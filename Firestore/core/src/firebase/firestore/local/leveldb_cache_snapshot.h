@@ -0,0 +1,109 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_CACHE_SNAPSHOT_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_CACHE_SNAPSHOT_H_
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+
+#include "Firestore/core/src/firebase/firestore/util/statusor.h"
+#include "leveldb/db.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** What a cache snapshot export or import covered. */
+struct LevelDbCacheSnapshotStats {
+  /** The number of rows written or read, of every table. */
+  int64_t rows = 0;
+
+  /** The number of remote documents among those rows. */
+  int64_t documents = 0;
+
+  /** The number of targets among those rows. */
+  int64_t targets = 0;
+
+  /** The number of bytes the rows count, as in LevelDbTableSizes. */
+  int64_t bytes = 0;
+};
+
+/**
+ * Exports the remote document cache and the query cache to a stream, and
+ * imports them into another database, for example to seed a new installation
+ * with a prebuilt cache.
+ *
+ * A snapshot starts with a header of
+ *
+ *   kMagic, the format version and the schema version of the database
+ *
+ * (the versions as varints), followed by one record per row, in key order:
+ *
+ *   varint key size, key, varint value size, value
+ *
+ * and ends with a zero key size followed by the number of rows as a varint.
+ * Rows are those of the remote document, remote document change, target,
+ * target resume, query target, target document block, document target and
+ * sequence number tables, plus the target global row, so remote documents are
+ * firestore_client.MaybeDocument protos and targets and their resume entries
+ * are firestore_client.Target protos. Remote documents are always
+ * exported uncompressed, so a snapshot does not depend on the compression
+ * dictionaries of the database it came from. The change log comes along so
+ * that cursors into it stay valid in the database a snapshot is loaded into.
+ *
+ * Importing streams the rows straight into write batches, skipping the
+ * per-row bookkeeping of LevelDbTransaction, so loading a snapshot costs about
+ * as much as writing its bytes.
+ */
+class LevelDbCacheSnapshot {
+ public:
+  /** The bytes every snapshot starts with. */
+  static const char kMagic[];
+
+  /**
+   * Writes a snapshot of the given database to `out`. The rows come from a
+   * single leveldb snapshot, so writes that happen meanwhile aren't partially
+   * included.
+   */
+  static util::StatusOr<LevelDbCacheSnapshotStats> Export(leveldb::DB* db,
+                                                          std::ostream* out);
+
+  /**
+   * Loads a snapshot written by Export() into the given database, which is
+   * first brought up to the current schema version.
+   *
+   * Fails with FailedPrecondition if the snapshot comes from a different
+   * schema version or if the database already holds any rows of the tables a
+   * snapshot contains, other than the target global row, which is replaced.
+   * Fails with DataLoss if the snapshot is malformed, in which case the rows
+   * imported so far are deleted again.
+   *
+   * Must be called before the database is opened for use, since an open
+   * FSTLevelDB would not see the imported rows.
+   *
+   * @param max_batch_rows The number of rows each write batch holds.
+   */
+  static util::StatusOr<LevelDbCacheSnapshotStats> Import(
+      leveldb::DB* db, std::istream* in, int max_batch_rows = 1000);
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_CACHE_SNAPSHOT_H_
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_group_commit.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/log.h"
+#include "absl/memory/memory.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+LevelDbGroupCommit::LevelDbGroupCommit(leveldb::DB* db,
+                                       LevelDbGroupCommitParams params)
+    : db_(db), params_(params) {
+}
+
+LevelDbTransaction* LevelDbGroupCommit::Begin(absl::string_view label) {
+  HARD_ASSERT(!in_transaction_,
+              "Starting a transaction while one is already outstanding");
+  in_transaction_ = true;
+
+  if (!transaction_) {
+    transaction_ = absl::make_unique<LevelDbTransaction>(db_, label);
+    transaction_->set_table_sizes(table_sizes_);
+    group_started_ = Clock::now();
+  }
+  return transaction_.get();
+}
+
+bool LevelDbGroupCommit::Commit() {
+  HARD_ASSERT(in_transaction_, "Committing a transaction before one is started");
+  in_transaction_ = false;
+
+  if (pending_transactions_ == 0) {
+    first_commit_ = Clock::now();
+  }
+  pending_transactions_++;
+  stats_.logical_commits++;
+
+  if (ShouldWrite()) {
+    Write();
+    return true;
+  }
+
+  // This commit opened a new group: make sure it doesn't wait indefinitely for
+  // a subsequent transaction to write it out.
+  if (pending_transactions_ == 1 && flush_scheduler_) {
+    flush_scheduler_(params_.max_delay);
+  }
+  return false;
+}
+
+void LevelDbGroupCommit::Flush() {
+  HARD_ASSERT(!in_transaction_, "Flushing while a transaction is outstanding");
+  if (transaction_) {
+    Write();
+  }
+}
+
+LevelDbTransaction* LevelDbGroupCommit::current() const {
+  HARD_ASSERT(in_transaction_,
+              "Attempting to access transaction before one has started");
+  return transaction_.get();
+}
+
+void LevelDbGroupCommit::set_params(LevelDbGroupCommitParams params) {
+  Flush();
+  params_ = params;
+}
+
+bool LevelDbGroupCommit::ShouldWrite() const {
+  if (pending_transactions_ >= params_.max_transactions) return true;
+  if (transaction_->changed_keys() >= params_.max_changed_keys) return true;
+  return Clock::now() - group_started_ >= params_.max_delay;
+}
+
+void LevelDbGroupCommit::Write() {
+  size_t changed_keys = transaction_->changed_keys();
+  transaction_->Commit();
+  transaction_.reset();
+
+  auto latency =
+      std::chrono::duration_cast<Milliseconds>(Clock::now() - first_commit_);
+  stats_.physical_commits++;
+  stats_.keys_written += changed_keys;
+  stats_.max_batch_size = std::max(stats_.max_batch_size, pending_transactions_);
+  stats_.total_latency += latency;
+  stats_.max_latency = std::max(stats_.max_latency, latency);
+
+  if (pending_transactions_ > 1) {
+    LOG_DEBUG("Group committed %s transactions (%s changes) after %sms",
+              pending_transactions_, changed_keys, latency.count());
+  }
+  pending_transactions_ = 0;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
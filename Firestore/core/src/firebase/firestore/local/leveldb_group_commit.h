@@ -0,0 +1,217 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_GROUP_COMMIT_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_GROUP_COMMIT_H_
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "absl/strings/string_view.h"
+#include "leveldb/db.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * Controls how many logical transactions LevelDbGroupCommit may merge into a
+ * single leveldb write.
+ */
+struct LevelDbGroupCommitParams {
+  using Milliseconds = std::chrono::milliseconds;
+
+  /** Every logical transaction is written as soon as it commits. */
+  static LevelDbGroupCommitParams Disabled() {
+    return LevelDbGroupCommitParams{1, 0, Milliseconds(0)};
+  }
+
+  static LevelDbGroupCommitParams Default() {
+    return LevelDbGroupCommitParams{32, 10000, Milliseconds(10)};
+  }
+
+  bool enabled() const {
+    return max_transactions > 1;
+  }
+
+  /** The maximum number of logical transactions merged into one write. */
+  int max_transactions;
+
+  /**
+   * The number of pending puts and deletes after which a group is written
+   * regardless of how many transactions it contains.
+   */
+  size_t max_changed_keys;
+
+  /**
+   * The maximum time a logical transaction may wait, after it committed, before
+   * its changes are written to leveldb.
+   */
+  Milliseconds max_delay;
+};
+
+/** Counters describing the writes performed by a LevelDbGroupCommit. */
+struct LevelDbGroupCommitStats {
+  using Milliseconds = std::chrono::milliseconds;
+
+  /** Returns the mean number of logical transactions per leveldb write. */
+  double average_batch_size() const {
+    return physical_commits == 0
+               ? 0
+               : static_cast<double>(logical_commits) / physical_commits;
+  }
+
+  /** The number of leveldb writes performed. */
+  int64_t physical_commits = 0;
+
+  /** The number of logical transactions committed. */
+  int64_t logical_commits = 0;
+
+  /** The total number of puts and deletes written. */
+  int64_t keys_written = 0;
+
+  /** The largest number of logical transactions merged into one write. */
+  int max_batch_size = 0;
+
+  /**
+   * The total and maximum time between the first logical commit in a group and
+   * the leveldb write that made it durable.
+   */
+  Milliseconds total_latency{0};
+  Milliseconds max_latency{0};
+};
+
+/**
+ * Merges consecutive logical transactions into a single LevelDbTransaction so
+ * that bursts of small writes pay for one leveldb write and log append.
+ *
+ * Logical transactions are still strictly serialized: each one sees all
+ * changes made by its predecessors, whether or not they have been written yet,
+ * because they all share the same underlying LevelDbTransaction. A group is
+ * written once it holds `max_transactions` transactions or `max_changed_keys`
+ * changes, once `max_delay` has elapsed since it was opened, or when `Flush()`
+ * is called.
+ *
+ * Changes in a pending group are only held in memory, so they are lost if the
+ * process dies before the group is written. With the default
+ * LevelDbGroupCommitParams::Disabled(), every commit is written immediately.
+ */
+class LevelDbGroupCommit {
+ public:
+  using Clock = std::chrono::steady_clock;
+  using Milliseconds = std::chrono::milliseconds;
+
+  /**
+   * Callback invoked when a logical commit is deferred into a newly opened
+   * group. Implementations should arrange for `Flush()` to be called after the
+   * given delay, e.g. by scheduling it on the AsyncQueue.
+   */
+  using FlushScheduler = std::function<void(Milliseconds)>;
+
+  LevelDbGroupCommit(leveldb::DB* db, LevelDbGroupCommitParams params);
+
+  LevelDbGroupCommit(const LevelDbGroupCommit& other) = delete;
+
+  LevelDbGroupCommit& operator=(const LevelDbGroupCommit& other) = delete;
+
+  /**
+   * Starts a logical transaction and returns the LevelDbTransaction against
+   * which its changes should be made. If a group is pending, its transaction
+   * is reused.
+   */
+  LevelDbTransaction* Begin(absl::string_view label);
+
+  /**
+   * Commits the current logical transaction. Its changes are written
+   * immediately if the group is full or too old, and deferred otherwise.
+   *
+   * @return true if the changes were written to leveldb.
+   */
+  bool Commit();
+
+  /**
+   * Writes any pending group to leveldb. Must not be called while a logical
+   * transaction is in progress.
+   */
+  void Flush();
+
+  /** Returns the transaction of the logical transaction in progress. */
+  LevelDbTransaction* current() const;
+
+  bool in_transaction() const {
+    return in_transaction_;
+  }
+
+  /** Returns true if committed changes are waiting to be written. */
+  bool has_pending_writes() const {
+    return !in_transaction_ && transaction_ != nullptr;
+  }
+
+  const LevelDbGroupCommitParams& params() const {
+    return params_;
+  }
+
+  /**
+   * Changes the grouping parameters. Any pending group is written first.
+   */
+  void set_params(LevelDbGroupCommitParams params);
+
+  /**
+   * Sets the in-memory table sizes that transactions begun from now on adjust
+   * as they commit. See LevelDbTransaction::set_table_sizes().
+   */
+  void set_table_sizes(LevelDbTableSizes* table_sizes) {
+    table_sizes_ = table_sizes;
+  }
+
+  void set_flush_scheduler(FlushScheduler scheduler) {
+    flush_scheduler_ = std::move(scheduler);
+  }
+
+  const LevelDbGroupCommitStats& stats() const {
+    return stats_;
+  }
+
+ private:
+  bool ShouldWrite() const;
+  void Write();
+
+  leveldb::DB* db_;
+  LevelDbGroupCommitParams params_;
+  FlushScheduler flush_scheduler_;
+  LevelDbTableSizes* table_sizes_ = nullptr;
+
+  std::unique_ptr<LevelDbTransaction> transaction_;
+  bool in_transaction_ = false;
+
+  // The number of logical transactions committed into transaction_.
+  int pending_transactions_ = 0;
+  // When the first logical transaction in the group started and committed.
+  Clock::time_point group_started_;
+  Clock::time_point first_commit_;
+
+  LevelDbGroupCommitStats stats_;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_GROUP_COMMIT_H_
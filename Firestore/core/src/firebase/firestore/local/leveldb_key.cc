@@ -41,10 +41,18 @@ const char* kDocumentMutationsTable = "document_mutation";
 const char* kMutationQueuesTable = "mutation_queue";
 const char* kTargetGlobalTable = "target_global";
 const char* kTargetsTable = "target";
+const char* kTargetResumesTable = "target_resume";
 const char* kQueryTargetsTable = "query_target";
 const char* kTargetDocumentsTable = "target_document";
 const char* kDocumentTargetsTable = "document_target";
 const char* kRemoteDocumentsTable = "remote_document";
+const char* kRemoteDocumentDictionariesTable = "remote_document_dictionary";
+const char* kRemoteDocumentChangesTable = "remote_document_change";
+const char* kSequenceNumbersTable = "sequence_number";
+const char* kLruGcProgressTable = "lru_gc_progress";
+const char* kTableSizesTable = "table_sizes";
+const char* kMigrationProgressTable = "migration_progress";
+const char* kTargetDocumentBlocksTable = "target_document_block";
 
 /**
  * Labels for the components of keys. These serve to make keys self-describing.
@@ -89,6 +97,15 @@ enum ComponentLabel {
   /** A component containing a user Id. */
   UserId = 13,
 
+  /** A component containing the Id of a compression dictionary. */
+  DictionaryId = 14,
+
+  /** A component containing a listen sequence number. */
+  SequenceNumber = 15,
+
+  /** A component containing the Id of a change in the remote documents. */
+  ChangeId = 16,
+
   /**
    * A path segment describes just a single segment in a resource path. Path
    * segments that occur sequentially in a key represent successive segments in
@@ -136,6 +153,10 @@ class Reader {
    */
   std::string Describe();
 
+  std::string ReadTableName() {
+    return ReadLabeledString(ComponentLabel::TableName);
+  }
+
   void ReadTableNameMatching(const char* expected_table_name) {
     if (!ReadLabeledStringMatching(ComponentLabel::TableName,
                                    expected_table_name)) {
@@ -159,6 +180,31 @@ class Reader {
     return ReadLabeledString(ComponentLabel::UserId);
   }
 
+  int32_t ReadDictionaryId() {
+    return ReadLabeledInt32(ComponentLabel::DictionaryId);
+  }
+
+  model::ListenSequenceNumber ReadSequenceNumber() {
+    return ReadLabeledInt64(ComponentLabel::SequenceNumber);
+  }
+
+  int64_t ReadChangeId() {
+    return ReadLabeledInt64(ComponentLabel::ChangeId);
+  }
+
+  /**
+   * Returns the label of the next component without consuming it, or
+   * ComponentLabel::Unknown if there is none.
+   */
+  ComponentLabel PeekComponentLabel() {
+    leveldb::Slice saved_position = src_;
+    bool saved_ok = ok_;
+    ComponentLabel label = ReadComponentLabel();
+    src_ = saved_position;
+    ok_ = saved_ok;
+    return label;
+  }
+
   /**
    * Reads component labels and strings from the key until it finds a component
    * label other than ComponentLabel::PathSegment (or the key is exhausted).
@@ -304,6 +350,23 @@ class Reader {
     return ReadInt32();
   }
 
+  /**
+   * Reads a component label and signed number from the key and verifies that
+   * the label matches the expected_label.
+   *
+   * If the read is unsuccessful or the label didn't match, returns 0 and fails
+   * the Reader.
+   *
+   * Otherwise, returns the number and advances the Reader to the next unread
+   * byte.
+   */
+  int64_t ReadLabeledInt64(ComponentLabel expected_label) {
+    if (!ReadComponentLabelMatching(expected_label)) {
+      Fail();
+    }
+    return ReadSignedNumIncreasing();
+  }
+
   /**
    * Reads a component label and a string from the key verifies that the label
    * matches the expected_label.
@@ -455,6 +518,24 @@ std::string Reader::Describe() {
         absl::StrAppend(&description, " user_id=", user_id);
       }
 
+    } else if (label == ComponentLabel::DictionaryId) {
+      int32_t dictionary_id = ReadDictionaryId();
+      if (ok_) {
+        absl::StrAppend(&description, " dictionary_id=", dictionary_id);
+      }
+
+    } else if (label == ComponentLabel::SequenceNumber) {
+      model::ListenSequenceNumber sequence_number = ReadSequenceNumber();
+      if (ok_) {
+        absl::StrAppend(&description, " sequence_number=", sequence_number);
+      }
+
+    } else if (label == ComponentLabel::ChangeId) {
+      int64_t change_id = ReadChangeId();
+      if (ok_) {
+        absl::StrAppend(&description, " change_id=", change_id);
+      }
+
     } else {
       absl::StrAppend(&description, " unknown label=", static_cast<int>(label));
       Fail();
@@ -502,6 +583,18 @@ class Writer {
     WriteLabeledString(ComponentLabel::UserId, user_id);
   }
 
+  void WriteDictionaryId(int32_t dictionary_id) {
+    WriteLabeledInt32(ComponentLabel::DictionaryId, dictionary_id);
+  }
+
+  void WriteSequenceNumber(model::ListenSequenceNumber sequence_number) {
+    WriteLabeledInt64(ComponentLabel::SequenceNumber, sequence_number);
+  }
+
+  void WriteChangeId(int64_t change_id) {
+    WriteLabeledInt64(ComponentLabel::ChangeId, change_id);
+  }
+
   /**
    * For each segment in the given resource path writes a
    * ComponentLabel::PathSegment component label and a string containing the
@@ -528,6 +621,15 @@ class Writer {
     OrderedCode::WriteSignedNumIncreasing(&dest_, value);
   }
 
+  /**
+   * Writes a component label and a 64-bit signed integer to the given key
+   * destination.
+   */
+  void WriteLabeledInt64(ComponentLabel label, int64_t value) {
+    WriteComponentLabel(label);
+    OrderedCode::WriteSignedNumIncreasing(&dest_, value);
+  }
+
   /**
    * Writes a component label and an encoded string to the given key
    * destination.
@@ -559,6 +661,12 @@ std::string DescribeKey(const char* key) {
   return DescribeKey(leveldb::Slice{key});
 }
 
+std::string ExtractTableName(absl::string_view key) {
+  Reader reader{key};
+  std::string table_name = reader.ReadTableName();
+  return reader.ok() ? table_name : "";
+}
+
 std::string LevelDbVersionKey::Key() {
   Writer writer;
   writer.WriteTableName(kVersionGlobalTable);
@@ -700,6 +808,28 @@ bool LevelDbTargetKey::Decode(leveldb::Slice key) {
   return reader.ok();
 }
 
+std::string LevelDbTargetResumeKey::KeyPrefix() {
+  Writer writer;
+  writer.WriteTableName(kTargetResumesTable);
+  return writer.result();
+}
+
+std::string LevelDbTargetResumeKey::Key(model::TargetId target_id) {
+  Writer writer;
+  writer.WriteTableName(kTargetResumesTable);
+  writer.WriteTargetId(target_id);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbTargetResumeKey::Decode(leveldb::Slice key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kTargetResumesTable);
+  target_id_ = reader.ReadTargetId();
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
 std::string LevelDbQueryTargetKey::KeyPrefix() {
   Writer writer;
   writer.WriteTableName(kQueryTargetsTable);
@@ -764,6 +894,39 @@ bool LevelDbTargetDocumentKey::Decode(absl::string_view key) {
   return reader.ok();
 }
 
+std::string LevelDbTargetDocumentBlockKey::KeyPrefix() {
+  Writer writer;
+  writer.WriteTableName(kTargetDocumentBlocksTable);
+  return writer.result();
+}
+
+std::string LevelDbTargetDocumentBlockKey::KeyPrefix(
+    model::TargetId target_id) {
+  Writer writer;
+  writer.WriteTableName(kTargetDocumentBlocksTable);
+  writer.WriteTargetId(target_id);
+  return writer.result();
+}
+
+std::string LevelDbTargetDocumentBlockKey::Key(
+    model::TargetId target_id, const DocumentKey& first_document_key) {
+  Writer writer;
+  writer.WriteTableName(kTargetDocumentBlocksTable);
+  writer.WriteTargetId(target_id);
+  writer.WriteResourcePath(first_document_key.path());
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbTargetDocumentBlockKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kTargetDocumentBlocksTable);
+  target_id_ = reader.ReadTargetId();
+  first_document_key_ = reader.ReadDocumentKey();
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
 std::string LevelDbDocumentTargetKey::KeyPrefix() {
   Writer writer;
   writer.WriteTableName(kDocumentTargetsTable);
@@ -848,6 +1011,152 @@ bool LevelDbRemoteDocumentKey::Decode(absl::string_view key) {
   return reader.ok();
 }
 
+std::string LevelDbRemoteDocumentDictionaryKey::KeyPrefix() {
+  Writer writer;
+  writer.WriteTableName(kRemoteDocumentDictionariesTable);
+  return writer.result();
+}
+
+std::string LevelDbRemoteDocumentDictionaryKey::Key(int32_t dictionary_id) {
+  Writer writer;
+  writer.WriteTableName(kRemoteDocumentDictionariesTable);
+  writer.WriteDictionaryId(dictionary_id);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbRemoteDocumentDictionaryKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kRemoteDocumentDictionariesTable);
+  dictionary_id_ = reader.ReadDictionaryId();
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
+std::string LevelDbRemoteDocumentChangeKey::KeyPrefix() {
+  Writer writer;
+  writer.WriteTableName(kRemoteDocumentChangesTable);
+  return writer.result();
+}
+
+std::string LevelDbRemoteDocumentChangeKey::KeyPrefix(int64_t change_id) {
+  Writer writer;
+  writer.WriteTableName(kRemoteDocumentChangesTable);
+  writer.WriteChangeId(change_id);
+  return writer.result();
+}
+
+std::string LevelDbRemoteDocumentChangeKey::Key(
+    int64_t change_id, const DocumentKey& document_key) {
+  Writer writer;
+  writer.WriteTableName(kRemoteDocumentChangesTable);
+  writer.WriteChangeId(change_id);
+  writer.WriteResourcePath(document_key.path());
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbRemoteDocumentChangeKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kRemoteDocumentChangesTable);
+  change_id_ = reader.ReadChangeId();
+  document_key_ = reader.ReadDocumentKey();
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
+std::string LevelDbSequenceNumberKey::KeyPrefix() {
+  Writer writer;
+  writer.WriteTableName(kSequenceNumbersTable);
+  return writer.result();
+}
+
+std::string LevelDbSequenceNumberKey::KeyPrefix(
+    model::ListenSequenceNumber sequence_number) {
+  Writer writer;
+  writer.WriteTableName(kSequenceNumbersTable);
+  writer.WriteSequenceNumber(sequence_number);
+  return writer.result();
+}
+
+std::string LevelDbSequenceNumberKey::Key(
+    model::ListenSequenceNumber sequence_number, model::TargetId target_id) {
+  Writer writer;
+  writer.WriteTableName(kSequenceNumbersTable);
+  writer.WriteSequenceNumber(sequence_number);
+  writer.WriteTargetId(target_id);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+std::string LevelDbSequenceNumberKey::Key(
+    model::ListenSequenceNumber sequence_number,
+    const DocumentKey& document_key) {
+  Writer writer;
+  writer.WriteTableName(kSequenceNumbersTable);
+  writer.WriteSequenceNumber(sequence_number);
+  writer.WriteResourcePath(document_key.path());
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbSequenceNumberKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kSequenceNumbersTable);
+  sequence_number_ = reader.ReadSequenceNumber();
+  if (reader.PeekComponentLabel() == ComponentLabel::TargetId) {
+    target_id_ = reader.ReadTargetId();
+    document_key_ = DocumentKey{};
+  } else {
+    target_id_ = 0;
+    document_key_ = reader.ReadDocumentKey();
+  }
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
+std::string LevelDbLruGcProgressKey::Key() {
+  Writer writer;
+  writer.WriteTableName(kLruGcProgressTable);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbLruGcProgressKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kLruGcProgressTable);
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
+std::string LevelDbTableSizesKey::Key() {
+  Writer writer;
+  writer.WriteTableName(kTableSizesTable);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbTableSizesKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kTableSizesTable);
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
+std::string LevelDbMigrationProgressKey::Key() {
+  Writer writer;
+  writer.WriteTableName(kMigrationProgressTable);
+  writer.WriteTerminator();
+  return writer.result();
+}
+
+bool LevelDbMigrationProgressKey::Decode(absl::string_view key) {
+  Reader reader{key};
+  reader.ReadTableNameMatching(kMigrationProgressTable);
+  reader.ReadTerminator();
+  return reader.ok();
+}
+
 }  // namespace local
 }  // namespace firestore
 }  // namespace firebase
@@ -56,6 +56,10 @@ namespace local {
 //   - table_name: string = "target"
 //   - target_id: model::TargetId
 //
+// target_resumes:
+//   - table_name: string = "target_resume"
+//   - target_id: model::TargetId
+//
 // target_globals:
 //   - table_name: string = "target_global"
 //
@@ -77,6 +81,29 @@ namespace local {
 // remote_documents:
 //   - table_name: string = "remote_document"
 //   - path: ResourcePath
+//
+// remote_document_dictionaries:
+//   - table_name: string = "remote_document_dictionary"
+//   - dictionary_id: int32_t
+//
+// remote_document_changes:
+//   - table_name: string = "remote_document_change"
+//   - change_id: int64_t
+//   - path: ResourcePath
+//
+// sequence_numbers:
+//   - table_name: string = "sequence_number"
+//   - sequence_number: model::ListenSequenceNumber
+//   - either target_id: model::TargetId or path: ResourcePath
+//
+// lru_gc_progress:
+//   - table_name: string = "lru_gc_progress"
+//
+// table_sizes:
+//   - table_name: string = "table_sizes"
+//
+// migration_progress:
+//   - table_name: string = "migration_progress"
 
 /**
  * Parses the given key and returns a human readable description of its
@@ -87,6 +114,12 @@ std::string DescribeKey(absl::string_view key);
 std::string DescribeKey(const std::string& key);
 std::string DescribeKey(const char* key);
 
+/**
+ * Returns the name of the table the given key belongs to, or an empty string
+ * if the key doesn't start with a table name.
+ */
+std::string ExtractTableName(absl::string_view key);
+
 /** A key to a singleton row storing the version of the schema. */
 class LevelDbVersionKey {
  public:
@@ -296,6 +329,48 @@ class LevelDbTargetKey {
   model::TargetId target_id_ = 0;
 };
 
+/**
+ * A key in the target resumes table, which holds the latest resume token and
+ * snapshot version received for each target. Recording them here avoids
+ * re-encoding the whole target, query included, every time watch advances it.
+ *
+ * Since schema version 9, rows in the targets table are written without a
+ * resume token or snapshot version. Older clients keep each target's documents
+ * in the target documents table instead of in blocks, so after a downgrade
+ * they must fetch targets afresh rather than resume them.
+ *
+ * The value of each row is a serialized `firestore_client_Target` with only
+ * the target ID, snapshot version and resume token set.
+ */
+class LevelDbTargetResumeKey {
+ public:
+  /**
+   * Creates a key prefix that points just before the first key in the table.
+   */
+  static std::string KeyPrefix();
+
+  /** Creates a complete key that points to the entry for the given target. */
+  static std::string Key(model::TargetId target_id);
+
+  /**
+   * Decodes the contents of a target resume key, storing the decoded values in
+   * this instance.
+   *
+   * @return true if the key successfully decoded, false otherwise. If false is
+   * returned, this instance is in an undefined state until the next call to
+   * `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(leveldb::Slice key);
+
+  model::TargetId target_id() const {
+    return target_id_;
+  }
+
+ private:
+  model::TargetId target_id_ = 0;
+};
+
 /**
  * A key in the query targets table, an index of canonical_ids to the targets
  * they may match. This is not a unique mapping because canonical_id does not
@@ -395,6 +470,57 @@ class LevelDbTargetDocumentKey {
   model::DocumentKey document_key_;
 };
 
+/**
+ * A key in the target document blocks table, which stores the documents in
+ * each target as a sequence of blocks. Each block is keyed by its target_id
+ * and the first document it holds, so the blocks for a target sort in document
+ * order.
+ */
+class LevelDbTargetDocumentBlockKey {
+ public:
+  /**
+   * Creates a key that contains just the target document blocks table prefix
+   * and points just before the first key.
+   */
+  static std::string KeyPrefix();
+
+  /** Creates a key that points to the first block for a target_id. */
+  static std::string KeyPrefix(model::TargetId target_id);
+
+  /**
+   * Creates a key that points to the block for a target_id that starts with
+   * the given document.
+   */
+  static std::string Key(model::TargetId target_id,
+                         const model::DocumentKey& first_document_key);
+
+  /**
+   * Decodes the contents of a target document block key, storing the decoded
+   * values in this instance.
+   *
+   * @return true if the key successfully decoded, false otherwise. If false is
+   * returned, this instance is in an undefined state until the next call to
+   * `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+
+  /** The target_id identifying a target. */
+  model::TargetId target_id() {
+    return target_id_;
+  }
+
+  /** The first document in the block, as encoded in the key. */
+  const model::DocumentKey& first_document_key() {
+    return first_document_key_;
+  }
+
+ private:
+  // Deliberately uninitialized: will be assigned in Decode
+  model::TargetId target_id_;
+  model::DocumentKey first_document_key_;
+};
+
 /**
  * A key in the document targets table, an index from documents to the targets
  * that contain them.
@@ -520,6 +646,215 @@ class LevelDbRemoteDocumentKey {
   model::DocumentKey document_key_;
 };
 
+/**
+ * A key in the remote document dictionaries table, which stores the
+ * dictionaries used to compress values in the remote documents table. The
+ * value of each row is the raw dictionary.
+ */
+class LevelDbRemoteDocumentDictionaryKey {
+ public:
+  /**
+   * Creates a key prefix that points just before the first key in the table.
+   */
+  static std::string KeyPrefix();
+
+  /** Creates a complete key that points to the dictionary with the given id. */
+  static std::string Key(int32_t dictionary_id);
+
+  /**
+   * Decodes the contents of a remote document dictionary key, storing the
+   * decoded values in this instance.
+   *
+   * @return true if the key successfully decoded, false otherwise. If false is
+   * returned, this instance is in an undefined state until the next call to
+   * `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+
+  int32_t dictionary_id() const {
+    return dictionary_id_;
+  }
+
+ private:
+  int32_t dictionary_id_ = 0;
+};
+
+/**
+ * A key in the remote document changes table, a log of the keys of the
+ * documents added to or removed from the remote documents table. Each change
+ * gets the next change ID, so rows are ordered by when they were written, and
+ * the documents changed after a given point are found with a single scan.
+ *
+ * The value of each row is empty.
+ */
+class LevelDbRemoteDocumentChangeKey {
+ public:
+  /**
+   * Creates a key prefix that points just before the first key in the table.
+   */
+  static std::string KeyPrefix();
+
+  /**
+   * Creates a key prefix that points just before the first change with the
+   * given ID.
+   */
+  static std::string KeyPrefix(int64_t change_id);
+
+  /** Creates a complete key that points to a change to the given document. */
+  static std::string Key(int64_t change_id,
+                         const model::DocumentKey& document_key);
+
+  /**
+   * Decodes the contents of a remote document change key, storing the decoded
+   * values in this instance.
+   *
+   * @return true if the key successfully decoded, false otherwise. If false is
+   * returned, this instance is in an undefined state until the next call to
+   * `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+
+  int64_t change_id() const {
+    return change_id_;
+  }
+
+  /** The key of the document that changed. */
+  const model::DocumentKey& document_key() const {
+    return document_key_;
+  }
+
+ private:
+  int64_t change_id_ = 0;
+  model::DocumentKey document_key_;
+};
+
+/**
+ * A key in the sequence numbers table, an index of targets and document
+ * sentinel rows ordered by the sequence number at which they were last used.
+ * This allows garbage collection to visit the least recently used entries
+ * first without scanning the targets and document targets tables.
+ *
+ * Each target has one row, as does each document with a sentinel row in the
+ * document targets table. The value of each row is empty.
+ *
+ * A document's row moves along with its sentinel row: writing the sentinel
+ * removes the row for its previous sequence number in the same transaction.
+ * A document row is only current if the sentinel still holds its sequence
+ * number, so garbage collection skips and removes any row that doesn't.
+ */
+class LevelDbSequenceNumberKey {
+ public:
+  /**
+   * Creates a key that contains just the sequence numbers table prefix and
+   * points just before the first key.
+   */
+  static std::string KeyPrefix();
+
+  /**
+   * Creates a key prefix that points just before the first entry with the
+   * given sequence number.
+   */
+  static std::string KeyPrefix(model::ListenSequenceNumber sequence_number);
+
+  /** Creates a key that points to the entry for a target. */
+  static std::string Key(model::ListenSequenceNumber sequence_number,
+                         model::TargetId target_id);
+
+  /** Creates a key that points to the entry for a document sentinel row. */
+  static std::string Key(model::ListenSequenceNumber sequence_number,
+                         const model::DocumentKey& document_key);
+
+  /**
+   * Decodes the contents of a sequence number key, storing the decoded values
+   * in this instance.
+   *
+   * @return true if the key successfully decoded, false otherwise. If false is
+   * returned, this instance is in an undefined state until the next call to
+   * `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+
+  model::ListenSequenceNumber sequence_number() const {
+    return sequence_number_;
+  }
+
+  /** Returns true if this entry is for a target rather than a document. */
+  bool IsTarget() const {
+    return target_id_ != 0;
+  }
+
+  /** The target_id of a target entry, or 0 for a document entry. */
+  model::TargetId target_id() const {
+    return target_id_;
+  }
+
+  /** The document key of a document entry. */
+  const model::DocumentKey& document_key() const {
+    return document_key_;
+  }
+
+ private:
+  model::ListenSequenceNumber sequence_number_ = 0;
+  model::TargetId target_id_ = 0;
+  model::DocumentKey document_key_;
+};
+
+/**
+ * A key in the LRU garbage collection progress table, which holds a single row
+ * recording how far an incremental garbage collection has got, so that it can
+ * resume after a restart.
+ */
+class LevelDbLruGcProgressKey {
+ public:
+  /** Creates a key that points to the single progress row. */
+  static std::string Key();
+
+  /**
+   * Decodes the contents of a progress key, essentially just verifying that
+   * the key has the correct table name.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+};
+
+/**
+ * A key to a singleton row holding the number of bytes stored in each table,
+ * which LevelDbTransaction keeps up to date as it commits.
+ */
+class LevelDbTableSizesKey {
+ public:
+  /** Creates a key that points to the single table sizes row. */
+  static std::string Key();
+
+  /**
+   * Decodes the contents of a table sizes key, essentially just verifying that
+   * the key has the correct table name.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+};
+
+/**
+ * A key to a singleton row recording how far the schema migration in progress
+ * has got, so that a migration interrupted by a restart resumes where it left
+ * off.
+ */
+class LevelDbMigrationProgressKey {
+ public:
+  /** Creates a key that points to the single progress row. */
+  static std::string Key();
+
+  /**
+   * Decodes the contents of a progress key, essentially just verifying that
+   * the key has the correct table name.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view key);
+};
+
 }  // namespace local
 }  // namespace firestore
 }  // namespace firebase
@@ -16,17 +16,25 @@
 
 #include "Firestore/core/src/firebase/firestore/local/leveldb_migrations.h"
 
+#include <functional>
 #include <string>
+#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "Firestore/Protos/nanopb/firestore/local/mutation.nanopb.h"
 #include "Firestore/Protos/nanopb/firestore/local/target.nanopb.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_range_delete.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 #include "Firestore/core/src/firebase/firestore/nanopb/reader.h"
 #include "Firestore/core/src/firebase/firestore/nanopb/writer.h"
-#include "absl/strings/match.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
 
 namespace firebase {
 namespace firestore {
@@ -38,6 +46,11 @@ using leveldb::Status;
 using leveldb::WriteOptions;
 using nanopb::Reader;
 using nanopb::Writer;
+using util::OrderedCode;
+
+using Progress = LevelDbMigrations::Progress;
+using ProgressCallback = LevelDbMigrations::ProgressCallback;
+using SchemaVersion = LevelDbMigrations::SchemaVersion;
 
 namespace {
 
@@ -60,8 +73,17 @@ namespace {
  *   * Migration 4 ensures that every document in the remote document cache
  *     has a sentinel row with a sequence number.
  *   * Migration 5 drops held write acks.
+ *   * Migration 6 allows values in the remote document cache to be compressed.
+ *   * Migration 7 indexes targets and sentinel rows by sequence number.
+ *   * Migration 8 adds up the size of each table, which transactions then keep
+ *     up to date.
+ *   * Migration 9 packs the target document rows into blocks of documents, and
+ *     moves resume tokens out of target rows so that older clients, which
+ *     can't read the blocks, fetch targets afresh after a downgrade.
  */
-const LevelDbMigrations::SchemaVersion kSchemaVersion = 5;
+const LevelDbMigrations::SchemaVersion kSchemaVersion = 9;
+
+const int64_t kProgressFormatVersion = 1;
 
 /**
  * Save the given version number as the current version of the schema of the
@@ -76,34 +98,183 @@ void SaveVersion(LevelDbMigrations::SchemaVersion version,
   transaction->Put(key, version_string);
 }
 
-void DeleteEverythingWithPrefix(const std::string& prefix, leveldb::DB* db) {
-  bool more_deletes = true;
-  while (more_deletes) {
-    LevelDbTransaction transaction(db, "Delete everything with prefix");
-    auto it = transaction.NewIterator();
-
-    more_deletes = false;
-    for (it->Seek(prefix); it->Valid() && absl::StartsWith(it->key(), prefix);
-         it->Next()) {
-      if (transaction.changed_keys() >= 1000) {
-        more_deletes = true;
-        break;
-      }
-      transaction.Delete(it->key());
+/**
+ * Called for each row a chunked migration visits, with the transaction of the
+ * chunk that contains it.
+ */
+using RowVisitor = std::function<void(LevelDbTransaction* transaction,
+                                      absl::string_view key,
+                                      absl::string_view value)>;
+
+/**
+ * Runs a single migration, committing its work in chunks and keeping its
+ * progress in the migration progress row in between.
+ */
+class ChunkedMigration {
+ public:
+  /**
+   * Loads the progress of the migration to `version` if it was interrupted,
+   * or starts it afresh otherwise.
+   */
+  ChunkedMigration(leveldb::DB* db,
+                   SchemaVersion version,
+                   const ProgressCallback& callback,
+                   int rows_per_chunk);
+
+  leveldb::DB* db() const {
+    return db_;
+  }
+
+  /** True if this migration committed some of its work before a restart. */
+  bool resumed() const {
+    return resumed_;
+  }
+
+  /** The state saved with the last chunk committed. */
+  const std::string& state() const {
+    return progress_.state;
+  }
+
+  /**
+   * Calls `visitor` for each row in [begin, limit) that comes after the
+   * cursor, or from `begin` onwards if `limit` is empty, committing a
+   * transaction after every `rows_per_chunk` rows. Ranges must be visited in
+   * increasing key order, so that the cursor of an interrupted migration marks
+   * the place to resume in all of them.
+   *
+   * @param save_state Returns the state to carry over to the next chunk; may be
+   *     empty.
+   */
+  void VisitRows(absl::string_view begin,
+                 absl::string_view limit,
+                 const RowVisitor& visitor,
+                 const std::function<std::string()>& save_state = {});
+
+  /**
+   * Deletes every row in [begin, limit) in bulk. The deletion isn't recorded in
+   * the progress row, so a resumed migration repeats it.
+   */
+  void DeleteRange(absl::string_view begin, absl::string_view limit);
+
+  void DeleteEverythingWithPrefix(absl::string_view prefix);
+
+  /**
+   * Saves the new schema version and clears the progress row as part of the
+   * given transaction, then commits it.
+   */
+  void Finish(LevelDbTransaction* transaction);
+
+ private:
+  void ReportProgress() {
+    if (callback_) callback_(progress_);
+  }
+
+  leveldb::DB* db_ = nullptr;
+  ProgressCallback callback_;
+  int rows_per_chunk_ = 0;
+  std::string label_;
+
+  Progress progress_;
+  bool resumed_ = false;
+};
+
+ChunkedMigration::ChunkedMigration(leveldb::DB* db,
+                                   SchemaVersion version,
+                                   const ProgressCallback& callback,
+                                   int rows_per_chunk)
+    : db_(db),
+      callback_(callback),
+      rows_per_chunk_(rows_per_chunk),
+      label_("Migrate to schema version " + std::to_string(version)) {
+  HARD_ASSERT(rows_per_chunk > 0, "rows_per_chunk must be positive");
+
+  LevelDbTransaction transaction(db, "Read migration progress");
+  std::string encoded;
+  Progress saved;
+  // Progress saved for another version was left behind by a migration that a
+  // downgrade interrupted, so it no longer applies.
+  if (transaction.Get(LevelDbMigrationProgressKey::Key(), &encoded).ok() &&
+      Progress::Decode(encoded, &saved) && saved.version == version) {
+    progress_ = std::move(saved);
+    resumed_ = true;
+  } else {
+    progress_.version = version;
+  }
+}
+
+void ChunkedMigration::VisitRows(
+    absl::string_view begin,
+    absl::string_view limit,
+    const RowVisitor& visitor,
+    const std::function<std::string()>& save_state) {
+  std::string start{begin};
+  bool after_start = false;
+  if (!progress_.cursor.empty() && progress_.cursor >= start) {
+    start = progress_.cursor;
+    after_start = true;
+  }
+
+  for (;;) {
+    LevelDbTransaction transaction(db_, label_);
+    auto it = transaction.NewIterator(begin, limit);
+    it->Seek(start);
+    if (after_start && it->Valid() && it->key() == start) {
+      it->Next();
+    }
+
+    int rows = 0;
+    for (; rows < rows_per_chunk_ && it->Valid(); it->Next()) {
+      visitor(&transaction, it->key(), it->value());
+      progress_.cursor = std::string{it->key()};
+      rows++;
     }
+    if (rows == 0) return;
 
+    progress_.rows_processed += rows;
+    if (save_state) {
+      progress_.state = save_state();
+    }
+    transaction.Put(LevelDbMigrationProgressKey::Key(), progress_.Encode());
     transaction.Commit();
+    ReportProgress();
+
+    start = progress_.cursor;
+    after_start = true;
   }
 }
 
+void ChunkedMigration::DeleteRange(absl::string_view begin,
+                                   absl::string_view limit) {
+  int64_t rows_before = progress_.rows_processed;
+  local::DeleteRange(
+      db_, begin, limit,
+      [&](const LevelDbRangeDeleteProgress& deleted) {
+        progress_.rows_processed = rows_before + deleted.rows_deleted;
+        ReportProgress();
+      },
+      rows_per_chunk_);
+}
+
+void ChunkedMigration::DeleteEverythingWithPrefix(absl::string_view prefix) {
+  DeleteRange(prefix, util::PrefixSuccessor(prefix));
+}
+
+void ChunkedMigration::Finish(LevelDbTransaction* transaction) {
+  SaveVersion(progress_.version, transaction);
+  transaction->Delete(LevelDbMigrationProgressKey::Key());
+  transaction->Commit();
+}
+
 /** Migration 3. */
-void ClearQueryCache(leveldb::DB* db) {
-  DeleteEverythingWithPrefix(LevelDbTargetKey::KeyPrefix(), db);
-  DeleteEverythingWithPrefix(LevelDbDocumentTargetKey::KeyPrefix(), db);
-  DeleteEverythingWithPrefix(LevelDbTargetDocumentKey::KeyPrefix(), db);
-  DeleteEverythingWithPrefix(LevelDbQueryTargetKey::KeyPrefix(), db);
+void ClearQueryCache(ChunkedMigration* migration) {
+  migration->DeleteEverythingWithPrefix(LevelDbTargetKey::KeyPrefix());
+  migration->DeleteEverythingWithPrefix(LevelDbDocumentTargetKey::KeyPrefix());
+  migration->DeleteEverythingWithPrefix(LevelDbTargetDocumentKey::KeyPrefix());
+  migration->DeleteEverythingWithPrefix(
+      LevelDbTargetDocumentBlockKey::KeyPrefix());
+  migration->DeleteEverythingWithPrefix(LevelDbQueryTargetKey::KeyPrefix());
 
-  LevelDbTransaction transaction(db, "Drop query cache");
+  LevelDbTransaction transaction(migration->db(), "Drop query cache");
 
   // Reset the target global entry too (to reset the target count).
   firestore_client_TargetGlobal target_global{};
@@ -114,74 +285,90 @@ void ClearQueryCache(leveldb::DB* db) {
                             &target_global);
   transaction.Put(LevelDbTargetGlobalKey::Key(), std::move(bytes));
 
-  SaveVersion(3, &transaction);
-  transaction.Commit();
+  migration->Finish(&transaction);
 }
 
 /**
- * Removes document associations for the given user's mutation queue for
- * any mutation with a `batch_id` less than or equal to
- * `last_acknowledged_batch_id`.
+ * Removes mutation batches for the given user with a `batch_id` less than
+ * or equal to `last_acknowledged_batch_id`. Batches sort by `batch_id` within
+ * each user, so these form a single range.
  */
-void RemoveMutationDocuments(LevelDbTransaction* transaction,
-                             absl::string_view user_id,
-                             int32_t last_acknowledged_batch_id) {
-  LevelDbDocumentMutationKey doc_key;
-  std::string prefix = LevelDbDocumentMutationKey::KeyPrefix(user_id);
-
-  auto it = transaction->NewIterator();
-  it->Seek(prefix);
-  for (; it->Valid() && absl::StartsWith(it->key(), prefix); it->Next()) {
-    HARD_ASSERT(doc_key.Decode(it->key()),
-                "Failed to decode document mutation key");
-    if (doc_key.batch_id() <= last_acknowledged_batch_id) {
-      transaction->Delete(it->key());
-    }
-  }
+void RemoveMutationBatches(ChunkedMigration* migration,
+                           absl::string_view user_id,
+                           int32_t last_acknowledged_batch_id) {
+  migration->DeleteRange(
+      LevelDbMutationKey::KeyPrefix(user_id),
+      LevelDbMutationKey::Key(user_id, last_acknowledged_batch_id + 1));
 }
 
 /**
- * Removes mutation batches for the given user with a `batch_id` less than
- * or equal to `last_acknowledged_batch_id`
+ * Migration 5.
+ *
+ * The acknowledged batches are deleted first, each user's in bulk, and then
+ * the document associations of those batches are removed in chunks. The
+ * associations don't depend on the batches being present, so an interrupted
+ * migration can resume with them.
  */
-void RemoveMutationBatches(LevelDbTransaction* transaction,
-                           absl::string_view user_id,
-                           int32_t last_acknowledged_batch_id) {
-  std::string mutations_key = LevelDbMutationKey::KeyPrefix(user_id);
-  std::string last_key =
-      LevelDbMutationKey::Key(user_id, last_acknowledged_batch_id);
-  auto it = transaction->NewIterator();
-  it->Seek(mutations_key);
-  for (; it->Valid() && it->key() <= last_key; it->Next()) {
-    transaction->Delete(it->key());
+void RemoveAcknowledgedMutations(ChunkedMigration* migration) {
+  std::unordered_map<std::string, int32_t> last_acknowledged_batch_ids;
+  {
+    LevelDbTransaction transaction(migration->db(), "Read mutation queues");
+    LevelDbMutationQueueKey key;
+
+    auto it = transaction.NewIterator(LevelDbMutationQueueKey::KeyPrefix());
+    for (it->SeekToFirst(); it->Valid(); it->Next()) {
+      HARD_ASSERT(key.Decode(it->key()), "Failed to decode mutation queue key");
+      firestore_client_MutationQueue mutation_queue{};
+      Reader reader = Reader::Wrap(it->value());
+      reader.ReadNanopbMessage(firestore_client_MutationQueue_fields,
+                               &mutation_queue);
+      HARD_ASSERT(reader.status().ok(), "Failed to deserialize MutationQueue");
+      last_acknowledged_batch_ids[key.user_id()] =
+          mutation_queue.last_acknowledged_batch_id;
+    }
   }
-}
 
-/** Migration 5. */
-void RemoveAcknowledgedMutations(leveldb::DB* db) {
-  LevelDbTransaction transaction(db, "remove acknowledged mutations");
-  std::string mutation_queue_start = LevelDbMutationQueueKey::KeyPrefix();
-
-  LevelDbMutationQueueKey key;
-
-  auto it = transaction.NewIterator();
-  it->Seek(mutation_queue_start);
-  for (; it->Valid() && absl::StartsWith(it->key(), mutation_queue_start);
-       it->Next()) {
-    HARD_ASSERT(key.Decode(it->key()), "Failed to decode mutation queue key");
-    firestore_client_MutationQueue mutation_queue{};
-    Reader reader = Reader::Wrap(it->value());
-    reader.ReadNanopbMessage(firestore_client_MutationQueue_fields,
-                             &mutation_queue);
-    HARD_ASSERT(reader.status().ok(), "Failed to deserialize MutationQueue");
-    RemoveMutationBatches(&transaction, key.user_id(),
-                          mutation_queue.last_acknowledged_batch_id);
-    RemoveMutationDocuments(&transaction, key.user_id(),
-                            mutation_queue.last_acknowledged_batch_id);
+  for (const auto& user : last_acknowledged_batch_ids) {
+    RemoveMutationBatches(migration, user.first, user.second);
   }
 
-  SaveVersion(5, &transaction);
-  transaction.Commit();
+  std::string prefix = LevelDbDocumentMutationKey::KeyPrefix();
+  LevelDbDocumentMutationKey doc_key;
+  migration->VisitRows(
+      prefix, util::PrefixSuccessor(prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view key,
+          absl::string_view) {
+        HARD_ASSERT(doc_key.Decode(key),
+                    "Failed to decode document mutation key");
+        auto found = last_acknowledged_batch_ids.find(doc_key.user_id());
+        if (found != last_acknowledged_batch_ids.end() &&
+            doc_key.batch_id() <= found->second) {
+          transaction->Delete(key);
+        }
+      });
+
+  LevelDbTransaction transaction(migration->db(),
+                                 "remove acknowledged mutations");
+  migration->Finish(&transaction);
+}
+
+/**
+ * Migration 6.
+ *
+ * Values in the remote document table may now start with a compression header
+ * (see LevelDbValueCompressor), and the dictionaries they were compressed with
+ * are kept in the remote document dictionaries table. Existing values are left
+ * as they are: an uncompressed value can't be mistaken for a compressed one, so
+ * they remain readable and get compressed the next time they are written.
+ *
+ * Compression is off unless enabled, so databases that never enable it stay
+ * readable by clients that predate this migration.
+ */
+void AllowCompressedRemoteDocuments(ChunkedMigration* migration) {
+  LevelDbTransaction transaction(migration->db(),
+                                 "Allow compressed remote documents");
+  migration->Finish(&transaction);
 }
 
 /**
@@ -217,32 +404,284 @@ void EnsureSentinelRow(LevelDbTransaction* transaction,
  * Ensure each document in the remote document table has a corresponding
  * sentinel row in the document target index.
  */
-void EnsureSentinelRows(leveldb::DB* db) {
-  LevelDbTransaction transaction(db, "Ensure sentinel rows");
-
+void EnsureSentinelRows(ChunkedMigration* migration) {
   // Get the value we'll use for anything that's missing a row.
-  model::ListenSequenceNumber sequence_number =
-      GetHighestSequenceNumber(&transaction);
+  model::ListenSequenceNumber sequence_number;
+  {
+    LevelDbTransaction transaction(migration->db(), "Ensure sentinel rows");
+    sequence_number = GetHighestSequenceNumber(&transaction);
+  }
   std::string sentinel_value =
       LevelDbDocumentTargetKey::EncodeSentinelValue(sequence_number);
 
   std::string documents_prefix = LevelDbRemoteDocumentKey::KeyPrefix();
-  auto it = transaction.NewIterator();
-  it->Seek(documents_prefix);
   LevelDbRemoteDocumentKey document_key;
-  for (; it->Valid() && absl::StartsWith(it->key(), documents_prefix);
-       it->Next()) {
-    HARD_ASSERT(document_key.Decode(it->key()),
-                "Failed to decode document key");
-    EnsureSentinelRow(&transaction, document_key.document_key(),
-                      sentinel_value);
+  migration->VisitRows(
+      documents_prefix, util::PrefixSuccessor(documents_prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view key,
+          absl::string_view) {
+        HARD_ASSERT(document_key.Decode(key), "Failed to decode document key");
+        EnsureSentinelRow(transaction, document_key.document_key(),
+                          sentinel_value);
+      });
+
+  LevelDbTransaction transaction(migration->db(), "Ensure sentinel rows");
+  migration->Finish(&transaction);
+}
+
+/**
+ * Migration 7.
+ *
+ * Builds the sequence number index (see LevelDbSequenceNumberKey) from the
+ * existing targets and sentinel rows. Any index left behind by a downgrade is
+ * stale, so it is dropped first, unless this is resuming a migration that has
+ * already started building it.
+ */
+void IndexSequenceNumbers(ChunkedMigration* migration) {
+  if (!migration->resumed()) {
+    migration->DeleteEverythingWithPrefix(
+        LevelDbSequenceNumberKey::KeyPrefix());
   }
-  SaveVersion(4, &transaction);
-  transaction.Commit();
+
+  std::string empty_buffer;
+
+  // Document targets sort before targets, so visit them first.
+  std::string document_targets_prefix = LevelDbDocumentTargetKey::KeyPrefix();
+  LevelDbDocumentTargetKey document_target_key;
+  migration->VisitRows(
+      document_targets_prefix, util::PrefixSuccessor(document_targets_prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view key,
+          absl::string_view value) {
+        HARD_ASSERT(document_target_key.Decode(key),
+                    "Failed to decode document target key");
+        if (document_target_key.IsSentinel()) {
+          model::ListenSequenceNumber sequence_number =
+              LevelDbDocumentTargetKey::DecodeSentinelValue(value);
+          transaction->Put(
+              LevelDbSequenceNumberKey::Key(sequence_number,
+                                            document_target_key.document_key()),
+              empty_buffer);
+        }
+      });
+
+  std::string targets_prefix = LevelDbTargetKey::KeyPrefix();
+  migration->VisitRows(
+      targets_prefix, util::PrefixSuccessor(targets_prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view,
+          absl::string_view value) {
+        firestore_client_Target target{};
+        Reader reader = Reader::Wrap(value);
+        reader.ReadNanopbMessage(firestore_client_Target_fields, &target);
+        HARD_ASSERT(reader.status().ok(), "Failed to deserialize Target");
+        transaction->Put(LevelDbSequenceNumberKey::Key(
+                             target.last_listen_sequence_number,
+                             target.target_id),
+                         empty_buffer);
+        reader.FreeNanopbMessage(firestore_client_Target_fields, &target);
+      });
+
+  LevelDbTransaction transaction(migration->db(), "Index sequence numbers");
+  migration->Finish(&transaction);
+}
+
+/**
+ * Migration 8.
+ *
+ * Writes the table sizes row, counting every row in the database. From then
+ * on, each transaction adjusts the row as it commits. This reruns after a
+ * downgrade, since older versions don't keep the row up to date.
+ */
+void ComputeTableSizes(ChunkedMigration* migration) {
+  std::string version_key = LevelDbVersionKey::Key();
+  std::string sizes_key = LevelDbTableSizesKey::Key();
+  std::string progress_key = LevelDbMigrationProgressKey::Key();
+
+  // The partial sizes are carried from chunk to chunk in the progress row.
+  LevelDbTableSizes sizes;
+  if (migration->resumed()) {
+    HARD_ASSERT(sizes.Decode(migration->state()),
+                "Failed to decode partial table sizes");
+  }
+
+  migration->VisitRows(
+      "", "",
+      [&](LevelDbTransaction*, absl::string_view key, absl::string_view value) {
+        // The version row is counted at its new size below, the progress row
+        // is about to be deleted, and the sizes row may have been left behind
+        // by a previous run before a downgrade.
+        if (key == version_key || key == sizes_key || key == progress_key) {
+          return;
+        }
+        sizes.Adjust(key, LevelDbTableSizes::RowSize(key, value));
+      },
+      [&] { return sizes.Encode(); });
+
+  LevelDbTransaction transaction(migration->db(), "Compute table sizes");
+  std::string version_string = std::to_string(8);
+  sizes.Adjust(version_key,
+               LevelDbTableSizes::RowSize(version_key, version_string));
+  transaction.Put(sizes_key, sizes.Encode());
+  migration->Finish(&transaction);
+}
+
+/**
+ * Moves the resume token and snapshot version of every target from its row in
+ * the targets table to the target resumes table, which is where
+ * LevelDbQueryCache keeps them from schema version 9 on. Part of migration 9.
+ */
+void MoveResumeTokens(ChunkedMigration* migration) {
+  std::string targets_prefix = LevelDbTargetKey::KeyPrefix();
+  migration->VisitRows(
+      targets_prefix, util::PrefixSuccessor(targets_prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view key,
+          absl::string_view value) {
+        firestore_client_Target target{};
+        Reader reader = Reader::Wrap(value);
+        reader.ReadNanopbMessage(firestore_client_Target_fields, &target);
+        HARD_ASSERT(reader.status().ok(), "Failed to deserialize Target");
+
+        firestore_client_Target resume{};
+        resume.target_id = target.target_id;
+        resume.snapshot_version = target.snapshot_version;
+        resume.resume_token = target.resume_token;
+        std::string resume_bytes;
+        Writer resume_writer = Writer::Wrap(&resume_bytes);
+        resume_writer.WriteNanopbMessage(firestore_client_Target_fields,
+                                         &resume);
+        transaction->Put(LevelDbTargetResumeKey::Key(target.target_id),
+                         std::move(resume_bytes));
+
+        // Detach the token while writing the target, so that it's still freed
+        // along with the rest of the message.
+        pb_bytes_array_t* resume_token = target.resume_token;
+        target.resume_token = nullptr;
+        target.snapshot_version = {};
+        std::string target_bytes;
+        Writer target_writer = Writer::Wrap(&target_bytes);
+        target_writer.WriteNanopbMessage(firestore_client_Target_fields,
+                                         &target);
+        transaction->Put(std::string{key}, std::move(target_bytes));
+
+        target.resume_token = resume_token;
+        reader.FreeNanopbMessage(firestore_client_Target_fields, &target);
+      });
+}
+
+/**
+ * Migration 9.
+ *
+ * Moves each target's documents from the target document table, which has a
+ * row per document, into blocks in the target document blocks table. Rows are
+ * visited in target and then document order, so each target's documents
+ * arrive sorted and fill its blocks one after another. The partly filled block
+ * is carried from chunk to chunk in the progress row. Any blocks left behind
+ * by a downgrade are stale, so they are dropped first, unless this is resuming
+ * a migration that has already started writing them.
+ *
+ * Older clients only look for a target's documents in the target document
+ * table, so it would look empty to them after a downgrade. The resume tokens
+ * of all targets are moved out of their rows first (see MoveResumeTokens), so
+ * that such a client listens to each target afresh instead of resuming it with
+ * none of its documents. Resume tokens left behind by a downgrade are dropped
+ * along with the blocks, as the targets may have advanced since.
+ */
+void PackTargetDocuments(ChunkedMigration* migration) {
+  if (!migration->resumed()) {
+    migration->DeleteEverythingWithPrefix(
+        LevelDbTargetDocumentBlockKey::KeyPrefix());
+    migration->DeleteEverythingWithPrefix(LevelDbTargetResumeKey::KeyPrefix());
+  }
+
+  // Targets sort before target documents, so visit them first.
+  MoveResumeTokens(migration);
+
+  model::TargetId pending_target_id = 0;
+  std::vector<model::DocumentKey> pending;
+  if (migration->resumed() && !migration->state().empty()) {
+    absl::string_view state = migration->state();
+    int64_t target_id = 0;
+    std::string block;
+    HARD_ASSERT(OrderedCode::ReadSignedNumIncreasing(&state, &target_id) &&
+                    OrderedCode::ReadString(&state, &block) &&
+                    LevelDbTargetDocuments::DecodeBlock(block, &pending),
+                "Failed to decode partial target document block");
+    pending_target_id = static_cast<model::TargetId>(target_id);
+  }
+
+  auto flush = [&](LevelDbTransaction* transaction) {
+    LevelDbTargetDocuments::WriteBlocks(transaction, pending_target_id,
+                                        pending);
+    pending.clear();
+  };
+
+  std::string target_documents_prefix = LevelDbTargetDocumentKey::KeyPrefix();
+  LevelDbTargetDocumentKey target_document_key;
+  migration->VisitRows(
+      target_documents_prefix, util::PrefixSuccessor(target_documents_prefix),
+      [&](LevelDbTransaction* transaction,
+          absl::string_view key,
+          absl::string_view) {
+        HARD_ASSERT(target_document_key.Decode(key),
+                    "Failed to decode target document key");
+        if (target_document_key.target_id() != pending_target_id ||
+            pending.size() == LevelDbTargetDocuments::kMaxBlockSize) {
+          flush(transaction);
+          pending_target_id = target_document_key.target_id();
+        }
+        pending.push_back(target_document_key.document_key());
+        transaction->Delete(key);
+      },
+      [&] {
+        std::string state;
+        OrderedCode::WriteSignedNumIncreasing(&state, pending_target_id);
+        OrderedCode::WriteString(&state,
+                                 LevelDbTargetDocuments::EncodeBlock(pending));
+        return state;
+      });
+
+  LevelDbTransaction transaction(migration->db(), "Pack target documents");
+  flush(&transaction);
+  migration->Finish(&transaction);
 }
 
 }  // namespace
 
+std::string LevelDbMigrations::Progress::Encode() const {
+  std::string result;
+  OrderedCode::WriteSignedNumIncreasing(&result, kProgressFormatVersion);
+  OrderedCode::WriteSignedNumIncreasing(&result, version);
+  OrderedCode::WriteString(&result, cursor);
+  OrderedCode::WriteSignedNumIncreasing(&result, rows_processed);
+  OrderedCode::WriteString(&result, state);
+  return result;
+}
+
+bool LevelDbMigrations::Progress::Decode(absl::string_view encoded,
+                                         Progress* progress) {
+  int64_t format_version = 0;
+  int64_t version = 0;
+  Progress result;
+  bool ok = OrderedCode::ReadSignedNumIncreasing(&encoded, &format_version) &&
+            format_version == kProgressFormatVersion &&
+            OrderedCode::ReadSignedNumIncreasing(&encoded, &version) &&
+            OrderedCode::ReadString(&encoded, &result.cursor) &&
+            OrderedCode::ReadSignedNumIncreasing(&encoded,
+                                                 &result.rows_processed) &&
+            OrderedCode::ReadString(&encoded, &result.state) &&
+            encoded.empty();
+  if (!ok) {
+    return false;
+  }
+
+  result.version = static_cast<SchemaVersion>(version);
+  *progress = std::move(result);
+  return true;
+}
+
 LevelDbMigrations::SchemaVersion LevelDbMigrations::ReadSchemaVersion(
     leveldb::DB* db) {
   LevelDbTransaction transaction(db, "Read schema version");
@@ -260,8 +699,20 @@ void LevelDbMigrations::RunMigrations(leveldb::DB* db) {
   RunMigrations(db, kSchemaVersion);
 }
 
+void LevelDbMigrations::RunMigrations(leveldb::DB* db,
+                                      const ProgressCallback& callback) {
+  RunMigrations(db, kSchemaVersion, callback);
+}
+
 void LevelDbMigrations::RunMigrations(leveldb::DB* db,
                                       SchemaVersion to_version) {
+  RunMigrations(db, to_version, ProgressCallback{});
+}
+
+void LevelDbMigrations::RunMigrations(leveldb::DB* db,
+                                      SchemaVersion to_version,
+                                      const ProgressCallback& callback,
+                                      int rows_per_chunk) {
   SchemaVersion from_version = ReadSchemaVersion(db);
   // If this is a downgrade, just save the downgrade version so we can
   // detect it when we go to upgrade again, allowing us to rerun the
@@ -269,6 +720,7 @@ void LevelDbMigrations::RunMigrations(leveldb::DB* db,
   if (from_version > to_version) {
     LevelDbTransaction transaction(db, "Save downgrade version");
     SaveVersion(to_version, &transaction);
+    transaction.Delete(LevelDbMigrationProgressKey::Key());
     transaction.Commit();
     return;
   }
@@ -277,15 +729,38 @@ void LevelDbMigrations::RunMigrations(leveldb::DB* db,
   // after the first release. There may be clients that have never run any
   // migrations that have existing targets.
   if (from_version < 3 && to_version >= 3) {
-    ClearQueryCache(db);
+    ChunkedMigration migration{db, 3, callback, rows_per_chunk};
+    ClearQueryCache(&migration);
   }
 
   if (from_version < 4 && to_version >= 4) {
-    EnsureSentinelRows(db);
+    ChunkedMigration migration{db, 4, callback, rows_per_chunk};
+    EnsureSentinelRows(&migration);
   }
 
   if (from_version < 5 && to_version >= 5) {
-    RemoveAcknowledgedMutations(db);
+    ChunkedMigration migration{db, 5, callback, rows_per_chunk};
+    RemoveAcknowledgedMutations(&migration);
+  }
+
+  if (from_version < 6 && to_version >= 6) {
+    ChunkedMigration migration{db, 6, callback, rows_per_chunk};
+    AllowCompressedRemoteDocuments(&migration);
+  }
+
+  if (from_version < 7 && to_version >= 7) {
+    ChunkedMigration migration{db, 7, callback, rows_per_chunk};
+    IndexSequenceNumbers(&migration);
+  }
+
+  if (from_version < 8 && to_version >= 8) {
+    ChunkedMigration migration{db, 8, callback, rows_per_chunk};
+    ComputeTableSizes(&migration);
+  }
+
+  if (from_version < 9 && to_version >= 9) {
+    ChunkedMigration migration{db, 9, callback, rows_per_chunk};
+    PackTargetDocuments(&migration);
   }
 }
 
@@ -18,9 +18,12 @@
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_MIGRATIONS_H_
 
 #include <cstdint>
+#include <functional>
+#include <string>
 
 #include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 #include "Firestore/core/src/firebase/firestore/local/local_serializer.h"
+#include "absl/strings/string_view.h"
 #include "leveldb/db.h"
 
 namespace firebase {
@@ -31,6 +34,40 @@ class LevelDbMigrations {
  public:
   using SchemaVersion = int32_t;
 
+  /**
+   * How far the migration in progress has got. Migrations that visit every row
+   * of a table commit their work in chunks of a bounded number of rows, saving
+   * this after each chunk, so that memory use stays bounded and an interrupted
+   * migration resumes after the last chunk it committed.
+   */
+  struct Progress {
+    /** Encodes this progress for storage in the migration progress row. */
+    std::string Encode() const;
+
+    /**
+     * Decodes progress written by Encode(). Returns false, leaving `progress`
+     * unchanged, if `encoded` was not recognized.
+     */
+    static bool Decode(absl::string_view encoded, Progress* progress);
+
+    /** The schema version the migration in progress upgrades to. */
+    SchemaVersion version = 0;
+
+    /** The key of the last row visited, or empty if none has been yet. */
+    std::string cursor;
+
+    /** The number of rows visited or deleted so far, across restarts. */
+    int64_t rows_processed = 0;
+
+    /** State the migration carries from one chunk to the next. */
+    std::string state;
+  };
+
+  /** Called after each chunk of work a migration commits. */
+  using ProgressCallback = std::function<void(const Progress&)>;
+
+  static const int kDefaultRowsPerChunk = 1000;
+
   /**
    * Returns the current version of the schema for the given database
    */
@@ -42,11 +79,31 @@ class LevelDbMigrations {
    */
   static void RunMigrations(leveldb::DB* db);
 
+  /**
+   * Runs any migrations needed to bring the given database up to the current
+   * schema version, reporting their progress to the given callback
+   */
+  static void RunMigrations(leveldb::DB* db, const ProgressCallback& callback);
+
   /**
    * Runs any migrations needed to bring the given database up to the given
    * schema version
    */
   static void RunMigrations(leveldb::DB* db, SchemaVersion version);
+
+  /**
+   * Runs any migrations needed to bring the given database up to the given
+   * schema version, resuming the migration that was in progress if one was
+   * interrupted.
+   *
+   * @param callback Receives the progress of each migration as it runs; may
+   *     be empty.
+   * @param rows_per_chunk The number of rows each transaction visits.
+   */
+  static void RunMigrations(leveldb::DB* db,
+                            SchemaVersion version,
+                            const ProgressCallback& callback,
+                            int rows_per_chunk = kDefaultRowsPerChunk);
 };
 
 }  // namespace local
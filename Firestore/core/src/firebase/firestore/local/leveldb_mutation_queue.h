@@ -0,0 +1,183 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_MUTATION_QUEUE_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_MUTATION_QUEUE_H_
+
+#if !defined(__OBJC__)
+#error "For now, this file must only be included by ObjC source files."
+#endif  // !defined(__OBJC__)
+
+#import <Foundation/Foundation.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#import "Firestore/Protos/objc/firestore/local/Mutation.pbobjc.h"
+#include "Firestore/core/src/firebase/firestore/auth/user.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/mutation_queue.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
+#include "Firestore/core/src/firebase/firestore/model/resource_path.h"
+#include "Firestore/core/src/firebase/firestore/model/types.h"
+#include "absl/strings/string_view.h"
+#include "leveldb/db.h"
+
+@class FSTLevelDB;
+@class FSTLocalSerializer;
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * A mutation queue for a specific user, backed by LevelDB.
+ *
+ * Every pending batch of the user is decoded once, when the queue starts, and
+ * kept in memory along with two indexes: the batches that mutate each
+ * document, and the batches that mutate each collection's immediate children.
+ * Reads are answered from memory, so finding the pending writes for a document
+ * or a query is a hash lookup rather than a scan of the document mutations
+ * index followed by a read and parse of each batch. Writes go through to the
+ * current transaction as before, so the rows on disk are unchanged.
+ *
+ * There can only be one LevelDbMutationQueue for a given db at a time, hence it
+ * is safe to cache the next batch ID and the batches themselves.
+ */
+class LevelDbMutationQueue : public MutationQueue {
+ public:
+  /**
+   * Creates a new mutation queue for the given user, in the given LevelDB.
+   *
+   * @param user The user for which to create a mutation queue.
+   * @param db The LevelDB in which to create the queue.
+   */
+  LevelDbMutationQueue(const auth::User& user,
+                       FSTLevelDB* db,
+                       FSTLocalSerializer* serializer);
+
+  /**
+   * Returns one larger than the largest batch ID that has been stored,
+   * including the pending changes in the given transaction. If there are no
+   * mutations returns 0. Note that batch IDs are global.
+   */
+  static model::BatchId LoadNextBatchIdFromTransaction(
+      LevelDbTransaction* transaction);
+
+  void Start() override;
+
+  bool IsEmpty() override;
+
+  model::BatchId GetHighestAcknowledgedBatchId() override;
+
+  void AcknowledgeBatch(FSTMutationBatch* batch,
+                        NSData* _Nullable stream_token) override;
+
+  NSData* _Nullable GetLastStreamToken() override;
+
+  void SetLastStreamToken(NSData* _Nullable stream_token) override;
+
+  FSTMutationBatch* AddMutationBatch(
+      FIRTimestamp* local_write_time,
+      NSArray<FSTMutation*>* mutations) override;
+
+  FSTMutationBatch* _Nullable LookupMutationBatch(
+      model::BatchId batch_id) override;
+
+  FSTMutationBatch* _Nullable NextMutationBatchAfterBatchId(
+      model::BatchId batch_id) override;
+
+  std::vector<FSTMutationBatch*> AllMutationBatches() override;
+
+  std::vector<FSTMutationBatch*> AllMutationBatchesAffectingDocumentKey(
+      const model::DocumentKey& key) override;
+
+  std::vector<FSTMutationBatch*> AllMutationBatchesAffectingDocumentKeys(
+      const model::DocumentKeySet& keys) override;
+
+  std::vector<FSTMutationBatch*> AllMutationBatchesAffectingQuery(
+      FSTQuery* query) override;
+
+  void RemoveMutationBatch(FSTMutationBatch* batch) override;
+
+  void PerformConsistencyCheck() override;
+
+ private:
+  /** Reads the user's batches from LevelDB and indexes them. */
+  void LoadBatches();
+
+  /** Adds `batch` to the in-memory batches and indexes. */
+  void IndexBatch(FSTMutationBatch* batch);
+
+  /** Removes `batch` from the in-memory batches and indexes. */
+  void UnindexBatch(FSTMutationBatch* batch);
+
+  /** Returns the batches with the given IDs, which must all exist. */
+  std::vector<FSTMutationBatch*> BatchesWithIds(
+      const std::set<model::BatchId>& batch_ids) const;
+
+  std::string mutation_queue_key() const;
+  void SaveMetadata();
+
+  FSTPBMutationQueue* _Nullable MetadataForKey(const std::string& key);
+  FSTPBMutationQueue* ParseMetadata(absl::string_view encoded);
+  FSTMutationBatch* DecodeMutationBatch(absl::string_view encoded);
+
+  // This instance is owned by FSTLevelDB; avoid a retain cycle.
+  __weak FSTLevelDB* db_;
+  FSTLocalSerializer* serializer_;
+
+  /** The normalized user ID (e.g. nil UID => "" user ID) used in our keys. */
+  std::string user_id_;
+
+  /** Next value to use when assigning sequential IDs to each mutation batch. */
+  model::BatchId next_batch_id_ = 0;
+
+  /** A write-through cached copy of the metadata describing the queue. */
+  FSTPBMutationQueue* _Nullable metadata_;
+
+  /** The user's pending batches, by batch ID. */
+  std::map<model::BatchId, FSTMutationBatch*> batches_;
+
+  /** The IDs of the batches that mutate each document, in ascending order. */
+  std::unordered_map<model::DocumentKey,
+                     std::vector<model::BatchId>,
+                     model::DocumentKeyHash>
+      batches_by_document_;
+
+  /**
+   * The IDs of the batches that mutate an immediate child of each collection,
+   * which are the batches that can affect a query of the collection.
+   */
+  std::unordered_map<model::ResourcePath,
+                     std::set<model::BatchId>,
+                     model::ResourcePathHash>
+      batches_by_collection_;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_MUTATION_QUEUE_H_
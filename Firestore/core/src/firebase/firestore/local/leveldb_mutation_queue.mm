@@ -0,0 +1,434 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_mutation_queue.h"
+
+#include <algorithm>
+#include <utility>
+
+#import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Local/FSTLevelDB.h"
+#import "Firestore/Source/Local/FSTLocalSerializer.h"
+#import "Firestore/Source/Model/FSTMutation.h"
+#import "Firestore/Source/Model/FSTMutationBatch.h"
+
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using auth::User;
+using leveldb::Status;
+using model::BatchId;
+using model::DocumentKey;
+using model::DocumentKeySet;
+using model::ResourcePath;
+
+LevelDbMutationQueue::LevelDbMutationQueue(const User& user,
+                                           FSTLevelDB* db,
+                                           FSTLocalSerializer* serializer)
+    : db_(db),
+      serializer_(serializer),
+      user_id_(user.is_authenticated() ? user.uid() : "") {
+}
+
+BatchId LevelDbMutationQueue::LoadNextBatchIdFromTransaction(
+    LevelDbTransaction* transaction) {
+  auto it = transaction->NewIterator(LevelDbMutationKey::KeyPrefix());
+
+  LevelDbMutationKey row_key;
+  BatchId max_batch_id = kFSTBatchIDUnknown;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    bool decoded = row_key.Decode(it->key());
+    HARD_ASSERT(decoded, "Failed to decode %s", DescribeKey(it));
+
+    // Each user's batches are ordered by batch ID, so rather than visiting all
+    // of them, skip to the first row after them and step back to the last one.
+    it->Seek(util::PrefixSuccessor(
+        LevelDbMutationKey::KeyPrefix(row_key.user_id())));
+    if (it->Valid()) {
+      it->Prev();
+    } else {
+      it->SeekToLast();
+    }
+    decoded = row_key.Decode(it->key());
+    HARD_ASSERT(decoded, "Failed to decode %s", DescribeKey(it));
+    max_batch_id = std::max(max_batch_id, row_key.batch_id());
+  }
+
+  return max_batch_id + 1;
+}
+
+void LevelDbMutationQueue::Start() {
+  LoadBatches();
+  BatchId next_batch_id = [db_ loadNextBatchID];
+
+  // On restart, next_batch_id may end up lower than the last acknowledged
+  // batch ID since it's computed from the queue contents, and there may be no
+  // mutations in the queue. In this case, we need to reset the last
+  // acknowledged batch ID (which is safe since the queue must be empty).
+  std::string key = mutation_queue_key();
+  FSTPBMutationQueue* metadata = MetadataForKey(key);
+  if (!metadata) {
+    metadata = [FSTPBMutationQueue message];
+
+    // proto3's default value for lastAcknowledgedBatchId is zero, but that
+    // would consider the first entry in the queue to be acknowledged without
+    // that acknowledgement actually happening.
+    metadata.lastAcknowledgedBatchId = kFSTBatchIDUnknown;
+  } else {
+    BatchId last_acked = metadata.lastAcknowledgedBatchId;
+    if (last_acked >= next_batch_id) {
+      HARD_ASSERT(IsEmpty(),
+                  "Reset next_batch_id is only possible when the queue is "
+                  "empty");
+      last_acked = kFSTBatchIDUnknown;
+
+      metadata.lastAcknowledgedBatchId = last_acked;
+      db_.currentTransaction->Put(key, metadata);
+    }
+  }
+
+  next_batch_id_ = next_batch_id;
+  metadata_ = metadata;
+}
+
+void LevelDbMutationQueue::LoadBatches() {
+  batches_.clear();
+  batches_by_document_.clear();
+  batches_by_collection_.clear();
+
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbMutationKey::KeyPrefix(user_id_));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    IndexBatch(DecodeMutationBatch(it->value()));
+  }
+}
+
+bool LevelDbMutationQueue::IsEmpty() {
+  return batches_.empty();
+}
+
+BatchId LevelDbMutationQueue::GetHighestAcknowledgedBatchId() {
+  return metadata_.lastAcknowledgedBatchId;
+}
+
+void LevelDbMutationQueue::AcknowledgeBatch(FSTMutationBatch* batch,
+                                            NSData* _Nullable stream_token) {
+  BatchId batch_id = batch.batchID;
+  HARD_ASSERT(batch_id > GetHighestAcknowledgedBatchId(),
+              "Mutation batchIDs must be acknowledged in order");
+
+  metadata_.lastAcknowledgedBatchId = batch_id;
+  metadata_.lastStreamToken = stream_token;
+  SaveMetadata();
+}
+
+NSData* _Nullable LevelDbMutationQueue::GetLastStreamToken() {
+  return metadata_.lastStreamToken;
+}
+
+void LevelDbMutationQueue::SetLastStreamToken(NSData* _Nullable stream_token) {
+  metadata_.lastStreamToken = stream_token;
+  SaveMetadata();
+}
+
+FSTMutationBatch* LevelDbMutationQueue::AddMutationBatch(
+    FIRTimestamp* local_write_time, NSArray<FSTMutation*>* mutations) {
+  BatchId batch_id = next_batch_id_;
+  next_batch_id_++;
+
+  FSTMutationBatch* batch =
+      [[FSTMutationBatch alloc] initWithBatchID:batch_id
+                                 localWriteTime:local_write_time
+                                      mutations:mutations];
+  // New batch IDs are above those of every stored batch, so none of the rows
+  // written here exist yet.
+  std::string batch_key = LevelDbMutationKey::Key(user_id_, batch_id);
+  db_.currentTransaction->NoteCommittedSize(batch_key, 0);
+  db_.currentTransaction->Put(batch_key,
+                              [serializer_ encodedMutationBatch:batch]);
+
+  // Store an empty value in the index which is equivalent to serializing a
+  // GPBEmpty message. In the future if we wanted to store some other kind of
+  // value here, we can parse these empty values as with some other protocol
+  // buffer (and the parser will see all default values).
+  std::string empty_buffer;
+
+  // A batch may mutate a document more than once but has a single index row
+  // for it, and the filter of mutated documents counts rows.
+  DocumentKeyFilter* mutated_documents = db_.mutatedDocuments;
+  for (const DocumentKey& key : [batch keys]) {
+    std::string index_key =
+        LevelDbDocumentMutationKey::Key(user_id_, key, batch_id);
+    db_.currentTransaction->NoteCommittedSize(index_key, 0);
+    db_.currentTransaction->Put(std::move(index_key), empty_buffer);
+    mutated_documents->Add(key);
+  }
+  if (mutated_documents->overfull()) {
+    *mutated_documents =
+        LevelDbStartupData::ReadMutatedDocuments(db_.currentTransaction);
+  }
+
+  IndexBatch(batch);
+  return batch;
+}
+
+FSTMutationBatch* _Nullable LevelDbMutationQueue::LookupMutationBatch(
+    BatchId batch_id) {
+  auto found = batches_.find(batch_id);
+  return found == batches_.end() ? nil : found->second;
+}
+
+FSTMutationBatch* _Nullable LevelDbMutationQueue::NextMutationBatchAfterBatchId(
+    BatchId batch_id) {
+  // All batches with batch_id <= lastAcknowledgedBatchId have been
+  // acknowledged so the first unacknowledged batch after batch_id will have a
+  // batch_id larger than both of these values.
+  BatchId after = std::max(batch_id, GetHighestAcknowledgedBatchId());
+  auto found = batches_.upper_bound(after);
+  return found == batches_.end() ? nil : found->second;
+}
+
+std::vector<FSTMutationBatch*> LevelDbMutationQueue::AllMutationBatches() {
+  std::vector<FSTMutationBatch*> result;
+  result.reserve(batches_.size());
+  for (const auto& entry : batches_) {
+    result.push_back(entry.second);
+  }
+  return result;
+}
+
+std::vector<FSTMutationBatch*>
+LevelDbMutationQueue::AllMutationBatchesAffectingDocumentKey(
+    const DocumentKey& key) {
+  std::vector<FSTMutationBatch*> result;
+  auto found = batches_by_document_.find(key);
+  if (found == batches_by_document_.end()) return result;
+
+  result.reserve(found->second.size());
+  for (BatchId batch_id : found->second) {
+    result.push_back(batches_.at(batch_id));
+  }
+  return result;
+}
+
+std::vector<FSTMutationBatch*>
+LevelDbMutationQueue::AllMutationBatchesAffectingDocumentKeys(
+    const DocumentKeySet& keys) {
+  // Some batches can affect more than one key, so collect the unique batch
+  // IDs first.
+  std::set<BatchId> batch_ids;
+  for (const DocumentKey& key : keys) {
+    auto found = batches_by_document_.find(key);
+    if (found != batches_by_document_.end()) {
+      batch_ids.insert(found->second.begin(), found->second.end());
+    }
+  }
+  return BatchesWithIds(batch_ids);
+}
+
+std::vector<FSTMutationBatch*>
+LevelDbMutationQueue::AllMutationBatchesAffectingQuery(FSTQuery* query) {
+  HARD_ASSERT(![query isDocumentQuery],
+              "Document queries shouldn't go down this path");
+
+  // TODO(mcg): Actually implement a single-collection query
+  //
+  // Since we don't yet index the actual properties in the mutations, our
+  // current approach is to just return all mutation batches that affect
+  // documents in the collection being queried. Documents in subcollections
+  // can't match, so they aren't indexed under the collection.
+  auto found = batches_by_collection_.find(query.path);
+  if (found == batches_by_collection_.end()) return {};
+
+  return BatchesWithIds(found->second);
+}
+
+std::vector<FSTMutationBatch*> LevelDbMutationQueue::BatchesWithIds(
+    const std::set<BatchId>& batch_ids) const {
+  // Ordered by batch ID to ensure that multiple mutations affecting the same
+  // document key are applied in order.
+  std::vector<FSTMutationBatch*> result;
+  result.reserve(batch_ids.size());
+  for (BatchId batch_id : batch_ids) {
+    auto found = batches_.find(batch_id);
+    HARD_ASSERT(found != batches_.end(), "Dangling reference to batch %s",
+                batch_id);
+    result.push_back(found->second);
+  }
+  return result;
+}
+
+void LevelDbMutationQueue::RemoveMutationBatch(FSTMutationBatch* batch) {
+  BatchId batch_id = batch.batchID;
+  std::string key = LevelDbMutationKey::Key(user_id_, batch_id);
+
+  // As a sanity check, verify that the mutation batch exists before deleting
+  // it.
+  HARD_ASSERT(batches_.find(batch_id) != batches_.end(),
+              "Mutation batch %s did not exist", DescribeKey(key));
+
+  db_.currentTransaction->Delete(key);
+
+  DocumentKeySet mutated_keys = [batch keys];
+  for (FSTMutation* mutation in batch.mutations) {
+    std::string index_key =
+        LevelDbDocumentMutationKey::Key(user_id_, mutation.key, batch_id);
+    db_.currentTransaction->NoteCommittedSize(
+        index_key, LevelDbTableSizes::RowSize(index_key, ""));
+    db_.currentTransaction->Delete(index_key);
+    [db_.referenceDelegate removeMutationReference:mutation.key];
+  }
+
+  DocumentKeyFilter* mutated_documents = db_.mutatedDocuments;
+  for (const DocumentKey& mutated_key : mutated_keys) {
+    mutated_documents->Remove(mutated_key);
+  }
+
+  UnindexBatch(batch);
+}
+
+void LevelDbMutationQueue::IndexBatch(FSTMutationBatch* batch) {
+  BatchId batch_id = batch.batchID;
+  batches_[batch_id] = batch;
+
+  for (const DocumentKey& key : [batch keys]) {
+    // Batches are added in ascending order, so appending keeps each list
+    // sorted.
+    batches_by_document_[key].push_back(batch_id);
+    batches_by_collection_[key.path().PopLast()].insert(batch_id);
+  }
+}
+
+void LevelDbMutationQueue::UnindexBatch(FSTMutationBatch* batch) {
+  BatchId batch_id = batch.batchID;
+  batches_.erase(batch_id);
+
+  for (const DocumentKey& key : [batch keys]) {
+    auto by_document = batches_by_document_.find(key);
+    if (by_document != batches_by_document_.end()) {
+      std::vector<BatchId>& batch_ids = by_document->second;
+      batch_ids.erase(std::remove(batch_ids.begin(), batch_ids.end(), batch_id),
+                      batch_ids.end());
+      if (batch_ids.empty()) batches_by_document_.erase(by_document);
+    }
+
+    auto by_collection = batches_by_collection_.find(key.path().PopLast());
+    if (by_collection != batches_by_collection_.end()) {
+      by_collection->second.erase(batch_id);
+      if (by_collection->second.empty()) {
+        batches_by_collection_.erase(by_collection);
+      }
+    }
+  }
+}
+
+void LevelDbMutationQueue::PerformConsistencyCheck() {
+  if (!IsEmpty()) {
+    return;
+  }
+
+  HARD_ASSERT(batches_by_document_.empty() && batches_by_collection_.empty(),
+              "Document leak -- the in-memory mutation index isn't empty when "
+              "the queue is");
+
+  // Verify that there are no entries in the document-mutation index if the
+  // queue is empty.
+  auto index_iterator = db_.currentTransaction->NewIterator(
+      LevelDbDocumentMutationKey::KeyPrefix(user_id_));
+
+  std::vector<std::string> dangling_mutation_references;
+
+  for (index_iterator->SeekToFirst(); index_iterator->Valid();
+       index_iterator->Next()) {
+    dangling_mutation_references.push_back(DescribeKey(index_iterator));
+  }
+
+  HARD_ASSERT(dangling_mutation_references.empty(),
+              "Document leak -- detected dangling mutation references when "
+              "queue is empty. Dangling keys: %s",
+              util::ToString(dangling_mutation_references));
+}
+
+std::string LevelDbMutationQueue::mutation_queue_key() const {
+  return LevelDbMutationQueueKey::Key(user_id_);
+}
+
+void LevelDbMutationQueue::SaveMetadata() {
+  db_.currentTransaction->Put(mutation_queue_key(), metadata_);
+}
+
+FSTPBMutationQueue* _Nullable LevelDbMutationQueue::MetadataForKey(
+    const std::string& key) {
+  std::string value;
+  Status status = db_.currentTransaction->Get(key, &value);
+  if (status.ok()) {
+    return ParseMetadata(value);
+  } else if (status.IsNotFound()) {
+    return nil;
+  } else {
+    HARD_FAIL("MetadataForKey: failed loading key %s with status: %s", key,
+              status.ToString());
+  }
+}
+
+FSTPBMutationQueue* LevelDbMutationQueue::ParseMetadata(
+    absl::string_view encoded) {
+  NSData* data =
+      [[NSData alloc] initWithBytesNoCopy:(void*)encoded.data()
+                                   length:encoded.size()
+                             freeWhenDone:NO];
+
+  NSError* error;
+  FSTPBMutationQueue* proto = [FSTPBMutationQueue parseFromData:data
+                                                          error:&error];
+  if (!proto) {
+    HARD_FAIL("FSTPBMutationQueue failed to parse: %s", error);
+  }
+
+  return proto;
+}
+
+FSTMutationBatch* LevelDbMutationQueue::DecodeMutationBatch(
+    absl::string_view encoded) {
+  NSData* data =
+      [[NSData alloc] initWithBytesNoCopy:(void*)encoded.data()
+                                   length:encoded.size()
+                             freeWhenDone:NO];
+
+  NSError* error;
+  FSTPBWriteBatch* proto = [FSTPBWriteBatch parseFromData:data error:&error];
+  if (!proto) {
+    HARD_FAIL("FSTPBMutationBatch failed to parse: %s", error);
+  }
+
+  return [serializer_ decodedMutationBatch:proto];
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
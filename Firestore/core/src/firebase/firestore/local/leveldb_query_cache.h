@@ -23,7 +23,18 @@
 
 #import <Foundation/Foundation.h>
 
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
 #import "Firestore/Protos/objc/firestore/local/Target.pbobjc.h"
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+#include "Firestore/core/src/firebase/firestore/local/incremental_lru_garbage_collector.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 #include "Firestore/core/src/firebase/firestore/local/query_cache.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
@@ -50,6 +61,13 @@ class LevelDbQueryCache : public QueryCache {
                                              model::ListenSequenceNumber,
                                              BOOL*);
 
+  /**
+   * Visitor callback type for VisitSequenceNumbers. Returns false to stop
+   * visiting.
+   */
+  using SequenceNumberVisitor =
+      std::function<bool(const LevelDbSequenceNumberKey&)>;
+
   /**
    * Retrieves the global singleton metadata row from the given database, if it
    * exists.
@@ -57,6 +75,9 @@ class LevelDbQueryCache : public QueryCache {
    */
   static FSTPBTargetGlobal* ReadMetadata(leveldb::DB* db);
 
+  /** Parses the encoded contents of the target global row. */
+  static FSTPBTargetGlobal* ParseMetadata(absl::string_view encoded);
+
   /**
    * Creates a new query cache in the given LevelDB.
    *
@@ -69,6 +90,13 @@ class LevelDbQueryCache : public QueryCache {
 
   void UpdateTarget(FSTQueryData* query_data) override;
 
+  /**
+   * Writes the resume token and snapshot version to the target resumes table
+   * rather than rewriting the target row. Target rows are always written
+   * without them, so the target resumes table is the only place they are kept.
+   */
+  void UpdateResumeToken(FSTQueryData* query_data) override;
+
   void RemoveTarget(FSTQueryData* query_data) override;
 
   FSTQueryData* _Nullable GetTarget(FSTQuery* query) override;
@@ -119,12 +147,147 @@ class LevelDbQueryCache : public QueryCache {
   void SetLastRemoteSnapshotVersion(model::SnapshotVersion version) override;
 
   // Non-interface methods
+
+  /** Starts the cache from startup data loaded from the database. */
   void Start();
 
+  /**
+   * Starts the cache from the target global row already read into
+   * `startup_data`, rather than reading it again.
+   */
+  void Start(const LevelDbStartupData& startup_data);
+
   void EnumerateOrphanedDocuments(OrphanedDocumentEnumerator block);
 
+  /**
+   * Enumerates the orphaned documents with a sequence number less than or
+   * equal to `upper_bound`, least recently used first. Unlike the overload
+   * above, this only visits the part of the sequence number index at or below
+   * the bound.
+   */
+  void EnumerateOrphanedDocuments(model::ListenSequenceNumber upper_bound,
+                                  OrphanedDocumentEnumerator block);
+
+  /**
+   * Returns the `n`th lowest sequence number among all targets and orphaned
+   * documents, or the highest one if there are fewer than `n` of them. Returns
+   * kFSTListenSequenceNumberInvalid if `n` is 0 or there are none.
+   */
+  model::ListenSequenceNumber NthSequenceNumber(size_t n);
+
+  /**
+   * Visits targets and orphaned documents in increasing sequence number order,
+   * a slice at a time, for incremental garbage collection.
+   *
+   * Starts after the index row stored in `*cursor`, or at the first one if
+   * `*cursor` is empty, and examines at most `limit` index rows, storing the
+   * last one examined back into `*cursor`. Rows visited may be removed by the
+   * visitor. The slice is finished once the index is exhausted or `visitor`
+   * returns false.
+   */
+  LruGcSlice VisitSequenceNumbers(std::string* cursor,
+                                  int limit,
+                                  const SequenceNumberVisitor& visitor);
+
+  /**
+   * Writes the sentinel row recording that the given document was last used
+   * at the given sequence number, and indexes it by that sequence number.
+   */
+  void WriteSentinel(const model::DocumentKey& key,
+                     model::ListenSequenceNumber sequence_number);
+
+  /**
+   * Removes the sentinel row for the given document and its index entry, given
+   * the sequence number the sentinel holds.
+   */
+  void RemoveSentinel(const model::DocumentKey& key,
+                      model::ListenSequenceNumber sequence_number);
+
+  /** Reads the target with the given ID from the current transaction. */
+  FSTQueryData* _Nullable ReadTarget(model::TargetId target_id);
+
  private:
+  /** The most targets whose sequence numbers are kept in memory. */
+  static const size_t kMaxTrackedSequenceNumbers = 1000;
+
+  /** The most documents whose sentinel sequence numbers are kept in memory. */
+  static const size_t kMaxTrackedSentinels = 10000;
+
   void Save(FSTQueryData* query_data);
+
+  /**
+   * Looks up the target for the given query by scanning the query-target index
+   * for its canonical ID.
+   */
+  FSTQueryData* _Nullable ScanForTarget(FSTQuery* query);
+
+  /**
+   * Returns the sequence number under which the target with the given ID is
+   * indexed, or kFSTListenSequenceNumberInvalid if there is no such target.
+   */
+  model::ListenSequenceNumber IndexedSequenceNumber(model::TargetId target_id);
+
+  /** Remembers the sequence number under which a target is indexed. */
+  void TrackSequenceNumber(model::TargetId target_id,
+                           model::ListenSequenceNumber sequence_number);
+
+  /**
+   * Writes the sequence numbers table row with the given key, which must not
+   * exist yet. Like DeleteIndexRow(), this tells the transaction what the
+   * change replaces, which spares reading the row when committing.
+   */
+  void PutIndexRow(std::string key);
+
+  /**
+   * Deletes the sequence numbers table row with the given key, which must
+   * exist.
+   */
+  void DeleteIndexRow(const std::string& key);
+
+  /**
+   * Returns the sequence number held by the sentinel row of the given
+   * document, or kFSTListenSequenceNumberInvalid if it has none.
+   */
+  model::ListenSequenceNumber SentinelSequenceNumber(
+      const model::DocumentKey& key);
+
+  /** Remembers the sequence number held by a document's sentinel row. */
+  void TrackSentinel(const model::DocumentKey& key,
+                     model::ListenSequenceNumber sequence_number);
+
+  /** Drops the entry for `target_id` from the targets by canonical hash. */
+  void ForgetCanonicalHash(uint64_t canonical_hash, model::TargetId target_id);
+
+  /**
+   * Drops the decoded copy of the target with the given ID, if any, so that
+   * the next lookup reads it again.
+   */
+  void ForgetDecodedTarget(uint64_t canonical_hash, model::TargetId target_id);
+
+  /**
+   * Returns an iterator over the sequence number index rows with sequence
+   * numbers less than or equal to `upper_bound`.
+   */
+  std::unique_ptr<LevelDbTransaction::Iterator> NewSequenceNumberIterator(
+      model::ListenSequenceNumber upper_bound);
+
+  /** The state of a document row in the sequence numbers table. */
+  enum class DocumentRowState {
+    /** The document's sentinel has since moved to another sequence number. */
+    kStale,
+    /** The document is in some target. */
+    kTargeted,
+    /** The document is in no target, so it may be collected. */
+    kOrphaned,
+  };
+
+  /**
+   * Classifies the given document row of the sequence numbers table, using
+   * `it` to look through the document targets table.
+   */
+  DocumentRowState ClassifyDocumentRow(const LevelDbSequenceNumberKey& row,
+                                       LevelDbTransaction::Iterator* it);
+
   bool UpdateMetadata(FSTQueryData* query_data);
   void SaveMetadata();
   /**
@@ -133,12 +296,65 @@ class LevelDbQueryCache : public QueryCache {
    */
   FSTQueryData* DecodeTarget(absl::string_view encoded);
 
+  /**
+   * Returns `query_data` with the resume token and snapshot version kept for
+   * it in the target resumes table, if they are newer than its own.
+   */
+  FSTQueryData* ApplyJournaledResume(FSTQueryData* query_data,
+                                     LevelDbTransaction* transaction);
+
   // This instance is owned by FSTLevelDB; avoid a retain cycle.
   __weak FSTLevelDB* db_;
   FSTLocalSerializer* serializer_;
   /** A write-through cached copy of the metadata for the query cache. */
   FSTPBTargetGlobal* metadata_;
   model::SnapshotVersion last_remote_snapshot_version_;
+
+  /**
+   * The sequence numbers of targets recently read or written, which saves
+   * decoding a target again to find its index entry when it is updated. Only
+   * writes through this cache change target rows, and transactions always
+   * commit, so entries can't go stale. The map is cleared when it reaches
+   * kMaxTrackedSequenceNumbers entries.
+   */
+  std::unordered_map<model::TargetId, model::ListenSequenceNumber>
+      target_sequence_numbers_;
+
+  /**
+   * The sequence numbers held by the sentinel rows of documents recently used,
+   * which lets WriteSentinel delete the previous index row without reading
+   * the sentinel. Like target_sequence_numbers_, entries can't go stale, and
+   * the map is cleared when it reaches kMaxTrackedSentinels entries.
+   */
+  std::unordered_map<model::DocumentKey,
+                     model::ListenSequenceNumber,
+                     model::DocumentKeyHash>
+      sentinel_sequence_numbers_;
+
+  /**
+   * The documents in any target, which lets lookups skip the document targets
+   * table for documents in none.
+   */
+  DocumentKeyFilter targeted_documents_;
+
+  /** A target added or found so far, and its decoded form once read. */
+  struct KnownTarget {
+    model::TargetId target_id;
+
+    /**
+     * The target as ReadTarget() last returned it, or nil if it has been
+     * written since.
+     */
+    FSTQueryData* _Nullable query_data;
+  };
+
+  /**
+   * The targets added or found so far, by the canonical hash of their query.
+   * A hit is only used once its query has been compared. Like the sequence
+   * numbers above, decoded targets can't go stale: every write to a target
+   * row or its resume row goes through this cache and drops the decoded copy.
+   */
+  std::unordered_multimap<uint64_t, KnownTarget> targets_by_canonical_hash_;
 };
 
 }  // namespace local
@@ -21,14 +21,17 @@
 
 #import "Firestore/Protos/objc/firestore/local/Target.pbobjc.h"
 #import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Local/FSTLRUGarbageCollector.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
 #import "Firestore/Source/Local/FSTLocalSerializer.h"
 #import "Firestore/Source/Local/FSTQueryData.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/util/string_apple.h"
-#include "absl/strings/match.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
 
 namespace firebase {
 namespace firestore {
@@ -53,8 +56,13 @@ FSTPBTargetGlobal* LevelDbQueryCache::ReadMetadata(leveldb::DB* db) {
               status.ToString());
   }
 
-  NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)value.data()
-                                              length:value.size()
+  return ParseMetadata(value);
+}
+
+FSTPBTargetGlobal* LevelDbQueryCache::ParseMetadata(
+    absl::string_view encoded) {
+  NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)encoded.data()
+                                              length:encoded.size()
                                         freeWhenDone:NO];
 
   NSError* error;
@@ -75,13 +83,17 @@ LevelDbQueryCache::LevelDbQueryCache(FSTLevelDB* db,
 // TODO(gsoltis): revisit having a Start method vs a static factory function
 // that returns a started instance.
 void LevelDbQueryCache::Start() {
-  // TODO(gsoltis): switch this usage of ptr to currentTransaction
-  metadata_ = ReadMetadata(db_.ptr);
-  HARD_ASSERT(metadata_ != nil,
-              "Found nil metadata, expected schema to be at version 0 which "
-              "ensures metadata existence");
+  Start(LevelDbStartupData::Load(db_.ptr));
+}
+
+void LevelDbQueryCache::Start(const LevelDbStartupData& startup_data) {
+  HARD_ASSERT(startup_data.has_target_global(),
+              "Found no target global row, expected schema to be at version 0 "
+              "which ensures metadata existence");
+  metadata_ = ParseMetadata(startup_data.target_global());
   last_remote_snapshot_version_ =
       [serializer_ decodedVersion:metadata_.lastRemoteSnapshotVersion];
+  targeted_documents_ = startup_data.targeted_documents();
 }
 
 void LevelDbQueryCache::AddTarget(FSTQueryData* query_data) {
@@ -90,8 +102,12 @@ void LevelDbQueryCache::AddTarget(FSTQueryData* query_data) {
   NSString* canonical_id = query_data.query.canonicalID;
   std::string index_key =
       LevelDbQueryTargetKey::Key(MakeString(canonical_id), query_data.targetID);
+  // Target IDs are never reused, so the row can't exist yet.
+  db_.currentTransaction->NoteCommittedSize(index_key, 0);
   std::string empty_buffer;
   db_.currentTransaction->Put(index_key, empty_buffer);
+  targets_by_canonical_hash_.emplace(
+      query_data.query.canonicalHash, KnownTarget{query_data.targetID, nil});
 
   metadata_.targetCount++;
   UpdateMetadata(query_data);
@@ -106,43 +122,89 @@ void LevelDbQueryCache::UpdateTarget(FSTQueryData* query_data) {
   }
 }
 
+void LevelDbQueryCache::UpdateResumeToken(FSTQueryData* query_data) {
+  FSTPBTarget* proto = [FSTPBTarget message];
+  proto.targetId = query_data.targetID;
+  proto.snapshotVersion =
+      [serializer_ encodedVersion:query_data.snapshotVersion];
+  proto.resumeToken = query_data.resumeToken;
+  db_.currentTransaction->Put(
+      LevelDbTargetResumeKey::Key(query_data.targetID), proto);
+  ForgetDecodedTarget(query_data.query.canonicalHash, query_data.targetID);
+}
+
 void LevelDbQueryCache::RemoveTarget(FSTQueryData* query_data) {
   TargetId target_id = query_data.targetID;
 
   RemoveAllKeysForTarget(target_id);
 
+  ListenSequenceNumber sequence_number = IndexedSequenceNumber(target_id);
+  if (sequence_number != kFSTListenSequenceNumberInvalid) {
+    DeleteIndexRow(LevelDbSequenceNumberKey::Key(sequence_number, target_id));
+  }
+  target_sequence_numbers_.erase(target_id);
+
   std::string key = LevelDbTargetKey::Key(target_id);
   db_.currentTransaction->Delete(key);
+  db_.currentTransaction->Delete(LevelDbTargetResumeKey::Key(target_id));
 
   std::string index_key = LevelDbQueryTargetKey::Key(
       MakeString(query_data.query.canonicalID), target_id);
+  db_.currentTransaction->NoteCommittedSize(
+      index_key, LevelDbTableSizes::RowSize(index_key, ""));
   db_.currentTransaction->Delete(index_key);
+  ForgetCanonicalHash(query_data.query.canonicalHash, target_id);
 
   metadata_.targetCount--;
   SaveMetadata();
 }
 
 FSTQueryData* _Nullable LevelDbQueryCache::GetTarget(FSTQuery* query) {
+  // Targets seen before are found by hash, which saves building the canonical
+  // ID key and scanning the query-target index. Unless the target has been
+  // written since it was last read, its decoded form is reused as well.
+  uint64_t canonical_hash = query.canonicalHash;
+  auto range = targets_by_canonical_hash_.equal_range(canonical_hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    KnownTarget& known = it->second;
+    if (!known.query_data) {
+      known.query_data = ReadTarget(known.target_id);
+    }
+    if (known.query_data && [known.query_data.query isEqual:query]) {
+      return known.query_data;
+    }
+  }
+
+  FSTQueryData* target = ScanForTarget(query);
+  if (target) {
+    ForgetCanonicalHash(canonical_hash, target.targetID);
+    targets_by_canonical_hash_.emplace(canonical_hash,
+                                       KnownTarget{target.targetID, target});
+  }
+  return target;
+}
+
+FSTQueryData* _Nullable LevelDbQueryCache::ScanForTarget(FSTQuery* query) {
+  LevelDbTransaction* transaction = db_.currentTransaction;
   // Scan the query-target index starting with a prefix starting with the given
   // query's canonicalID. Note that this is a scan rather than a get because
   // canonicalIDs are not required to be unique per target.
   std::string canonical_id = MakeString(query.canonicalID);
-  auto index_iterator = db_.currentTransaction->NewIterator();
-  std::string index_prefix = LevelDbQueryTargetKey::KeyPrefix(canonical_id);
-  index_iterator->Seek(index_prefix);
+  auto index_iterator =
+      transaction->NewIterator(LevelDbQueryTargetKey::KeyPrefix(canonical_id));
 
   // Simultaneously scan the targets table. This works because each
   // (canonicalID, targetID) pair is unique and ordered, so when scanning a
   // table prefixed by exactly one canonicalID, all the targetIDs will be unique
   // and in order.
-  std::string target_prefix = LevelDbTargetKey::KeyPrefix();
-  auto target_iterator = db_.currentTransaction->NewIterator();
+  auto target_iterator =
+      transaction->NewIterator(LevelDbTargetKey::KeyPrefix());
 
   LevelDbQueryTargetKey row_key;
-  for (; index_iterator->Valid(); index_iterator->Next()) {
+  for (index_iterator->SeekToFirst(); index_iterator->Valid();
+       index_iterator->Next()) {
     // Only consider rows matching exactly the specific canonicalID of interest.
-    if (!absl::StartsWith(index_iterator->key(), index_prefix) ||
-        !row_key.Decode(index_iterator->key()) ||
+    if (!row_key.Decode(index_iterator->key()) ||
         canonical_id != row_key.canonical_id()) {
       // End of this canonicalID's possible targets.
       break;
@@ -163,7 +225,7 @@ FSTQueryData* _Nullable LevelDbQueryCache::GetTarget(FSTQuery* query) {
     // equal to the requested query.
     FSTQueryData* target = DecodeTarget(target_iterator->value());
     if ([target.query isEqual:query]) {
-      return target;
+      return ApplyJournaledResume(target, transaction);
     }
   }
 
@@ -172,13 +234,11 @@ FSTQueryData* _Nullable LevelDbQueryCache::GetTarget(FSTQuery* query) {
 
 void LevelDbQueryCache::EnumerateTargets(TargetEnumerator block) {
   // Enumerate all targets, give their sequence numbers.
-  std::string target_prefix = LevelDbTargetKey::KeyPrefix();
-  auto it = db_.currentTransaction->NewIterator();
-  it->Seek(target_prefix);
+  auto it = db_.currentTransaction->NewIterator(LevelDbTargetKey::KeyPrefix());
   BOOL stop = NO;
-  for (; !stop && it->Valid() && absl::StartsWith(it->key(), target_prefix);
-       it->Next()) {
-    FSTQueryData* target = DecodeTarget(it->value());
+  for (it->SeekToFirst(); !stop && it->Valid(); it->Next()) {
+    FSTQueryData* target =
+        ApplyJournaledResume(DecodeTarget(it->value()), db_.currentTransaction);
     block(target, &stop);
   }
 }
@@ -186,18 +246,23 @@ void LevelDbQueryCache::EnumerateTargets(TargetEnumerator block) {
 int LevelDbQueryCache::RemoveTargets(
     ListenSequenceNumber upper_bound,
     NSDictionary<NSNumber*, FSTQueryData*>* live_targets) {
+  // Walk the sequence number index rather than the targets table so that only
+  // targets eligible for removal are decoded.
   int count = 0;
-  std::string target_prefix = LevelDbTargetKey::KeyPrefix();
-  auto it = db_.currentTransaction->NewIterator();
-  it->Seek(target_prefix);
-  for (; it->Valid() && absl::StartsWith(it->key(), target_prefix);
-       it->Next()) {
-    FSTQueryData* query_data = DecodeTarget(it->value());
-    if (query_data.sequenceNumber <= upper_bound &&
-        !live_targets[@(query_data.targetID)]) {
-      RemoveTarget(query_data);
-      count++;
+  auto it = NewSequenceNumberIterator(upper_bound);
+  LevelDbSequenceNumberKey row_key;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    HARD_ASSERT(row_key.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    if (!row_key.IsTarget() || live_targets[@(row_key.target_id())]) {
+      continue;
     }
+
+    FSTQueryData* query_data = ReadTarget(row_key.target_id());
+    HARD_ASSERT(query_data, "Dangling sequence number reference found: %s",
+                DescribeKey(it));
+    RemoveTarget(query_data);
+    count++;
   }
   return count;
 }
@@ -210,79 +275,67 @@ void LevelDbQueryCache::AddMatchingKeys(const DocumentKeySet& keys,
   // buffer (and the parser will see all default values).
   std::string empty_buffer;
 
+  DocumentKeySet added =
+      LevelDbTargetDocuments::AddKeys(db_.currentTransaction, target_id, keys);
   for (const DocumentKey& key : keys) {
-    db_.currentTransaction->Put(LevelDbTargetDocumentKey::Key(target_id, key),
-                                empty_buffer);
     db_.currentTransaction->Put(LevelDbDocumentTargetKey::Key(key, target_id),
                                 empty_buffer);
     [db_.referenceDelegate addReference:key];
   };
+
+  for (const DocumentKey& key : added) {
+    targeted_documents_.Add(key);
+  }
+  if (targeted_documents_.overfull()) {
+    // Resize the filter for the number of documents it now holds.
+    targeted_documents_ =
+        LevelDbStartupData::ReadTargetedDocuments(db_.currentTransaction);
+  }
 }
 
 void LevelDbQueryCache::RemoveMatchingKeys(const DocumentKeySet& keys,
                                            TargetId target_id) {
+  DocumentKeySet removed = LevelDbTargetDocuments::RemoveKeys(
+      db_.currentTransaction, target_id, keys);
   for (const DocumentKey& key : keys) {
-    db_.currentTransaction->Delete(
-        LevelDbTargetDocumentKey::Key(target_id, key));
     db_.currentTransaction->Delete(
         LevelDbDocumentTargetKey::Key(key, target_id));
     [db_.referenceDelegate removeReference:key];
   }
+
+  for (const DocumentKey& key : removed) {
+    targeted_documents_.Remove(key);
+  }
 }
 
 void LevelDbQueryCache::RemoveAllKeysForTarget(TargetId target_id) {
-  std::string index_prefix = LevelDbTargetDocumentKey::KeyPrefix(target_id);
-  auto index_iterator = db_.currentTransaction->NewIterator();
-  index_iterator->Seek(index_prefix);
-
-  LevelDbTargetDocumentKey row_key;
-  for (; index_iterator->Valid(); index_iterator->Next()) {
-    absl::string_view index_key = index_iterator->key();
-
-    // Only consider rows matching this specific targetID.
-    if (!row_key.Decode(index_key) || row_key.target_id() != target_id) {
-      break;
-    }
-    const DocumentKey& document_key = row_key.document_key();
-
-    // Delete both index rows
-    db_.currentTransaction->Delete(index_key);
+  DocumentKeySet removed =
+      LevelDbTargetDocuments::RemoveAllKeys(db_.currentTransaction, target_id);
+  for (const DocumentKey& document_key : removed) {
     db_.currentTransaction->Delete(
         LevelDbDocumentTargetKey::Key(document_key, target_id));
+    targeted_documents_.Remove(document_key);
   }
 }
 
 DocumentKeySet LevelDbQueryCache::GetMatchingKeys(TargetId target_id) {
-  std::string index_prefix = LevelDbTargetDocumentKey::KeyPrefix(target_id);
-  auto index_iterator = db_.currentTransaction->NewIterator();
-  index_iterator->Seek(index_prefix);
-
-  DocumentKeySet result;
-  LevelDbTargetDocumentKey row_key;
-  for (; index_iterator->Valid(); index_iterator->Next()) {
-    // TODO(gsoltis): could we use a StartsWith instead?
-    // Only consider rows matching this specific target_id.
-    if (!row_key.Decode(index_iterator->key()) ||
-        row_key.target_id() != target_id) {
-      break;
-    }
-
-    result = result.insert(row_key.document_key());
-  }
-
-  return result;
+  return LevelDbTargetDocuments::GetKeys(db_.currentTransaction, target_id);
 }
 
 bool LevelDbQueryCache::Contains(const DocumentKey& key) {
+  // Most documents asked about are in no target, which the filter can tell
+  // without a lookup.
+  if (!targeted_documents_.MightContain(key)) {
+    return false;
+  }
+
   // ignore sentinel rows when determining if a key belongs to a target.
   // Sentinel row just says the document exists, not that it's a member of any
   // particular target.
-  std::string index_prefix = LevelDbDocumentTargetKey::KeyPrefix(key.path());
-  auto index_iterator = db_.currentTransaction->NewIterator();
-  index_iterator->Seek(index_prefix);
+  auto index_iterator = db_.currentTransaction->NewIterator(
+      LevelDbDocumentTargetKey::KeyPrefix(key.path()));
 
-  for (; index_iterator->Valid() &&
-         absl::StartsWith(index_iterator->key(), index_prefix);
+  for (index_iterator->SeekToFirst(); index_iterator->Valid();
        index_iterator->Next()) {
     LevelDbDocumentTargetKey row_key;
     if (row_key.Decode(index_iterator->key()) && !row_key.IsSentinel() &&
@@ -307,16 +360,13 @@ void LevelDbQueryCache::SetLastRemoteSnapshotVersion(SnapshotVersion version) {
 
 void LevelDbQueryCache::EnumerateOrphanedDocuments(
     OrphanedDocumentEnumerator block) {
-  std::string document_target_prefix = LevelDbDocumentTargetKey::KeyPrefix();
-  auto it = db_.currentTransaction->NewIterator();
-  it->Seek(document_target_prefix);
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbDocumentTargetKey::KeyPrefix());
   ListenSequenceNumber next_to_report = 0;
   DocumentKey key_to_report;
   LevelDbDocumentTargetKey key;
   BOOL stop = NO;
-  for (; !stop && it->Valid() &&
-         absl::StartsWith(it->key(), document_target_prefix);
-       it->Next()) {
+  for (it->SeekToFirst(); !stop && it->Valid(); it->Next()) {
     HARD_ASSERT(key.Decode(it->key()), "Failed to decode DocumentTarget key");
     if (key.IsSentinel()) {
       // if next_to_report is non-zero, report it, this is a new key so the last
@@ -342,10 +392,296 @@ void LevelDbQueryCache::EnumerateOrphanedDocuments(
   }
 }
 
+void LevelDbQueryCache::EnumerateOrphanedDocuments(
+    ListenSequenceNumber upper_bound, OrphanedDocumentEnumerator block) {
+  auto it = NewSequenceNumberIterator(upper_bound);
+  auto document_target_iterator = db_.currentTransaction->NewIterator(
+      LevelDbDocumentTargetKey::KeyPrefix());
+  LevelDbSequenceNumberKey row_key;
+  BOOL stop = NO;
+  for (it->SeekToFirst(); !stop && it->Valid(); it->Next()) {
+    HARD_ASSERT(row_key.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    if (row_key.IsTarget()) continue;
+
+    switch (ClassifyDocumentRow(row_key, document_target_iterator.get())) {
+      case DocumentRowState::kStale:
+        DeleteIndexRow(std::string{it->key()});
+        break;
+      case DocumentRowState::kTargeted:
+        break;
+      case DocumentRowState::kOrphaned:
+        block(row_key.document_key(), row_key.sequence_number(), &stop);
+        break;
+    }
+  }
+}
+
+ListenSequenceNumber LevelDbQueryCache::NthSequenceNumber(size_t n) {
+  ListenSequenceNumber result = kFSTListenSequenceNumberInvalid;
+  if (n == 0) {
+    return result;
+  }
+
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbSequenceNumberKey::KeyPrefix());
+  auto document_target_iterator = db_.currentTransaction->NewIterator(
+      LevelDbDocumentTargetKey::KeyPrefix());
+  LevelDbSequenceNumberKey row_key;
+  size_t seen = 0;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    HARD_ASSERT(row_key.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    if (row_key.IsTarget() ||
+        ClassifyDocumentRow(row_key, document_target_iterator.get()) ==
+            DocumentRowState::kOrphaned) {
+      result = row_key.sequence_number();
+      if (++seen == n) {
+        break;
+      }
+    }
+  }
+  return result;
+}
+
+LruGcSlice LevelDbQueryCache::VisitSequenceNumbers(
+    std::string* cursor, int limit, const SequenceNumberVisitor& visitor) {
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbSequenceNumberKey::KeyPrefix());
+  if (cursor->empty()) {
+    it->SeekToFirst();
+  } else {
+    // The row under the cursor may have been removed since, in which case
+    // seeking to it lands on the row after it.
+    it->Seek(*cursor);
+    if (it->Valid() && it->key() == *cursor) {
+      it->Next();
+    }
+  }
+
+  auto document_target_iterator = db_.currentTransaction->NewIterator(
+      LevelDbDocumentTargetKey::KeyPrefix());
+  LevelDbSequenceNumberKey row_key;
+  LruGcSlice slice;
+  for (; slice.rows < limit && it->Valid(); it->Next()) {
+    HARD_ASSERT(row_key.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    *cursor = std::string{it->key()};
+    slice.rows++;
+    if (!row_key.IsTarget()) {
+      DocumentRowState state =
+          ClassifyDocumentRow(row_key, document_target_iterator.get());
+      if (state == DocumentRowState::kStale) {
+        DeleteIndexRow(std::string{it->key()});
+      }
+      if (state != DocumentRowState::kOrphaned) continue;
+    }
+    if (!visitor(row_key)) {
+      slice.finished = true;
+      return slice;
+    }
+  }
+
+  slice.finished = !it->Valid();
+  return slice;
+}
+
+void LevelDbQueryCache::WriteSentinel(const DocumentKey& key,
+                                      ListenSequenceNumber sequence_number) {
+  ListenSequenceNumber previous = SentinelSequenceNumber(key);
+  if (previous == sequence_number) {
+    return;
+  }
+
+  // What the sentinel replaces is known, so committing needn't read it.
+  std::string sentinel_key = LevelDbDocumentTargetKey::SentinelKey(key);
+  if (previous != kFSTListenSequenceNumberInvalid) {
+    db_.currentTransaction->NoteCommittedSize(
+        sentinel_key,
+        LevelDbTableSizes::RowSize(
+            sentinel_key,
+            LevelDbDocumentTargetKey::EncodeSentinelValue(previous)));
+    DeleteIndexRow(LevelDbSequenceNumberKey::Key(previous, key));
+  } else {
+    db_.currentTransaction->NoteCommittedSize(sentinel_key, 0);
+  }
+  db_.currentTransaction->Put(
+      std::move(sentinel_key),
+      LevelDbDocumentTargetKey::EncodeSentinelValue(sequence_number));
+  PutIndexRow(LevelDbSequenceNumberKey::Key(sequence_number, key));
+  TrackSentinel(key, sequence_number);
+}
+
+void LevelDbQueryCache::RemoveSentinel(const DocumentKey& key,
+                                       ListenSequenceNumber sequence_number) {
+  DeleteIndexRow(LevelDbSequenceNumberKey::Key(sequence_number, key));
+  db_.currentTransaction->Delete(LevelDbDocumentTargetKey::SentinelKey(key));
+  sentinel_sequence_numbers_.erase(key);
+}
+
 void LevelDbQueryCache::Save(FSTQueryData* query_data) {
   TargetId target_id = query_data.targetID;
+  ListenSequenceNumber sequence_number = query_data.sequenceNumber;
+
+  // Move the target's index entry if it was last used at a different time.
+  ListenSequenceNumber previous = IndexedSequenceNumber(target_id);
+  if (previous != sequence_number) {
+    if (previous != kFSTListenSequenceNumberInvalid) {
+      DeleteIndexRow(LevelDbSequenceNumberKey::Key(previous, target_id));
+    }
+    PutIndexRow(LevelDbSequenceNumberKey::Key(sequence_number, target_id));
+    TrackSequenceNumber(target_id, sequence_number);
+  }
+
+  // Clients from before target document blocks can't see which documents a
+  // target holds, so the target row never has a resume token they could use
+  // to skip fetching them. The token is only kept in the target resumes table.
+  FSTQueryData* without_resume =
+      [query_data queryDataByReplacingSnapshotVersion:SnapshotVersion::None()
+                                          resumeToken:[NSData data]
+                                       sequenceNumber:sequence_number];
   std::string key = LevelDbTargetKey::Key(target_id);
-  db_.currentTransaction->Put(key, [serializer_ encodedQueryData:query_data]);
+  db_.currentTransaction->Put(key,
+                              [serializer_ encodedQueryData:without_resume]);
+  UpdateResumeToken(query_data);
+}
+
+FSTQueryData* _Nullable LevelDbQueryCache::ReadTarget(TargetId target_id) {
+  std::string key = LevelDbTargetKey::Key(target_id);
+  std::string value;
+  Status status = db_.currentTransaction->Get(key, &value);
+  if (status.IsNotFound()) {
+    return nil;
+  } else if (!status.ok()) {
+    HARD_FAIL("Reading target %s failed with status: %s", target_id,
+              status.ToString());
+  }
+
+  FSTQueryData* query_data = DecodeTarget(value);
+  TrackSequenceNumber(target_id, query_data.sequenceNumber);
+  return ApplyJournaledResume(query_data, db_.currentTransaction);
+}
+
+void LevelDbQueryCache::ForgetCanonicalHash(uint64_t canonical_hash,
+                                            TargetId target_id) {
+  auto range = targets_by_canonical_hash_.equal_range(canonical_hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.target_id == target_id) {
+      targets_by_canonical_hash_.erase(it);
+      return;
+    }
+  }
+}
+
+void LevelDbQueryCache::ForgetDecodedTarget(uint64_t canonical_hash,
+                                            TargetId target_id) {
+  auto range = targets_by_canonical_hash_.equal_range(canonical_hash);
+  for (auto it = range.first; it != range.second; ++it) {
+    if (it->second.target_id == target_id) {
+      it->second.query_data = nil;
+      return;
+    }
+  }
+}
+
+ListenSequenceNumber LevelDbQueryCache::IndexedSequenceNumber(
+    TargetId target_id) {
+  auto found = target_sequence_numbers_.find(target_id);
+  if (found != target_sequence_numbers_.end()) {
+    return found->second;
+  }
+
+  FSTQueryData* query_data = ReadTarget(target_id);
+  return query_data ? query_data.sequenceNumber
+                    : kFSTListenSequenceNumberInvalid;
+}
+
+void LevelDbQueryCache::TrackSequenceNumber(
+    TargetId target_id, ListenSequenceNumber sequence_number) {
+  // Forgetting every entry is cheap to recover from: each target costs one
+  // read the next time it's saved.
+  if (target_sequence_numbers_.size() >= kMaxTrackedSequenceNumbers &&
+      target_sequence_numbers_.count(target_id) == 0) {
+    target_sequence_numbers_.clear();
+  }
+  target_sequence_numbers_[target_id] = sequence_number;
+}
+
+void LevelDbQueryCache::PutIndexRow(std::string key) {
+  db_.currentTransaction->NoteCommittedSize(key, 0);
+  std::string empty_buffer;
+  db_.currentTransaction->Put(std::move(key), std::move(empty_buffer));
+}
+
+void LevelDbQueryCache::DeleteIndexRow(const std::string& key) {
+  db_.currentTransaction->NoteCommittedSize(
+      key, LevelDbTableSizes::RowSize(key, ""));
+  db_.currentTransaction->Delete(key);
+}
+
+ListenSequenceNumber LevelDbQueryCache::SentinelSequenceNumber(
+    const DocumentKey& key) {
+  auto found = sentinel_sequence_numbers_.find(key);
+  if (found != sentinel_sequence_numbers_.end()) {
+    return found->second;
+  }
+
+  std::string value;
+  Status status = db_.currentTransaction->Get(
+      LevelDbDocumentTargetKey::SentinelKey(key), &value);
+  if (status.IsNotFound()) {
+    return kFSTListenSequenceNumberInvalid;
+  } else if (!status.ok()) {
+    HARD_FAIL("Reading sentinel of %s failed with status: %s", key.ToString(),
+              status.ToString());
+  }
+
+  ListenSequenceNumber sequence_number =
+      LevelDbDocumentTargetKey::DecodeSentinelValue(value);
+  TrackSentinel(key, sequence_number);
+  return sequence_number;
+}
+
+void LevelDbQueryCache::TrackSentinel(const DocumentKey& key,
+                                      ListenSequenceNumber sequence_number) {
+  if (sentinel_sequence_numbers_.size() >= kMaxTrackedSentinels &&
+      sentinel_sequence_numbers_.count(key) == 0) {
+    sentinel_sequence_numbers_.clear();
+  }
+  sentinel_sequence_numbers_[key] = sequence_number;
+}
+
+std::unique_ptr<LevelDbTransaction::Iterator>
+LevelDbQueryCache::NewSequenceNumberIterator(ListenSequenceNumber upper_bound) {
+  // Sequence numbers are encoded so that their keys sort in numeric order, so
+  // every row at or below the bound sorts before the successor of its prefix.
+  return db_.currentTransaction->NewIterator(
+      LevelDbSequenceNumberKey::KeyPrefix(),
+      util::PrefixSuccessor(LevelDbSequenceNumberKey::KeyPrefix(upper_bound)));
+}
+
+LevelDbQueryCache::DocumentRowState LevelDbQueryCache::ClassifyDocumentRow(
+    const LevelDbSequenceNumberKey& row, LevelDbTransaction::Iterator* it) {
+  const DocumentKey& key = row.document_key();
+  std::string sentinel_key = LevelDbDocumentTargetKey::SentinelKey(key);
+  it->Seek(sentinel_key);
+  if (!it->Valid() || it->key() != sentinel_key ||
+      LevelDbDocumentTargetKey::DecodeSentinelValue(it->value()) !=
+          row.sequence_number()) {
+    return DocumentRowState::kStale;
+  }
+
+  if (!targeted_documents_.MightContain(key)) {
+    return DocumentRowState::kOrphaned;
+  }
+
+  // The sentinel row sorts before the rows for any targets containing the
+  // document, so the row after it is the only one worth looking at.
+  it->Next();
+  LevelDbDocumentTargetKey row_key;
+  bool targeted = it->Valid() && row_key.Decode(it->key()) &&
+                  row_key.document_key() == key;
+  return targeted ? DocumentRowState::kTargeted : DocumentRowState::kOrphaned;
 }
 
 bool LevelDbQueryCache::UpdateMetadata(FSTQueryData* query_data) {
@@ -381,6 +717,37 @@ FSTQueryData* LevelDbQueryCache::DecodeTarget(absl::string_view encoded) {
   return [serializer_ decodedQueryData:proto];
 }
 
+FSTQueryData* LevelDbQueryCache::ApplyJournaledResume(
+    FSTQueryData* query_data, LevelDbTransaction* transaction) {
+  std::string value;
+  Status status = transaction->Get(
+      LevelDbTargetResumeKey::Key(query_data.targetID), &value);
+  if (status.IsNotFound()) {
+    return query_data;
+  } else if (!status.ok()) {
+    HARD_FAIL("Reading resume token of target %s failed with status: %s",
+              query_data.targetID, status.ToString());
+  }
+
+  NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)value.data()
+                                              length:value.size()
+                                        freeWhenDone:NO];
+  NSError* error;
+  FSTPBTarget* proto = [FSTPBTarget parseFromData:data error:&error];
+  if (!proto) {
+    HARD_FAIL("FSTPBTarget failed to parse: %s", error);
+  }
+
+  SnapshotVersion version = [serializer_ decodedVersion:proto.snapshotVersion];
+  if (version <= query_data.snapshotVersion) {
+    return query_data;
+  }
+  ListenSequenceNumber sequence_number = query_data.sequenceNumber;
+  return [query_data queryDataByReplacingSnapshotVersion:version
+                                             resumeToken:proto.resumeToken
+                                          sequenceNumber:sequence_number];
+}
+
 }  // namespace local
 }  // namespace firestore
 }  // namespace firebase
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_range_delete.h"
+
+#include <memory>
+#include <string>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_util.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
+#include "leveldb/write_batch.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using leveldb::DB;
+using leveldb::Iterator;
+using leveldb::ReadOptions;
+using leveldb::Slice;
+using leveldb::Status;
+using leveldb::WriteBatch;
+
+namespace {
+
+/**
+ * Reads the table sizes row into `sizes`, returning false if the row doesn't
+ * exist yet.
+ */
+bool ReadTableSizes(DB* db,
+                    const std::string& sizes_key,
+                    LevelDbTableSizes* sizes) {
+  std::string encoded;
+  Status status = db->Get(LevelDbTransaction::DefaultReadOptions(),
+                          MakeSlice(sizes_key), &encoded);
+  if (status.IsNotFound()) return false;
+
+  HARD_ASSERT(status.ok(), "Failed to read table sizes: %s", status.ToString());
+  HARD_ASSERT(sizes->Decode(encoded), "Failed to decode table sizes");
+  return true;
+}
+
+}  // namespace
+
+LevelDbRangeDeleteProgress DeleteRange(
+    DB* db,
+    absl::string_view begin,
+    absl::string_view limit,
+    const LevelDbRangeDeleteCallback& callback,
+    int max_batch_rows) {
+  HARD_ASSERT(max_batch_rows > 0, "max_batch_rows must be positive");
+
+  std::string sizes_key = LevelDbTableSizesKey::Key();
+  LevelDbTableSizes sizes;
+  bool track_sizes = ReadTableSizes(db, sizes_key, &sizes);
+
+  // The iterator reads from an implicit snapshot, so the batches written below
+  // don't disturb it. Its blocks are read only once, so keep them out of the
+  // cache.
+  ReadOptions read_options = LevelDbTransaction::DefaultReadOptions();
+  read_options.fill_cache = false;
+  std::unique_ptr<Iterator> it(db->NewIterator(read_options));
+
+  LevelDbRangeDeleteProgress progress;
+  WriteBatch batch;
+  int batch_rows = 0;
+
+  auto write_batch = [&] {
+    if (track_sizes) {
+      batch.Put(sizes_key, sizes.Encode());
+    }
+    Status status =
+        db->Write(LevelDbTransaction::DefaultWriteOptions(), &batch);
+    HARD_ASSERT(status.ok(), "Failed to delete range: %s", status.ToString());
+
+    batch.Clear();
+    batch_rows = 0;
+    progress.batches_written++;
+    if (callback) callback(progress);
+  };
+
+  for (it->Seek(MakeSlice(begin)); it->Valid(); it->Next()) {
+    absl::string_view key = MakeStringView(it->key());
+    if (!limit.empty() && key >= limit) break;
+    // The sizes row is rewritten by each batch rather than deleted.
+    if (key == sizes_key) continue;
+
+    int64_t row_size =
+        LevelDbTableSizes::RowSize(key, MakeStringView(it->value()));
+    if (track_sizes) {
+      sizes.Adjust(key, -row_size);
+    }
+    batch.Delete(it->key());
+    batch_rows++;
+    progress.rows_deleted++;
+    progress.bytes_deleted += row_size;
+
+    if (batch_rows >= max_batch_rows) {
+      write_batch();
+    }
+  }
+  HARD_ASSERT(it->status().ok(), "leveldb iterator reported an error: %s",
+              it->status().ToString());
+
+  if (batch_rows > 0) {
+    write_batch();
+  }
+
+  // Deleting only writes tombstones; compacting drops them along with the
+  // values they hide, instead of leaving every later scan to skip over them.
+  if (progress.rows_deleted > 0) {
+    Slice begin_slice = MakeSlice(begin);
+    Slice limit_slice = MakeSlice(limit);
+    db->CompactRange(&begin_slice, limit.empty() ? nullptr : &limit_slice);
+  }
+
+  return progress;
+}
+
+LevelDbRangeDeleteProgress DeleteEverythingWithPrefix(
+    DB* db,
+    absl::string_view prefix,
+    const LevelDbRangeDeleteCallback& callback,
+    int max_batch_rows) {
+  std::string limit = util::PrefixSuccessor(prefix);
+  return DeleteRange(db, prefix, limit, callback, max_batch_rows);
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
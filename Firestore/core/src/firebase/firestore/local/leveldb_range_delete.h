@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_RANGE_DELETE_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_RANGE_DELETE_H_
+
+#include <cstdint>
+#include <functional>
+
+#include "absl/strings/string_view.h"
+#include "leveldb/db.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** How far a range deletion has got. */
+struct LevelDbRangeDeleteProgress {
+  /** The number of rows deleted so far. */
+  int64_t rows_deleted = 0;
+
+  /** The number of bytes those rows counted, as in LevelDbTableSizes. */
+  int64_t bytes_deleted = 0;
+
+  /** The number of write batches committed so far. */
+  int batches_written = 0;
+};
+
+/** Called after each write batch a range deletion commits. */
+using LevelDbRangeDeleteCallback =
+    std::function<void(const LevelDbRangeDeleteProgress&)>;
+
+/**
+ * Deletes every row with a key in [begin, limit), or every row from `begin`
+ * onwards if `limit` is empty, and then compacts the deleted range.
+ *
+ * Unlike deleting through a LevelDbTransaction, keys are streamed from a single
+ * leveldb iterator straight into write batches of at most `max_batch_rows`
+ * rows, so the cost is a single pass over the range no matter how large it is.
+ * If the table sizes row exists, each batch adjusts it as well.
+ *
+ * Each batch commits on its own, so an interrupted deletion leaves part of the
+ * range in place. Callers must be able to rerun it, and must not run it while a
+ * LevelDbTransaction is open, since that transaction won't see the deletions.
+ *
+ * @param callback Called after each batch commits; may be empty.
+ * @return The totals for the whole deletion.
+ */
+LevelDbRangeDeleteProgress DeleteRange(
+    leveldb::DB* db,
+    absl::string_view begin,
+    absl::string_view limit,
+    const LevelDbRangeDeleteCallback& callback = {},
+    int max_batch_rows = 1000);
+
+/**
+ * Deletes every row with a key starting with `prefix`, as if by DeleteRange().
+ */
+LevelDbRangeDeleteProgress DeleteEverythingWithPrefix(
+    leveldb::DB* db,
+    absl::string_view prefix,
+    const LevelDbRangeDeleteCallback& callback = {},
+    int max_batch_rows = 1000);
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_RANGE_DELETE_H_
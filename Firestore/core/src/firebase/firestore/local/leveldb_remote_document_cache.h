@@ -21,14 +21,21 @@
 #error "For now, this file must only be included by ObjC source files."
 #endif  // !defined(__OBJC__)
 
+#include <string>
 #include <vector>
 
+#include "Firestore/core/src/firebase/firestore/local/decoded_document_cache.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
 #include "Firestore/core/src/firebase/firestore/local/remote_document_cache.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/model/document_map.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 
 @class FSTLevelDB;
 @class FSTLocalSerializer;
@@ -41,11 +48,44 @@ namespace firebase {
 namespace firestore {
 namespace local {
 
-/** Cached Remote Documents backed by leveldb. */
+/**
+ * Cached Remote Documents backed by leveldb.
+ *
+ * Every Add() and Remove() also appends the key of the document to the remote
+ * document changes table, in the same transaction, so the documents changed
+ * since any earlier point can be found without scanning the whole cache. The
+ * oldest changes are deleted periodically to keep the table bounded, so it is
+ * left out of the cache size that LRU garbage collection works towards.
+ */
 class LevelDbRemoteDocumentCache : public RemoteDocumentCache {
  public:
+  /** A cursor that precedes every change. */
+  static const int64_t kNoChanges = 0;
+
+  /** The number of most recent changes that truncation keeps. */
+  static const int64_t kDefaultMaxChanges = 100000;
+
+  /** The number of changes between truncations of the change log. */
+  static const int64_t kTruncationInterval = 1000;
+
+  /** The documents changed after some cursor in the change log. */
+  struct Changes {
+    /** The keys of the documents added or removed. */
+    model::DocumentKeySet keys;
+
+    /** The cursor to pass to GetChangedSince() to continue from here. */
+    int64_t cursor = kNoChanges;
+  };
+
   LevelDbRemoteDocumentCache(FSTLevelDB* db, FSTLocalSerializer* serializer);
 
+  /**
+   * Loads the compression dictionaries read into `startup_data`, which are
+   * needed to read stored documents. The most recently added dictionary is
+   * used for new writes.
+   */
+  void Start(const LevelDbStartupData& startup_data);
+
   void Add(FSTMaybeDocument* document) override;
   void Remove(const model::DocumentKey& key) override;
 
@@ -53,12 +93,101 @@ class LevelDbRemoteDocumentCache : public RemoteDocumentCache {
   model::MaybeDocumentMap GetAll(const model::DocumentKeySet& keys) override;
   model::DocumentMap GetMatching(FSTQuery* query) override;
 
+  DocumentChangeLog& change_log() override {
+    return change_log_;
+  }
+
+  /**
+   * Returns the documents changed after `cursor`, or nullopt if the change
+   * log no longer reaches back that far (or doesn't reach that far at all), in
+   * which case the caller needs to scan the whole cache instead.
+   *
+   * Must be called in a transaction.
+   *
+   * @param cursor kNoChanges, or the cursor returned by an earlier call.
+   */
+  absl::optional<Changes> GetChangedSince(int64_t cursor);
+
+  /**
+   * Deletes all but the most recent `max_changes` changes from the change
+   * log. At least the most recent change is always kept. Must be called in a
+   * transaction.
+   */
+  void TruncateChangeLog(int64_t max_changes);
+
+  /**
+   * Sets how many changes periodic truncation keeps, kDefaultMaxChanges by
+   * default.
+   */
+  void set_max_changes(int64_t max_changes) {
+    max_changes_ = max_changes;
+  }
+
+  const LevelDbValueCompressionOptions& compression_options() const {
+    return compressor_.options();
+  }
+
+  /**
+   * Controls how documents are compressed from now on. Documents already
+   * stored are unaffected and remain readable either way.
+   */
+  void SetCompressionOptions(LevelDbValueCompressionOptions options) {
+    compressor_.set_options(options);
+  }
+
+  /**
+   * Trains a compression dictionary from up to `max_samples` of the documents
+   * in the cache, stores it, and uses it to compress documents from now on.
+   * Must be called in a transaction.
+   */
+  void TrainCompressionDictionary(size_t max_samples);
+
+  /**
+   * The cache of recently decoded documents, which can be resized and reports
+   * its hit rate.
+   */
+  DecodedDocumentCache& decoded_documents() {
+    return decoded_documents_;
+  }
+
  private:
+  /**
+   * Decodes the stored document, going through the cache of decoded
+   * documents.
+   */
   FSTMaybeDocument* DecodeMaybeDocument(absl::string_view encoded,
                                         const model::DocumentKey& key);
 
+  /**
+   * Decodes the stored document without consulting or filling the cache of
+   * decoded documents, and sets `byte_size` to the size of its serialized
+   * form.
+   */
+  FSTMaybeDocument* ParseMaybeDocument(absl::string_view encoded,
+                                       const model::DocumentKey& key,
+                                       size_t* byte_size);
+
+  /**
+   * Appends a change to the given document to the change log, truncating the
+   * log every kTruncationInterval changes.
+   */
+  void RecordChange(const model::DocumentKey& key);
+
+  /**
+   * Returns the ID to give the next change, reading the last one from the
+   * change log if it hasn't been read yet.
+   */
+  int64_t NextChangeId();
+
   FSTLevelDB* db_;
   FSTLocalSerializer* serializer_;
+  LevelDbValueCompressor compressor_;
+  DecodedDocumentCache decoded_documents_;
+  DocumentChangeLog change_log_;
+
+  /** The ID of the next change, or zero if not yet read from the log. */
+  int64_t next_change_id_ = 0;
+  int64_t max_changes_ = kDefaultMaxChanges;
 };
 
 }  // namespace local
@@ -18,13 +18,17 @@
 
 #import <Foundation/Foundation.h>
 
+#include <algorithm>
 #include <string>
+#include <utility>
+#include <vector>
 
 #import "Firestore/Protos/objc/firestore/local/MaybeDocument.pbobjc.h"
 #import "Firestore/Source/Core/FSTQuery.h"
 #import "Firestore/Source/Local/FSTLevelDB.h"
 #import "Firestore/Source/Local/FSTLocalSerializer.h"
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
 #include "Firestore/core/src/firebase/firestore/util/status.h"
 #include "leveldb/db.h"
 
@@ -43,15 +47,54 @@ LevelDbRemoteDocumentCache::LevelDbRemoteDocumentCache(
     : db_(db), serializer_(serializer) {
 }
 
+void LevelDbRemoteDocumentCache::Start(
+    const LevelDbStartupData& startup_data) {
+  for (const auto& entry : startup_data.dictionaries()) {
+    compressor_.AddDictionary(entry.first, entry.second);
+  }
+  compressor_.SetActiveDictionary(compressor_.max_dictionary_id());
+}
+
 void LevelDbRemoteDocumentCache::Add(FSTMaybeDocument* document) {
   std::string ldb_key = LevelDbRemoteDocumentKey::Key(document.key);
-  db_.currentTransaction->Put(ldb_key,
-                              [serializer_ encodedMaybeDocument:document]);
+  NSData* data = [[serializer_ encodedMaybeDocument:document] data];
+  absl::string_view bytes{static_cast<const char*>(data.bytes), data.length};
+  std::string stored = compressor_.Encode(bytes);
+
+  // The next read will most likely be of what was just written.
+  decoded_documents_.Put(document.key,
+                         DecodedDocumentCache::Fingerprint(stored),
+                         bytes.size(), document);
+  db_.currentTransaction->Put(std::move(ldb_key), std::move(stored));
+  RecordChange(document.key);
+}
+
+void LevelDbRemoteDocumentCache::TrainCompressionDictionary(
+    size_t max_samples) {
+  std::vector<std::string> samples;
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbRemoteDocumentKey::KeyPrefix());
+  std::string buffer;
+  for (it->SeekToFirst(); it->Valid() && samples.size() < max_samples;
+       it->Next()) {
+    samples.emplace_back(compressor_.Decode(it->value(), &buffer));
+  }
+
+  std::string dictionary = LevelDbValueCompressor::TrainDictionary(samples);
+  if (dictionary.empty()) return;
+
+  int32_t dictionary_id = compressor_.max_dictionary_id() + 1;
+  db_.currentTransaction->Put(
+      LevelDbRemoteDocumentDictionaryKey::Key(dictionary_id), dictionary);
+  compressor_.AddDictionary(dictionary_id, std::move(dictionary));
+  compressor_.SetActiveDictionary(dictionary_id);
 }
 
 void LevelDbRemoteDocumentCache::Remove(const DocumentKey& key) {
   std::string ldb_key = LevelDbRemoteDocumentKey::Key(key);
   db_.currentTransaction->Delete(ldb_key);
+  decoded_documents_.Invalidate(key);
+  RecordChange(key);
 }
 
 FSTMaybeDocument* _Nullable LevelDbRemoteDocumentCache::Get(
@@ -74,10 +117,13 @@ MaybeDocumentMap LevelDbRemoteDocumentCache::GetAll(
   MaybeDocumentMap results;
 
   LevelDbRemoteDocumentKey currentKey;
-  auto it = db_.currentTransaction->NewIterator();
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbRemoteDocumentKey::KeyPrefix());
 
+  // DocumentKeySet is ordered the same way as the encoded remote document keys,
+  // so a single iterator can walk forward through the requested keys.
   for (const DocumentKey& key : keys) {
-    it->Seek(LevelDbRemoteDocumentKey::Key(key));
+    it->SeekForward(LevelDbRemoteDocumentKey::Key(key));
     if (!it->Valid() || !currentKey.Decode(it->key()) ||
         currentKey.document_key() != key) {
       results = results.insert(key, nil);
@@ -94,17 +140,19 @@ DocumentMap LevelDbRemoteDocumentCache::GetMatching(FSTQuery* query) {
 
   // Documents are ordered by key, so we can use a prefix scan to narrow down
   // the documents we need to match the query against.
-  std::string startKey = LevelDbRemoteDocumentKey::KeyPrefix(query.path);
-  auto it = db_.currentTransaction->NewIterator();
-  it->Seek(startKey);
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbRemoteDocumentKey::KeyPrefix(query.path));
 
+  // A scan can cover far more documents than the decoded document cache
+  // holds, so scanned documents bypass it rather than evict everything else.
   LevelDbRemoteDocumentKey currentKey;
-  for (; it->Valid() && currentKey.Decode(it->key()); it->Next()) {
-    FSTMaybeDocument* maybeDoc =
-        DecodeMaybeDocument(it->value(), currentKey.document_key());
-    if (!query.path.IsPrefixOf(maybeDoc.key.path())) {
-      break;
-    } else if ([maybeDoc isKindOfClass:[FSTDocument class]]) {
+  size_t byte_size;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    HARD_ASSERT(currentKey.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    FSTMaybeDocument* maybeDoc = ParseMaybeDocument(
+        it->value(), currentKey.document_key(), &byte_size);
+    if ([maybeDoc isKindOfClass:[FSTDocument class]]) {
       results =
           results.insert(maybeDoc.key, static_cast<FSTDocument*>(maybeDoc));
     }
@@ -113,10 +161,110 @@ DocumentMap LevelDbRemoteDocumentCache::GetMatching(FSTQuery* query) {
   return results;
 }
 
+absl::optional<LevelDbRemoteDocumentCache::Changes>
+LevelDbRemoteDocumentCache::GetChangedSince(int64_t cursor) {
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbRemoteDocumentChangeKey::KeyPrefix());
+  LevelDbRemoteDocumentChangeKey change_key;
+
+  // Truncation always keeps the latest change, so an empty log means there
+  // have been no changes at all.
+  it->SeekToLast();
+  if (!it->Valid()) {
+    if (cursor != kNoChanges) return absl::nullopt;
+    return Changes{};
+  }
+  HARD_ASSERT(change_key.Decode(it->key()), "Failed to decode %s",
+              DescribeKey(it));
+  int64_t last_change_id = change_key.change_id();
+  if (cursor > last_change_id) return absl::nullopt;
+
+  // Changes are numbered consecutively, so if the change right after the
+  // cursor has been truncated, some of the changes since are missing.
+  it->SeekToFirst();
+  HARD_ASSERT(change_key.Decode(it->key()), "Failed to decode %s",
+              DescribeKey(it));
+  if (change_key.change_id() > cursor + 1) return absl::nullopt;
+
+  Changes changes;
+  changes.cursor = last_change_id;
+  for (it->Seek(LevelDbRemoteDocumentChangeKey::KeyPrefix(cursor + 1));
+       it->Valid(); it->Next()) {
+    HARD_ASSERT(change_key.Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it));
+    changes.keys = changes.keys.insert(change_key.document_key());
+  }
+  return changes;
+}
+
+void LevelDbRemoteDocumentCache::TruncateChangeLog(int64_t max_changes) {
+  int64_t first_kept = NextChangeId() - std::max<int64_t>(max_changes, 1);
+  if (first_kept <= kNoChanges + 1) return;
+
+  auto it = db_.currentTransaction->NewIterator(
+      LevelDbRemoteDocumentChangeKey::KeyPrefix(),
+      LevelDbRemoteDocumentChangeKey::KeyPrefix(first_kept));
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    // Change rows have empty values, so there's no need to read them to
+    // account for their size.
+    db_.currentTransaction->NoteCommittedSize(
+        it->key(), LevelDbTableSizes::RowSize(it->key(), ""));
+    db_.currentTransaction->Delete(it->key());
+  }
+}
+
+void LevelDbRemoteDocumentCache::RecordChange(const DocumentKey& key) {
+  change_log_.Record(key);
+
+  int64_t change_id = NextChangeId();
+  next_change_id_++;
+  std::string change_key = LevelDbRemoteDocumentChangeKey::Key(change_id, key);
+  // Change IDs are never reused, so there is no previous row.
+  db_.currentTransaction->NoteCommittedSize(change_key, 0);
+  db_.currentTransaction->Put(std::move(change_key), std::string{});
+
+  if (change_id % kTruncationInterval == 0) {
+    TruncateChangeLog(max_changes_);
+  }
+}
+
+int64_t LevelDbRemoteDocumentCache::NextChangeId() {
+  if (next_change_id_ == 0) {
+    auto it = db_.currentTransaction->NewIterator(
+        LevelDbRemoteDocumentChangeKey::KeyPrefix());
+    it->SeekToLast();
+    next_change_id_ = kNoChanges + 1;
+    if (it->Valid()) {
+      LevelDbRemoteDocumentChangeKey change_key;
+      HARD_ASSERT(change_key.Decode(it->key()), "Failed to decode %s",
+                  DescribeKey(it));
+      next_change_id_ = change_key.change_id() + 1;
+    }
+  }
+  return next_change_id_;
+}
+
 FSTMaybeDocument* LevelDbRemoteDocumentCache::DecodeMaybeDocument(
     absl::string_view encoded, const DocumentKey& key) {
-  NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)encoded.data()
-                                              length:encoded.size()
+  uint64_t fingerprint = DecodedDocumentCache::Fingerprint(encoded);
+  FSTMaybeDocument* cached = decoded_documents_.Get(key, fingerprint);
+  if (cached) {
+    return cached;
+  }
+
+  size_t byte_size = 0;
+  FSTMaybeDocument* maybeDocument =
+      ParseMaybeDocument(encoded, key, &byte_size);
+  decoded_documents_.Put(key, fingerprint, byte_size, maybeDocument);
+  return maybeDocument;
+}
+
+FSTMaybeDocument* LevelDbRemoteDocumentCache::ParseMaybeDocument(
+    absl::string_view encoded, const DocumentKey& key, size_t* byte_size) {
+  std::string buffer;
+  absl::string_view bytes = compressor_.Decode(encoded, &buffer);
+  NSData* data = [[NSData alloc] initWithBytesNoCopy:(void*)bytes.data()
+                                              length:bytes.size()
                                         freeWhenDone:NO];
 
   NSError* error;
@@ -130,6 +278,7 @@ FSTMaybeDocument* LevelDbRemoteDocumentCache::DecodeMaybeDocument(
   HARD_ASSERT(maybeDocument.key == key,
               "Read document has key (%s) instead of expected key (%s).",
               maybeDocument.key.ToString(), key.ToString());
+  *byte_size = bytes.size();
   return maybeDocument;
 }
 
@@ -0,0 +1,207 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_startup_data.h"
+
+#include <future>  // NOLINT(build/c++11)
+#include <memory>
+#include <vector>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_util.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using leveldb::DB;
+using leveldb::Iterator;
+using leveldb::ReadOptions;
+using leveldb::Status;
+using model::BatchId;
+
+namespace {
+
+void AssertIteratorOk(const Iterator& it) {
+  HARD_ASSERT(it.status().ok(), "leveldb iterator reported an error: %s",
+              it.status().ToString());
+}
+
+/**
+ * Finds the users with queued mutations and the highest batch ID among them.
+ *
+ * Rather than visiting every mutation, this seeks past each user's batches and
+ * steps back to the last one, which has that user's highest batch ID.
+ */
+void ReadMutationQueues(DB* db,
+                        const ReadOptions& options,
+                        std::set<std::string>* users,
+                        BatchId* highest_batch_id) {
+  std::unique_ptr<Iterator> it(db->NewIterator(options));
+  LevelDbMutationKey row_key;
+
+  it->Seek(LevelDbMutationKey::KeyPrefix());
+  while (it->Valid() && row_key.Decode(MakeStringView(it->key()))) {
+    std::string user_id = row_key.user_id();
+    users->insert(user_id);
+
+    // Seek to the first row after this user's batches, then step back to the
+    // last of them.
+    it->Seek(util::PrefixSuccessor(LevelDbMutationKey::KeyPrefix(user_id)));
+    AssertIteratorOk(*it);
+    if (it->Valid()) {
+      it->Prev();
+    } else {
+      it->SeekToLast();
+    }
+    HARD_ASSERT(it->Valid() && row_key.Decode(MakeStringView(it->key())) &&
+                    row_key.user_id() == user_id,
+                "There should have been a mutation for user %s", user_id);
+    if (row_key.batch_id() > *highest_batch_id) {
+      *highest_batch_id = row_key.batch_id();
+    }
+
+    it->Next();
+  }
+  AssertIteratorOk(*it);
+}
+
+void ReadDictionaries(DB* db,
+                      const ReadOptions& options,
+                      std::map<int32_t, std::string>* dictionaries) {
+  std::unique_ptr<Iterator> it(db->NewIterator(options));
+  std::string prefix = LevelDbRemoteDocumentDictionaryKey::KeyPrefix();
+  LevelDbRemoteDocumentDictionaryKey dictionary_key;
+  for (it->Seek(prefix); it->Valid() && it->key().starts_with(prefix);
+       it->Next()) {
+    HARD_ASSERT(dictionary_key.Decode(MakeStringView(it->key())),
+                "Failed to decode dictionary key");
+    (*dictionaries)[dictionary_key.dictionary_id()] = it->value().ToString();
+  }
+  AssertIteratorOk(*it);
+}
+
+/**
+ * Builds a filter over the document keys of the rows with the given prefix,
+ * skipping rows for which `include` returns false.
+ */
+template <typename RowKey>
+DocumentKeyFilter ReadDocumentFilter(LevelDbTransaction* transaction,
+                                     const std::string& prefix,
+                                     RowKey* row_key,
+                                     bool (*include)(RowKey*)) {
+  // The filter is sized by the number of keys, so hash them all first.
+  std::vector<uint64_t> hashes;
+  auto it = transaction->NewIterator(prefix);
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    HARD_ASSERT(row_key->Decode(it->key()), "Failed to decode %s",
+                DescribeKey(it->key()));
+    if (include(row_key)) {
+      hashes.push_back(DocumentKeyFilter::KeyHash(row_key->document_key()));
+    }
+  }
+
+  DocumentKeyFilter filter{hashes.size()};
+  for (uint64_t hash : hashes) {
+    filter.AddHash(hash);
+  }
+  return filter;
+}
+
+}  // namespace
+
+DocumentKeyFilter LevelDbStartupData::ReadTargetedDocuments(
+    LevelDbTransaction* transaction) {
+  // Sentinel rows say that a document exists, not that a target contains it.
+  LevelDbDocumentTargetKey row_key;
+  return ReadDocumentFilter<LevelDbDocumentTargetKey>(
+      transaction, LevelDbDocumentTargetKey::KeyPrefix(), &row_key,
+      [](LevelDbDocumentTargetKey* key) { return !key->IsSentinel(); });
+}
+
+DocumentKeyFilter LevelDbStartupData::ReadMutatedDocuments(
+    LevelDbTransaction* transaction) {
+  LevelDbDocumentMutationKey row_key;
+  return ReadDocumentFilter<LevelDbDocumentMutationKey>(
+      transaction, LevelDbDocumentMutationKey::KeyPrefix(), &row_key,
+      [](LevelDbDocumentMutationKey*) { return true; });
+}
+
+LevelDbStartupData LevelDbStartupData::Load(DB* db) {
+  auto start = std::chrono::steady_clock::now();
+
+  // Every scan reads the same snapshot, so the results are consistent with one
+  // another.
+  const leveldb::Snapshot* snapshot = db->GetSnapshot();
+  ReadOptions options = LevelDbTransaction::DefaultReadOptions();
+  options.snapshot = snapshot;
+
+  LevelDbStartupData result;
+  std::future<void> mutation_queues = std::async(std::launch::async, [&] {
+    ReadMutationQueues(db, options, &result.users_, &result.highest_batch_id_);
+  });
+  std::future<void> dictionaries = std::async(std::launch::async, [&] {
+    ReadDictionaries(db, options, &result.dictionaries_);
+  });
+  std::future<void> targeted_documents = std::async(std::launch::async, [&] {
+    LevelDbTransaction transaction(db, "Read targeted documents", options);
+    result.targeted_documents_ = ReadTargetedDocuments(&transaction);
+  });
+  std::future<void> mutated_documents = std::async(std::launch::async, [&] {
+    LevelDbTransaction transaction(db, "Read mutated documents", options);
+    result.mutated_documents_ = ReadMutatedDocuments(&transaction);
+  });
+
+  // The target global row is a single lookup, so read it on this thread while
+  // the scans run.
+  Status status = db->Get(options, LevelDbTargetGlobalKey::Key(),
+                          &result.target_global_);
+  HARD_ASSERT(status.ok() || status.IsNotFound(),
+              "Failed to read target global: %s", status.ToString());
+  result.has_target_global_ = status.ok();
+
+  mutation_queues.get();
+  dictionaries.get();
+  targeted_documents.get();
+  mutated_documents.get();
+  db->ReleaseSnapshot(snapshot);
+
+  result.duration_ = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start);
+  return result;
+}
+
+int64_t LevelDbStartupData::WarmPrefix(DB* db, absl::string_view prefix) {
+  // Filling the block cache is the point, so leave fill_cache on.
+  std::unique_ptr<Iterator> it(
+      db->NewIterator(LevelDbTransaction::DefaultReadOptions()));
+
+  leveldb::Slice prefix_slice = MakeSlice(prefix);
+  int64_t rows = 0;
+  for (it->Seek(prefix_slice);
+       it->Valid() && it->key().starts_with(prefix_slice); it->Next()) {
+    rows++;
+  }
+  AssertIteratorOk(*it);
+  return rows;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,134 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_STARTUP_DATA_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_STARTUP_DATA_H_
+
+#include <chrono>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/model/types.h"
+#include "absl/strings/string_view.h"
+#include "leveldb/db.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * The rows that persistence reads while the database opens: the target global
+ * row, the set of users with queued mutations along with the highest batch ID
+ * among them, the remote document compression dictionaries, and filters over
+ * the documents that targets and mutation queues refer to.
+ *
+ * Load() reads them from a single snapshot with one leveldb iterator per table,
+ * running on separate threads, so that opening a large database costs about as
+ * much as its slowest scan rather than the sum of all of them.
+ */
+class LevelDbStartupData {
+ public:
+  /** The highest batch ID when no user has any queued mutations. */
+  static const model::BatchId kNoBatches = -1;
+
+  /** Reads the startup rows from `db`, in parallel. */
+  static LevelDbStartupData Load(leveldb::DB* db);
+
+  /**
+   * Reads every row with the given prefix and discards it, so that the blocks
+   * holding those rows are in leveldb's block cache by the time they are
+   * needed.
+   *
+   * @return The number of rows read.
+   */
+  static int64_t WarmPrefix(leveldb::DB* db, absl::string_view prefix);
+
+  /**
+   * Builds a filter over the documents in any target, from the document
+   * targets table as seen by `transaction`.
+   */
+  static DocumentKeyFilter ReadTargetedDocuments(
+      LevelDbTransaction* transaction);
+
+  /**
+   * Builds a filter over the documents with queued mutations for any user,
+   * from the document mutations table as seen by `transaction`.
+   */
+  static DocumentKeyFilter ReadMutatedDocuments(
+      LevelDbTransaction* transaction);
+
+  /** Whether the target global row exists. */
+  bool has_target_global() const {
+    return has_target_global_;
+  }
+
+  /** The encoded target global row, if it exists. */
+  const std::string& target_global() const {
+    return target_global_;
+  }
+
+  /** The users that have mutation batches queued. */
+  const std::set<std::string>& users() const {
+    return users_;
+  }
+
+  model::BatchId highest_batch_id() const {
+    return highest_batch_id_;
+  }
+
+  /** The remote document compression dictionaries, keyed by ID. */
+  const std::map<int32_t, std::string>& dictionaries() const {
+    return dictionaries_;
+  }
+
+  /** The documents in any target, from the document targets table. */
+  const DocumentKeyFilter& targeted_documents() const {
+    return targeted_documents_;
+  }
+
+  /**
+   * The documents with queued mutations for any user, from the document
+   * mutations table.
+   */
+  const DocumentKeyFilter& mutated_documents() const {
+    return mutated_documents_;
+  }
+
+  /** The wall time Load() took. */
+  std::chrono::microseconds duration() const {
+    return duration_;
+  }
+
+ private:
+  bool has_target_global_ = false;
+  std::string target_global_;
+  std::set<std::string> users_;
+  model::BatchId highest_batch_id_ = kNoBatches;
+  std::map<int32_t, std::string> dictionaries_;
+  DocumentKeyFilter targeted_documents_;
+  DocumentKeyFilter mutated_documents_;
+  std::chrono::microseconds duration_{0};
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_STARTUP_DATA_H_
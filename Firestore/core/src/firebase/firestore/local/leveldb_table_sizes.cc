@@ -0,0 +1,82 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using util::OrderedCode;
+
+namespace {
+
+const int64_t kTableSizesFormatVersion = 1;
+
+}  // namespace
+
+void LevelDbTableSizes::Adjust(absl::string_view key, int64_t delta) {
+  if (delta == 0) return;
+
+  int64_t& table_size = tables_[ExtractTableName(key)];
+  table_size += delta;
+  total_ += delta;
+}
+
+int64_t LevelDbTableSizes::TableSize(absl::string_view table_name) const {
+  auto found = tables_.find(std::string{table_name});
+  return found == tables_.end() ? 0 : found->second;
+}
+
+std::string LevelDbTableSizes::Encode() const {
+  std::string result;
+  OrderedCode::WriteSignedNumIncreasing(&result, kTableSizesFormatVersion);
+  for (const auto& entry : tables_) {
+    OrderedCode::WriteString(&result, entry.first);
+    OrderedCode::WriteSignedNumIncreasing(&result, entry.second);
+  }
+  return result;
+}
+
+bool LevelDbTableSizes::Decode(absl::string_view encoded) {
+  tables_.clear();
+  total_ = 0;
+
+  int64_t version = 0;
+  if (!OrderedCode::ReadSignedNumIncreasing(&encoded, &version) ||
+      version != kTableSizesFormatVersion) {
+    return false;
+  }
+
+  while (!encoded.empty()) {
+    std::string table_name;
+    int64_t table_size = 0;
+    if (!OrderedCode::ReadString(&encoded, &table_name) ||
+        !OrderedCode::ReadSignedNumIncreasing(&encoded, &table_size)) {
+      return false;
+    }
+    tables_[table_name] = table_size;
+    total_ += table_size;
+  }
+  return true;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
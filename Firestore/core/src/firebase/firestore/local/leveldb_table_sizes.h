@@ -0,0 +1,84 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TABLE_SIZES_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TABLE_SIZES_H_
+
+#include <cstdint>
+#include <map>
+#include <string>
+
+#include "absl/base/attributes.h"
+#include "absl/strings/string_view.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * Running totals of the number of bytes stored in each leveldb table, where
+ * each row counts the size of its key plus the size of its value.
+ *
+ * Once the table sizes row exists, LevelDbTransaction adjusts it as part of
+ * every commit, so reading the total size of the database costs a single
+ * lookup rather than a walk over its files or rows.
+ */
+class LevelDbTableSizes {
+ public:
+  /** Returns the number of bytes a row with the given key and value counts. */
+  static int64_t RowSize(absl::string_view key, absl::string_view value) {
+    return static_cast<int64_t>(key.size() + value.size());
+  }
+
+  /** Adds `delta` bytes, which may be negative, to the table of `key`. */
+  void Adjust(absl::string_view key, int64_t delta);
+
+  /** Returns the number of bytes stored in the table with the given name. */
+  int64_t TableSize(absl::string_view table_name) const;
+
+  /** Returns the number of bytes stored in all tables. */
+  int64_t total() const {
+    return total_;
+  }
+
+  /** Returns the number of bytes stored in each table, keyed by table name. */
+  const std::map<std::string, int64_t>& tables() const {
+    return tables_;
+  }
+
+  /** Encodes these sizes for storage in the table sizes row. */
+  std::string Encode() const;
+
+  /**
+   * Decodes sizes written by Encode(), replacing the contents of this
+   * instance.
+   *
+   * @return true if `encoded` was recognized. If false is returned, this
+   * instance is in an undefined state until the next call to `Decode()`.
+   */
+  ABSL_MUST_USE_RESULT
+  bool Decode(absl::string_view encoded);
+
+ private:
+  std::map<std::string, int64_t> tables_;
+  int64_t total_ = 0;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TABLE_SIZES_H_
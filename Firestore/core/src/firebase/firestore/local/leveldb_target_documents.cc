@@ -0,0 +1,277 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
+
+#include <algorithm>
+#include <iterator>
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/model/resource_path.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "Firestore/core/src/firebase/firestore/util/ordered_code.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKey;
+using model::DocumentKeySet;
+using model::ResourcePath;
+using model::TargetId;
+using util::OrderedCode;
+
+namespace {
+
+const int64_t kTargetDocumentBlockFormatVersion = 1;
+
+/**
+ * Reads the block the iterator points at into `keys`, failing if it doesn't
+ * decode.
+ */
+void ReadBlock(LevelDbTransaction::Iterator* it,
+               std::vector<DocumentKey>* keys) {
+  HARD_ASSERT(LevelDbTargetDocuments::DecodeBlock(it->value(), keys),
+              "Failed to decode target document block %s",
+              DescribeKey(it->key()));
+}
+
+/**
+ * Applies the sorted `keys` to the blocks of the given target, inserting them
+ * if `add` is true and removing them otherwise.
+ *
+ * Each key belongs in the last block whose first key is at or before it, or in
+ * the first block if there is no such block. Every key that falls in the same
+ * block is merged into it in one pass, and the block is then rewritten, split
+ * if it has grown too large.
+ *
+ * @return The keys that were actually inserted or removed.
+ */
+DocumentKeySet UpdateBlocks(LevelDbTransaction* transaction,
+                            TargetId target_id,
+                            const DocumentKeySet& keys,
+                            bool add) {
+  auto it = transaction->NewIterator(
+      LevelDbTargetDocumentBlockKey::KeyPrefix(target_id));
+  LevelDbTargetDocumentBlockKey block_key;
+  std::vector<DocumentKey> block;
+  std::vector<DocumentKey> changes;
+  std::vector<DocumentKey> merged;
+  std::vector<DocumentKey> changed;
+  DocumentKeySet result;
+
+  auto next_key = keys.begin();
+  while (next_key != keys.end()) {
+    it->Seek(LevelDbTargetDocumentBlockKey::Key(target_id, *next_key));
+    if (!it->Valid() ||
+        it->key() !=
+            LevelDbTargetDocumentBlockKey::Key(target_id, *next_key)) {
+      if (it->Valid()) {
+        it->Prev();
+      } else {
+        it->SeekToLast();
+      }
+      if (!it->Valid()) {
+        // Every block starts after this key, so it belongs in the first.
+        it->SeekToFirst();
+      }
+    }
+
+    std::string existing_block_key;
+    block.clear();
+    if (it->Valid()) {
+      existing_block_key = std::string{it->key()};
+      ReadBlock(it.get(), &block);
+      it->Next();
+    }
+
+    // Keys from the first key of the next block onwards belong to that one.
+    bool has_limit = it->Valid();
+    if (has_limit) {
+      HARD_ASSERT(block_key.Decode(it->key()), "Failed to decode %s",
+                  DescribeKey(it->key()));
+    }
+
+    changes.clear();
+    while (next_key != keys.end() &&
+           (!has_limit || *next_key < block_key.first_document_key())) {
+      changes.push_back(*next_key);
+      ++next_key;
+    }
+
+    merged.clear();
+    changed.clear();
+    if (add) {
+      std::set_union(block.begin(), block.end(), changes.begin(), changes.end(),
+                     std::back_inserter(merged));
+      std::set_difference(changes.begin(), changes.end(), block.begin(),
+                          block.end(), std::back_inserter(changed));
+    } else {
+      std::set_difference(block.begin(), block.end(), changes.begin(),
+                          changes.end(), std::back_inserter(merged));
+      std::set_intersection(changes.begin(), changes.end(), block.begin(),
+                            block.end(), std::back_inserter(changed));
+    }
+    if (changed.empty()) continue;
+
+    for (const DocumentKey& key : changed) {
+      result = result.insert(key);
+    }
+
+    if (!existing_block_key.empty()) {
+      transaction->Delete(existing_block_key);
+    }
+    LevelDbTargetDocuments::WriteBlocks(transaction, target_id, merged);
+  }
+  return result;
+}
+
+}  // namespace
+
+DocumentKeySet LevelDbTargetDocuments::AddKeys(LevelDbTransaction* transaction,
+                                               TargetId target_id,
+                                               const DocumentKeySet& keys) {
+  return UpdateBlocks(transaction, target_id, keys, /* add= */ true);
+}
+
+DocumentKeySet LevelDbTargetDocuments::RemoveKeys(
+    LevelDbTransaction* transaction,
+    TargetId target_id,
+    const DocumentKeySet& keys) {
+  return UpdateBlocks(transaction, target_id, keys, /* add= */ false);
+}
+
+DocumentKeySet LevelDbTargetDocuments::GetKeys(LevelDbTransaction* transaction,
+                                               TargetId target_id) {
+  auto it = transaction->NewIterator(
+      LevelDbTargetDocumentBlockKey::KeyPrefix(target_id));
+
+  DocumentKeySet result;
+  std::vector<DocumentKey> block;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    ReadBlock(it.get(), &block);
+    for (const DocumentKey& key : block) {
+      result = result.insert(key);
+    }
+  }
+  return result;
+}
+
+DocumentKeySet LevelDbTargetDocuments::RemoveAllKeys(
+    LevelDbTransaction* transaction, TargetId target_id) {
+  auto it = transaction->NewIterator(
+      LevelDbTargetDocumentBlockKey::KeyPrefix(target_id));
+
+  DocumentKeySet result;
+  std::vector<DocumentKey> block;
+  for (it->SeekToFirst(); it->Valid(); it->Next()) {
+    ReadBlock(it.get(), &block);
+    for (const DocumentKey& key : block) {
+      result = result.insert(key);
+    }
+    transaction->Delete(it->key());
+  }
+  return result;
+}
+
+void LevelDbTargetDocuments::WriteBlocks(LevelDbTransaction* transaction,
+                                         TargetId target_id,
+                                         const std::vector<DocumentKey>& keys) {
+  if (keys.empty()) return;
+
+  // Split evenly rather than filling all but the last block, so that each
+  // block has room to grow before it splits again.
+  size_t block_count = (keys.size() + kMaxBlockSize - 1) / kMaxBlockSize;
+  auto begin = keys.begin();
+  for (size_t i = 0; i < block_count; ++i) {
+    auto end = keys.begin() + (keys.size() * (i + 1)) / block_count;
+    std::vector<DocumentKey> block(begin, end);
+    transaction->Put(LevelDbTargetDocumentBlockKey::Key(target_id, *begin),
+                     EncodeBlock(block));
+    begin = end;
+  }
+}
+
+std::string LevelDbTargetDocuments::EncodeBlock(
+    const std::vector<DocumentKey>& keys) {
+  std::string result;
+  OrderedCode::WriteSignedNumIncreasing(&result,
+                                        kTargetDocumentBlockFormatVersion);
+  OrderedCode::WriteNumIncreasing(&result, keys.size());
+
+  const ResourcePath* previous = nullptr;
+  for (const DocumentKey& key : keys) {
+    const ResourcePath& path = key.path();
+    size_t shared = 0;
+    if (previous) {
+      size_t max_shared = std::min(previous->size(), path.size());
+      while (shared < max_shared && (*previous)[shared] == path[shared]) {
+        shared++;
+      }
+    }
+
+    OrderedCode::WriteNumIncreasing(&result, shared);
+    OrderedCode::WriteNumIncreasing(&result, path.size() - shared);
+    for (size_t i = shared; i < path.size(); ++i) {
+      OrderedCode::WriteString(&result, path[i]);
+    }
+    previous = &path;
+  }
+  return result;
+}
+
+bool LevelDbTargetDocuments::DecodeBlock(absl::string_view encoded,
+                                         std::vector<DocumentKey>* keys) {
+  keys->clear();
+
+  int64_t version = 0;
+  uint64_t count = 0;
+  if (!OrderedCode::ReadSignedNumIncreasing(&encoded, &version) ||
+      version != kTargetDocumentBlockFormatVersion ||
+      !OrderedCode::ReadNumIncreasing(&encoded, &count)) {
+    return false;
+  }
+
+  // Every entry takes at least two bytes, which bounds a corrupt count.
+  keys->reserve(std::min<uint64_t>(count, encoded.size() / 2));
+  std::vector<std::string> segments;
+  for (uint64_t i = 0; i < count; ++i) {
+    uint64_t shared = 0;
+    uint64_t added = 0;
+    if (!OrderedCode::ReadNumIncreasing(&encoded, &shared) ||
+        !OrderedCode::ReadNumIncreasing(&encoded, &added) ||
+        shared > segments.size()) {
+      return false;
+    }
+
+    segments.resize(shared);
+    for (uint64_t j = 0; j < added; ++j) {
+      std::string segment;
+      if (!OrderedCode::ReadString(&encoded, &segment)) return false;
+      segments.push_back(std::move(segment));
+    }
+
+    ResourcePath path{std::vector<std::string>(segments)};
+    if (path.empty() || !DocumentKey::IsDocumentKey(path)) return false;
+    keys->emplace_back(std::move(path));
+  }
+  return encoded.empty();
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -0,0 +1,114 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TARGET_DOCUMENTS_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TARGET_DOCUMENTS_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
+#include "Firestore/core/src/firebase/firestore/model/types.h"
+#include "absl/base/attributes.h"
+#include "absl/strings/string_view.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/**
+ * The documents in each target, stored as posting lists in the target document
+ * blocks table.
+ *
+ * Each block holds up to kMaxBlockSize of a target's documents in sorted order
+ * and is keyed by the first of them, so the blocks of a target partition its
+ * documents into consecutive runs. Within a block, each document key is stored
+ * as the number of leading path segments it shares with the key before it plus
+ * the segments that follow, which keeps documents from the same collection to
+ * little more than their IDs.
+ *
+ * Compared with a row per document, reading a target's documents costs one row
+ * per block, and adding or removing a sorted set of documents rewrites only the
+ * blocks the set falls into.
+ */
+class LevelDbTargetDocuments {
+ public:
+  /** The most documents a block holds before it is split. */
+  static const size_t kMaxBlockSize = 128;
+
+  /**
+   * Adds `keys` to the documents in the given target.
+   *
+   * @return The keys that weren't already in the target.
+   */
+  static model::DocumentKeySet AddKeys(LevelDbTransaction* transaction,
+                                       model::TargetId target_id,
+                                       const model::DocumentKeySet& keys);
+
+  /**
+   * Removes `keys` from the documents in the given target. Keys that aren't
+   * in the target are ignored.
+   *
+   * @return The keys that were in the target.
+   */
+  static model::DocumentKeySet RemoveKeys(LevelDbTransaction* transaction,
+                                          model::TargetId target_id,
+                                          const model::DocumentKeySet& keys);
+
+  /** Returns all the documents in the given target. */
+  static model::DocumentKeySet GetKeys(LevelDbTransaction* transaction,
+                                       model::TargetId target_id);
+
+  /**
+   * Removes all the documents in the given target.
+   *
+   * @return The documents that were removed.
+   */
+  static model::DocumentKeySet RemoveAllKeys(LevelDbTransaction* transaction,
+                                             model::TargetId target_id);
+
+  /**
+   * Writes `keys`, which must be sorted and must not overlap any existing
+   * block of the target, as one or more new blocks of at most kMaxBlockSize
+   * documents each.
+   */
+  static void WriteBlocks(LevelDbTransaction* transaction,
+                          model::TargetId target_id,
+                          const std::vector<model::DocumentKey>& keys);
+
+  /** Encodes a block holding `keys`, which must be sorted. */
+  static std::string EncodeBlock(const std::vector<model::DocumentKey>& keys);
+
+  /**
+   * Decodes a block written by EncodeBlock(), replacing the contents of
+   * `keys`.
+   *
+   * @return true if `encoded` was recognized. If false is returned, the
+   * contents of `keys` are unspecified.
+   */
+  ABSL_MUST_USE_RESULT
+  static bool DecodeBlock(absl::string_view encoded,
+                          std::vector<model::DocumentKey>* keys);
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_TARGET_DOCUMENTS_H_
@@ -17,8 +17,10 @@
 #include "Firestore/core/src/firebase/firestore/local/leveldb_transaction.h"
 
 #include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
 #include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
 #include "Firestore/core/src/firebase/firestore/util/log.h"
+#include "Firestore/core/src/firebase/firestore/util/string_util.h"
 #include "absl/memory/memory.h"
 #include "absl/strings/str_cat.h"
 #include "leveldb/write_batch.h"
@@ -35,54 +37,151 @@ namespace firestore {
 namespace local {
 
 LevelDbTransaction::Iterator::Iterator(LevelDbTransaction* txn)
+    : Iterator(txn, "", "") {
+}
+
+LevelDbTransaction::Iterator::Iterator(LevelDbTransaction* txn,
+                                       std::string lower_bound,
+                                       std::string upper_bound)
     : db_iter_(txn->db_->NewIterator(txn->read_options_)),
       last_version_(txn->version_),
       txn_(txn),
       mutations_iter_(txn->mutations_.begin()),
       current_(),
+      current_value_loaded_(false),
       is_mutation_(false),
       // Iterator doesn't really point to anything yet, so is
       // invalid
-      is_valid_(false) {
+      is_valid_(false),
+      reverse_(false),
+      lower_bound_(std::move(lower_bound)),
+      upper_bound_(std::move(upper_bound)) {
+}
+
+bool LevelDbTransaction::Iterator::InRange(Slice key) const {
+  return key.compare(lower_bound_) >= 0 &&
+         (upper_bound_.empty() || key.compare(upper_bound_) < 0);
 }
 
 void LevelDbTransaction::Iterator::UpdateCurrent() {
-  bool mutation_is_valid = mutations_iter_ != txn_->mutations_.end();
-  is_valid_ = mutation_is_valid || db_iter_->Valid();
+  bool mutation_is_valid = mutations_iter_ != txn_->mutations_.end() &&
+                           InRange(mutations_iter_->first);
+  bool db_is_valid = db_iter_->Valid() && InRange(db_iter_->key());
+  is_valid_ = mutation_is_valid || db_is_valid;
 
   if (is_valid_) {
     if (!mutation_is_valid) {
       is_mutation_ = false;
-    } else if (!db_iter_->Valid()) {
+    } else if (!db_is_valid) {
       is_mutation_ = true;
     } else {
-      // Both iterators are valid. If the leveldb key is equal to or greater
-      // than the current mutation key, we are looking at a mutation next. It's
-      // either sooner in the iteration or directly shadowing the underlying
-      // committed value in leveldb.
-      is_mutation_ = db_iter_->key().compare(mutations_iter_->first) >= 0;
+      // Both iterators are valid. If the leveldb key is equal to or past the
+      // current mutation key, we are looking at a mutation next. It's either
+      // sooner in the iteration or directly shadowing the underlying committed
+      // value in leveldb.
+      int comparison = db_iter_->key().compare(mutations_iter_->first);
+      is_mutation_ = reverse_ ? comparison <= 0 : comparison >= 0;
     }
     if (is_mutation_) {
       current_ = *mutations_iter_;
+      current_value_loaded_ = true;
     } else {
-      current_ = {db_iter_->key().ToString(), db_iter_->value().ToString()};
+      // Callers that step over entries only look at their keys, so the value
+      // is only copied out of leveldb once asked for.
+      Slice db_key = db_iter_->key();
+      current_.first.assign(db_key.data(), db_key.size());
+      current_.second.clear();
+      current_value_loaded_ = false;
     }
   }
 }
 
 void LevelDbTransaction::Iterator::Seek(const std::string& key) {
-  db_iter_->Seek(key);
+  const std::string& start = key < lower_bound_ ? lower_bound_ : key;
+  db_iter_->Seek(start);
   HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
               db_iter_->status().ToString());
-  for (; db_iter_->Valid() && IsDeleted(db_iter_->key()); db_iter_->Next()) {
+  for (; db_iter_->Valid() && InRange(db_iter_->key()) &&
+         IsDeleted(db_iter_->key());
+       db_iter_->Next()) {
   }
   HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
               db_iter_->status().ToString());
-  mutations_iter_ = txn_->mutations_.lower_bound(key);
+  mutations_iter_ = txn_->mutations_.lower_bound(start);
+  reverse_ = false;
   UpdateCurrent();
   last_version_ = txn_->version_;
 }
 
+void LevelDbTransaction::Iterator::SeekToFirst() {
+  Seek(lower_bound_);
+}
+
+void LevelDbTransaction::Iterator::SeekToLast() {
+  SeekReverse(upper_bound_, /*inclusive=*/false);
+}
+
+void LevelDbTransaction::Iterator::SeekReverse(absl::string_view limit,
+                                               bool inclusive) {
+  Mutations& mutations = txn_->mutations_;
+  if (limit.empty()) {
+    db_iter_->SeekToLast();
+    mutations_iter_ = mutations.end();
+  } else {
+    Slice limit_slice{limit.data(), limit.size()};
+    db_iter_->Seek(limit_slice);
+    if (!db_iter_->Valid()) {
+      db_iter_->SeekToLast();
+    } else {
+      int comparison = db_iter_->key().compare(limit_slice);
+      if (comparison > 0 || (comparison == 0 && !inclusive)) {
+        db_iter_->Prev();
+      }
+    }
+    std::string limit_key{limit};
+    mutations_iter_ = inclusive ? mutations.upper_bound(limit_key)
+                                : mutations.lower_bound(limit_key);
+  }
+  HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
+              db_iter_->status().ToString());
+
+  // mutations_iter_ is now just past the last candidate.
+  if (mutations_iter_ == mutations.begin()) {
+    mutations_iter_ = mutations.end();
+  } else {
+    --mutations_iter_;
+  }
+  for (; db_iter_->Valid() && InRange(db_iter_->key()) &&
+         IsDeleted(db_iter_->key());
+       db_iter_->Prev()) {
+  }
+  HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
+              db_iter_->status().ToString());
+
+  reverse_ = true;
+  UpdateCurrent();
+  last_version_ = txn_->version_;
+}
+
+void LevelDbTransaction::Iterator::SeekForward(const std::string& key) {
+  // A Seek() has to reposition every level of the underlying leveldb iterator,
+  // so stepping past a handful of entries is cheaper than seeking over them.
+  static const int kMaxNextsBeforeSeek = 8;
+
+  if (!is_valid_ || last_version_ < txn_->version_) {
+    Seek(key);
+    return;
+  }
+  for (int i = 0; i < kMaxNextsBeforeSeek; ++i) {
+    if (current_.first >= key) return;
+    Next();
+    if (!is_valid_) return;
+  }
+  if (current_.first < key) {
+    Seek(key);
+  }
+}
+
 absl::string_view LevelDbTransaction::Iterator::key() {
   HARD_ASSERT(Valid(), "key() called on invalid iterator");
   return current_.first;
@@ -90,6 +189,16 @@ absl::string_view LevelDbTransaction::Iterator::key() {
 
 absl::string_view LevelDbTransaction::Iterator::value() {
   HARD_ASSERT(Valid(), "value() called on invalid iterator");
+  if (!current_value_loaded_) {
+    // db_iter_ only moves along with current_, so it still points at the
+    // current entry.
+    Slice db_value = db_iter_->value();
+    current_.second.assign(db_value.data(), db_value.size());
+    current_value_loaded_ = true;
+    txn_->NoteCommittedSize(
+        current_.first,
+        LevelDbTableSizes::RowSize(current_.first, current_.second));
+  }
   return current_.second;
 }
 
@@ -98,7 +207,7 @@ bool LevelDbTransaction::Iterator::IsDeleted(leveldb::Slice slice) {
 }
 
 bool LevelDbTransaction::Iterator::SyncToTransaction() {
-  if (last_version_ < txn_->version_) {
+  if (last_version_ < txn_->version_ || reverse_) {
     // Intentionally copying here since Seek() may update current_. We need the
     // copy to do the comparison below.
     const std::string current_key = current_.first;
@@ -113,7 +222,17 @@ bool LevelDbTransaction::Iterator::SyncToTransaction() {
 void LevelDbTransaction::Iterator::AdvanceLDB() {
   do {
     db_iter_->Next();
-  } while (db_iter_->Valid() && IsDeleted(db_iter_->key()));
+  } while (db_iter_->Valid() && InRange(db_iter_->key()) &&
+           IsDeleted(db_iter_->key()));
+  HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
+              db_iter_->status().ToString());
+}
+
+void LevelDbTransaction::Iterator::RetreatLDB() {
+  do {
+    db_iter_->Prev();
+  } while (db_iter_->Valid() && InRange(db_iter_->key()) &&
+           IsDeleted(db_iter_->key()));
   HARD_ASSERT(db_iter_->status().ok(), "leveldb iterator reported an error: %s",
               db_iter_->status().ToString());
 }
@@ -135,6 +254,32 @@ void LevelDbTransaction::Iterator::Next() {
   }
 }
 
+void LevelDbTransaction::Iterator::Prev() {
+  HARD_ASSERT(Valid(), "Prev() called on invalid iterator");
+  if (last_version_ < txn_->version_ || !reverse_) {
+    // Intentionally copying here since SeekReverse() updates current_.
+    const std::string current_key = current_.first;
+    SeekReverse(current_key, /*inclusive=*/true);
+    // If the current entry was deleted, we've already moved back.
+    if (!is_valid_ || current_.first < current_key) return;
+  }
+
+  if (is_mutation_) {
+    // A mutation might be shadowing leveldb. If so, move both back.
+    if (db_iter_->Valid() && db_iter_->key() == mutations_iter_->first) {
+      RetreatLDB();
+    }
+    if (mutations_iter_ == txn_->mutations_.begin()) {
+      mutations_iter_ = txn_->mutations_.end();
+    } else {
+      --mutations_iter_;
+    }
+  } else {
+    RetreatLDB();
+  }
+  UpdateCurrent();
+}
+
 LevelDbTransaction::LevelDbTransaction(DB* db,
                                        absl::string_view label,
                                        const ReadOptions& read_options,
@@ -164,7 +309,7 @@ const WriteOptions& LevelDbTransaction::DefaultWriteOptions() {
 
 void LevelDbTransaction::Put(std::string key, std::string value) {
   deletions_.erase(key);
-  mutations_.emplace(std::make_pair(std::move(key), std::move(value)));
+  mutations_[std::move(key)] = std::move(value);
   version_++;
 }
 
@@ -173,6 +318,17 @@ LevelDbTransaction::NewIterator() {
   return absl::make_unique<LevelDbTransaction::Iterator>(this);
 }
 
+std::unique_ptr<LevelDbTransaction::Iterator> LevelDbTransaction::NewIterator(
+    absl::string_view prefix) {
+  return NewIterator(prefix, util::PrefixSuccessor(prefix));
+}
+
+std::unique_ptr<LevelDbTransaction::Iterator> LevelDbTransaction::NewIterator(
+    absl::string_view lower_bound, absl::string_view upper_bound) {
+  return absl::make_unique<LevelDbTransaction::Iterator>(
+      this, std::string{lower_bound}, std::string{upper_bound});
+}
+
 Status LevelDbTransaction::Get(absl::string_view key, std::string* value) {
   std::string key_string(key);
   if (deletions_.find(key_string) != deletions_.end()) {
@@ -183,11 +339,27 @@ Status LevelDbTransaction::Get(absl::string_view key, std::string* value) {
       *value = iter->second;
       return Status::OK();
     } else {
-      return db_->Get(read_options_, key_string, value);
+      Status status = db_->Get(read_options_, key_string, value);
+      if (status.ok()) {
+        NoteCommittedSize(key_string,
+                          LevelDbTableSizes::RowSize(key_string, *value));
+      } else if (status.IsNotFound()) {
+        NoteCommittedSize(key_string, 0);
+      }
+      return status;
     }
   }
 }
 
+void LevelDbTransaction::NoteCommittedSize(absl::string_view key,
+                                           int64_t size) {
+  std::string key_string{key};
+  if (mutations_.count(key_string) != 0 || deletions_.count(key_string) != 0) {
+    return;
+  }
+  committed_sizes_.emplace(std::move(key_string), size);
+}
+
 void LevelDbTransaction::Delete(absl::string_view key) {
   std::string to_delete(key);
   deletions_.insert(to_delete);
@@ -205,6 +377,8 @@ void LevelDbTransaction::Commit() {
     batch.Put(entry.first, entry.second);
   }
 
+  UpdateTableSizes(&batch);
+
   LOG_DEBUG("Committing transaction: %s", ToString());
 
   Status status = db_->Write(write_options_, &batch);
@@ -212,6 +386,55 @@ void LevelDbTransaction::Commit() {
               ToString(), status.ToString());
 }
 
+void LevelDbTransaction::UpdateTableSizes(WriteBatch* batch) {
+  std::string sizes_key = LevelDbTableSizesKey::Key();
+  // A transaction that writes the row itself has computed the sizes already.
+  if (mutations_.count(sizes_key) != 0 || deletions_.count(sizes_key) != 0) {
+    return;
+  }
+
+  LevelDbTableSizes stored;
+  LevelDbTableSizes* sizes = table_sizes_;
+  if (!sizes) {
+    std::string encoded;
+    Status status = db_->Get(read_options_, sizes_key, &encoded);
+    if (status.IsNotFound()) {
+      // Sizes aren't tracked until the migration that computes them has run.
+      return;
+    }
+    HARD_ASSERT(status.ok(), "Failed to read table sizes: %s",
+                status.ToString());
+    HARD_ASSERT(stored.Decode(encoded), "Failed to decode table sizes");
+    sizes = &stored;
+  }
+
+  // Only the rows whose committed size is still unknown cost a lookup.
+  std::string previous;
+  auto committed_size = [&](const std::string& key) -> int64_t {
+    auto found = committed_sizes_.find(key);
+    if (found != committed_sizes_.end()) {
+      return found->second;
+    }
+    Status status = db_->Get(read_options_, key, &previous);
+    if (status.IsNotFound()) {
+      return 0;
+    }
+    HARD_ASSERT(status.ok(), "Failed to read %s: %s", DescribeKey(key),
+                status.ToString());
+    return LevelDbTableSizes::RowSize(key, previous);
+  };
+
+  for (const auto& deletion : deletions_) {
+    sizes->Adjust(deletion, -committed_size(deletion));
+  }
+  for (const auto& entry : mutations_) {
+    int64_t new_size = LevelDbTableSizes::RowSize(entry.first, entry.second);
+    sizes->Adjust(entry.first, new_size - committed_size(entry.first));
+  }
+
+  batch->Put(sizes_key, sizes->Encode());
+}
+
 std::string LevelDbTransaction::ToString() {
   std::string dest = absl::StrCat("<LevelDbTransaction ", label_, ": ");
   size_t changes = deletions_.size() + mutations_.size();
@@ -22,6 +22,7 @@
 #include <memory>
 #include <set>
 #include <string>
+#include <unordered_map>
 #include <utility>
 
 #include "absl/strings/string_view.h"
@@ -35,6 +36,8 @@ namespace firebase {
 namespace firestore {
 namespace local {
 
+class LevelDbTableSizes;
+
 /**
  * LevelDBTransaction tracks pending changes to entries in leveldb, including
  * deletions. It also provides an Iterator to traverse a merged view of pending
@@ -53,6 +56,17 @@ class LevelDbTransaction {
    public:
     explicit Iterator(LevelDbTransaction* txn);
 
+    /**
+     * Creates an iterator that only visits keys in [lower_bound, upper_bound),
+     * or every key from `lower_bound` onwards if `upper_bound` is empty. Keys
+     * outside the range are never merged with pending changes or checked for
+     * deletion, so scanning a small range of a large table stops as soon as
+     * the range ends.
+     */
+    Iterator(LevelDbTransaction* txn,
+             std::string lower_bound,
+             std::string upper_bound);
+
     /**
      * Returns true if this iterator points to an entry
      */
@@ -66,11 +80,34 @@ class LevelDbTransaction {
      */
     void Seek(const std::string& key);
 
+    /**
+     * Seeks this iterator to the first key in its range.
+     */
+    void SeekToFirst();
+
+    /**
+     * Seeks this iterator to the last key in its range.
+     */
+    void SeekToLast();
+
+    /**
+     * Moves this iterator forward to the first key equal to or greater than the
+     * given key. Unlike Seek(), this never moves the iterator backwards, and it
+     * steps with Next() when the key is only a few entries ahead. Walking a
+     * sorted list of nearby keys this way avoids most of the cost of seeking.
+     */
+    void SeekForward(const std::string& key);
+
     /**
      * Advances the iterator to the next entry
      */
     void Next();
 
+    /**
+     * Moves the iterator back to the previous entry
+     */
+    void Prev();
+
     /**
      * Returns the key of the current entry
      */
@@ -87,6 +124,21 @@ class LevelDbTransaction {
      */
     void AdvanceLDB();
 
+    /**
+     * Moves back to the previous non-deleted key in leveldb.
+     */
+    void RetreatLDB();
+
+    /**
+     * Positions both internal iterators at the last entries before `limit`,
+     * or at or before it if `inclusive`, ready to iterate in reverse. An empty
+     * `limit` positions them at the very last entries.
+     */
+    void SeekReverse(absl::string_view limit, bool inclusive);
+
+    /** Returns true if the given key is within this iterator's range. */
+    bool InRange(leveldb::Slice key) const;
+
     /**
      * Returns true if the given slice matches a key present in the deletions_
      * set.
@@ -95,9 +147,10 @@ class LevelDbTransaction {
 
     /**
      * Syncs with the underlying transaction. If the transaction has been
-     * updated, the mutation iterator may need to be reset. Returns true if this
-     * resulted in moving to a new underlying entry (i.e. the entry represented
-     * by current_ was deleted).
+     * updated, or the iterator was last moving in reverse, the internal
+     * iterators need to be reset. Returns true if this resulted in moving to a
+     * new underlying entry (i.e. the entry represented by current_ was
+     * deleted).
      */
     bool SyncToTransaction();
 
@@ -118,12 +171,23 @@ class LevelDbTransaction {
     // remains so at least until the next call to Seek() or Next(), even if the
     // underlying data is deleted.
     std::pair<std::string, std::string> current_;
+    // True if current_.second holds the value of the current entry. Values of
+    // committed entries are only read from db_iter_ when value() is called.
+    bool current_value_loaded_;
     // True if current_ represents an entry in the mutations_ map, rather than
     // committed data.
     bool is_mutation_;
     // True if the iterator pointed to a valid entry the last time Next() or
     // Seek() was called.
     bool is_valid_;
+    // True if the internal iterators are positioned for Prev() rather than
+    // Next(). In reverse, mutations_iter_ points at the last mutation at or
+    // before current_, or at the end if there is none.
+    bool reverse_;
+    // The range of keys this iterator visits. An empty upper bound means the
+    // range has no end.
+    std::string lower_bound_;
+    std::string upper_bound_;
   };
 
   explicit LevelDbTransaction(
@@ -150,6 +214,16 @@ class LevelDbTransaction {
     return mutations_.size() + deletions_.size();
   }
 
+  /**
+   * Makes Commit() adjust `table_sizes` in place, and write them as the table
+   * sizes row, rather than reading the row back from leveldb. The owner of the
+   * database keeps these in memory for as long as it's open, so they must
+   * outlive the transaction.
+   */
+  void set_table_sizes(LevelDbTableSizes* table_sizes) {
+    table_sizes_ = table_sizes;
+  }
+
   /**
    * Remove the database entry (if any) for "key".  It is not an error if "key"
    * did not exist in the database.
@@ -164,6 +238,7 @@ class LevelDbTransaction {
   void Put(absl::string_view key, GPBMessage* message) {
     NSData* data = [message data];
     std::string key_string(key);
+    deletions_.erase(key_string);
     mutations_[key_string] = std::string((const char*)data.bytes, data.length);
     version_++;
   }
@@ -190,17 +265,60 @@ class LevelDbTransaction {
   std::unique_ptr<Iterator> NewIterator();
 
   /**
-   * Commits the transaction. All pending changes are written. The transaction
+   * Returns a new Iterator like NewIterator(), but which only visits keys that
+   * start with `prefix`.
+   */
+  std::unique_ptr<Iterator> NewIterator(absl::string_view prefix);
+
+  /**
+   * Returns a new Iterator like NewIterator(), but which only visits keys in
+   * [lower_bound, upper_bound), or every key from `lower_bound` onwards if
+   * `upper_bound` is empty.
+   */
+  std::unique_ptr<Iterator> NewIterator(absl::string_view lower_bound,
+                                        absl::string_view upper_bound);
+
+  /**
+   * Tells Commit() how many bytes the committed row for `key` counts, as
+   * LevelDbTableSizes::RowSize() does, or 0 if there is no such row. Callers
+   * that know what a change replaces, such as an index row with an empty
+   * value, call this before making the change so that Commit() needn't read
+   * the row. It has no effect once `key` has been changed in this
+   * transaction, since the caller can then only describe the pending row.
+   */
+  void NoteCommittedSize(absl::string_view key, int64_t size);
+
+  /**
+   * Commits the transaction. All pending changes are written, along with an
+   * update to the table sizes row if the database has one. The transaction
    * should not be used after calling this method.
+   *
+   * Table sizes are adjusted by exactly how much each changed row grew or
+   * shrank. The size of a replaced row is taken from the transaction's own
+   * reads of it or from NoteCommittedSize(); only the changed rows whose
+   * size is known neither way are read here.
    */
   void Commit();
 
   std::string ToString();
 
  private:
+  /**
+   * Adds the changes in this transaction to the table sizes, if the database
+   * tracks them, and schedules the updated row to be written as part of
+   * `batch`.
+   */
+  void UpdateTableSizes(leveldb::WriteBatch* batch);
+
   leveldb::DB* db_;
   Mutations mutations_;
   Deletions deletions_;
+  // The sizes of committed rows this transaction has read or been told about,
+  // counting missing rows as zero.
+  std::unordered_map<std::string, int64_t> committed_sizes_;
+  // The in-memory table sizes to adjust on commit, or nullptr to read and
+  // adjust the table sizes row.
+  LevelDbTableSizes* table_sizes_ = nullptr;
   leveldb::ReadOptions read_options_;
   leveldb::WriteOptions write_options_;
   int32_t version_;
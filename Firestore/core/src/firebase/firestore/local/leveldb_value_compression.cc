@@ -0,0 +1,245 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
+
+#include <zlib.h>
+
+#include <algorithm>
+#include <set>
+#include <unordered_map>
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+namespace {
+
+const char kHeaderMarker = '\0';
+const uint8_t kFormatVersion = 1;
+const size_t kHeaderSize = 11;
+
+// Raw deflate streams, without the zlib header and checksum: leveldb already
+// checksums its blocks.
+const int kWindowBits = -15;
+const int kMemLevel = 8;
+
+void AppendUint32(std::string* dest, uint32_t value) {
+  for (int i = 0; i < 4; ++i) {
+    dest->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+  }
+}
+
+uint32_t ReadUint32(absl::string_view src) {
+  uint32_t value = 0;
+  for (int i = 0; i < 4; ++i) {
+    value |= static_cast<uint32_t>(static_cast<uint8_t>(src[i])) << (8 * i);
+  }
+  return value;
+}
+
+Bytef* ToBytef(const char* data) {
+  return reinterpret_cast<Bytef*>(const_cast<char*>(data));
+}
+
+}  // namespace
+
+const int32_t LevelDbValueCompressor::kNoDictionary;
+const size_t LevelDbValueCompressor::kMaxDictionarySize;
+const size_t LevelDbValueCompressor::kMaxValueSize;
+
+LevelDbValueCompressor::LevelDbValueCompressor(
+    LevelDbValueCompressionOptions options)
+    : options_(options) {
+}
+
+void LevelDbValueCompressor::AddDictionary(int32_t dictionary_id,
+                                           std::string dictionary) {
+  HARD_ASSERT(dictionary_id > kNoDictionary, "Invalid dictionary id %s",
+              dictionary_id);
+  // Values already stored under this id must stay decodable.
+  auto found = dictionaries_.find(dictionary_id);
+  if (found != dictionaries_.end()) {
+    HARD_ASSERT(found->second == dictionary,
+                "Compression dictionary %s redefined", dictionary_id);
+    return;
+  }
+  dictionaries_.emplace(dictionary_id, std::move(dictionary));
+}
+
+void LevelDbValueCompressor::SetActiveDictionary(int32_t dictionary_id) {
+  HARD_ASSERT(dictionary_id == kNoDictionary || FindDictionary(dictionary_id),
+              "Unknown compression dictionary %s", dictionary_id);
+  active_dictionary_id_ = dictionary_id;
+}
+
+int32_t LevelDbValueCompressor::max_dictionary_id() const {
+  return dictionaries_.empty() ? kNoDictionary : dictionaries_.rbegin()->first;
+}
+
+const std::string* LevelDbValueCompressor::FindDictionary(
+    int32_t dictionary_id) const {
+  auto found = dictionaries_.find(dictionary_id);
+  return found == dictionaries_.end() ? nullptr : &found->second;
+}
+
+bool LevelDbValueCompressor::IsCompressed(absl::string_view stored) {
+  return stored.size() >= kHeaderSize && stored[0] == kHeaderMarker;
+}
+
+std::string LevelDbValueCompressor::Encode(absl::string_view value) const {
+  if (!options_.enabled || value.size() < options_.min_size ||
+      value.size() > kMaxValueSize) {
+    return std::string{value};
+  }
+
+  z_stream stream{};
+  int status = deflateInit2(&stream, options_.level, Z_DEFLATED, kWindowBits,
+                            kMemLevel, Z_DEFAULT_STRATEGY);
+  HARD_ASSERT(status == Z_OK, "deflateInit2 failed: %s", status);
+
+  int32_t dictionary_id = active_dictionary_id();
+  const std::string* dictionary = FindDictionary(dictionary_id);
+  if (dictionary) {
+    status = deflateSetDictionary(&stream, ToBytef(dictionary->data()),
+                                  static_cast<uInt>(dictionary->size()));
+    HARD_ASSERT(status == Z_OK, "deflateSetDictionary failed: %s", status);
+  }
+
+  std::string result;
+  result.push_back(kHeaderMarker);
+  result.push_back(static_cast<char>(kFormatVersion));
+  result.push_back(static_cast<char>(Codec::Deflate));
+  AppendUint32(&result, static_cast<uint32_t>(dictionary_id));
+  AppendUint32(&result, static_cast<uint32_t>(value.size()));
+
+  uLong bound = deflateBound(&stream, static_cast<uLong>(value.size()));
+  result.resize(kHeaderSize + bound);
+
+  stream.next_in = ToBytef(value.data());
+  stream.avail_in = static_cast<uInt>(value.size());
+  stream.next_out = ToBytef(&result[kHeaderSize]);
+  stream.avail_out = static_cast<uInt>(bound);
+  status = deflate(&stream, Z_FINISH);
+  HARD_ASSERT(status == Z_STREAM_END, "deflate failed: %s", status);
+
+  result.resize(kHeaderSize + stream.total_out);
+  deflateEnd(&stream);
+
+  // Small or incompressible values can grow, in which case storing them as is
+  // is both smaller and faster to read.
+  if (result.size() >= value.size()) {
+    return std::string{value};
+  }
+  return result;
+}
+
+absl::string_view LevelDbValueCompressor::Decode(absl::string_view stored,
+                                                 std::string* buffer) const {
+  if (!IsCompressed(stored)) {
+    return stored;
+  }
+
+  uint8_t version = static_cast<uint8_t>(stored[1]);
+  HARD_ASSERT(version == kFormatVersion,
+              "Unsupported compressed value version %s",
+              static_cast<int>(version));
+  uint8_t codec = static_cast<uint8_t>(stored[2]);
+  HARD_ASSERT(codec == static_cast<uint8_t>(Codec::Deflate),
+              "Unsupported compression codec %s", static_cast<int>(codec));
+  int32_t dictionary_id = static_cast<int32_t>(ReadUint32(stored.substr(3)));
+  uint32_t size = ReadUint32(stored.substr(7));
+  HARD_ASSERT(size <= kMaxValueSize,
+              "Compressed value claims an uncompressed size of %s bytes", size);
+
+  z_stream stream{};
+  int status = inflateInit2(&stream, kWindowBits);
+  HARD_ASSERT(status == Z_OK, "inflateInit2 failed: %s", status);
+
+  if (dictionary_id != kNoDictionary) {
+    const std::string* dictionary = FindDictionary(dictionary_id);
+    HARD_ASSERT(dictionary, "Value compressed with unknown dictionary %s",
+                dictionary_id);
+    status = inflateSetDictionary(&stream, ToBytef(dictionary->data()),
+                                  static_cast<uInt>(dictionary->size()));
+    HARD_ASSERT(status == Z_OK, "inflateSetDictionary failed: %s", status);
+  }
+
+  absl::string_view compressed = stored.substr(kHeaderSize);
+  buffer->resize(size);
+  stream.next_in = ToBytef(compressed.data());
+  stream.avail_in = static_cast<uInt>(compressed.size());
+  stream.next_out = ToBytef(&(*buffer)[0]);
+  stream.avail_out = size;
+  status = inflate(&stream, Z_FINISH);
+  HARD_ASSERT(status == Z_STREAM_END && stream.total_out == size,
+              "Failed to decompress value: %s", status);
+  inflateEnd(&stream);
+
+  return *buffer;
+}
+
+std::string LevelDbValueCompressor::TrainDictionary(
+    const std::vector<std::string>& samples, size_t max_size) {
+  // Deflate finds matches of three bytes or more; eight byte segments are long
+  // enough to capture field names while still matching in many samples.
+  static const size_t kSegmentSize = 8;
+
+  // Counts the number of samples each segment occurs in, so that a long
+  // repetitive sample doesn't dominate.
+  std::unordered_map<std::string, int> counts;
+  for (const std::string& sample : samples) {
+    absl::string_view sample_view{sample};
+    std::set<absl::string_view> seen;
+    for (size_t i = 0; i + kSegmentSize <= sample.size(); ++i) {
+      absl::string_view segment = sample_view.substr(i, kSegmentSize);
+      if (seen.insert(segment).second) {
+        counts[std::string{segment}]++;
+      }
+    }
+  }
+
+  std::vector<std::pair<int, std::string>> common;
+  for (auto& entry : counts) {
+    if (entry.second > 1) {
+      common.emplace_back(entry.second, entry.first);
+    }
+  }
+  std::sort(common.begin(), common.end(),
+            [](const std::pair<int, std::string>& lhs,
+               const std::pair<int, std::string>& rhs) {
+              return lhs.first != rhs.first ? lhs.first > rhs.first
+                                            : lhs.second < rhs.second;
+            });
+
+  size_t limit = std::min(max_size, kMaxDictionarySize);
+  size_t count = std::min(common.size(), limit / kSegmentSize);
+
+  // Deflate encodes nearby matches more cheaply, so the most common segments
+  // go at the end of the dictionary, right before the data.
+  std::string dictionary;
+  for (size_t i = count; i > 0; --i) {
+    dictionary += common[i - 1].second;
+  }
+  return dictionary;
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
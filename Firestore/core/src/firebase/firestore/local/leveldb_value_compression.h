@@ -0,0 +1,158 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_VALUE_COMPRESSION_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_VALUE_COMPRESSION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "absl/strings/string_view.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** Controls whether and how LevelDbValueCompressor compresses values. */
+struct LevelDbValueCompressionOptions {
+  /** Values are stored exactly as given. */
+  static LevelDbValueCompressionOptions Disabled() {
+    return LevelDbValueCompressionOptions{false, 6, 0};
+  }
+
+  static LevelDbValueCompressionOptions Default() {
+    return LevelDbValueCompressionOptions{true, 6, 64};
+  }
+
+  bool enabled;
+
+  /** The zlib compression level, from 1 (fastest) to 9 (smallest). */
+  int level;
+
+  /** Values shorter than this are not worth compressing. */
+  size_t min_size;
+};
+
+/**
+ * Compresses and decompresses leveldb values.
+ *
+ * A compressed value starts with a versioned header:
+ *
+ *   byte 0     kHeaderMarker (0x00)
+ *   byte 1     format version, currently 1
+ *   byte 2     codec, see Codec
+ *   bytes 3-6  dictionary id, little-endian; 0 if no dictionary was used
+ *   bytes 7-10 uncompressed size, little-endian
+ *
+ * followed by the compressed bytes. Any other value is stored as is, which is
+ * also how values were stored before compression existed. This is unambiguous
+ * for serialized protocol buffers: a non-empty message never starts with a zero
+ * byte since zero is not a valid field tag.
+ *
+ * Values compressed with a dictionary can only be decoded if the same
+ * dictionary has been registered under the same id, so dictionaries must be
+ * persisted and never changed once used.
+ */
+class LevelDbValueCompressor {
+ public:
+  enum class Codec : uint8_t {
+    /** Raw deflate streams, as produced by zlib. */
+    Deflate = 1,
+  };
+
+  static const int32_t kNoDictionary = 0;
+
+  /** The largest useful dictionary: the size of the deflate window. */
+  static const size_t kMaxDictionarySize = 32 * 1024;
+
+  /**
+   * The largest value that is compressed. Stored values claiming to decompress
+   * to more than this are rejected as corrupt rather than allocated for.
+   */
+  static const size_t kMaxValueSize = 16 * 1024 * 1024;
+
+  explicit LevelDbValueCompressor(
+      LevelDbValueCompressionOptions options =
+          LevelDbValueCompressionOptions::Disabled());
+
+  const LevelDbValueCompressionOptions& options() const {
+    return options_;
+  }
+
+  void set_options(LevelDbValueCompressionOptions options) {
+    options_ = options;
+  }
+
+  /**
+   * Makes the given dictionary available for decoding values under the given
+   * id, which must be positive. An id can't be given a different dictionary
+   * later.
+   */
+  void AddDictionary(int32_t dictionary_id, std::string dictionary);
+
+  /**
+   * Selects the dictionary used to compress new values, which must have been
+   * added. Pass kNoDictionary to compress without a dictionary.
+   */
+  void SetActiveDictionary(int32_t dictionary_id);
+
+  int32_t active_dictionary_id() const {
+    return active_dictionary_id_;
+  }
+
+  /** Returns the largest dictionary id added so far, or kNoDictionary. */
+  int32_t max_dictionary_id() const;
+
+  /**
+   * Returns the form in which the given value should be stored. This is the
+   * value itself if compression is disabled or would not make it smaller.
+   */
+  std::string Encode(absl::string_view value) const;
+
+  /**
+   * Returns the original value for the given stored value. If the value was
+   * stored uncompressed, the result points into `stored`; otherwise it points
+   * into `buffer`.
+   */
+  absl::string_view Decode(absl::string_view stored,
+                           std::string* buffer) const;
+
+  /** Returns true if the given stored value starts with a header. */
+  static bool IsCompressed(absl::string_view stored);
+
+  /**
+   * Builds a compression dictionary of at most `max_size` bytes from sample
+   * values, made up of the byte sequences shared by the most samples.
+   */
+  static std::string TrainDictionary(const std::vector<std::string>& samples,
+                                     size_t max_size = kMaxDictionarySize);
+
+ private:
+  const std::string* FindDictionary(int32_t dictionary_id) const;
+
+  LevelDbValueCompressionOptions options_;
+  std::map<int32_t, std::string> dictionaries_;
+  int32_t active_dictionary_id_ = kNoDictionary;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_LEVELDB_VALUE_COMPRESSION_H_
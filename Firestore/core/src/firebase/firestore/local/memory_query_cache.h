@@ -24,6 +24,7 @@
 #import <Foundation/Foundation.h>
 
 #include <cstdint>
+#include <unordered_map>
 #include <utility>
 
 #include "Firestore/core/src/firebase/firestore/local/query_cache.h"
@@ -47,11 +48,20 @@ class MemoryQueryCache : public QueryCache {
  public:
   explicit MemoryQueryCache(FSTMemoryPersistence* persistence);
 
+  /**
+   * Creates a cache that keeps a running total of the size of its targets,
+   * measured as the size of their encoded form.
+   */
+  MemoryQueryCache(FSTMemoryPersistence* persistence,
+                   FSTLocalSerializer* serializer);
+
   // Target-related methods
   void AddTarget(FSTQueryData* query_data) override;
 
   void UpdateTarget(FSTQueryData* query_data) override;
 
+  void UpdateResumeToken(FSTQueryData* query_data) override;
+
   void RemoveTarget(FSTQueryData* query_data) override;
 
   FSTQueryData* _Nullable GetTarget(FSTQuery* query) override;
@@ -74,7 +84,14 @@ class MemoryQueryCache : public QueryCache {
   bool Contains(const model::DocumentKey& key) override;
 
   // Other methods and accessors
-  size_t CalculateByteSize(FSTLocalSerializer* serializer);
+
+  /**
+   * Returns the number of bytes the cached targets take up, or zero if the
+   * cache was created without a serializer to measure them.
+   */
+  size_t byte_size() const {
+    return byte_size_;
+  }
 
   size_t size() const override {
     return [queries_ count];
@@ -93,7 +110,14 @@ class MemoryQueryCache : public QueryCache {
   void SetLastRemoteSnapshotVersion(model::SnapshotVersion version) override;
 
  private:
+  /** Updates the size accounting for a target being added or updated. */
+  void TrackSize(FSTQueryData* query_data);
+
+  /** Updates the size accounting for the target with `target_id` going away. */
+  void UntrackSize(model::TargetId target_id);
+
   FSTMemoryPersistence* persistence_;
+  FSTLocalSerializer* _Nullable serializer_ = nil;
   /** The highest sequence number encountered */
   model::ListenSequenceNumber highest_listen_sequence_number_;
   /** The highest numbered target ID encountered. */
@@ -106,6 +130,11 @@ class MemoryQueryCache : public QueryCache {
   /** A ordered bidirectional mapping between documents and the remote target
    * IDs. */
   ReferenceSet references_;
+
+  /** The size of each cached target, when sizes are tracked. */
+  std::unordered_map<model::TargetId, size_t> target_sizes_;
+  /** The sum of `target_sizes_`. */
+  size_t byte_size_ = 0;
 };
 
 }  // namespace local
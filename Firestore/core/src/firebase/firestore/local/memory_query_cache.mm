@@ -19,9 +19,11 @@
 
 #import "Firestore/Protos/objc/firestore/local/Target.pbobjc.h"
 #import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Local/FSTLocalSerializer.h"
 #import "Firestore/Source/Local/FSTMemoryPersistence.h"
 #import "Firestore/Source/Local/FSTQueryData.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
 
 using firebase::firestore::model::DocumentKey;
 using firebase::firestore::model::DocumentKeySet;
@@ -43,8 +45,15 @@ MemoryQueryCache::MemoryQueryCache(FSTMemoryPersistence* persistence)
       queries_([NSMutableDictionary dictionary]) {
 }
 
+MemoryQueryCache::MemoryQueryCache(FSTMemoryPersistence* persistence,
+                                   FSTLocalSerializer* serializer)
+    : MemoryQueryCache(persistence) {
+  serializer_ = serializer;
+}
+
 void MemoryQueryCache::AddTarget(FSTQueryData* query_data) {
   queries_[query_data.query] = query_data;
+  TrackSize(query_data);
   if (query_data.targetID > highest_target_id_) {
     highest_target_id_ = query_data.targetID;
   }
@@ -58,9 +67,21 @@ void MemoryQueryCache::UpdateTarget(FSTQueryData* query_data) {
   AddTarget(query_data);
 }
 
+void MemoryQueryCache::UpdateResumeToken(FSTQueryData* query_data) {
+  FSTQueryData* existing = queries_[query_data.query];
+  HARD_ASSERT(existing, "Cannot update the resume token of a missing target");
+  FSTQueryData* updated = [existing
+      queryDataByReplacingSnapshotVersion:query_data.snapshotVersion
+                              resumeToken:query_data.resumeToken
+                           sequenceNumber:existing.sequenceNumber];
+  queries_[query_data.query] = updated;
+  TrackSize(updated);
+}
+
 void MemoryQueryCache::RemoveTarget(FSTQueryData* query_data) {
   [queries_ removeObjectForKey:query_data.query];
   references_.RemoveReferences(query_data.targetID);
+  UntrackSize(query_data.targetID);
 }
 
 FSTQueryData* _Nullable MemoryQueryCache::GetTarget(FSTQuery* query) {
@@ -84,6 +105,7 @@ int MemoryQueryCache::RemoveTargets(
       if (live_targets[@(queryData.targetID)] == nil) {
         [toRemove addObject:query];
         references_.RemoveReferences(queryData.targetID);
+        UntrackSize(queryData.targetID);
       }
     }
   }];
@@ -115,13 +137,21 @@ bool MemoryQueryCache::Contains(const DocumentKey& key) {
   return references_.ContainsKey(key);
 }
 
-size_t MemoryQueryCache::CalculateByteSize(FSTLocalSerializer* serializer) {
-  __block size_t count = 0;
-  [queries_ enumerateKeysAndObjectsUsingBlock:^(
-                FSTQuery* query, FSTQueryData* query_data, BOOL* stop) {
-    count += [[serializer encodedQueryData:query_data] serializedSize];
-  }];
-  return count;
+void MemoryQueryCache::TrackSize(FSTQueryData* query_data) {
+  if (!serializer_) return;
+
+  size_t size = [[serializer_ encodedQueryData:query_data] serializedSize];
+  size_t& tracked = target_sizes_[query_data.targetID];
+  byte_size_ = byte_size_ - tracked + size;
+  tracked = size;
+}
+
+void MemoryQueryCache::UntrackSize(TargetId target_id) {
+  auto found = target_sizes_.find(target_id);
+  if (found == target_sizes_.end()) return;
+
+  byte_size_ -= found->second;
+  target_sizes_.erase(found);
 }
 
 const SnapshotVersion& MemoryQueryCache::GetLastRemoteSnapshotVersion() const {
@@ -21,12 +21,16 @@
 #error "For now, this file must only be included by ObjC source files."
 #endif  // !defined(__OBJC__)
 
+#include <set>
+#include <unordered_map>
 #include <vector>
 
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
 #include "Firestore/core/src/firebase/firestore/local/remote_document_cache.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/model/document_map.h"
+#include "Firestore/core/src/firebase/firestore/model/resource_path.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 
 @class FSTLocalSerializer;
@@ -40,8 +44,25 @@ namespace firebase {
 namespace firestore {
 namespace local {
 
+/**
+ * A remote document cache held in memory.
+ *
+ * Documents live in a hash table, so lookups by key don't depend on the size
+ * of the cache, and each collection keeps an ordered index of the keys of its
+ * immediate children, which are the only documents a query of the collection
+ * can match. Both are updated in place; immutable maps are only built for
+ * results.
+ */
 class MemoryRemoteDocumentCache : public RemoteDocumentCache {
  public:
+  MemoryRemoteDocumentCache() = default;
+
+  /**
+   * Creates a cache that keeps a running total of the size of its documents,
+   * measured as the size of their encoded form.
+   */
+  explicit MemoryRemoteDocumentCache(FSTLocalSerializer *serializer);
+
   void Add(FSTMaybeDocument *document) override;
   void Remove(const model::DocumentKey &key) override;
 
@@ -49,15 +70,53 @@ class MemoryRemoteDocumentCache : public RemoteDocumentCache {
   model::MaybeDocumentMap GetAll(const model::DocumentKeySet &keys) override;
   model::DocumentMap GetMatching(FSTQuery *query) override;
 
+  DocumentChangeLog &change_log() override {
+    return change_log_;
+  }
+
   std::vector<model::DocumentKey> RemoveOrphanedDocuments(
       FSTMemoryLRUReferenceDelegate *reference_delegate,
       model::ListenSequenceNumber upper_bound);
 
-  size_t CalculateByteSize(FSTLocalSerializer *serializer);
+  /**
+   * Returns the number of bytes the cached documents take up, or zero if the
+   * cache was created without a serializer to measure them.
+   */
+  size_t byte_size() const {
+    return byte_size_;
+  }
 
  private:
-  /** Underlying cache of documents. */
-  model::MaybeDocumentMap docs_;
+  struct Entry {
+    FSTMaybeDocument *document;
+    /** The encoded size of the document, or zero if sizes aren't tracked. */
+    size_t size;
+  };
+
+  using DocumentTable =
+      std::unordered_map<model::DocumentKey, Entry, model::DocumentKeyHash>;
+
+  /** Returns the encoded size of `document`, or zero if not tracking. */
+  size_t SizeOf(FSTMaybeDocument *document) const;
+
+  /** Removes the document at `it` from the cache and the child index. */
+  DocumentTable::iterator Erase(DocumentTable::iterator it);
+
+  /** The cached documents, by key. */
+  DocumentTable docs_;
+
+  /** The keys of the cached documents in each collection, in key order. */
+  std::unordered_map<model::ResourcePath,
+                     std::set<model::DocumentKey>,
+                     model::ResourcePathHash>
+      children_;
+
+  FSTLocalSerializer *_Nullable serializer_ = nil;
+
+  DocumentChangeLog change_log_;
+
+  /** The sum of the sizes of the cached documents. */
+  size_t byte_size_ = 0;
 };
 
 }  // namespace local
@@ -18,7 +18,11 @@
 
 #import "Firestore/Protos/objc/firestore/local/MaybeDocument.pbobjc.h"
 #import "Firestore/Source/Core/FSTQuery.h"
+#import "Firestore/Source/Local/FSTLocalSerializer.h"
 #import "Firestore/Source/Local/FSTMemoryPersistence.h"
+#import "Firestore/Source/Model/FSTDocument.h"
+
+#include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
 
 using firebase::firestore::model::DocumentKey;
 using firebase::firestore::model::DocumentKeySet;
@@ -45,18 +49,36 @@ size_t DocumentKeyByteSize(const DocumentKey& key) {
 }
 }  // namespace
 
+MemoryRemoteDocumentCache::MemoryRemoteDocumentCache(
+    FSTLocalSerializer* serializer)
+    : serializer_(serializer) {
+}
+
 void MemoryRemoteDocumentCache::Add(FSTMaybeDocument* document) {
-  docs_ = docs_.insert(document.key, document);
+  size_t size = SizeOf(document);
+  auto inserted = docs_.emplace(document.key, Entry{document, size});
+  if (inserted.second) {
+    children_[document.key.path().PopLast()].insert(document.key);
+  } else {
+    Entry& entry = inserted.first->second;
+    byte_size_ -= entry.size;
+    entry = Entry{document, size};
+  }
+  byte_size_ += size;
+  change_log_.Record(document.key);
 }
 
 void MemoryRemoteDocumentCache::Remove(const DocumentKey& key) {
-  docs_ = docs_.erase(key);
+  auto found = docs_.find(key);
+  if (found != docs_.end()) {
+    Erase(found);
+  }
 }
 
 FSTMaybeDocument* _Nullable MemoryRemoteDocumentCache::Get(
     const DocumentKey& key) {
   auto found = docs_.find(key);
-  return found != docs_.end() ? found->second : nil;
+  return found != docs_.end() ? found->second.document : nil;
 }
 
 MaybeDocumentMap MemoryRemoteDocumentCache::GetAll(const DocumentKeySet& keys) {
@@ -73,15 +95,15 @@ MaybeDocumentMap MemoryRemoteDocumentCache::GetAll(const DocumentKeySet& keys) {
 DocumentMap MemoryRemoteDocumentCache::GetMatching(FSTQuery* query) {
   DocumentMap results;
 
-  // Documents are ordered by key, so we can use a prefix scan to narrow down
-  // the documents we need to match the query against.
-  DocumentKey prefix{query.path.Append("")};
-  for (auto it = docs_.lower_bound(prefix); it != docs_.end(); ++it) {
-    const DocumentKey& key = it->first;
-    if (!query.path.IsPrefixOf(key.path())) {
-      break;
-    }
-    FSTMaybeDocument* maybeDoc = it->second;
+  // Only the immediate children of the collection can match the query, so the
+  // child index narrows the candidates down to exactly those documents.
+  auto children = children_.find(query.path);
+  if (children == children_.end()) {
+    return results;
+  }
+
+  for (const DocumentKey& key : children->second) {
+    FSTMaybeDocument* maybeDoc = docs_.at(key).document;
     if (![maybeDoc isKindOfClass:[FSTDocument class]]) {
       continue;
     }
@@ -97,27 +119,42 @@ std::vector<DocumentKey> MemoryRemoteDocumentCache::RemoveOrphanedDocuments(
     FSTMemoryLRUReferenceDelegate* reference_delegate,
     ListenSequenceNumber upper_bound) {
   std::vector<DocumentKey> removed;
-  MaybeDocumentMap updated_docs = docs_;
-  for (const auto& kv : docs_) {
-    const DocumentKey& key = kv.first;
+  for (auto it = docs_.begin(); it != docs_.end();) {
+    const DocumentKey& key = it->first;
     if (![reference_delegate isPinnedAtSequenceNumber:upper_bound
                                              document:key]) {
-      updated_docs = updated_docs.erase(key);
       removed.push_back(key);
+      it = Erase(it);
+    } else {
+      ++it;
     }
   }
-  docs_ = updated_docs;
   return removed;
 }
 
-size_t MemoryRemoteDocumentCache::CalculateByteSize(
-    FSTLocalSerializer* serializer) {
-  size_t count = 0;
-  for (const auto& kv : docs_) {
-    count += DocumentKeyByteSize(kv.first);
-    count += [[serializer encodedMaybeDocument:kv.second] serializedSize];
+size_t MemoryRemoteDocumentCache::SizeOf(FSTMaybeDocument* document) const {
+  if (!serializer_) return 0;
+
+  // Documents are encoded once, as they're added, so that the size of the
+  // cache is always at hand rather than recomputed from every document.
+  return DocumentKeyByteSize(document.key) +
+         [[serializer_ encodedMaybeDocument:document] serializedSize];
+}
+
+MemoryRemoteDocumentCache::DocumentTable::iterator
+MemoryRemoteDocumentCache::Erase(DocumentTable::iterator it) {
+  const DocumentKey& key = it->first;
+  auto children = children_.find(key.path().PopLast());
+  HARD_ASSERT(children != children_.end(), "Cached document %s isn't indexed",
+              key.ToString());
+  children->second.erase(key);
+  if (children->second.empty()) {
+    children_.erase(children);
   }
-  return count;
+
+  byte_size_ -= it->second.size;
+  change_log_.Record(key);
+  return docs_.erase(it);
 }
 
 }  // namespace local
@@ -0,0 +1,148 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_MUTATION_QUEUE_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_MUTATION_QUEUE_H_
+
+#if !defined(__OBJC__)
+#error "For now, this file must only be included by ObjC source files."
+#endif  // !defined(__OBJC__)
+
+#import <Foundation/Foundation.h>
+
+#include <vector>
+
+#include "Firestore/core/src/firebase/firestore/model/document_key.h"
+#include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
+#include "Firestore/core/src/firebase/firestore/model/types.h"
+
+@class FIRTimestamp;
+@class FSTMutation;
+@class FSTMutationBatch;
+@class FSTQuery;
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** A queue of mutations to apply to the remote store. */
+class MutationQueue {
+ public:
+  virtual ~MutationQueue() {
+  }
+
+  /**
+   * Starts the mutation queue, performing any initial reads that might be
+   * required to establish invariants, etc.
+   *
+   * After starting, the mutation queue must guarantee that the highest
+   * acknowledged batch ID is less than the next batch ID. This prevents the
+   * local store from creating new batches that the mutation queue would
+   * consider erroneously acknowledged.
+   */
+  virtual void Start() = 0;
+
+  /** Returns true if this queue contains no mutation batches. */
+  virtual bool IsEmpty() = 0;
+
+  /**
+   * Returns the highest batch ID that has been acknowledged. If no batches have
+   * been acknowledged or if there are no batches in the queue this can return
+   * kFSTBatchIDUnknown.
+   */
+  virtual model::BatchId GetHighestAcknowledgedBatchId() = 0;
+
+  /** Acknowledges the given batch. */
+  virtual void AcknowledgeBatch(FSTMutationBatch* batch,
+                                NSData* _Nullable stream_token) = 0;
+
+  /** Returns the current stream token for this mutation queue. */
+  virtual NSData* _Nullable GetLastStreamToken() = 0;
+
+  /** Sets the stream token for this mutation queue. */
+  virtual void SetLastStreamToken(NSData* _Nullable stream_token) = 0;
+
+  /** Creates a new mutation batch and adds it to this mutation queue. */
+  virtual FSTMutationBatch* AddMutationBatch(
+      FIRTimestamp* local_write_time, NSArray<FSTMutation*>* mutations) = 0;
+
+  /** Loads the mutation batch with the given batch ID. */
+  virtual FSTMutationBatch* _Nullable LookupMutationBatch(
+      model::BatchId batch_id) = 0;
+
+  /**
+   * Gets the first unacknowledged mutation batch after the passed in batch ID
+   * in the mutation queue or nil if empty.
+   *
+   * @param batch_id The batch to search after, or kFSTBatchIDUnknown for the
+   * first mutation in the queue.
+   */
+  virtual FSTMutationBatch* _Nullable NextMutationBatchAfterBatchId(
+      model::BatchId batch_id) = 0;
+
+  /** Gets all mutation batches in the mutation queue, ordered by batch ID. */
+  virtual std::vector<FSTMutationBatch*> AllMutationBatches() = 0;
+
+  /**
+   * Finds all mutation batches that could possibly affect the given document
+   * key, ordered by batch ID. Not all mutations in a batch will necessarily
+   * affect the key.
+   */
+  virtual std::vector<FSTMutationBatch*> AllMutationBatchesAffectingDocumentKey(
+      const model::DocumentKey& key) = 0;
+
+  /**
+   * Finds all mutation batches that could possibly affect the given document
+   * keys, ordered by batch ID. Not all mutations in a batch will necessarily
+   * affect each key.
+   */
+  virtual std::vector<FSTMutationBatch*>
+  AllMutationBatchesAffectingDocumentKeys(
+      const model::DocumentKeySet& keys) = 0;
+
+  /**
+   * Finds all mutation batches that could affect the results for the given
+   * query, ordered by batch ID. Not all mutations in a batch will necessarily
+   * affect the query.
+   */
+  virtual std::vector<FSTMutationBatch*> AllMutationBatchesAffectingQuery(
+      FSTQuery* query) = 0;
+
+  /**
+   * Removes the given mutation batch from the queue. This is useful in two
+   * circumstances:
+   *
+   * + Removing applied mutations from the head of the queue
+   * + Removing rejected mutations from anywhere in the queue
+   */
+  virtual void RemoveMutationBatch(FSTMutationBatch* batch) = 0;
+
+  /**
+   * Performs a consistency check, examining the mutation queue for any leaks,
+   * if possible.
+   */
+  virtual void PerformConsistencyCheck() = 0;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_MUTATION_QUEUE_H_
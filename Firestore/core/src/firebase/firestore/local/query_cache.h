@@ -74,6 +74,14 @@ class QueryCache {
    */
   virtual void UpdateTarget(FSTQueryData* query_data) = 0;
 
+  /**
+   * Records the resume token and snapshot version of `query_data` for an entry
+   * that is already in the cache, without necessarily rewriting the rest of
+   * the entry. This is cheap enough to call for every change received from
+   * watch. Subsequent lookups of the target return the recorded values.
+   */
+  virtual void UpdateResumeToken(FSTQueryData* query_data) = 0;
+
   /** Removes the cached entry for the given query data. The entry must already
    * exist in the cache. */
   virtual void RemoveTarget(FSTQueryData* query_data) = 0;
@@ -0,0 +1,102 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_QUERY_RESULT_CACHE_H_
+#define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_QUERY_RESULT_CACHE_H_
+
+#if !defined(__OBJC__)
+#error "For now, this file must only be included by ObjC source files."
+#endif  // !defined(__OBJC__)
+
+#import <Foundation/Foundation.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <string>
+#include <unordered_map>
+
+#include "Firestore/core/src/firebase/firestore/model/document_map.h"
+
+@class FSTQuery;
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+/** The results of a local query, as of some position in a DocumentChangeLog. */
+struct QueryResults {
+  model::DocumentMap documents;
+  int64_t change_log_position;
+};
+
+/**
+ * A bounded, least-recently-used cache of the most recent local results of
+ * each query, so that executing a query again only needs to revisit the
+ * documents that changed in the meantime.
+ *
+ * The size of the cache is measured in documents across all cached results.
+ */
+class QueryResultCache {
+ public:
+  static const size_t kDefaultMaxDocuments = 50000;
+
+  explicit QueryResultCache(size_t max_documents = kDefaultMaxDocuments);
+
+  /**
+   * Returns the cached results of `query`, or nullptr if there are none. The
+   * returned pointer is valid until the cache is next modified.
+   */
+  const QueryResults* _Nullable Get(FSTQuery* query);
+
+  /** Caches `results` as the latest results of `query`. */
+  void Put(FSTQuery* query, QueryResults results);
+
+  /** Drops all cached results. */
+  void Clear();
+
+  /** Returns the number of documents across all cached results. */
+  size_t document_count() const {
+    return document_count_;
+  }
+
+ private:
+  struct Entry {
+    std::string canonical_id;
+    QueryResults results;
+  };
+
+  using EntryList = std::list<Entry>;
+
+  void Erase(EntryList::iterator entry);
+
+  size_t max_documents_;
+  size_t document_count_ = 0;
+
+  // Most recently used first.
+  EntryList entries_;
+  std::unordered_map<std::string, EntryList::iterator> index_;
+};
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
+
+#endif  // FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_QUERY_RESULT_CACHE_H_
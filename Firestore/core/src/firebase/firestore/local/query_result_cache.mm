@@ -0,0 +1,83 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/query_result_cache.h"
+
+#include <iterator>
+#include <utility>
+
+#import "Firestore/Source/Core/FSTQuery.h"
+
+#include "Firestore/core/src/firebase/firestore/util/string_apple.h"
+
+NS_ASSUME_NONNULL_BEGIN
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+const size_t QueryResultCache::kDefaultMaxDocuments;
+
+QueryResultCache::QueryResultCache(size_t max_documents)
+    : max_documents_(max_documents) {
+}
+
+const QueryResults* _Nullable QueryResultCache::Get(FSTQuery* query) {
+  auto found = index_.find(util::MakeString(query.canonicalID));
+  if (found == index_.end()) {
+    return nullptr;
+  }
+
+  entries_.splice(entries_.begin(), entries_, found->second);
+  return &found->second->results;
+}
+
+void QueryResultCache::Put(FSTQuery* query, QueryResults results) {
+  std::string canonical_id = util::MakeString(query.canonicalID);
+  auto found = index_.find(canonical_id);
+  if (found != index_.end()) {
+    Erase(found->second);
+  }
+
+  size_t size = results.documents.size();
+  if (size > max_documents_) return;
+
+  entries_.push_front(Entry{canonical_id, std::move(results)});
+  index_[std::move(canonical_id)] = entries_.begin();
+  document_count_ += size;
+
+  while (document_count_ > max_documents_) {
+    Erase(std::prev(entries_.end()));
+  }
+}
+
+void QueryResultCache::Clear() {
+  entries_.clear();
+  index_.clear();
+  document_count_ = 0;
+}
+
+void QueryResultCache::Erase(EntryList::iterator entry) {
+  document_count_ -= entry->results.documents.size();
+  index_.erase(entry->canonical_id);
+  entries_.erase(entry);
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
+
+NS_ASSUME_NONNULL_END
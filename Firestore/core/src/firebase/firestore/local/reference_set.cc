@@ -15,8 +15,10 @@
  */
 
 #include "Firestore/core/src/firebase/firestore/local/reference_set.h"
-#include "Firestore/core/src/firebase/firestore/immutable/sorted_set.h"
-#include "Firestore/core/src/firebase/firestore/local/document_reference.h"
+
+#include <algorithm>
+#include <utility>
+
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 
 namespace firebase {
@@ -27,73 +29,113 @@ using model::DocumentKey;
 using model::DocumentKeySet;
 
 void ReferenceSet::AddReference(const DocumentKey& key, int id) {
-  DocumentReference reference{key, id};
-  by_key_ = by_key_.insert(reference);
-  by_id_ = by_id_.insert(reference);
+  if (AddId(key, id)) {
+    keys_by_id_[id].insert(key);
+  }
 }
 
 void ReferenceSet::AddReferences(const DocumentKeySet& keys, int id) {
+  if (keys.empty()) return;
+
+  KeySet& id_keys = keys_by_id_[id];
+  id_keys.reserve(id_keys.size() + keys.size());
   for (const DocumentKey& key : keys) {
-    AddReference(key, id);
+    if (AddId(key, id)) {
+      id_keys.insert(key);
+    }
   }
 }
 
 void ReferenceSet::RemoveReference(const DocumentKey& key, int id) {
-  RemoveReference(DocumentReference{key, id});
+  if (!RemoveId(key, id)) return;
+
+  auto found = keys_by_id_.find(id);
+  found->second.erase(key);
+  if (found->second.empty()) {
+    keys_by_id_.erase(found);
+  }
 }
 
-void ReferenceSet::RemoveReferences(
-    const firebase::firestore::model::DocumentKeySet& keys, int id) {
+void ReferenceSet::RemoveReferences(const DocumentKeySet& keys, int id) {
+  auto found = keys_by_id_.find(id);
+  if (found == keys_by_id_.end()) return;
+
+  KeySet& id_keys = found->second;
   for (const DocumentKey& key : keys) {
-    RemoveReference(key, id);
+    if (RemoveId(key, id)) {
+      id_keys.erase(key);
+    }
+  }
+  if (id_keys.empty()) {
+    keys_by_id_.erase(found);
   }
 }
 
 DocumentKeySet ReferenceSet::RemoveReferences(int id) {
-  DocumentReference start{DocumentKey::Empty(), id};
-  DocumentReference end{DocumentKey::Empty(), id + 1};
-
-  DocumentKeySet removed{};
+  auto found = keys_by_id_.find(id);
+  if (found == keys_by_id_.end()) return DocumentKeySet{};
 
-  auto initial = by_id_;
-  for (const auto& reference : initial.values_in(start, end)) {
-    RemoveReference(reference);
-    removed = removed.insert(reference.key());
+  KeySet id_keys = std::move(found->second);
+  keys_by_id_.erase(found);
+  for (const DocumentKey& key : id_keys) {
+    RemoveId(key, id);
   }
-  return removed;
+  return ToSortedSet(id_keys);
 }
 
 void ReferenceSet::RemoveAllReferences() {
-  auto initial = by_key_;
-  for (const DocumentReference& reference : initial) {
-    RemoveReference(reference);
-  }
+  ids_by_key_.clear();
+  keys_by_id_.clear();
+  size_ = 0;
 }
 
-void ReferenceSet::RemoveReference(const DocumentReference& reference) {
-  by_key_ = by_key_.erase(reference);
-  by_id_ = by_id_.erase(reference);
+DocumentKeySet ReferenceSet::ReferencedKeys(int id) const {
+  auto found = keys_by_id_.find(id);
+  if (found == keys_by_id_.end()) return DocumentKeySet{};
+
+  return ToSortedSet(found->second);
 }
 
-DocumentKeySet ReferenceSet::ReferencedKeys(int id) {
-  DocumentReference start{DocumentKey::Empty(), id};
-  DocumentReference end{DocumentKey::Empty(), id + 1};
+bool ReferenceSet::ContainsKey(const DocumentKey& key) const {
+  return ids_by_key_.find(key) != ids_by_key_.end();
+}
 
-  DocumentKeySet keys;
-  for (const auto& reference : by_id_.values_in(start, end)) {
-    keys = keys.insert(reference.key());
+bool ReferenceSet::AddId(const DocumentKey& key, int id) {
+  std::vector<int>& ids = ids_by_key_[key];
+  if (std::find(ids.begin(), ids.end(), id) != ids.end()) return false;
+
+  ids.push_back(id);
+  size_++;
+  return true;
+}
+
+bool ReferenceSet::RemoveId(const DocumentKey& key, int id) {
+  auto found = ids_by_key_.find(key);
+  if (found == ids_by_key_.end()) return false;
+
+  std::vector<int>& ids = found->second;
+  auto position = std::find(ids.begin(), ids.end(), id);
+  if (position == ids.end()) return false;
+
+  // Order doesn't matter, so fill the gap with the last Id.
+  *position = ids.back();
+  ids.pop_back();
+  if (ids.empty()) {
+    ids_by_key_.erase(found);
   }
-  return keys;
+  size_--;
+  return true;
 }
 
-bool ReferenceSet::ContainsKey(const DocumentKey& key) {
-  // Create a reference with a zero ID as the start position to find any
-  // document reference with this key.
-  DocumentReference start{key, 0};
+DocumentKeySet ReferenceSet::ToSortedSet(const KeySet& keys) {
+  std::vector<DocumentKey> sorted(keys.begin(), keys.end());
+  std::sort(sorted.begin(), sorted.end());
 
-  auto range = by_key_.values_from(start);
-  auto begin = range.begin();
-  return begin != range.end() && begin->key() == key;
+  DocumentKeySet result;
+  for (const DocumentKey& key : sorted) {
+    result = result.insert(key);
+  }
+  return result;
 }
 
 }  // namespace local
@@ -17,8 +17,11 @@
 #ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_REFERENCE_SET_H_
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_LOCAL_REFERENCE_SET_H_
 
-#include "Firestore/core/src/firebase/firestore/immutable/sorted_set.h"
-#include "Firestore/core/src/firebase/firestore/local/document_reference.h"
+#include <cstddef>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 
@@ -31,25 +34,23 @@ namespace local {
  * (either a TargetId or BatchId). As references are added to or removed from
  * the set corresponding events are emitted to a registered garbage collector.
  *
- * Each reference is represented by a DocumentReference object. Each of them
- * contains enough information to uniquely identify the reference. They are all
- * stored primarily in a set sorted by key. A document is considered garbage if
- * there's no references in that set (this can be efficiently checked thanks to
- * sorting by key).
- *
- * ReferenceSet also keeps a secondary set that contains references sorted by
- * Id. This one is used to efficiently implement removal of all references by
- * some TargetId.
+ * References are kept in two mutable hash indexes: the Ids referencing each
+ * key, and the keys referenced by each Id. A document is considered garbage if
+ * no Id references it, which is a single lookup in the first index. The second
+ * makes finding or removing all the references of an Id proportional to the
+ * number of references it has, and adding or removing the references of many
+ * keys at once looks up the Id only once.
  */
 class ReferenceSet {
  public:
   /** Returns true if the reference set contains no references. */
   bool empty() const {
-    return by_key_.empty();
+    return size_ == 0;
   }
 
+  /** Returns the number of references in the set. */
   size_t size() const {
-    return by_key_.size();
+    return size_;
   }
 
   /** Adds a reference to the given document key for the given Id. */
@@ -64,8 +65,11 @@ class ReferenceSet {
   /** Removes references to the given document keys for the given Id. */
   void RemoveReferences(const model::DocumentKeySet& keys, int id);
 
-  /** Clears all references with a given ID. Calls -removeReferenceToKey: for
-   * each key removed. */
+  /**
+   * Clears all references with a given ID.
+   *
+   * @return The keys whose references were removed.
+   */
   model::DocumentKeySet RemoveReferences(int id);
 
   /** Clears all references for all IDs. */
@@ -73,18 +77,44 @@ class ReferenceSet {
 
   /** Returns all of the document keys that have had references added for the
    * given ID. */
-  model::DocumentKeySet ReferencedKeys(int id);
+  model::DocumentKeySet ReferencedKeys(int id) const;
 
   /**
    * Checks to see if there are any references to a document with the given key.
    */
-  bool ContainsKey(const model::DocumentKey& key);
+  bool ContainsKey(const model::DocumentKey& key) const;
 
  private:
-  void RemoveReference(const DocumentReference& reference);
+  using KeySet = std::unordered_set<model::DocumentKey, model::DocumentKeyHash>;
+
+  /**
+   * Adds `id` to the Ids referencing `key`, returning false if it was already
+   * there.
+   */
+  bool AddId(const model::DocumentKey& key, int id);
+
+  /**
+   * Removes `id` from the Ids referencing `key`, returning false if it wasn't
+   * there.
+   */
+  bool RemoveId(const model::DocumentKey& key, int id);
+
+  /** Returns `keys` as a sorted set. */
+  static model::DocumentKeySet ToSortedSet(const KeySet& keys);
+
+  /**
+   * The Ids referencing each key. Documents are rarely referenced by more than
+   * a couple of Ids, so a vector is cheaper than a set.
+   */
+  std::unordered_map<model::DocumentKey,
+                     std::vector<int>,
+                     model::DocumentKeyHash>
+      ids_by_key_;
+
+  /** The keys each Id references. */
+  std::unordered_map<int, KeySet> keys_by_id_;
 
-  immutable::SortedSet<DocumentReference, DocumentReference::ByKey> by_key_;
-  immutable::SortedSet<DocumentReference, DocumentReference::ById> by_id_;
+  size_t size_ = 0;
 };
 
 }  // namespace local
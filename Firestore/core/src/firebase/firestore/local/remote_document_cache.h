@@ -23,6 +23,7 @@
 
 #import <Foundation/Foundation.h>
 
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key.h"
 #include "Firestore/core/src/firebase/firestore/model/document_key_set.h"
 #include "Firestore/core/src/firebase/firestore/model/document_map.h"
@@ -93,6 +94,16 @@ class RemoteDocumentCache {
    * @return The set of matching documents.
    */
   virtual model::DocumentMap GetMatching(FSTQuery* query) = 0;
+
+  /**
+   * Returns the log of the documents added to or removed from this cache since
+   * it was opened.
+   *
+   * The local store also records documents whose pending mutations changed,
+   * so that the log covers everything that can change the local view of a
+   * document.
+   */
+  virtual DocumentChangeLog& change_log() = 0;
 };
 
 }  // namespace local
@@ -24,6 +24,8 @@
 
 #include "Firestore/core/src/firebase/firestore/util/comparison.h"
 #include "Firestore/core/src/firebase/firestore/util/hard_assert.h"
+#include "absl/strings/escaping.h"
+#include "absl/strings/str_cat.h"
 
 using firebase::firestore::util::Comparator;
 
@@ -159,6 +161,60 @@ bool FieldValue::Comparable(Type lhs, Type rhs) {
   }
 }
 
+std::string FieldValue::ToString() const {
+  switch (tag_) {
+    case Type::Null:
+      return "null";
+    case Type::Boolean:
+      return boolean_value_ ? "true" : "false";
+    case Type::Integer:
+      return absl::StrCat(integer_value_);
+    case Type::Double:
+      return absl::StrCat(double_value_);
+    case Type::Timestamp:
+      return timestamp_value_.ToString();
+    case Type::ServerTimestamp:
+      return absl::StrCat("ServerTimestamp(local_write_time=",
+                          server_timestamp_value_.local_write_time.ToString(),
+                          ")");
+    case Type::String:
+      return string_value_;
+    case Type::Blob:
+      return absl::StrCat(
+          "<",
+          absl::BytesToHexString(absl::string_view{
+              reinterpret_cast<const char*>(blob_value_.data()),
+              blob_value_.size()}),
+          ">");
+    case Type::Reference:
+      return reference_value_.reference.ToString();
+    case Type::GeoPoint:
+      return absl::StrCat("GeoPoint(", geo_point_value_.latitude(), ", ",
+                          geo_point_value_.longitude(), ")");
+    case Type::Array: {
+      std::string result = "[";
+      for (const FieldValue& element : array_value_) {
+        if (result.size() > 1) {
+          absl::StrAppend(&result, ",");
+        }
+        absl::StrAppend(&result, element.ToString());
+      }
+      return absl::StrCat(result, "]");
+    }
+    case Type::Object: {
+      std::string result = "{";
+      for (const auto& kv : object_value_.internal_value) {
+        if (result.size() > 1) {
+          absl::StrAppend(&result, ",");
+        }
+        absl::StrAppend(&result, kv.first, ":", kv.second.ToString());
+      }
+      return absl::StrCat(result, "}");
+    }
+  }
+  UNREACHABLE();
+}
+
 FieldValue FieldValue::Set(const FieldPath& field_path,
                            FieldValue value) const {
   HARD_ASSERT(type() == Type::Object,
@@ -142,6 +142,12 @@ class FieldValue {
     return ObjectValue{object_value_};
   }
 
+  /**
+   * Returns a deterministic string representation of the value, suitable for
+   * use in canonical IDs: equal values produce equal strings.
+   */
+  std::string ToString() const;
+
   /**
    * Returns a FieldValue with the field at the named path set to value.
    * Any absent parent of the field will also be created accordingly.
@@ -22,6 +22,7 @@
 #include <utility>
 
 #include "Firestore/core/src/firebase/firestore/model/base_path.h"
+#include "Firestore/core/src/firebase/firestore/util/hashing.h"
 #include "absl/strings/string_view.h"
 
 namespace firebase {
@@ -76,6 +77,13 @@ class ResourcePath : public impl::BasePath<ResourcePath> {
   }
 };
 
+/** A hash function for using ResourcePaths as keys in unordered containers. */
+struct ResourcePathHash {
+  size_t operator()(const ResourcePath& path) const {
+    return util::Hash(path);
+  }
+};
+
 }  // namespace model
 }  // namespace firestore
 }  // namespace firebase
@@ -112,6 +112,7 @@ void GrpcStream::Start() {
   // particular, the tag will never come back from the completion queue (by
   // design).
   call_->StartCall(nullptr);
+  is_grpc_call_started_ = true;
 
   if (observer_) {
     // Start listening for new messages.
@@ -134,6 +135,18 @@ void GrpcStream::Read() {
   call_->Read(completion->message(), completion);
 }
 
+void GrpcStream::PauseReads() {
+  reads_paused_ = true;
+}
+
+void GrpcStream::ResumeReads() {
+  reads_paused_ = false;
+  if (read_deferred_) {
+    read_deferred_ = false;
+    Read();
+  }
+}
+
 void GrpcStream::Write(grpc::ByteBuffer&& message) {
   MaybeWrite(buffered_writer_.EnqueueWrite(std::move(message)));
 }
@@ -184,11 +197,10 @@ void GrpcStream::Shutdown() {
 
   MaybeUnregister();
 
-  // If completions are empty but the call hasn't been finished, it means this
-  // stream has never started. Calling `Finish` on the underlying gRPC call is
-  // invalid if it wasn't started previously.
-  if (!completions_.empty() && !is_grpc_call_finished_) {
-    // Important: during normal operation, the stream always has a pending read
+  // Calling `Finish` on the underlying gRPC call is invalid if it wasn't
+  // started previously.
+  if (is_grpc_call_started_ && !is_grpc_call_finished_) {
+    // Important: unless reads are paused, the stream always has a pending read
     // operation, so `Shutdown` would hang indefinitely if we didn't cancel the
     // `context_`. However, if the stream has already failed, avoid canceling
     // the context to avoid overwriting the status captured during the
@@ -291,7 +303,11 @@ void GrpcStream::OnRead(const grpc::ByteBuffer& message) {
     // interested observer.
     // Order is important here -- any call to observer can potentially end this
     // stream's lifetime, so call `Read` before notifying.
-    Read();
+    if (reads_paused_) {
+      read_deferred_ = true;
+    } else {
+      Read();
+    }
     observer_->OnStreamRead(message);
   }
 }
@@ -161,6 +161,17 @@ class GrpcStream : public GrpcCall {
    */
   bool WriteAndFinish(grpc::ByteBuffer&& message);
 
+  /**
+   * Stops reading new messages from the server until `ResumeReads` is called.
+   * A read that is already in progress still completes and is delivered to
+   * the observer; further messages stay buffered in gRPC, which eventually
+   * makes flow control hold them back on the server.
+   */
+  void PauseReads();
+
+  /** Resumes reading after `PauseReads`. */
+  void ResumeReads();
+
   bool IsFinished() const {
     return observer_ == nullptr;
   }
@@ -233,8 +244,16 @@ class GrpcStream : public GrpcCall {
 
   std::vector<GrpcCompletion*> completions_;
 
+  // Calling `Finish` is only valid once the call has been started. While
+  // reads are paused, a started call can have no pending completions at all.
+  bool is_grpc_call_started_ = false;
   // gRPC asserts that a call is finished exactly once.
   bool is_grpc_call_finished_ = false;
+
+  bool reads_paused_ = false;
+  // Whether a read was held back because reads were paused; it is issued once
+  // they resume.
+  bool read_deferred_ = false;
 };
 
 }  // namespace remote
@@ -198,6 +198,33 @@ class Stream : public GrpcStreamObserver,
   void Write(grpc::ByteBuffer&& message);
   std::string GetDebugDescription() const;
 
+  /**
+   * Closes the stream because a response from the server could not be
+   * handled. The error is reported like any other stream error.
+   */
+  void CloseWithReadError(const util::Status& status);
+
+  /**
+   * Stops and resumes reading responses from the underlying `GrpcStream`,
+   * allowing derived classes to apply backpressure while they catch up with
+   * the responses already received.
+   */
+  void PauseReads();
+  void ResumeReads();
+
+  util::AsyncQueue* worker_queue() const {
+    return worker_queue_;
+  }
+
+  /**
+   * Increases every time the stream is closed; asynchronous work can compare
+   * it with the value it started with to discard results for a stream that has
+   * since been closed or restarted.
+   */
+  int close_count() const {
+    return close_count_;
+  }
+
   ExponentialBackoff backoff_;
 
  private:
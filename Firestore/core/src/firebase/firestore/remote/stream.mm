@@ -207,10 +207,7 @@ void Stream::OnStreamRead(const grpc::ByteBuffer& message) {
 
   Status read_status = NotifyStreamResponse(message);
   if (!read_status.ok()) {
-    grpc_stream_->FinishImmediately();
-    // Don't expect gRPC to produce status -- since the error happened on the
-    // client, we have all the information we need.
-    OnStreamFinish(read_status);
+    CloseWithReadError(read_status);
     return;
   }
 }
@@ -313,6 +310,30 @@ void Stream::Write(grpc::ByteBuffer&& message) {
   grpc_stream_->Write(std::move(message));
 }
 
+void Stream::CloseWithReadError(const Status& status) {
+  EnsureOnQueue();
+  HARD_ASSERT(grpc_stream_, "CloseWithReadError called for a closed stream.");
+
+  grpc_stream_->FinishImmediately();
+  // Don't expect gRPC to produce status -- since the error happened on the
+  // client, we have all the information we need.
+  OnStreamFinish(status);
+}
+
+void Stream::PauseReads() {
+  EnsureOnQueue();
+  if (grpc_stream_) {
+    grpc_stream_->PauseReads();
+  }
+}
+
+void Stream::ResumeReads() {
+  EnsureOnQueue();
+  if (grpc_stream_) {
+    grpc_stream_->ResumeReads();
+  }
+}
+
 std::string Stream::GetDebugDescription() const {
   EnsureOnQueue();
   return StringFormat("%s (%s)", GetDebugName(), this);
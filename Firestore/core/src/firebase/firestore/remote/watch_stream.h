@@ -21,9 +21,15 @@
 #error "This header only supports Objective-C++"
 #endif  // !defined(__OBJC__)
 
+#include <dispatch/dispatch.h>
+
+#include <cstdint>
+#include <functional>
+#include <map>
 #include <memory>
 #include <string>
 
+#include "Firestore/core/src/firebase/firestore/model/snapshot_version.h"
 #include "Firestore/core/src/firebase/firestore/model/types.h"
 #include "Firestore/core/src/firebase/firestore/remote/grpc_connection.h"
 #include "Firestore/core/src/firebase/firestore/remote/remote_objc_bridge.h"
@@ -31,6 +37,7 @@
 #include "Firestore/core/src/firebase/firestore/util/async_queue.h"
 #include "Firestore/core/src/firebase/firestore/util/status.h"
 #include "absl/strings/string_view.h"
+#include "absl/types/optional.h"
 #include "grpcpp/support/byte_buffer.h"
 
 #import "Firestore/Source/Core/FSTTypes.h"
@@ -47,9 +54,30 @@ namespace remote {
  * Once the `WatchStream` has called the `streamDidOpen` method on the delegate,
  * any number of `WatchQuery` and `UnwatchTargetId` calls can be sent to control
  * what changes will be sent from the server for WatchChanges.
+ *
+ * Responses are decoded on a concurrent dispatch queue, so that decoding the
+ * next responses overlaps with the delegate applying the previous ones on the
+ * worker queue. Decoded responses are still handed to the delegate one at a
+ * time and in the order they were received. Once a bounded number of
+ * responses have been received but not yet handed over, the stream stops
+ * reading from gRPC until the delegate catches up.
+ *
+ * If the server closes the stream, the responses received before that are
+ * still handed to the delegate before it is told that the stream closed. The
+ * delegate's watch and unwatch requests are dropped meanwhile: the stream can
+ * no longer send them, and the delegate sends them again once it restarts the
+ * stream. Responses that are outstanding when the stream is closed by the
+ * client (by `Stop`, idleness or a response that fails to parse) are dropped,
+ * just like any that the server might have sent after them.
  */
 class WatchStream : public Stream {
  public:
+  /**
+   * The number of responses that may be received from the server before
+   * earlier ones have been handed to the delegate. Past this, reads are paused.
+   */
+  static const uint64_t kMaxResponsesInFlight = 16;
+
   WatchStream(util::AsyncQueue* async_queue,
               auth::CredentialsProvider* credentials_provider,
               FSTSerializerBeta* serializer,
@@ -71,6 +99,17 @@ class WatchStream : public Stream {
   virtual /*virtual for tests only*/ void UnwatchTargetId(
       model::TargetId target_id);
 
+  // `GrpcStreamObserver` interface -- do not use.
+  void OnStreamFinish(const util::Status& status) override;
+
+ protected:
+  /**
+   * Runs `decode` off the worker queue. Decoding may finish in a different
+   * order than it was scheduled in.
+   */
+  virtual /*virtual for tests only*/ void ScheduleDecode(
+      std::function<void()> decode);
+
  private:
   std::unique_ptr<GrpcStream> CreateGrpcStream(
       GrpcConnection* grpc_connection, const auth::Token& token) override;
@@ -84,8 +123,44 @@ class WatchStream : public Stream {
     return "WatchStream";
   }
 
+  /** A response from the server, decoded off the worker queue. */
+  struct DecodedResponse {
+    util::Status status;
+    GCFSListenResponse* response = nil;
+    FSTWatchChange* change = nil;
+    model::SnapshotVersion version;
+  };
+
+  static DecodedResponse Decode(const bridge::WatchStreamSerializer& serializer,
+                                const grpc::ByteBuffer& message);
+
+  void OnResponseDecoded(uint64_t sequence, DecodedResponse decoded);
+
+  /**
+   * Hands the decoded responses that are next in order to the delegate, and
+   * resumes reading once there is room for more.
+   */
+  void DeliverDecodedResponses();
+
+  /** Forgets the responses of the current stream, if any. */
+  void ResetResponses();
+
   bridge::WatchStreamSerializer serializer_bridge_;
   bridge::WatchStreamDelegate delegate_bridge_;
+
+  dispatch_queue_t decode_queue_;
+
+  /** The sequence number to give to the next response that is received. */
+  uint64_t next_received_ = 0;
+  /** The sequence number of the next response to hand to the delegate. */
+  uint64_t next_delivered_ = 0;
+  /** Responses decoded ahead of an earlier one, by sequence number. */
+  std::map<uint64_t, DecodedResponse> decoded_responses_;
+  /**
+   * The status the server closed the stream with, while earlier responses
+   * were still being decoded.
+   */
+  absl::optional<util::Status> pending_finish_;
 };
 
 }  // namespace remote
@@ -16,6 +16,9 @@
 
 #include "Firestore/core/src/firebase/firestore/remote/watch_stream.h"
 
+#include <utility>
+
+#include "Firestore/core/src/firebase/firestore/util/executor_libdispatch.h"
 #include "Firestore/core/src/firebase/firestore/util/log.h"
 #include "Firestore/core/src/firebase/firestore/util/status.h"
 
@@ -31,6 +34,9 @@ using model::TargetId;
 using util::AsyncQueue;
 using util::TimerId;
 using util::Status;
+using util::internal::DispatchAsync;
+
+const uint64_t WatchStream::kMaxResponsesInFlight;
 
 WatchStream::WatchStream(AsyncQueue* async_queue,
                          CredentialsProvider* credentials_provider,
@@ -40,11 +46,17 @@ WatchStream::WatchStream(AsyncQueue* async_queue,
     : Stream{async_queue, credentials_provider, grpc_connection,
              TimerId::ListenStreamConnectionBackoff, TimerId::ListenStreamIdle},
       serializer_bridge_{serializer},
-      delegate_bridge_{delegate} {
+      delegate_bridge_{delegate},
+      decode_queue_{dispatch_queue_create(
+          "com.google.firebase.firestore.watch.decode",
+          DISPATCH_QUEUE_CONCURRENT)} {
 }
 
 void WatchStream::WatchQuery(FSTQueryData* query) {
   EnsureOnQueue();
+  if (pending_finish_) {
+    return;
+  }
 
   GCFSListenRequest* request = serializer_bridge_.CreateWatchRequest(query);
   LOG_DEBUG("%s watch: %s", GetDebugDescription(),
@@ -54,6 +66,9 @@ void WatchStream::WatchQuery(FSTQueryData* query) {
 
 void WatchStream::UnwatchTargetId(TargetId target_id) {
   EnsureOnQueue();
+  if (pending_finish_) {
+    return;
+  }
 
   GCFSListenRequest* request =
       serializer_bridge_.CreateUnwatchRequest(target_id);
@@ -73,35 +88,141 @@ void WatchStream::TearDown(GrpcStream* grpc_stream) {
 }
 
 void WatchStream::NotifyStreamOpen() {
+  ResetResponses();
   delegate_bridge_.NotifyDelegateOnOpen();
 }
 
 Status WatchStream::NotifyStreamResponse(const grpc::ByteBuffer& message) {
-  Status status;
-  GCFSListenResponse* response =
-      serializer_bridge_.ParseResponse(message, &status);
-  if (!status.ok()) {
-    return status;
+  uint64_t sequence = next_received_++;
+  if (next_received_ - next_delivered_ >= kMaxResponsesInFlight) {
+    PauseReads();
   }
 
-  if (bridge::IsLoggingEnabled()) {
-    LOG_DEBUG("%s response: %s", GetDebugDescription(),
-              serializer_bridge_.Describe(response));
+  std::weak_ptr<WatchStream> weak_this{
+      std::static_pointer_cast<WatchStream>(shared_from_this())};
+  int initial_close_count = close_count();
+  AsyncQueue* worker_queue = this->worker_queue();
+  bridge::WatchStreamSerializer serializer = serializer_bridge_;
+
+  ScheduleDecode([weak_this, initial_close_count, worker_queue, serializer,
+                  sequence, message] {
+    if (weak_this.expired()) {
+      return;
+    }
+    DecodedResponse decoded = Decode(serializer, message);
+
+    worker_queue->EnqueueRelaxed([weak_this, initial_close_count, sequence,
+                                  decoded] {
+      auto strong_this = weak_this.lock();
+      // The stream may have been closed, or even reopened, while the response
+      // was being decoded.
+      if (!strong_this || strong_this->close_count() != initial_close_count) {
+        return;
+      }
+      strong_this->OnResponseDecoded(sequence, decoded);
+    });
+  });
+
+  // Errors surface once the response is decoded.
+  return Status::OK();
+}
+
+void WatchStream::ScheduleDecode(std::function<void()> decode) {
+  DispatchAsync(decode_queue_, std::move(decode));
+}
+
+WatchStream::DecodedResponse WatchStream::Decode(
+    const bridge::WatchStreamSerializer& serializer,
+    const grpc::ByteBuffer& message) {
+  DecodedResponse decoded;
+  decoded.response = serializer.ParseResponse(message, &decoded.status);
+  if (decoded.status.ok()) {
+    decoded.change = serializer.ToWatchChange(decoded.response);
+    decoded.version = serializer.ToSnapshotVersion(decoded.response);
   }
+  return decoded;
+}
 
-  // A successful response means the stream is healthy.
-  backoff_.Reset();
+void WatchStream::OnResponseDecoded(uint64_t sequence,
+                                    DecodedResponse decoded) {
+  EnsureOnQueue();
 
-  delegate_bridge_.NotifyDelegateOnChange(
-      serializer_bridge_.ToWatchChange(response),
-      serializer_bridge_.ToSnapshotVersion(response));
-  return Status::OK();
+  decoded_responses_.emplace(sequence, std::move(decoded));
+  DeliverDecodedResponses();
+}
+
+void WatchStream::DeliverDecodedResponses() {
+  int initial_close_count = close_count();
+
+  auto next = decoded_responses_.begin();
+  while (next != decoded_responses_.end() && next->first == next_delivered_) {
+    DecodedResponse decoded = std::move(next->second);
+    decoded_responses_.erase(next);
+    ++next_delivered_;
+
+    if (!decoded.status.ok()) {
+      // Any later responses are dropped along with the stream.
+      ResetResponses();
+      CloseWithReadError(decoded.status);
+      return;
+    }
+
+    if (bridge::IsLoggingEnabled()) {
+      LOG_DEBUG("%s response: %s", GetDebugDescription(),
+                serializer_bridge_.Describe(decoded.response));
+    }
+
+    // A successful response means the stream is healthy.
+    backoff_.Reset();
+
+    delegate_bridge_.NotifyDelegateOnChange(decoded.change, decoded.version);
+
+    // The delegate may have stopped the stream.
+    if (close_count() != initial_close_count) {
+      return;
+    }
+    next = decoded_responses_.begin();
+  }
+
+  if (pending_finish_) {
+    if (next_delivered_ == next_received_) {
+      Status status = *pending_finish_;
+      pending_finish_.reset();
+      Stream::OnStreamFinish(status);
+    }
+    return;
+  }
+
+  if (next_received_ - next_delivered_ < kMaxResponsesInFlight) {
+    ResumeReads();
+  }
+}
+
+void WatchStream::OnStreamFinish(const Status& status) {
+  EnsureOnQueue();
+
+  // Hold on to the close until the responses received before it have been
+  // handed to the delegate.
+  if (next_delivered_ != next_received_) {
+    pending_finish_ = status;
+    return;
+  }
+  Stream::OnStreamFinish(status);
 }
 
 void WatchStream::NotifyStreamClose(const Status& status) {
+  // Responses still being decoded are discarded by the close count check.
+  ResetResponses();
   delegate_bridge_.NotifyDelegateOnClose(status);
 }
 
+void WatchStream::ResetResponses() {
+  next_received_ = 0;
+  next_delivered_ = 0;
+  decoded_responses_.clear();
+  pending_finish_.reset();
+}
+
 }  // namespace remote
 }  // namespace firestore
 }  // namespace firebase
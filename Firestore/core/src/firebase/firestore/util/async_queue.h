@@ -57,7 +57,12 @@ enum class TimerId {
   /**
    * A timer used to periodically attempt LRU Garbage collection
    */
-  GarbageCollectionDelay
+  GarbageCollectionDelay,
+  /**
+   * A timer used to write out LevelDB transactions deferred by group commit
+   * once no further transactions arrive to fill the group.
+   */
+  GroupCommitFlush
 };
 
 // A serial queue that executes given operations asynchronously, one at a time.
@@ -17,11 +17,14 @@
 #ifndef FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_UTIL_HASHING_H_
 #define FIRESTORE_CORE_SRC_FIREBASE_FIRESTORE_UTIL_HASHING_H_
 
+#include <cstdint>
 #include <functional>
 #include <iterator>
 #include <string>
 #include <type_traits>
 
+#include "absl/strings/string_view.h"
+
 namespace firebase {
 namespace firestore {
 namespace util {
@@ -183,6 +186,23 @@ size_t Hash(const Ts&... values) {
   return impl::HashInternal(0u, values...);
 }
 
+/**
+ * Returns the 64-bit FNV-1a hash of the given bytes.
+ *
+ * Unlike `Hash`, the result is 64 bits wide on every platform and doesn't
+ * depend on the standard library, which makes it a good key for in-memory maps
+ * of long strings such as canonical IDs, and lets Objective-C and C++ code
+ * computing it for the same bytes agree.
+ */
+inline uint64_t Fingerprint64(absl::string_view bytes) {
+  uint64_t result = 14695981039346656037ULL;
+  for (char c : bytes) {
+    result ^= static_cast<uint8_t>(c);
+    result *= 1099511628211ULL;
+  }
+  return result;
+}
+
 }  // namespace util
 }  // namespace firestore
 }  // namespace firebase
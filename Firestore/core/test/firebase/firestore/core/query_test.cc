@@ -119,6 +119,31 @@ TEST(QueryTest, NanFilter) {
   EXPECT_FALSE(query.Matches(doc5));
 }
 
+TEST(QueryTest, CanonicalId) {
+  Query query = Query::AtPath(ResourcePath::FromString("rooms/eros/messages"));
+  EXPECT_EQ("rooms/eros/messages|f:|ob:__name__asc", query.CanonicalId());
+
+  Query filtered =
+      query.Filter(Filter("a", "<=", 1)).Filter(Filter("b", "==", "foo"));
+  EXPECT_EQ("rooms/eros/messages|f:a<=1b==foo|ob:__name__asc",
+            filtered.CanonicalId());
+}
+
+TEST(QueryTest, EquivalentQueriesHaveTheSameCanonicalHash) {
+  Query coll = Query::AtPath(ResourcePath::FromString("coll"));
+  Query query1 = coll.Filter(Filter("a", ">", 1));
+  Query query2 = coll.Filter(Filter("a", ">", 1));
+  Query query3 = coll.Filter(Filter("a", ">", 2));
+
+  EXPECT_EQ(query1.CanonicalHash(), query2.CanonicalHash());
+  EXPECT_NE(query1.CanonicalHash(), query3.CanonicalHash());
+
+  // Copies keep the cached values.
+  Query copy = query1;
+  EXPECT_EQ(query1.CanonicalId(), copy.CanonicalId());
+  EXPECT_EQ(query1.CanonicalHash(), copy.CanonicalHash());
+}
+
 }  // namespace core
 }  // namespace firestore
 }  // namespace firebase
@@ -110,6 +110,16 @@ TEST(SortedSetTest, CanBeConstructedFromSortedMap) {
   ASSERT_TRUE(NotFound(map, 2));
 }
 
+TEST(SortedSetTest, CanBeConstructedFromSortedKeys) {
+  for (int size : {0, 10, kLargeNumber}) {
+    std::vector<int> all = Sequence(size);
+    SortedSet<int> set = SortedSet<int>::FromSorted(all);
+    ASSERT_EQ(static_cast<SizeType>(size), set.size());
+    ASSERT_SEQ_EQ(all, set);
+    ASSERT_EQ(ToSet(all), set);
+  }
+}
+
 TEST(SortedSetTest, Iterator) {
   std::vector<int> all = Sequence(kLargeNumber);
   SortedSet<int> set = ToSet(Shuffled(all));
@@ -16,6 +16,9 @@
 
 #include "Firestore/core/src/firebase/firestore/immutable/tree_sorted_map.h"
 
+#include <utility>
+#include <vector>
+
 #include "Firestore/core/src/firebase/firestore/util/secure_random.h"
 #include "Firestore/core/test/firebase/firestore/immutable/testing.h"
 #include "gtest/gtest.h"
@@ -221,6 +224,42 @@ TEST(TreeSortedMap, InsertIsImmutable) {
   EXPECT_TRUE(original.root().right().empty());
 }
 
+/**
+ * Checks the red-black invariants of the tree under `node`, returning its black
+ * height, or -1 if an invariant doesn't hold.
+ */
+int BlackHeight(const LlrbNode<int, int>& node) {
+  if (node.empty()) return 0;
+  if (node.right().red()) return -1;
+  if (node.red() && node.left().red()) return -1;
+  if (node.size() != node.left().size() + 1 + node.right().size()) return -1;
+
+  int left = BlackHeight(node.left());
+  int right = BlackHeight(node.right());
+  if (left < 0 || left != right) return -1;
+  return left + (node.red() ? 0 : 1);
+}
+
+TEST(TreeSortedMap, CreatesBalancedTreeFromSorted) {
+  for (int size = 0; size < 300; size++) {
+    std::vector<std::pair<int, int>> entries;
+    for (int i = 0; i < size; i++) {
+      entries.emplace_back(i, i * 2);
+    }
+
+    IntMap map = IntMap::CreateFromSorted(entries, {});
+    ASSERT_EQ(static_cast<size_t>(size), map.size());
+    ASSERT_FALSE(map.root().red());
+    ASSERT_GE(BlackHeight(map.root()), 0) << "size " << size;
+    ASSERT_EQ(entries, Collect(map));
+
+    // The result is an ordinary tree that can be modified further.
+    IntMap modified = map.insert(size, size).erase(0);
+    ASSERT_GE(BlackHeight(modified.root()), 0) << "size " << size;
+    ASSERT_EQ(static_cast<size_t>(size), modified.size());
+  }
+}
+
 }  // namespace impl
 }  // namespace immutable
 }  // namespace firestore
@@ -0,0 +1,58 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/document_change_log.h"
+
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKeySet;
+using testutil::Key;
+
+TEST(DocumentChangeLogTest, ReportsChangesSincePosition) {
+  DocumentChangeLog log;
+  log.Record(Key("coll/a"));
+  int64_t position = log.position();
+  EXPECT_EQ(DocumentKeySet{}, log.ChangedSince(position).value());
+
+  log.Record(Key("coll/b"));
+  log.Record(DocumentKeySet{Key("coll/c"), Key("coll/b")});
+
+  EXPECT_EQ((DocumentKeySet{Key("coll/b"), Key("coll/c")}),
+            log.ChangedSince(position).value());
+  EXPECT_EQ((DocumentKeySet{Key("coll/a"), Key("coll/b"), Key("coll/c")}),
+            log.ChangedSince(0).value());
+}
+
+TEST(DocumentChangeLogTest, ForgetsChangesBeyondCapacity) {
+  DocumentChangeLog log(2);
+  log.Record(Key("coll/a"));
+  int64_t position = log.position();
+  log.Record(Key("coll/b"));
+  log.Record(Key("coll/c"));
+
+  EXPECT_FALSE(log.ChangedSince(0).has_value());
+  EXPECT_EQ((DocumentKeySet{Key("coll/b"), Key("coll/c")}),
+            log.ChangedSince(position).value());
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
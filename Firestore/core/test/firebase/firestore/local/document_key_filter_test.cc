@@ -0,0 +1,104 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/document_key_filter.h"
+
+#include <string>
+
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKey;
+
+namespace {
+
+DocumentKey DocKey(int i) {
+  return testutil::Key("docs/" + std::to_string(i));
+}
+
+}  // namespace
+
+TEST(DocumentKeyFilterTest, ContainsAddedKeys) {
+  DocumentKeyFilter filter;
+  for (int i = 0; i < 1000; i++) {
+    filter.Add(DocKey(i));
+  }
+
+  for (int i = 0; i < 1000; i++) {
+    EXPECT_TRUE(filter.MightContain(DocKey(i)));
+  }
+  EXPECT_EQ(1000u, filter.size());
+}
+
+TEST(DocumentKeyFilterTest, RejectsMostAbsentKeys) {
+  DocumentKeyFilter filter{1000};
+  for (int i = 0; i < 1000; i++) {
+    filter.Add(DocKey(i));
+  }
+
+  int false_positives = 0;
+  for (int i = 1000; i < 11000; i++) {
+    if (filter.MightContain(DocKey(i))) false_positives++;
+  }
+  // The expected rate at capacity is about 1%.
+  EXPECT_LT(false_positives, 300);
+}
+
+TEST(DocumentKeyFilterTest, RemovesKeys) {
+  DocumentKeyFilter filter;
+  DocumentKey key = testutil::Key("coll/doc");
+
+  filter.Add(key);
+  filter.Add(key);
+  filter.Remove(key);
+  EXPECT_TRUE(filter.MightContain(key));
+
+  filter.Remove(key);
+  EXPECT_FALSE(filter.MightContain(key));
+  EXPECT_EQ(0u, filter.size());
+}
+
+TEST(DocumentKeyFilterTest, KeepsOtherKeysAfterRemoval) {
+  DocumentKeyFilter filter;
+  for (int i = 0; i < 2000; i++) {
+    filter.Add(DocKey(i));
+  }
+  for (int i = 0; i < 2000; i += 2) {
+    filter.Remove(DocKey(i));
+  }
+
+  for (int i = 1; i < 2000; i += 2) {
+    EXPECT_TRUE(filter.MightContain(DocKey(i)));
+  }
+}
+
+TEST(DocumentKeyFilterTest, ReportsWhenOverfull) {
+  DocumentKeyFilter filter;
+  size_t i = 0;
+  while (filter.size() <= 2 * filter.capacity()) {
+    EXPECT_FALSE(filter.overfull());
+    filter.Add(DocKey(static_cast<int>(i++)));
+  }
+  EXPECT_TRUE(filter.overfull());
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
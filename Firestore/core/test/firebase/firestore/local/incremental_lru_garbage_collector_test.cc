@@ -0,0 +1,284 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/incremental_lru_garbage_collector.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::ListenSequenceNumber;
+using model::TargetId;
+
+namespace {
+
+/**
+ * An in-memory stand-in for persistence: a list of targets and orphaned
+ * documents in sequence number order. The cursor is the index of the last
+ * entry examined.
+ */
+class FakeLruGcDelegate : public LruGcDelegate {
+ public:
+  struct Entry {
+    ListenSequenceNumber sequence_number;
+    // 0 for documents.
+    TargetId target_id;
+    bool removed;
+  };
+
+  /**
+   * Creates entries with sequence numbers 1 through `count`, where those with
+   * even sequence numbers are targets.
+   */
+  explicit FakeLruGcDelegate(int count) {
+    for (int i = 1; i <= count; ++i) {
+      entries_.push_back(Entry{i, i % 2 == 0 ? i : 0, false});
+    }
+  }
+
+  LruGcProgress LoadProgress() override {
+    LruGcProgress progress;
+    if (!saved_.empty()) {
+      EXPECT_TRUE(LruGcProgress::Decode(saved_, &progress));
+    }
+    return progress;
+  }
+
+  void SaveProgress(const LruGcProgress& progress) override {
+    saved_ = progress.Encode();
+    saves_++;
+  }
+
+  LruGcSlice CountSequenceNumbers(std::string* cursor,
+                                  int limit,
+                                  int64_t* count) override {
+    return Visit(cursor, limit, [&](Entry*) {
+      (*count)++;
+      return true;
+    });
+  }
+
+  LruGcSlice FindUpperBound(std::string* cursor,
+                            int limit,
+                            int64_t* remaining,
+                            ListenSequenceNumber* upper_bound) override {
+    return Visit(cursor, limit, [&](Entry* entry) {
+      *upper_bound = entry->sequence_number;
+      return --(*remaining) > 0;
+    });
+  }
+
+  LruGcSlice RemoveTargets(ListenSequenceNumber upper_bound,
+                           const std::unordered_set<TargetId>& live_targets,
+                           std::string* cursor,
+                           int limit,
+                           int64_t* removed) override {
+    return Visit(cursor, limit, [&](Entry* entry) {
+      if (entry->sequence_number > upper_bound) return false;
+      if (entry->target_id != 0 && live_targets.count(entry->target_id) == 0) {
+        entry->removed = true;
+        (*removed)++;
+      }
+      return true;
+    });
+  }
+
+  LruGcSlice RemoveOrphanedDocuments(ListenSequenceNumber upper_bound,
+                                     std::string* cursor,
+                                     int limit,
+                                     int64_t* removed) override {
+    return Visit(cursor, limit, [&](Entry* entry) {
+      if (entry->sequence_number > upper_bound) return false;
+      if (entry->target_id == 0) {
+        entry->removed = true;
+        (*removed)++;
+      }
+      return true;
+    });
+  }
+
+  int saves() const {
+    return saves_;
+  }
+
+  std::vector<ListenSequenceNumber> remaining_sequence_numbers() const {
+    std::vector<ListenSequenceNumber> result;
+    for (const Entry& entry : entries_) {
+      if (!entry.removed) result.push_back(entry.sequence_number);
+    }
+    return result;
+  }
+
+ private:
+  template <typename Visitor>
+  LruGcSlice Visit(std::string* cursor, int limit, Visitor visitor) {
+    size_t i = cursor->empty() ? 0 : std::stoul(*cursor) + 1;
+    LruGcSlice slice;
+    for (; i < entries_.size() && slice.rows < limit; ++i) {
+      if (entries_[i].removed) continue;
+
+      slice.rows++;
+      *cursor = std::to_string(i);
+      if (!visitor(&entries_[i])) {
+        slice.finished = true;
+        return slice;
+      }
+    }
+    slice.finished = i == entries_.size();
+    return slice;
+  }
+
+  std::vector<Entry> entries_;
+  std::string saved_;
+  int saves_ = 0;
+};
+
+class RecordingLruGcMetrics : public LruGcMetrics {
+ public:
+  void PhaseCompleted(LruGcPhase phase,
+                      std::chrono::microseconds,
+                      int64_t rows) override {
+    phases.push_back(phase);
+    phase_rows.push_back(rows);
+  }
+
+  void CollectionCompleted(const LruGcProgress& progress) override {
+    completed.push_back(progress);
+  }
+
+  std::vector<LruGcPhase> phases;
+  std::vector<int64_t> phase_rows;
+  std::vector<LruGcProgress> completed;
+};
+
+}  // namespace
+
+TEST(IncrementalLruGarbageCollectorTest, CollectsInSlices) {
+  FakeLruGcDelegate delegate{100};
+  RecordingLruGcMetrics metrics;
+  IncrementalLruGarbageCollector gc{&delegate, 10, 1000, &metrics};
+
+  gc.Start();
+  int slices = 0;
+  do {
+    slices++;
+  } while (!gc.RunSlice(7, {2}));
+
+  EXPECT_GT(slices, 1);
+  EXPECT_EQ(slices, delegate.saves());
+
+  // Sequence numbers 1 through 10 are collected, except the live target 2.
+  std::vector<ListenSequenceNumber> remaining =
+      delegate.remaining_sequence_numbers();
+  ASSERT_EQ(91u, remaining.size());
+  EXPECT_EQ(2, remaining[0]);
+  EXPECT_EQ(11, remaining[1]);
+
+  ASSERT_EQ(1u, metrics.completed.size());
+  const LruGcProgress& result = metrics.completed[0];
+  EXPECT_EQ(100, result.count);
+  EXPECT_EQ(10, result.sequence_numbers_to_collect);
+  EXPECT_EQ(10, result.upper_bound);
+  EXPECT_EQ(4, result.targets_removed);
+  EXPECT_EQ(5, result.documents_removed);
+
+  std::vector<LruGcPhase> expected_phases = {
+      LruGcPhase::Counting, LruGcPhase::FindingUpperBound,
+      LruGcPhase::RemovingTargets, LruGcPhase::RemovingDocuments};
+  EXPECT_EQ(expected_phases, metrics.phases);
+  EXPECT_EQ(100, metrics.phase_rows[0]);
+}
+
+TEST(IncrementalLruGarbageCollectorTest, ResumesSavedProgress) {
+  FakeLruGcDelegate delegate{100};
+  {
+    IncrementalLruGarbageCollector gc{&delegate, 10, 1000};
+    gc.Start();
+    EXPECT_FALSE(gc.RunSlice(50, {}));
+  }
+
+  RecordingLruGcMetrics metrics;
+  IncrementalLruGarbageCollector gc{&delegate, 10, 1000, &metrics};
+  EXPECT_TRUE(gc.in_progress());
+  EXPECT_EQ(LruGcPhase::Counting, gc.progress().phase);
+
+  // Starting again doesn't discard the resumed collection.
+  gc.Start();
+  EXPECT_EQ(50, gc.progress().count);
+
+  EXPECT_TRUE(gc.RunSlice(1000, {}));
+  ASSERT_EQ(1u, metrics.completed.size());
+  EXPECT_EQ(100, metrics.completed[0].count);
+  EXPECT_EQ(5, metrics.completed[0].targets_removed);
+  EXPECT_EQ(5, metrics.completed[0].documents_removed);
+  EXPECT_EQ(90u, delegate.remaining_sequence_numbers().size());
+}
+
+TEST(IncrementalLruGarbageCollectorTest, CapsSequenceNumbersCollected) {
+  FakeLruGcDelegate delegate{100};
+  RecordingLruGcMetrics metrics;
+  IncrementalLruGarbageCollector gc{&delegate, 50, 4, &metrics};
+
+  gc.Start();
+  EXPECT_TRUE(gc.RunSlice(1000, {}));
+  ASSERT_EQ(1u, metrics.completed.size());
+  EXPECT_EQ(4, metrics.completed[0].sequence_numbers_to_collect);
+  EXPECT_EQ(4, metrics.completed[0].upper_bound);
+}
+
+TEST(IncrementalLruGarbageCollectorTest, StopsAfterCountingIfNothingToCollect) {
+  FakeLruGcDelegate delegate{5};
+  RecordingLruGcMetrics metrics;
+  IncrementalLruGarbageCollector gc{&delegate, 10, 1000, &metrics};
+
+  EXPECT_TRUE(gc.RunSlice(1000, {}));
+  EXPECT_TRUE(metrics.phases.empty());
+
+  gc.Start();
+  EXPECT_TRUE(gc.RunSlice(1000, {}));
+  std::vector<LruGcPhase> expected_phases = {LruGcPhase::Counting};
+  EXPECT_EQ(expected_phases, metrics.phases);
+  ASSERT_EQ(1u, metrics.completed.size());
+  EXPECT_EQ(LruGcProgress::kNoUpperBound, metrics.completed[0].upper_bound);
+  EXPECT_EQ(5u, delegate.remaining_sequence_numbers().size());
+}
+
+TEST(IncrementalLruGarbageCollectorTest, EncodesProgress) {
+  LruGcProgress progress;
+  progress.phase = LruGcPhase::RemovingTargets;
+  progress.cursor = std::string("\0cursor", 7);
+  progress.count = 1234567;
+  progress.sequence_numbers_to_collect = 1000;
+  progress.upper_bound = 98765432100;
+  progress.targets_removed = 3;
+
+  LruGcProgress decoded;
+  ASSERT_TRUE(LruGcProgress::Decode(progress.Encode(), &decoded));
+  EXPECT_EQ(progress, decoded);
+
+  EXPECT_FALSE(LruGcProgress::Decode("", &decoded));
+  EXPECT_FALSE(LruGcProgress::Decode(progress.Encode() + "x", &decoded));
+  EXPECT_EQ(progress, decoded);
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
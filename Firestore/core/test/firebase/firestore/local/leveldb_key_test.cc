@@ -236,6 +236,22 @@ TEST(LevelDbTargetKeyTest, Description) {
                                LevelDbTargetKey::Key(42));
 }
 
+TEST(LevelDbTargetResumeKeyTest, EncodeDecodeCycle) {
+  LevelDbTargetResumeKey key;
+
+  auto encoded = LevelDbTargetResumeKey::Key(42);
+  ASSERT_TRUE(key.Decode(encoded));
+  ASSERT_EQ(42, key.target_id());
+
+  // Rows of the targets table are not resume rows.
+  ASSERT_FALSE(key.Decode(LevelDbTargetKey::Key(42)));
+}
+
+TEST(LevelDbTargetResumeKeyTest, Description) {
+  AssertExpectedKeyDescription("[target_resume: target_id=42]",
+                               LevelDbTargetResumeKey::Key(42));
+}
+
 TEST(LevelDbQueryTargetKeyTest, EncodeDecodeCycle) {
   LevelDbQueryTargetKey key;
   std::string canonical_id("foo");
@@ -282,6 +298,36 @@ TEST(TargetDocumentKeyTest, Description) {
   ASSERT_EQ("[target_document: target_id=42 key=foo/bar]", DescribeKey(key));
 }
 
+TEST(TargetDocumentBlockKeyTest, EncodeDecodeCycle) {
+  LevelDbTargetDocumentBlockKey key;
+
+  auto encoded =
+      LevelDbTargetDocumentBlockKey::Key(42, testutil::Key("foo/bar"));
+  bool ok = key.Decode(encoded);
+  ASSERT_TRUE(ok);
+  ASSERT_EQ(42, key.target_id());
+  ASSERT_EQ(testutil::Key("foo/bar"), key.first_document_key());
+}
+
+TEST(TargetDocumentBlockKeyTest, Prefixing) {
+  auto target_prefix = LevelDbTargetDocumentBlockKey::KeyPrefix(42);
+
+  ASSERT_TRUE(absl::StartsWith(
+      LevelDbTargetDocumentBlockKey::Key(42, testutil::Key("foo/bar")),
+      target_prefix));
+  ASSERT_FALSE(absl::StartsWith(
+      LevelDbTargetDocumentBlockKey::Key(4, testutil::Key("foo/bar")),
+      target_prefix));
+  ASSERT_FALSE(absl::StartsWith(TargetDocKey(42, "foo/bar"),
+                                LevelDbTargetDocumentBlockKey::KeyPrefix()));
+}
+
+TEST(TargetDocumentBlockKeyTest, Description) {
+  auto key = LevelDbTargetDocumentBlockKey::Key(42, testutil::Key("foo/bar"));
+  ASSERT_EQ("[target_document_block: target_id=42 key=foo/bar]",
+            DescribeKey(key));
+}
+
 TEST(DocumentTargetKeyTest, EncodeDecodeCycle) {
   LevelDbDocumentTargetKey key;
 
@@ -356,6 +402,146 @@ TEST(RemoteDocumentKeyTest, Description) {
       LevelDbRemoteDocumentKey::Key(testutil::Key("foo/bar/baz/quux")));
 }
 
+TEST(RemoteDocumentDictionaryKeyTest, EncodeDecodeCycle) {
+  LevelDbRemoteDocumentDictionaryKey key;
+
+  for (int32_t dictionary_id : {1, 2, 1234}) {
+    auto encoded = LevelDbRemoteDocumentDictionaryKey::Key(dictionary_id);
+    bool ok = key.Decode(encoded);
+    ASSERT_TRUE(ok);
+    ASSERT_EQ(dictionary_id, key.dictionary_id());
+  }
+}
+
+TEST(RemoteDocumentDictionaryKeyTest, Description) {
+  AssertExpectedKeyDescription(
+      "[remote_document_dictionary: dictionary_id=7]",
+      LevelDbRemoteDocumentDictionaryKey::Key(7));
+}
+
+TEST(RemoteDocumentChangeKeyTest, EncodeDecodeCycle) {
+  LevelDbRemoteDocumentChangeKey key;
+
+  auto encoded =
+      LevelDbRemoteDocumentChangeKey::Key(1234567890123, testutil::Key("a/b"));
+  ASSERT_TRUE(key.Decode(encoded));
+  ASSERT_EQ(1234567890123, key.change_id());
+  ASSERT_EQ(testutil::Key("a/b"), key.document_key());
+}
+
+TEST(RemoteDocumentChangeKeyTest, Ordering) {
+  // Changes order by ID first, regardless of the document.
+  ASSERT_LT(LevelDbRemoteDocumentChangeKey::Key(2, testutil::Key("z/z")),
+            LevelDbRemoteDocumentChangeKey::Key(10, testutil::Key("a/a")));
+  ASSERT_LT(LevelDbRemoteDocumentChangeKey::Key(255, testutil::Key("a/a")),
+            LevelDbRemoteDocumentChangeKey::Key(256, testutil::Key("a/a")));
+
+  // All changes with an ID follow its prefix.
+  ASSERT_LT(LevelDbRemoteDocumentChangeKey::KeyPrefix(5),
+            LevelDbRemoteDocumentChangeKey::Key(5, testutil::Key("a/a")));
+  ASSERT_LT(LevelDbRemoteDocumentChangeKey::Key(4, testutil::Key("z/z")),
+            LevelDbRemoteDocumentChangeKey::KeyPrefix(5));
+}
+
+TEST(RemoteDocumentChangeKeyTest, Description) {
+  AssertExpectedKeyDescription(
+      "[remote_document_change: change_id=42 key=foo/bar]",
+      LevelDbRemoteDocumentChangeKey::Key(42, testutil::Key("foo/bar")));
+}
+
+TEST(SequenceNumberKeyTest, EncodeDecodeCycle) {
+  LevelDbSequenceNumberKey key;
+
+  auto encoded = LevelDbSequenceNumberKey::Key(1234567890123, 42);
+  ASSERT_TRUE(key.Decode(encoded));
+  ASSERT_EQ(1234567890123, key.sequence_number());
+  ASSERT_TRUE(key.IsTarget());
+  ASSERT_EQ(42, key.target_id());
+
+  encoded = LevelDbSequenceNumberKey::Key(7, testutil::Key("foo/bar"));
+  ASSERT_TRUE(key.Decode(encoded));
+  ASSERT_EQ(7, key.sequence_number());
+  ASSERT_FALSE(key.IsTarget());
+  ASSERT_EQ(testutil::Key("foo/bar"), key.document_key());
+}
+
+TEST(SequenceNumberKeyTest, Ordering) {
+  // Sequence numbers order first, regardless of magnitude.
+  ASSERT_LT(LevelDbSequenceNumberKey::Key(2, testutil::Key("foo/bar")),
+            LevelDbSequenceNumberKey::Key(10, 1));
+  ASSERT_LT(LevelDbSequenceNumberKey::Key(255, 1),
+            LevelDbSequenceNumberKey::Key(256, 1));
+  ASSERT_LT(LevelDbSequenceNumberKey::Key(1, 1),
+            LevelDbSequenceNumberKey::Key(int64_t{1} << 40, 1));
+
+  // Targets sort before documents with the same sequence number.
+  ASSERT_LT(LevelDbSequenceNumberKey::Key(5, 100),
+            LevelDbSequenceNumberKey::Key(5, testutil::Key("foo/bar")));
+
+  // All entries for a sequence number follow its prefix.
+  ASSERT_LT(LevelDbSequenceNumberKey::KeyPrefix(5),
+            LevelDbSequenceNumberKey::Key(5, 1));
+  ASSERT_LT(LevelDbSequenceNumberKey::Key(4, testutil::Key("foo/bar")),
+            LevelDbSequenceNumberKey::KeyPrefix(5));
+}
+
+TEST(SequenceNumberKeyTest, Description) {
+  AssertExpectedKeyDescription(
+      "[sequence_number: sequence_number=5 target_id=3]",
+      LevelDbSequenceNumberKey::Key(5, 3));
+  AssertExpectedKeyDescription(
+      "[sequence_number: sequence_number=5 key=foo/bar]",
+      LevelDbSequenceNumberKey::Key(5, testutil::Key("foo/bar")));
+}
+
+TEST(LevelDbLruGcProgressKeyTest, EncodeDecodeCycle) {
+  LevelDbLruGcProgressKey key;
+
+  auto encoded = LevelDbLruGcProgressKey::Key();
+  bool ok = key.Decode(encoded);
+  ASSERT_TRUE(ok);
+}
+
+TEST(LevelDbLruGcProgressKeyTest, Description) {
+  AssertExpectedKeyDescription("[lru_gc_progress:]",
+                               LevelDbLruGcProgressKey::Key());
+}
+
+TEST(LevelDbTableSizesKeyTest, EncodeDecodeCycle) {
+  LevelDbTableSizesKey key;
+
+  auto encoded = LevelDbTableSizesKey::Key();
+  bool ok = key.Decode(encoded);
+  ASSERT_TRUE(ok);
+}
+
+TEST(LevelDbTableSizesKeyTest, Description) {
+  AssertExpectedKeyDescription("[table_sizes:]", LevelDbTableSizesKey::Key());
+}
+
+TEST(LevelDbMigrationProgressKeyTest, EncodeDecodeCycle) {
+  LevelDbMigrationProgressKey key;
+
+  auto encoded = LevelDbMigrationProgressKey::Key();
+  bool ok = key.Decode(encoded);
+  ASSERT_TRUE(ok);
+}
+
+TEST(LevelDbMigrationProgressKeyTest, Description) {
+  AssertExpectedKeyDescription("[migration_progress:]",
+                               LevelDbMigrationProgressKey::Key());
+}
+
+TEST(LevelDbKeyTest, ExtractTableName) {
+  ASSERT_EQ("target_global", ExtractTableName(LevelDbTargetGlobalKey::Key()));
+  ASSERT_EQ("sequence_number",
+            ExtractTableName(LevelDbSequenceNumberKey::Key(5, 3)));
+  ASSERT_EQ("remote_document", ExtractTableName(LevelDbRemoteDocumentKey::Key(
+                                   testutil::Key("foo/bar"))));
+  ASSERT_EQ("", ExtractTableName(""));
+  ASSERT_EQ("", ExtractTableName("not a key"));
+}
+
 #undef AssertExpectedKeyDescription
 
 }  // namespace local
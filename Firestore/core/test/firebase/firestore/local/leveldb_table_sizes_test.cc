@@ -0,0 +1,73 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_table_sizes.h"
+
+#include <string>
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_key.h"
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+TEST(LevelDbTableSizesTest, AdjustsTablesAndTotal) {
+  LevelDbTableSizes sizes;
+  std::string target = LevelDbTargetKey::Key(1);
+  std::string document =
+      LevelDbRemoteDocumentKey::Key(testutil::Key("docs/1"));
+
+  sizes.Adjust(target, LevelDbTableSizes::RowSize(target, "abc"));
+  sizes.Adjust(document, 100);
+  sizes.Adjust(document, -40);
+
+  EXPECT_EQ(static_cast<int64_t>(target.size() + 3),
+            sizes.TableSize("target"));
+  EXPECT_EQ(60, sizes.TableSize("remote_document"));
+  EXPECT_EQ(0, sizes.TableSize("mutation"));
+  EXPECT_EQ(sizes.TableSize("target") + 60, sizes.total());
+}
+
+TEST(LevelDbTableSizesTest, EncodeDecodeCycle) {
+  LevelDbTableSizes sizes;
+  sizes.Adjust(LevelDbTargetGlobalKey::Key(), 12);
+  sizes.Adjust(LevelDbMutationQueueKey::Key("user"), int64_t{1} << 40);
+
+  LevelDbTableSizes decoded;
+  ASSERT_TRUE(decoded.Decode(sizes.Encode()));
+  EXPECT_EQ(sizes.tables(), decoded.tables());
+  EXPECT_EQ(sizes.total(), decoded.total());
+
+  ASSERT_TRUE(decoded.Decode(LevelDbTableSizes{}.Encode()));
+  EXPECT_TRUE(decoded.tables().empty());
+  EXPECT_EQ(0, decoded.total());
+}
+
+TEST(LevelDbTableSizesTest, RejectsUnrecognizedEncodings) {
+  LevelDbTableSizes sizes;
+  sizes.Adjust(LevelDbTargetGlobalKey::Key(), 12);
+  std::string encoded = sizes.Encode();
+
+  LevelDbTableSizes decoded;
+  EXPECT_FALSE(decoded.Decode(""));
+  EXPECT_FALSE(decoded.Decode(encoded.substr(0, encoded.size() - 1)));
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
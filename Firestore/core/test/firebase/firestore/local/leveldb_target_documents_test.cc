@@ -0,0 +1,75 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_target_documents.h"
+
+#include <string>
+#include <vector>
+
+#include "Firestore/core/test/firebase/firestore/testutil/testutil.h"
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+using model::DocumentKey;
+
+TEST(LevelDbTargetDocumentsTest, EncodeDecodeCycle) {
+  std::vector<DocumentKey> keys = {
+      testutil::Key("coll/a"), testutil::Key("coll/a/sub/b"),
+      testutil::Key("coll/a/sub/c"), testutil::Key("coll/b"),
+      testutil::Key("other/a"),
+  };
+
+  std::vector<DocumentKey> decoded;
+  ASSERT_TRUE(LevelDbTargetDocuments::DecodeBlock(
+      LevelDbTargetDocuments::EncodeBlock(keys), &decoded));
+  EXPECT_EQ(keys, decoded);
+
+  ASSERT_TRUE(LevelDbTargetDocuments::DecodeBlock(
+      LevelDbTargetDocuments::EncodeBlock({}), &decoded));
+  EXPECT_TRUE(decoded.empty());
+}
+
+TEST(LevelDbTargetDocumentsTest, SharesLeadingSegments) {
+  std::vector<DocumentKey> same_collection;
+  std::vector<DocumentKey> different_collections;
+  for (int i = 0; i < 10; i++) {
+    std::string id = std::to_string(i);
+    same_collection.push_back(testutil::Key("collection/" + id));
+    different_collections.push_back(
+        testutil::Key("collection" + id + "/" + id));
+  }
+
+  EXPECT_LT(LevelDbTargetDocuments::EncodeBlock(same_collection).size(),
+            LevelDbTargetDocuments::EncodeBlock(different_collections).size());
+}
+
+TEST(LevelDbTargetDocumentsTest, RejectsMalformedBlocks) {
+  std::vector<DocumentKey> decoded;
+  std::string encoded =
+      LevelDbTargetDocuments::EncodeBlock({testutil::Key("coll/a")});
+
+  EXPECT_FALSE(LevelDbTargetDocuments::DecodeBlock("", &decoded));
+  EXPECT_FALSE(LevelDbTargetDocuments::DecodeBlock(
+      encoded.substr(0, encoded.size() - 1), &decoded));
+  EXPECT_FALSE(LevelDbTargetDocuments::DecodeBlock(encoded + "x", &decoded));
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
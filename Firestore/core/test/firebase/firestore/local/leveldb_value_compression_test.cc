@@ -0,0 +1,120 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "Firestore/core/src/firebase/firestore/local/leveldb_value_compression.h"
+
+#include <string>
+#include <vector>
+
+#include "absl/strings/str_cat.h"
+#include "gtest/gtest.h"
+
+namespace firebase {
+namespace firestore {
+namespace local {
+
+namespace {
+
+/** Returns a value shaped like a serialized document with the given id. */
+std::string Document(int id) {
+  return absl::StrCat("\n projects/p/databases/d/documents/rooms/", id,
+                      "\x12\x0b\n\x04name\x12\x03", "abc", id,
+                      "\x12\x12\n\x0b" "description\x12\x03xyz",
+                      "\x12\x0b\n\x07" "created\x12\x00", id * 31);
+}
+
+}  // namespace
+
+TEST(LevelDbValueCompressionTest, DisabledStoresValuesAsIs) {
+  LevelDbValueCompressor compressor;
+  std::string value = Document(1) + std::string(200, 'a');
+  EXPECT_EQ(value, compressor.Encode(value));
+}
+
+TEST(LevelDbValueCompressionTest, RoundTrips) {
+  LevelDbValueCompressor compressor{LevelDbValueCompressionOptions::Default()};
+  std::string value = Document(1) + std::string(200, 'a');
+
+  std::string encoded = compressor.Encode(value);
+  EXPECT_TRUE(LevelDbValueCompressor::IsCompressed(encoded));
+  EXPECT_LT(encoded.size(), value.size());
+
+  std::string buffer;
+  EXPECT_EQ(value, compressor.Decode(encoded, &buffer));
+}
+
+TEST(LevelDbValueCompressionTest, ReadsUncompressedValues) {
+  LevelDbValueCompressor compressor{LevelDbValueCompressionOptions::Default()};
+
+  // Values written before compression existed, or too small to compress.
+  for (const std::string& value : {std::string{}, Document(1)}) {
+    std::string encoded = compressor.Encode(value);
+    EXPECT_FALSE(LevelDbValueCompressor::IsCompressed(encoded));
+
+    std::string buffer;
+    EXPECT_EQ(value, compressor.Decode(encoded, &buffer));
+    EXPECT_TRUE(buffer.empty());
+  }
+}
+
+TEST(LevelDbValueCompressionTest, CompressesWithDictionary) {
+  std::vector<std::string> samples;
+  for (int i = 0; i < 100; ++i) {
+    samples.push_back(Document(i));
+  }
+  std::string dictionary = LevelDbValueCompressor::TrainDictionary(samples);
+  EXPECT_FALSE(dictionary.empty());
+  EXPECT_LE(dictionary.size(), LevelDbValueCompressor::kMaxDictionarySize);
+
+  LevelDbValueCompressionOptions options =
+      LevelDbValueCompressionOptions::Default();
+  options.min_size = 0;
+  LevelDbValueCompressor compressor{options};
+  std::string value = Document(1000);
+  std::string without_dictionary = compressor.Encode(value);
+
+  compressor.AddDictionary(1, dictionary);
+  compressor.SetActiveDictionary(1);
+  std::string with_dictionary = compressor.Encode(value);
+  EXPECT_TRUE(LevelDbValueCompressor::IsCompressed(with_dictionary));
+  EXPECT_LT(with_dictionary.size(), without_dictionary.size());
+
+  // Values compressed with an older dictionary remain readable after switching.
+  compressor.AddDictionary(2, "unrelated");
+  compressor.SetActiveDictionary(2);
+  std::string buffer;
+  EXPECT_EQ(value, compressor.Decode(with_dictionary, &buffer));
+  EXPECT_EQ(2, compressor.max_dictionary_id());
+}
+
+TEST(LevelDbValueCompressionTest, RejectsOversizedValues) {
+  LevelDbValueCompressor compressor{LevelDbValueCompressionOptions::Default()};
+  std::string encoded = compressor.Encode(Document(1) + std::string(200, 'a'));
+  ASSERT_TRUE(LevelDbValueCompressor::IsCompressed(encoded));
+
+  // Claim an uncompressed size just past the limit.
+  uint32_t size = LevelDbValueCompressor::kMaxValueSize + 1;
+  for (int i = 0; i < 4; ++i) {
+    encoded[7 + i] = static_cast<char>((size >> (8 * i)) & 0xFF);
+  }
+  std::string buffer;
+  EXPECT_ANY_THROW(compressor.Decode(encoded, &buffer));
+  EXPECT_TRUE(buffer.empty());
+}
+
+}  // namespace local
+}  // namespace firestore
+}  // namespace firebase
@@ -26,6 +26,7 @@ namespace firestore {
 namespace local {
 
 using model::DocumentKey;
+using model::DocumentKeySet;
 
 TEST(ReferenceSetTest, AddOrRemoveReferences) {
   DocumentKey key = testutil::Key("foo/bar");
@@ -79,6 +80,36 @@ TEST(ReferenceSetTest, RemoteAllReferencesForTargetId) {
   EXPECT_FALSE(referenceSet.ContainsKey(key3));
 }
 
+TEST(ReferenceSetTest, AddsAndRemovesReferencesInBulk) {
+  DocumentKey key1 = testutil::Key("foo/bar");
+  DocumentKey key2 = testutil::Key("foo/baz");
+  DocumentKey key3 = testutil::Key("foo/blah");
+  ReferenceSet referenceSet{};
+
+  referenceSet.AddReferences(DocumentKeySet{key1, key2}, 1);
+  referenceSet.AddReferences(DocumentKeySet{key2, key3}, 2);
+  referenceSet.AddReferences(DocumentKeySet{key1}, 1);
+  EXPECT_EQ(4u, referenceSet.size());
+  EXPECT_EQ((DocumentKeySet{key1, key2}), referenceSet.ReferencedKeys(1));
+  EXPECT_EQ((DocumentKeySet{key2, key3}), referenceSet.ReferencedKeys(2));
+
+  referenceSet.RemoveReferences(DocumentKeySet{key2, key3}, 1);
+  EXPECT_EQ(3u, referenceSet.size());
+  EXPECT_EQ(DocumentKeySet{key1}, referenceSet.ReferencedKeys(1));
+  EXPECT_TRUE(referenceSet.ContainsKey(key2));
+
+  EXPECT_EQ((DocumentKeySet{key2, key3}), referenceSet.RemoveReferences(2));
+  EXPECT_FALSE(referenceSet.ContainsKey(key2));
+  EXPECT_FALSE(referenceSet.ContainsKey(key3));
+  EXPECT_EQ(DocumentKeySet{}, referenceSet.ReferencedKeys(2));
+  EXPECT_EQ(DocumentKeySet{}, referenceSet.RemoveReferences(2));
+
+  referenceSet.RemoveAllReferences();
+  EXPECT_TRUE(referenceSet.empty());
+  EXPECT_FALSE(referenceSet.ContainsKey(key1));
+  EXPECT_EQ(DocumentKeySet{}, referenceSet.ReferencedKeys(1));
+}
+
 }  // namespace local
 }  // namespace firestore
 }  // namespace firebase
@@ -574,6 +574,22 @@ TEST(FieldValue, GetNothing) {
   EXPECT_EQ(absl::nullopt, value.Get(testutil::Field("a.a")));
 }
 
+TEST(FieldValue, ToString) {
+  EXPECT_EQ("null", FieldValue::Null().ToString());
+  EXPECT_EQ("true", FieldValue::True().ToString());
+  EXPECT_EQ("42", FieldValue::FromInteger(42).ToString());
+  EXPECT_EQ("1.5", FieldValue::FromDouble(1.5).ToString());
+  EXPECT_EQ("foo", FieldValue::FromString("foo").ToString());
+  EXPECT_EQ("<616263>", FieldValue::FromBlob(Bytes("abc"), 3).ToString());
+  EXPECT_EQ("[1,foo]", FieldValue::FromArray({FieldValue::FromInteger(1),
+                                              FieldValue::FromString("foo")})
+                           .ToString());
+  EXPECT_EQ("{a:1,b:[]}",
+            FieldValue::FromMap({{"b", FieldValue::FromArray({})},
+                                 {"a", FieldValue::FromInteger(1)}})
+                .ToString());
+}
+
 }  //  namespace model
 }  //  namespace firestore
 }  //  namespace firebase
@@ -16,7 +16,9 @@
 
 #include "Firestore/core/src/firebase/firestore/remote/grpc_stream.h"
 
+#include <chrono>  // NOLINT(build/c++11)
 #include <functional>
+#include <future>  // NOLINT(build/c++11)
 #include <initializer_list>
 #include <memory>
 #include <string>
@@ -222,6 +224,50 @@ TEST_F(GrpcStreamTest, ReadIsAutomaticallyReadded) {
                                        "OnStreamRead(bar)"}));
 }
 
+TEST_F(GrpcStreamTest, ReadIsReaddedAfterResumingReads) {
+  worker_queue.EnqueueBlocking([&] {
+    stream->Start();
+    stream->PauseReads();
+  });
+
+  // The read issued on start still completes while reads are paused.
+  ForceFinish({{Type::Read, MakeByteBuffer("foo")}});
+  EXPECT_EQ(observed_states(), States({"OnStreamStart", "OnStreamRead(foo)"}));
+
+  worker_queue.EnqueueBlocking([&] { stream->ResumeReads(); });
+  ForceFinish({{Type::Read, MakeByteBuffer("bar")}});
+  EXPECT_EQ(observed_states(), States({"OnStreamStart", "OnStreamRead(foo)",
+                                       "OnStreamRead(bar)"}));
+}
+
+TEST_F(GrpcStreamTest, FinishesCallWithNoPendingReadWhileReadsArePaused) {
+  worker_queue.EnqueueBlocking([&] {
+    stream->Start();
+    stream->PauseReads();
+  });
+
+  // Once the read issued on start completes, the stream has no pending
+  // completions at all.
+  ForceFinish({{Type::Read, MakeByteBuffer("foo")}});
+
+  bool finished = false;
+  auto future = tester.ForceFinishAsync([&](GrpcCompletion* completion) {
+    if (!completion) {
+      // The queue has been shut down.
+      return true;
+    }
+    finished = completion->type() == Type::Finish;
+    completion->Complete(true);
+    return finished;
+  });
+
+  worker_queue.EnqueueBlocking([&] { stream->FinishImmediately(); });
+  EXPECT_EQ(future.wait_for(std::chrono::seconds(1)),
+            std::future_status::ready);
+  EXPECT_TRUE(finished);
+  EXPECT_EQ(observed_states(), States({"OnStreamStart", "OnStreamRead(foo)"}));
+}
+
 TEST_F(GrpcStreamTest, CanAddSeveralWrites) {
   worker_queue.EnqueueBlocking([&] { stream->Start(); });
 
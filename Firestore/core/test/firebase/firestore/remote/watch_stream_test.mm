@@ -0,0 +1,302 @@
+/*
+ * Copyright 2018 Google
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#import <Foundation/Foundation.h>
+
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "Firestore/core/src/firebase/firestore/model/database_id.h"
+#include "Firestore/core/src/firebase/firestore/remote/grpc_completion.h"
+#include "Firestore/core/src/firebase/firestore/remote/grpc_stream.h"
+#include "Firestore/core/src/firebase/firestore/remote/watch_stream.h"
+#include "Firestore/core/src/firebase/firestore/util/async_queue.h"
+#include "Firestore/core/src/firebase/firestore/util/executor_std.h"
+#include "Firestore/core/src/firebase/firestore/util/string_format.h"
+#include "Firestore/core/test/firebase/firestore/util/create_noop_connectivity_monitor.h"
+#include "Firestore/core/test/firebase/firestore/util/fake_credentials_provider.h"
+#include "Firestore/core/test/firebase/firestore/util/grpc_stream_tester.h"
+#include "absl/memory/memory.h"
+#include "grpcpp/client_context.h"
+#include "grpcpp/support/byte_buffer.h"
+#include "gtest/gtest.h"
+
+#import "Firestore/Protos/objc/google/firestore/v1/Firestore.pbobjc.h"
+#import "Firestore/Source/Remote/FSTSerializerBeta.h"
+#import "Firestore/Source/Remote/FSTStream.h"
+#import "Firestore/Source/Remote/FSTWatchChange.h"
+
+/** Records the calls a `WatchStream` makes to its delegate. */
+@interface FSTWatchStreamTestDelegate : NSObject <FSTWatchStreamDelegate>
+@property(nonatomic, assign) std::vector<std::string> observedStates;
+@end
+
+@implementation FSTWatchStreamTestDelegate
+
+- (void)watchStreamDidOpen {
+  _observedStates.push_back("Open");
+}
+
+- (void)watchStreamDidChange:(FSTWatchChange *)change
+             snapshotVersion:(const firebase::firestore::model::SnapshotVersion &)snapshotVersion {
+  FSTWatchTargetChange *targetChange = (FSTWatchTargetChange *)change;
+  _observedStates.push_back(
+      firebase::firestore::util::StringFormat("Change(%s)", targetChange.targetIDs[0]));
+}
+
+- (void)watchStreamWasInterruptedWithError:(nullable NSError *)error {
+  auto code = static_cast<firebase::firestore::FirestoreErrorCode>(error ? error.code : 0);
+  _observedStates.push_back("Close(" + firebase::firestore::util::GetFirestoreErrorCodeName(code) +
+                            ")");
+}
+
+@end
+
+namespace firebase {
+namespace firestore {
+namespace remote {
+
+using auth::CredentialsProvider;
+using auth::Token;
+using model::DatabaseId;
+using util::AsyncQueue;
+using util::CompletionResult::Error;
+using util::CreateNoOpConnectivityMonitor;
+using util::ExecutorStd;
+using util::FakeCredentialsProvider;
+using util::GrpcStreamTester;
+using util::MakeByteBuffer;
+using Type = GrpcCompletion::Type;
+
+namespace {
+
+grpc::ByteBuffer MakeByteBuffer(NSData *data) {
+  grpc::Slice slice{[data bytes], [data length]};
+  return grpc::ByteBuffer{&slice, 1};
+}
+
+/** A response from the server acknowledging the given target. */
+grpc::ByteBuffer AddTargetResponse(int target_id) {
+  GCFSListenResponse *response = [GCFSListenResponse message];
+  response.targetChange.targetChangeType = GCFSTargetChange_TargetChangeType_Add;
+  [response.targetChange.targetIdsArray addValue:target_id];
+  return MakeByteBuffer([response data]);
+}
+
+/**
+ * A `WatchStream` that decodes responses only when told to, so tests control
+ * the order in which decoding finishes.
+ */
+class TestWatchStream : public WatchStream {
+ public:
+  TestWatchStream(AsyncQueue *worker_queue,
+                  GrpcStreamTester *tester,
+                  CredentialsProvider *credentials_provider,
+                  FSTSerializerBeta *serializer,
+                  id<FSTWatchStreamDelegate> delegate)
+      : WatchStream{worker_queue, credentials_provider, serializer, tester->grpc_connection(),
+                    delegate},
+        tester_{tester} {
+  }
+
+  size_t pending_decodes() const {
+    return pending_decodes_.size();
+  }
+
+  /** Decodes the `index`-th response that hasn't been decoded yet. */
+  void FinishDecode(size_t index) {
+    std::function<void()> decode = std::move(pending_decodes_[index]);
+    pending_decodes_.erase(pending_decodes_.begin() + index);
+    decode();
+  }
+
+  grpc::ClientContext *context() {
+    return context_;
+  }
+
+ private:
+  std::unique_ptr<GrpcStream> CreateGrpcStream(GrpcConnection *, const Token &) override {
+    auto result = tester_->CreateStream(this);
+    context_ = result->context();
+    return result;
+  }
+
+  void ScheduleDecode(std::function<void()> decode) override {
+    pending_decodes_.push_back(std::move(decode));
+  }
+
+  GrpcStreamTester *tester_ = nullptr;
+  std::vector<std::function<void()>> pending_decodes_;
+  grpc::ClientContext *context_ = nullptr;
+};
+
+}  // namespace
+
+class WatchStreamTest : public testing::Test {
+ public:
+  WatchStreamTest()
+      : worker_queue{absl::make_unique<ExecutorStd>()},
+        connectivity_monitor{CreateNoOpConnectivityMonitor()},
+        tester{&worker_queue, connectivity_monitor.get()},
+        database_id{"p", "d"},
+        delegate{[[FSTWatchStreamTestDelegate alloc] init]},
+        watch_stream{std::make_shared<TestWatchStream>(
+            &worker_queue, &tester, &credentials,
+            [[FSTSerializerBeta alloc] initWithDatabaseID:&database_id], delegate)} {
+  }
+
+  ~WatchStreamTest() {
+    worker_queue.EnqueueBlocking([&] {
+      if (watch_stream->IsStarted()) {
+        tester.KeepPollingGrpcQueue();
+        watch_stream->Stop();
+      }
+    });
+    tester.Shutdown();
+  }
+
+  void StartStream() {
+    worker_queue.EnqueueBlocking([&] { watch_stream->Start(); });
+    worker_queue.EnqueueBlocking([] {});
+  }
+
+  /** Receives the given responses from the server, one at a time. */
+  void ReceiveResponses(std::initializer_list<int> target_ids) {
+    for (int target_id : target_ids) {
+      tester.ForceFinish(watch_stream->context(), {{Type::Read, AddTargetResponse(target_id)}});
+    }
+  }
+
+  /** Decodes the `index`-th response that hasn't been decoded yet. */
+  void FinishDecode(size_t index) {
+    worker_queue.EnqueueBlocking([&] { watch_stream->FinishDecode(index); });
+    // Let the decoded response reach the stream.
+    worker_queue.EnqueueBlocking([] {});
+  }
+
+  size_t pending_decodes() {
+    size_t result = 0;
+    worker_queue.EnqueueBlocking([&] { result = watch_stream->pending_decodes(); });
+    return result;
+  }
+
+  std::vector<std::string> observed_states() {
+    std::vector<std::string> result;
+    worker_queue.EnqueueBlocking([&] { result = delegate.observedStates; });
+    return result;
+  }
+
+  std::vector<std::string> States(std::initializer_list<std::string> states) {
+    return {states};
+  }
+
+  AsyncQueue worker_queue;
+
+  std::unique_ptr<ConnectivityMonitor> connectivity_monitor;
+  GrpcStreamTester tester;
+
+  DatabaseId database_id;
+  FakeCredentialsProvider credentials;
+  FSTWatchStreamTestDelegate *delegate;
+  std::shared_ptr<TestWatchStream> watch_stream;
+};
+
+TEST_F(WatchStreamTest, DeliversResponsesInOrderReceived) {
+  StartStream();
+  ReceiveResponses({1, 2, 3});
+  ASSERT_EQ(pending_decodes(), 3u);
+
+  // The third response can't be delivered before the first two.
+  FinishDecode(2);
+  EXPECT_EQ(observed_states(), States({"Open"}));
+
+  FinishDecode(0);
+  EXPECT_EQ(observed_states(), States({"Open", "Change(1)"}));
+
+  FinishDecode(0);
+  EXPECT_EQ(observed_states(), States({"Open", "Change(1)", "Change(2)", "Change(3)"}));
+}
+
+TEST_F(WatchStreamTest, ResumesReadingAfterBackpressure) {
+  StartStream();
+
+  // The read for the next response is issued before the stream learns that
+  // one too many responses are in flight, so one more response gets through.
+  int received = static_cast<int>(WatchStream::kMaxResponsesInFlight) + 1;
+  for (int target_id = 1; target_id <= received; ++target_id) {
+    ReceiveResponses({target_id});
+  }
+  ASSERT_EQ(pending_decodes(), static_cast<size_t>(received));
+
+  // Reading stays paused until the delegate catches up; delivering the first
+  // two responses makes room for another.
+  FinishDecode(0);
+  FinishDecode(0);
+  ReceiveResponses({received + 1});
+
+  while (pending_decodes() > 0) {
+    FinishDecode(0);
+  }
+
+  std::vector<std::string> expected{"Open"};
+  for (int target_id = 1; target_id <= received + 1; ++target_id) {
+    expected.push_back(util::StringFormat("Change(%s)", target_id));
+  }
+  EXPECT_EQ(observed_states(), expected);
+}
+
+TEST_F(WatchStreamTest, DeliversResponsesReceivedBeforeServerClose) {
+  StartStream();
+  ReceiveResponses({1, 2});
+
+  tester.ForceFinish(watch_stream->context(),
+                     {{Type::Read, Error}, {Type::Finish, grpc::Status{grpc::UNAVAILABLE, ""}}});
+  worker_queue.EnqueueBlocking([&] { EXPECT_TRUE(watch_stream->IsOpen()); });
+  EXPECT_EQ(observed_states(), States({"Open"}));
+
+  FinishDecode(1);
+  EXPECT_EQ(observed_states(), States({"Open"}));
+
+  FinishDecode(0);
+  worker_queue.EnqueueBlocking([&] { EXPECT_FALSE(watch_stream->IsStarted()); });
+  EXPECT_EQ(observed_states(), States({"Open", "Change(1)", "Change(2)", "Close(Unavailable)"}));
+}
+
+TEST_F(WatchStreamTest, ParseErrorClosesStream) {
+  StartStream();
+  ReceiveResponses({1});
+  tester.ForceFinish(watch_stream->context(), {{Type::Read, MakeByteBuffer("not a proto")}});
+  ReceiveResponses({3});
+
+  FinishDecode(2);
+  FinishDecode(1);
+  EXPECT_EQ(observed_states(), States({"Open"}));
+
+  // Closing the stream waits for the finish operation to complete. The
+  // response after the malformed one is never delivered.
+  tester.KeepPollingGrpcQueue();
+  FinishDecode(0);
+  worker_queue.EnqueueBlocking([&] { EXPECT_FALSE(watch_stream->IsStarted()); });
+  EXPECT_EQ(observed_states(), States({"Open", "Change(1)", "Close(Internal)"}));
+}
+
+}  // namespace remote
+}  // namespace firestore
+}  // namespace firebase
@@ -134,6 +134,16 @@ TEST(HashingTest, Composite) {
   EXPECT_EQ(expected, Hash(1, 2, 3));
 }
 
+TEST(HashingTest, Fingerprint64) {
+  // Published FNV-1a test vectors.
+  EXPECT_EQ(0xcbf29ce484222325ULL, Fingerprint64(""));
+  EXPECT_EQ(0xaf63dc4c8601ec8cULL, Fingerprint64("a"));
+  EXPECT_EQ(0x85944171f73967e8ULL, Fingerprint64("foobar"));
+
+  EXPECT_EQ(Fingerprint64(std::string{"coll|f:|ob:__name__asc"}),
+            Fingerprint64("coll|f:|ob:__name__asc"));
+}
+
 }  // namespace util
 }  // namespace firestore
 }  // namespace firebase